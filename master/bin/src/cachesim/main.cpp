@@ -0,0 +1,267 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   main.cpp
+// header n/a
+// info   Replays a memory access trace recorded with "swarm -T" through one
+//        or more cache setups, using the same cache classes as SWARM.
+//        Usage:
+//
+//          cachesim [-c spec] [-s ispec,dspec] ... tracefile
+//
+//        -c adds a shared cache, -s a split instruction/data pair. Specs
+//        are as for swarm: size[:line[:ways[:rr|random]]]. With no caches
+//        given the SWARM default is used. All the setups are run in the
+//        one pass over the trace.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "swarm.h"
+#include "cache.h"
+#include "trace.h"
+
+#define MAX_SETUPS   16
+#define BATCH_SIZE   4096
+#define DEFAULT_SPEC "8192:16:4:rr"
+
+#define USAGE "Usage: cachesim [-c spec] [-s ispec,dspec] ... tracefile\n" \
+              "       specs are size[:line[:ways[:rr|random]]]\n"
+
+typedef struct STAG
+{
+  char*    strName;
+  CCache*  pICache;
+  CCache*  pDCache;      // Same as pICache if shared
+  uint32_t iLineMask;    // In words
+  uint32_t dLineMask;
+  uint64_t accesses[3];  // Indexed by TRACE_TYPE
+  uint64_t misses[3];
+} SETUP;
+
+static uint32_t line[MAX_LINESIZE / 4];
+
+
+///////////////////////////////////////////////////////////////////////////////
+// make_cache - Builds a cache from a spec, or exits if we can't.
+//
+static CCache* make_cache(const char* strSpec)
+{
+  CACHECONFIG config;
+
+  InitCacheConfig(&config, 8192);
+  if (!ParseCacheConfig(strSpec, &config))
+    {
+      fprintf(stderr, "Bad cache spec %s\n" USAGE, strSpec);
+      exit(EXIT_FAILURE);
+    }
+
+  try
+    {
+      return CreateCache(&config);
+    }
+  catch (CCacheConfigException &e)
+    {
+      fprintf(stderr, "%s: %s\n", strSpec, e.StrError());
+      exit(EXIT_FAILURE);
+    }
+
+  return NULL;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add_setup - Fills in a setup given the caches for it.
+//
+static void add_setup(SETUP* pSetup, const char* strName, CCache* pICache,
+		      CCache* pDCache)
+{
+  memset(pSetup, 0, sizeof(SETUP));
+
+  pSetup->strName = strdup(strName);
+  pSetup->pICache = pICache;
+  pSetup->pDCache = pDCache;
+  pSetup->iLineMask = ~(pICache->GetLineWords() - 1);
+  pSetup->dLineMask = ~(pDCache->GetLineWords() - 1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// run_batch - Pushes a batch of accesses through a setup. This mirrors what
+//             CArmProc does: reads fill a line on a miss, writes go through
+//             and only update the cache if the line is already there.
+//
+static void run_batch(SETUP* pSetup, TRACEREC* pRecs, uint32_t nRecs)
+{
+  uint32_t word;
+
+  for (uint32_t i = 0; i < nRecs; i++)
+    {
+      uint32_t addr = pRecs[i].addr >> 2;
+      uint32_t type = pRecs[i].type;
+
+      pSetup->accesses[type]++;
+
+      if (type == TR_FETCH)
+	{
+	  if (!pSetup->pICache->Lookup(addr, &word))
+	    {
+	      pSetup->misses[TR_FETCH]++;
+	      pSetup->pICache->WriteLine(addr & pSetup->iLineMask, line);
+	    }
+	}
+      else if (!pSetup->pDCache->Lookup(addr, &word))
+	{
+	  pSetup->misses[type]++;
+	  if (type == TR_LOAD)
+	    pSetup->pDCache->WriteLine(addr & pSetup->dLineMask, line);
+	}
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//
+int main(int argc, char* argv[])
+{
+  SETUP setups[MAX_SETUPS];
+  int nSetups = 0;
+  char* strTrace = NULL;
+
+  for (int i = 1; i < argc; i++)
+    {
+      if ((argv[i][0] == '-') && (i + 1 < argc) && (nSetups < MAX_SETUPS))
+	{
+	  switch (argv[i][1])
+	    {
+	    case 'c':
+	      {
+		CCache* pCache = make_cache(argv[++i]);
+		add_setup(&setups[nSetups++], argv[i], pCache, pCache);
+	      }
+	      continue;
+	    case 's':
+	      {
+		char* strI = strdup(argv[++i]);
+		char* strD = strchr(strI, ',');
+		if (strD == NULL)
+		  {
+		    fprintf(stderr, USAGE);
+		    exit(EXIT_FAILURE);
+		  }
+		*strD++ = '\0';
+		add_setup(&setups[nSetups++], argv[i], make_cache(strI),
+			  make_cache(strD));
+		free(strI);
+	      }
+	      continue;
+	    }
+	}
+
+      if (argv[i][0] == '-')
+	{
+	  fprintf(stderr, USAGE);
+	  exit(EXIT_FAILURE);
+	}
+      strTrace = argv[i];
+    }
+
+  if (strTrace == NULL)
+    {
+      fprintf(stderr, USAGE);
+      exit(EXIT_FAILURE);
+    }
+
+  if (nSetups == 0)
+    {
+      CCache* pCache = make_cache(DEFAULT_SPEC);
+      add_setup(&setups[nSetups++], DEFAULT_SPEC, pCache, pCache);
+    }
+
+  CTraceReader* pReader;
+  try
+    {
+      pReader = new CTraceReader(strTrace);
+    }
+  catch (CTraceException &e)
+    {
+      fprintf(stderr, "%s\n", e.StrError());
+      exit(EXIT_FAILURE);
+    }
+
+  TRACEREC* pRecs = new TRACEREC[BATCH_SIZE];
+  uint64_t nTotal = 0;
+  uint32_t n;
+  struct timeval start, end;
+
+  gettimeofday(&start, NULL);
+
+  try
+    {
+      // Each batch goes through every setup while it's still warm in the
+      // host's cache.
+      while ((n = pReader->Read(pRecs, BATCH_SIZE)) != 0)
+	{
+	  for (int i = 0; i < nSetups; i++)
+	    run_batch(&setups[i], pRecs, n);
+	  nTotal += n;
+	}
+    }
+  catch (CTraceException &e)
+    {
+      fprintf(stderr, "%s (after %llu accesses)\n", e.StrError(),
+	      (unsigned long long)nTotal);
+    }
+
+  gettimeofday(&end, NULL);
+
+  double secs = (end.tv_sec - start.tv_sec) +
+    ((end.tv_usec - start.tv_usec) / 1000000.0);
+
+  printf("%llu accesses in %.3fs (%.1fM accesses/s per setup)\n",
+	 (unsigned long long)nTotal, secs,
+	 secs > 0 ? (nTotal * nSetups) / (secs * 1000000.0) : 0.0);
+
+  for (int i = 0; i < nSetups; i++)
+    {
+      SETUP* p = &setups[i];
+      uint64_t nAcc = p->accesses[0] + p->accesses[1] + p->accesses[2];
+      uint64_t nMiss = p->misses[0] + p->misses[1] + p->misses[2];
+
+      printf("%-24s fetch %llu/%llu load %llu/%llu store %llu/%llu "
+	     "miss rate %.3f%%\n", p->strName,
+	     (unsigned long long)p->misses[TR_FETCH],
+	     (unsigned long long)p->accesses[TR_FETCH],
+	     (unsigned long long)p->misses[TR_LOAD],
+	     (unsigned long long)p->accesses[TR_LOAD],
+	     (unsigned long long)p->misses[TR_STORE],
+	     (unsigned long long)p->accesses[TR_STORE],
+	     nAcc != 0 ? (nMiss * 100.0) / nAcc : 0.0);
+
+      if (p->pDCache != p->pICache)
+	delete p->pDCache;
+      delete p->pICache;
+      free(p->strName);
+    }
+
+  delete[] pRecs;
+  delete pReader;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+###############################################################################
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+#
+# file   common.mk
+# header n/a
+# info   Included by the Makefiles of the tools that build their own copy
+#        of the whole simulator from the SWARM source (swarmbench and
+#        swarmfuzz), with QUIET so the core's tracing stays out of the
+#        way. Each provides its own main.o and link rule.
+#
+###############################################################################
+
+CC    = c++
+ROOT  = ../../..
+SRC   = $(ROOT)/src
+ARCH  = `$(ROOT)/bin/scripts/arch`
+
+CFLAGS = -O3 -Wno-deprecated -I$(SRC) -D$(ARCH) -DSHARED_CACHE \
+         -DSWARM_SWI_HANDLER -DQUIET
+LIBS   = -lpthread
+
+OBJS = main.o core.o alu.o cache.o direct.o swarm.o swi.o armproc.o \
+       associative.o disarm.o copro.o syscopro.o ostimer.o intctrl.o \
+       booth.o lcdctrl.o setassoc.o trace.o dram.o cachestats.o \
+       uartctrl.o device.o dmactrl.o blockdev.o netdev.o rtc.o stats.o \
+       perfmon.o refarm.o cosim.o gdbstub.o elfimage.o
+BASIC = Makefile ../common.mk $(SRC)/swarm.h $(SRC)/swarm_types.h \
+        $(SRC)/swarm_macros.h
+
+# Everything but main.o is a straight copy of the simulator's. Rather than
+# list each one's headers again, they're all rebuilt when any header
+# changes.
+%.o: $(SRC)/%.cpp $(BASIC) $(wildcard $(SRC)/*.h)
+	$(CC) $(CFLAGS) -c $<
+
+core.o: $(SRC)/memory.cpp
@@ -0,0 +1,487 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   main.cpp
+// header n/a
+// info   Benchmarks SWARM's hot paths, and compares the results with a
+//        baseline so slowdowns get noticed. Usage:
+//
+//          swarmbench [-b baseline [-w]] [-t percent] [-s swarm] [-a dir]
+//                     [-q]
+//
+//        The micro benchmarks run the core on synthetic instruction
+//        streams, each cache implementation on its own, and the ALU
+//        functions. They are built from this directory with QUIET, so
+//        the core's tracing doesn't swamp them. The macro benchmarks run
+//        the test apps in dir with the real swarm binary, and take its
+//        MIPS from "-P 0". Their stdout, a line or more each cycle, goes
+//        to /dev/null so it isn't the pipe being timed. -q leaves them
+//        out.
+//
+//        With -b each result is compared with the one in the baseline
+//        file, and anything more than percent (15) slower is flagged and
+//        makes us exit with 1. -w writes the results to the baseline
+//        instead, as does -b with a baseline that doesn't exist yet.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "swarm.h"
+#include "armproc.h"
+#include "cache.h"
+#include "alu.h"
+
+#define MEMORY_SIZE  (1024 * 64)
+#define DATA_BASE    0x8000
+#define LOOP_BASE    0x20
+#define LOOP_LEN     64         // Instructions in a loop body
+#define CORE_INSTS   1000000
+#define CACHE_OPS    20000000
+#define ALU_OPS      50000000
+#define RUNS         3          // We keep the best, as noise only slows
+#define MAX_RESULTS  32
+
+#define DEFAULT_SWARM     "../../../src/swarm"
+#define DEFAULT_APPS      "../../../test_apps"
+#define DEFAULT_THRESHOLD 15.0
+
+#define USAGE "Usage: swarmbench [-b baseline [-w]] [-t percent] [-s swarm] " \
+              "[-a dir] [-q]\n"
+
+typedef struct RTAG
+{
+  const char* strName;
+  double      rate;       // Millions of things a second
+  const char* strUnit;
+} RESULT;
+
+static RESULT s_results[MAX_RESULTS];
+static uint32_t s_nResults = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// The instruction streams. Each is a loop body, repeated to fill LOOP_LEN
+// instructions and then branched back to the start of. Before the loop
+// r1 points at DATA_BASE, r2 = 1, r3 = 3, r4 = 5 and Z is set.
+//
+typedef struct STAG
+{
+  const char*     strName;
+  const uint32_t* pBody;
+  uint32_t        nLen;
+} STREAM;
+
+static const uint32_t s_setup[] = {
+  0xE3A01902,   // mov   r1, #0x8000
+  0xE3A02001,   // mov   r2, #1
+  0xE3A03003,   // mov   r3, #3
+  0xE3A04005,   // mov   r4, #5
+  0xE3520001,   // cmp   r2, #1
+};
+
+static const uint32_t s_dpi[] = {
+  0xE0825003,   // add   r5, r2, r3
+  0xE0256004,   // eor   r6, r5, r4
+  0xE0467002,   // sub   r7, r6, r2
+  0xE1878003,   // orr   r8, r7, r3
+};
+
+static const uint32_t s_shift[] = {
+  0xE0825103,   // add   r5, r2, r3, lsl #2
+  0xE0256124,   // eor   r6, r5, r4, lsr #2
+  0xE0467142,   // sub   r7, r6, r2, asr #2
+  0xE1878473,   // orr   r8, r7, r3, ror r4
+};
+
+static const uint32_t s_ldrstr[] = {
+  0xE5815004,   // str   r5, [r1, #4]
+  0xE5916004,   // ldr   r6, [r1, #4]
+  0xE5C17009,   // strb  r7, [r1, #9]
+  0xE5D18009,   // ldrb  r8, [r1, #9]
+};
+
+static const uint32_t s_ldmstm[] = {
+  0xE88103FC,   // stmia r1, {r2-r9}
+  0xE89103FC,   // ldmia r1, {r2-r9}
+};
+
+static const uint32_t s_mul[] = {
+  0xE0050392,   // mul   r5, r2, r3
+  0xE0265392,   // mla   r6, r2, r3, r5
+  0xE0887392,   // umull r7, r8, r2, r3
+};
+
+static const uint32_t s_branch[] = {
+  0xEAFFFFFF,   // b     .+4
+  0x1AFFFFFF,   // bne   .+4 (not taken)
+  0x0AFFFFFF,   // beq   .+4
+};
+
+static const STREAM s_streams[] = {
+  {"core.dpi",    s_dpi,    sizeof(s_dpi) / 4},
+  {"core.shift",  s_shift,  sizeof(s_shift) / 4},
+  {"core.ldrstr", s_ldrstr, sizeof(s_ldrstr) / 4},
+  {"core.ldmstm", s_ldmstm, sizeof(s_ldmstm) / 4},
+  {"core.mul",    s_mul,    sizeof(s_mul) / 4},
+  {"core.branch", s_branch, sizeof(s_branch) / 4},
+};
+
+typedef struct CTAG
+{
+  const char* strName;
+  const char* strSpec;
+} CACHEBENCH;
+
+static const CACHEBENCH s_caches[] = {
+  {"cache.direct",   "8192:16:1"},
+  {"cache.setassoc", "8192:16:4"},
+  {"cache.assoc",    "1024:16:0"},
+};
+
+static const char* s_apps[] = {"test1", "filter", "test3"};
+
+static uint8_t s_memory[MEMORY_SIZE];
+
+
+///////////////////////////////////////////////////////////////////////////////
+// now - Host seconds.
+//
+static double now()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add_result - Keeps the best of the runs of each benchmark.
+//
+static void add_result(const char* strName, double rate, const char* strUnit)
+{
+  for (uint32_t i = 0; i < s_nResults; i++)
+    if (strcmp(s_results[i].strName, strName) == 0)
+      {
+	if (rate > s_results[i].rate)
+	  s_results[i].rate = rate;
+	return;
+      }
+
+  if (s_nResults == MAX_RESULTS)
+    return;
+  s_results[s_nResults].strName = strName;
+  s_results[s_nResults].rate = rate;
+  s_results[s_nResults].strUnit = strUnit;
+  s_nResults++;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_core - Runs CORE_INSTS instructions of a stream through a fresh
+//              processor and memory. Returns MIPS.
+//
+static double bench_core(const STREAM* pStream)
+{
+  uint32_t* pWords = (uint32_t*)s_memory;
+  uint32_t n = 0;
+  CACHECONFIG config;
+  PINOUT pinout;
+
+  memset(s_memory, 0, MEMORY_SIZE);
+  for (uint32_t i = 0; i < sizeof(s_setup) / 4; i++)
+    pWords[n++] = s_setup[i];
+  while (n < (LOOP_BASE / 4))
+    pWords[n++] = 0xE1A00000;   // mov r0, r0
+  for (uint32_t i = 0; i < LOOP_LEN; i++)
+    pWords[n++] = pStream->pBody[i % pStream->nLen];
+  pWords[n] = 0xEA000000 | ((((LOOP_BASE - (n * 4)) - 8) >> 2) & 0xFFFFFF);
+
+  InitCacheConfig(&config, 1024 * 8);
+  CArmProc* pArm = new CArmProc(&config, NULL);
+
+  memset(&pinout, 0, sizeof(pinout));
+  pinout.fiq = 1;
+  pinout.irq = 1;
+
+  double start = now();
+  while (pArm->GetInstructions() < CORE_INSTS)
+    {
+      pArm->Cycle(&pinout);
+      if (pinout.benable == 0)
+	continue;
+
+      // The same as the loop in swarm's main, bar the endian swaps
+      uint32_t addr = pinout.address % MEMORY_SIZE;
+      if (pinout.rw == 1)
+	switch (pinout.bw)
+	  {
+	  case 0:
+	    *((uint32_t*)(s_memory + (addr & ~0x3))) = pinout.data;
+	    break;
+	  case 1:
+	    s_memory[addr] = (uint8_t)pinout.data;
+	    break;
+	  case 2:
+	    *((uint16_t*)(s_memory + (addr & ~0x1))) = (uint16_t)pinout.data;
+	    break;
+	  }
+      else
+	pinout.data = *((uint32_t*)(s_memory + (addr & ~0x3)));
+    }
+  double secs = now() - start;
+
+  delete pArm;
+
+  return CORE_INSTS / (secs * 1000000.0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_cache - Looks up CACHE_OPS word addresses, mostly within a working
+//               set that fits in the cache, filling the line on each miss.
+//               Returns millions of lookups a second.
+//
+static double bench_cache(const char* strSpec)
+{
+  CACHECONFIG config;
+  uint32_t line[MAX_LINESIZE / 4];
+  uint32_t word, rand = 1;
+
+  InitCacheConfig(&config, 1024 * 8);
+  ParseCacheConfig(strSpec, &config);
+  CCache* pCache = CreateCache(&config);
+
+  uint32_t nSetWords = (config.nSize >> 2) - 1;
+  uint32_t nLineMask = ~(pCache->GetLineWords() - 1);
+  memset(line, 0, sizeof(line));
+
+  double start = now();
+  for (uint32_t i = 0; i < CACHE_OPS; i++)
+    {
+      // One in sixteen goes outside the working set
+      rand = (rand * 1103515245) + 12345;
+      uint32_t addr = (rand >> 8) & nSetWords;
+      if ((rand & 0xF00000) == 0)
+	addr += nSetWords + 1;
+
+      if (!pCache->Lookup(addr, &word))
+	pCache->WriteLine(addr & nLineMask, line);
+    }
+  double secs = now() - start;
+
+  delete pCache;
+
+  return CACHE_OPS / (secs * 1000000.0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_alu - Calls every ALU function ALU_OPS times between them. Returns
+//             millions of operations a second.
+//
+static double bench_alu()
+{
+  static alu_fn* const fns[] = {and_op, eor_op, sub_op, rsb_op,
+				add_op, adc_op, sbc_op, rsc_op,
+				tst_op, teq_op, cmp_op, cmn_op,
+				orr_op, mov_op, bic_op, mvn_op};
+  uint32_t a = 0x12345678, b = 0x9ABCDEF0, cond = 0;
+
+  double start = now();
+  for (uint32_t i = 0; i < ALU_OPS; i++)
+    {
+      a = fns[i & 0xF](a, b, &cond) ^ i;
+      b += cond;
+    }
+  double secs = now() - start;
+
+  // So the compiler can't throw the loop away
+  if ((a == 0) && (b == 0))
+    printf("\n");
+
+  return ALU_OPS / (secs * 1000000.0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_app - Runs a test app with swarm and takes the MIPS it reports on
+//             stderr.
+//             Returns 0 if it didn't report any.
+//
+static double bench_app(const char* strSwarm, const char* strApps,
+			const char* strApp)
+{
+  char strCmd[1024];
+  char strLine[256];
+  double mips = 0;
+
+  snprintf(strCmd, sizeof(strCmd), "cd '%s' && '%s' %s -P 0 2>&1 >/dev/null",
+	   strApps, strSwarm, strApp);
+  FILE* fp = popen(strCmd, "r");
+  if (fp == NULL)
+    return 0;
+
+  while (fgets(strLine, sizeof(strLine), fp) != NULL)
+    sscanf(strLine, "Perf rates: MIPS = %lf", &mips);
+  pclose(fp);
+
+  return mips;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// read_baseline - Finds strName's rate in the baseline file. Returns FALSE
+//                 if it isn't there.
+//
+static bool_t read_baseline(FILE* fp, const char* strName, double* pRate)
+{
+  char strLine[256], strKey[128];
+  double rate;
+
+  rewind(fp);
+  while (fgets(strLine, sizeof(strLine), fp) != NULL)
+    if ((sscanf(strLine, "%127s %lf", strKey, &rate) == 2) &&
+	(strcmp(strKey, strName) == 0))
+      {
+	*pRate = rate;
+	return TRUE;
+      }
+
+  return FALSE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// main -
+//
+int main(int argc, char* argv[])
+{
+  const char* strBaseline = NULL;
+  const char* strSwarm = DEFAULT_SWARM;
+  const char* strApps = DEFAULT_APPS;
+  double threshold = DEFAULT_THRESHOLD;
+  bool_t bWrite = FALSE, bMacro = TRUE;
+  int c;
+
+  while ((c = getopt(argc, argv, "b:wt:s:a:q")) != -1)
+    switch (c)
+      {
+      case 'b': strBaseline = optarg; break;
+      case 'w': bWrite = TRUE; break;
+      case 't': threshold = atof(optarg); break;
+      case 's': strSwarm = optarg; break;
+      case 'a': strApps = optarg; break;
+      case 'q': bMacro = FALSE; break;
+      default:
+	fprintf(stderr, USAGE);
+	return 2;
+      }
+  if (bWrite && (strBaseline == NULL))
+    {
+      fprintf(stderr, USAGE);
+      return 2;
+    }
+
+  // The swarm binary is run from the apps directory
+  char strPath[1024];
+  if ((strSwarm[0] != '/') && (getcwd(strPath, sizeof(strPath) - 256) != NULL))
+    {
+      strcat(strPath, "/");
+      strncat(strPath, strSwarm, 255);
+      strSwarm = strPath;
+    }
+
+  for (uint32_t r = 0; r < RUNS; r++)
+    {
+      for (uint32_t i = 0; i < sizeof(s_streams) / sizeof(STREAM); i++)
+	add_result(s_streams[i].strName, bench_core(&s_streams[i]), "MIPS");
+      for (uint32_t i = 0; i < sizeof(s_caches) / sizeof(CACHEBENCH); i++)
+	add_result(s_caches[i].strName, bench_cache(s_caches[i].strSpec),
+		   "Mlookups/s");
+      add_result("alu", bench_alu(), "Mops/s");
+    }
+
+  // These take long enough on their own to be steady
+  if (bMacro)
+    for (uint32_t i = 0; i < sizeof(s_apps) / sizeof(char*); i++)
+      {
+	double mips = bench_app(strSwarm, strApps, s_apps[i]);
+	if (mips == 0)
+	  fprintf(stderr, "Couldn't run %s/%s with %s\n", strApps, s_apps[i],
+		  strSwarm);
+	else
+	  add_result(s_apps[i], mips, "MIPS");
+      }
+
+  // Compare with the baseline, or make one
+  FILE* fp = NULL;
+  if ((strBaseline != NULL) && !bWrite)
+    {
+      fp = fopen(strBaseline, "r");
+      if (fp == NULL)
+	{
+	  printf("No baseline in %s, so writing one\n", strBaseline);
+	  bWrite = TRUE;
+	}
+    }
+
+  int nSlower = 0;
+  for (uint32_t i = 0; i < s_nResults; i++)
+    {
+      double base;
+
+      printf("%-14s %10.3f %-10s", s_results[i].strName, s_results[i].rate,
+	     s_results[i].strUnit);
+      if ((fp != NULL) && read_baseline(fp, s_results[i].strName, &base))
+	{
+	  double change = ((s_results[i].rate - base) * 100.0) / base;
+	  printf(" %+6.1f%%", change);
+	  if (change < -threshold)
+	    {
+	      printf("  SLOWER");
+	      nSlower++;
+	    }
+	}
+      printf("\n");
+    }
+  if (fp != NULL)
+    fclose(fp);
+
+  if (bWrite)
+    {
+      fp = fopen(strBaseline, "w");
+      if (fp == NULL)
+	{
+	  perror(strBaseline);
+	  return 2;
+	}
+      for (uint32_t i = 0; i < s_nResults; i++)
+	fprintf(fp, "%s %.3f\n", s_results[i].strName, s_results[i].rate);
+      fclose(fp);
+    }
+
+  if (nSlower != 0)
+    {
+      printf("%d benchmark(s) more than %.0f%% slower than %s\n", nSlower,
+	     threshold, strBaseline);
+      return 1;
+    }
+
+  return 0;
+}
@@ -0,0 +1,828 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   main.cpp
+// header n/a
+// info   Fuzzes the core. Usage:
+//
+//          swarmfuzz [-n runs] [-s seed] [-l length] [-j jobs]
+//                    [-c classes] [-o dir] [-k] [-a]
+//
+//        Each run generates a random program of length instructions from
+//        the classes given (dp, mem, half, ldm, psr, mul and branch, comma
+//        separated - all of them by default), and runs it on the core with
+//        the co-simulation checker (cosim.h) comparing every instruction
+//        against the reference interpreter. The registers of every mode
+//        start out random, and the loads and stores work on random data.
+//
+//        The known differences between the core and the reference (see
+//        README-INFO) are left out, so a clean run means nothing has got
+//        worse: immediate MSR, mode changes, MVNS and ORRS, immediate LSR
+//        and ASR by 32, multiplies with S, long multiplies, and LDMDA and
+//        STMDA. -a puts them back in.
+//
+//        When they disagree the program is cut down to the fewest
+//        instructions that still show it, by turning the rest into no-ops,
+//        and printed with the checker's report. With -o the memory image
+//        is saved too, as seed.bin, which swarm will run. The setup code
+//        before the program changes mode with MSR, so swarm's own -C
+//        stops at that known difference; we only check the program.
+//
+//        Run n uses seed + n, so any failure can be had again with -s and
+//        -n 1. The runs are shared between jobs processes (one for each
+//        host processor by default). Each stops at its first failure
+//        unless -k is given. We exit with 1 if anything failed.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "swarm.h"
+#include "armproc.h"
+#include "cosim.h"
+#include "disarm.h"
+
+#define MEMORY_SIZE  0x30000    // All of it goes in the image
+#define SETUP_BASE   0x20
+#define BODY_BASE    0x1000
+#define TABLE_BASE   0x8000     // The registers the setup code loads
+#define DATA_BASE    0x10000    // What the loads and stores work on
+#define DATA_SIZE    0x20000
+#define MAX_LENGTH   1024
+#define MAX_CYCLES   200000
+
+#define NOP          0xE1A00000 // mov r0, r0
+#define SWI_EXIT     0x00800000
+
+#define USAGE "Usage: swarmfuzz [-n runs] [-s seed] [-l length] [-j jobs] " \
+              "[-c classes] [-o dir] [-k] [-a]\n"
+
+// The instruction classes
+#define IC_DP      0x01
+#define IC_MEM     0x02
+#define IC_HALF    0x04
+#define IC_LDM     0x08
+#define IC_PSR     0x10
+#define IC_MUL     0x20
+#define IC_BRANCH  0x40
+#define IC_ALL     0x7F
+
+static const char* s_strClasses[] =
+  {"dp", "mem", "half", "ldm", "psr", "mul", "branch"};
+
+// The registers are split up so the loads and stores stay inside the data.
+// r0 - r8 and r14 are fair game, r9 and r10 are small word indexes, and
+// r11 - r13 point into the data. Only writeback moves the last lot, and
+// only by words, as an unaligned LDM is a known difference (see
+// README-INFO) that would drown out everything else.
+static const uint32_t s_general[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 14};
+#define NUM_GENERAL (sizeof(s_general) / sizeof(uint32_t))
+
+// The modes the setup visits, svc last as that's where the body starts
+static const uint32_t s_modes[] = {M_FIQ, M_IRQ, M_ABORT, M_UNDEF, M_SYSTEM,
+				   M_SVC};
+#define NUM_MODES (sizeof(s_modes) / sizeof(uint32_t))
+
+typedef struct WTAG
+{
+  uint64_t nRuns;
+  uint64_t nFailed;
+} WORKER;
+
+static uint8_t s_memory[MEMORY_SIZE];
+static uint32_t s_rand;
+static bool_t s_bExit;
+static uint32_t s_nSetup;       // Instructions run before the body
+static bool_t s_bKnown;         // Generate the known differences too
+
+
+///////////////////////////////////////////////////////////////////////////////
+// rnd - xorshift, so a seed gives the same program on any host.
+//
+static uint32_t rnd()
+{
+  s_rand ^= s_rand << 13;
+  s_rand ^= s_rand >> 17;
+  s_rand ^= s_rand << 5;
+  return s_rand;
+}
+
+static inline uint32_t rnd_of(uint32_t n) { return rnd() % n; }
+static inline uint32_t rnd_general() { return s_general[rnd_of(NUM_GENERAL)]; }
+static inline uint32_t rnd_pointer() { return 11 + rnd_of(3); }
+static inline uint32_t rnd_index() { return 9 + rnd_of(2); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// rnd_cond - Mostly always. Never NV, which SWARM treats as undefined.
+//
+static uint32_t rnd_cond()
+{
+  if (rnd_of(2) == 0)
+    return C_AL << 28;
+  return rnd_of(C_AL) << 28;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// gen_dp - Data processing, with an immediate, an immediately shifted
+//          register, or a register shifted register. Never writes the PC
+//          or the pointer and index registers, but can read anything.
+//          Without -a, MVN and ORR don't set the flags and an immediate
+//          LSR or ASR is never by 32.
+//
+static uint32_t gen_dp()
+{
+  uint32_t opcode = rnd_of(16);
+  uint32_t inst = rnd_cond() | (opcode << 21);
+  uint32_t form = rnd_of(3);
+
+  // The tests need S, or they're MRS/MSR. Their Rd and MOV and MVN's Rn
+  // should be 0.
+  if (((opcode & 0xC) == 0x8) || rnd_of(2))
+    if (s_bKnown || ((opcode != OP_MVN) && (opcode != OP_ORR)))
+      inst |= 0x00100000;
+  if ((opcode & 0xC) != 0x8)
+    inst |= rnd_general() << 12;
+  if ((opcode != OP_MOV) && (opcode != OP_MVN))
+    inst |= ((form == 2) ? rnd_general() : rnd_of(16)) << 16;
+
+  switch (form)
+    {
+    case 0:
+      inst |= 0x02000000 | (rnd_of(16) << 8) | rnd_of(256);
+      break;
+    case 1:
+      {
+	uint32_t type = rnd_of(4);
+	uint32_t amount = rnd_of(32);
+
+	// An amount of 0 means 32 for these
+	if (!s_bKnown && (amount == 0) && ((type == 1) || (type == 2)))
+	  amount = 1 + rnd_of(31);
+	inst |= (amount << 7) | (type << 5) | rnd_of(16);
+      }
+      break;
+    default:
+      // A PC anywhere here is UNPREDICTABLE
+      inst |= (rnd_general() << 8) | (rnd_of(4) << 5) | 0x10 | rnd_general();
+      break;
+    }
+
+  return inst;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// gen_mem - LDR, STR, LDRB and STRB, pre or post indexed, with an immediate
+//           or a scaled index. The offsets are kept small when the base is
+//           written back, so it doesn't wander out of the data.
+//
+static uint32_t gen_mem()
+{
+  uint32_t rn = rnd_pointer();
+  uint32_t inst = rnd_cond() | 0x04000000 | (rn << 16);
+  bool_t bLoad = rnd_of(2);
+  bool_t bPre = rnd_of(2);
+  bool_t bWrite = !bPre || rnd_of(2);
+  uint32_t rd;
+
+  if (bLoad)
+    {
+      inst |= 0x00100000;
+      rd = rnd_general();
+    }
+  else
+    {
+      // The data can be anything but the base when it's written back
+      do
+	rd = rnd_of(15);
+      while (bWrite && (rd == rn));
+    }
+  inst |= rd << 12;
+
+  if (bPre)
+    inst |= 0x01000000 | (bWrite ? 0x00200000 : 0);
+  inst |= rnd_of(2) << 23;     // Up or down
+  inst |= rnd_of(2) << 22;     // Byte
+
+  if (rnd_of(2))
+    inst |= bWrite ? rnd_of(64) * 4 : rnd_of(4096);
+  else
+    inst |= 0x02000000 | (rnd_of(3) << 7) | rnd_index();
+
+  return inst;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// gen_half - LDRH, STRH, LDRSB and LDRSH. Even offsets only, as odd half
+//            word addresses are UNPREDICTABLE.
+//
+static uint32_t gen_half()
+{
+  static const uint32_t sh[] = {0x0B0, 0x0B0, 0x0D0, 0x0F0};
+  uint32_t rn = rnd_pointer();
+  uint32_t inst = rnd_cond() | (rn << 16);
+  uint32_t n = rnd_of(4);
+  bool_t bPre = rnd_of(2);
+  bool_t bWrite = !bPre || rnd_of(2);
+  uint32_t rd;
+
+  // Stores are STRH only
+  if (n == 0)
+    {
+      do
+	rd = rnd_of(15);
+      while (bWrite && (rd == rn));
+    }
+  else
+    {
+      inst |= 0x00100000;
+      rd = rnd_general();
+    }
+  inst |= (rd << 12) | sh[n];
+
+  if (bPre)
+    inst |= 0x01000000 | (bWrite ? 0x00200000 : 0);
+  inst |= rnd_of(2) << 23;
+
+  if (rnd_of(2))
+    {
+      uint32_t offset = bWrite ? rnd_of(64) * 4 : rnd_of(128) * 2;
+      inst |= 0x00400000 | ((offset & 0xF0) << 4) | (offset & 0xF);
+    }
+  else
+    inst |= rnd_index();
+
+  return inst;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// gen_ldm - LDM and STM, in all four directions (not DA without -a),
+//           sometimes with ^. Never the PC, and the base isn't in the list
+//           if it's written back. Loads only go to the general registers.
+//
+static uint32_t gen_ldm()
+{
+  uint32_t rn = rnd_pointer();
+  uint32_t inst = rnd_cond() | 0x08000000 | (rn << 16);
+  bool_t bLoad = rnd_of(2);
+  bool_t bWrite = rnd_of(2);
+  uint32_t list = 0;
+
+  // ^ (the user mode registers) can't be written back
+  if (rnd_of(4) == 0)
+    {
+      inst |= 0x00400000;
+      bWrite = FALSE;
+    }
+  inst |= (s_bKnown ? rnd_of(4) : 1 + rnd_of(3)) << 23;   // P and U
+  if (bLoad)
+    inst |= 0x00100000;
+  if (bWrite)
+    inst |= 0x00200000;
+
+  while (list == 0)
+    for (uint32_t i = 0; i < 15; i++)
+      if (rnd_of(3) == 0)
+	list |= 1 << i;
+
+  if (bLoad)
+    {
+      uint32_t mask = 0;
+      for (uint32_t i = 0; i < NUM_GENERAL; i++)
+	mask |= 1 << s_general[i];
+      list &= mask;
+      if (list == 0)
+	list = 1 << rnd_general();
+    }
+  if (bWrite)
+    {
+      list &= ~(1 << rn);
+      if (list == 0)
+	list = 1 << rnd_general();
+    }
+
+  return inst | list;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// gen_psr - MRS of either PSR, and MSR. The CPSR's control byte only ever
+//           goes to another privileged mode with interrupts off, as we
+//           can't get back from user mode and don't want interrupts.
+//           Without -a, MSR is never immediate and doesn't change mode.
+//
+static uint32_t gen_psr()
+{
+  uint32_t inst = rnd_cond();
+
+  switch (rnd_of(s_bKnown ? 4 : 3))
+    {
+    case 0:
+      return inst | 0x010F0000 | (rnd_of(2) << 22) | (rnd_general() << 12);
+    case 1:
+      // The flags, from a register or an immediate
+      if (!s_bKnown || rnd_of(2))
+	return inst | 0x0128F000 | rnd_general();
+      return inst | 0x0328F000 | (rnd_of(16) << 8) | rnd_of(256);
+    case 2:
+      // The SPSR, any fields
+      return inst | 0x0160F000 | ((rnd_of(15) + 1) << 16) | rnd_general();
+    default:
+      // mode | I | F from an immediate
+      return inst | 0x0321F000 | 0xC0 | s_modes[rnd_of(NUM_MODES)];
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// gen_mul - MUL, MLA and the long multiplies. The registers are all
+//           different, which covers the ones that have to be. Without -a,
+//           only MUL and MLA, and never with S.
+//
+static uint32_t gen_mul()
+{
+  uint32_t inst = rnd_cond() | 0x00000090;
+  uint32_t regs[4];
+  uint32_t n = 0;
+
+  while (n < 4)
+    {
+      uint32_t r = rnd_general();
+      uint32_t i;
+
+      for (i = 0; i < n; i++)
+	if (regs[i] == r)
+	  break;
+      if (i == n)
+	regs[n++] = r;
+    }
+
+  if (s_bKnown)
+    inst |= rnd_of(2) << 20;        // S
+  inst |= (regs[0] << 16) | (regs[2] << 8) | regs[3];
+  if (!s_bKnown || rnd_of(2))
+    {
+      // MUL's Rn should be 0
+      if (rnd_of(2))
+	inst |= 0x00200000 | (regs[1] << 12);
+    }
+  else
+    inst |= 0x00800000 | (rnd_of(4) << 21) | (regs[1] << 12);
+
+  return inst;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// gen_branch - B or BL, forward and within the body so every program ends.
+//
+static uint32_t gen_branch(uint32_t n, uint32_t nLength)
+{
+  uint32_t nLeft = nLength - n;      // Including the exit
+  uint32_t offset = rnd_of((nLeft < 8) ? nLeft : 8);
+
+  // The offset is from the instruction 2 on
+  return rnd_cond() | 0x0A000000 | (rnd_of(2) << 24) | ((offset - 1) & 0xFFFFFF);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// generate - Writes a whole program to s_memory: the vectors, code to give
+//            every mode random registers, the body, and random data.
+//            Returns the body.
+//
+static void generate(uint32_t nSeed, uint32_t nClasses, uint32_t nLength,
+		     uint32_t* pBody)
+{
+  uint32_t* pWords = (uint32_t*)s_memory;
+  uint32_t n;
+
+  s_rand = (nSeed * 2654435761U) | 1;
+  memset(s_memory, 0, MEMORY_SIZE);
+
+  // Nothing should trap, but if it does carry on after it
+  pWords[0] = 0xEA000000 | (((SETUP_BASE - 8) >> 2) & 0xFFFFFF);
+  for (n = 1; n < 8; n++)
+    pWords[n] = 0xE1B0F00E;     // movs pc, lr
+
+  // Each mode's r8 - r14 and SPSR, then r0 - r7 and the flags
+  n = SETUP_BASE / 4;
+  for (uint32_t m = 0; m < NUM_MODES; m++)
+    {
+      uint32_t* pTable = (uint32_t*)(s_memory + TABLE_BASE + (m * 32));
+
+      for (uint32_t r = 8; r < 15; r++)
+	pTable[r - 8] = rnd();
+      pTable[9 - 8] = rnd_of(64) * 4;
+      pTable[10 - 8] = rnd_of(64) * 4;
+      for (uint32_t r = 11; r < 14; r++)
+	pTable[r - 8] = DATA_BASE + (DATA_SIZE / 2) + (rnd_of(1024) * 4) - 2048;
+      pTable[7] = (rnd() & 0xF0000000) | 0xC0 | s_modes[rnd_of(NUM_MODES)];
+
+      pWords[n++] = 0xE3A000C0 | s_modes[m];  // mov   r0, #mode | I | F
+      pWords[n++] = 0xE121F000;               // msr   cpsr_c, r0
+      pWords[n++] = 0xE3A01902;               // mov   r1, #TABLE_BASE
+      pWords[n++] = 0xE2811000 | (m * 32);    // add   r1, r1, #m * 32
+      pWords[n++] = 0xE8917F00;               // ldmia r1, {r8 - r14}
+      if (s_modes[m] != M_SYSTEM)
+	{
+	  pWords[n++] = 0xE591201C;           // ldr   r2, [r1, #28]
+	  pWords[n++] = 0xE16FF002;           // msr   spsr_fsxc, r2
+	}
+    }
+
+  uint32_t* pTable = (uint32_t*)(s_memory + TABLE_BASE + (NUM_MODES * 32));
+  for (uint32_t r = 0; r < 8; r++)
+    pTable[r] = rnd();
+  pTable[8] = rnd() & 0xF0000000;
+  pWords[n++] = 0xE3A00902;                   // mov   r0, #TABLE_BASE
+  pWords[n++] = 0xE2800000 | (NUM_MODES * 32);// add   r0, r0, #..
+  pWords[n++] = 0xE5901020;                   // ldr   r1, [r0, #32]
+  pWords[n++] = 0xE128F001;                   // msr   cpsr_f, r1
+  pWords[n++] = 0xE89000FF;                   // ldmia r0, {r0 - r7}
+  pWords[n] = 0xEA000000 | ((((BODY_BASE - (n * 4)) - 8) >> 2) & 0xFFFFFF);
+  s_nSetup = (n - (SETUP_BASE / 4)) + 2;
+
+  uint32_t* pData = (uint32_t*)(s_memory + DATA_BASE);
+  for (uint32_t i = 0; i < DATA_SIZE / 4; i++)
+    pData[i] = rnd();
+
+  // The body, ending with the exit SWI
+  uint32_t classes[8];
+  uint32_t nNum = 0;
+  for (uint32_t i = 0; i < 7; i++)
+    if (nClasses & (1 << i))
+      classes[nNum++] = 1 << i;
+
+  for (n = 0; n < nLength; n++)
+    {
+      switch (classes[rnd_of(nNum)])
+	{
+	case IC_DP:     pBody[n] = gen_dp(); break;
+	case IC_MEM:    pBody[n] = gen_mem(); break;
+	case IC_HALF:   pBody[n] = gen_half(); break;
+	case IC_LDM:    pBody[n] = gen_ldm(); break;
+	case IC_PSR:    pBody[n] = gen_psr(); break;
+	case IC_MUL:    pBody[n] = gen_mul(); break;
+	default:        pBody[n] = gen_branch(n, nLength); break;
+	}
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// place - Puts a body into the image.
+//
+static void place(const uint32_t* pBody, uint32_t nLength)
+{
+  uint32_t* pWords = (uint32_t*)(s_memory + BODY_BASE);
+
+  memcpy(pWords, pBody, nLength * 4);
+  pWords[nLength] = 0xEF000000 | SWI_EXIT;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// fuzz_exit - The exit SWI.
+//
+static uint32_t fuzz_exit(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  s_bExit = TRUE;
+  return r0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// run - Runs a copy of the image on a fresh processor. Returns TRUE if the
+//       checker found a difference.
+//
+static bool_t run(const uint8_t* pImage)
+{
+  static uint8_t memory[MEMORY_SIZE];
+  CACHECONFIG config;
+  PINOUT pinout;
+
+  memcpy(memory, pImage, MEMORY_SIZE);
+
+  InitCacheConfig(&config, 1024 * 8);
+  CArmProc* pArm = new CArmProc(&config, NULL);
+  CCoSim* pCoSim = new CCoSim(memory, MEMORY_SIZE, 1);
+  pArm->RegisterSWI(SWI_EXIT, fuzz_exit);
+
+  memset(&pinout, 0, sizeof(pinout));
+  pinout.fiq = 1;
+  pinout.irq = 1;
+  s_bExit = FALSE;
+
+  for (uint32_t i = 0; (i < MAX_CYCLES) && !s_bExit; i++)
+    {
+      // The setup's mode changes hit the core's known differences (see
+      // README-INFO), so the checker only starts with the body, taking
+      // the core's state as it stands then.
+      if (pArm->GetInstructions() == s_nSetup)
+	pArm->SetCoSim(pCoSim);
+
+      pArm->Cycle(&pinout);
+      if (pCoSim->HasFailed())
+	break;
+      if ((pinout.benable == 0) || (pinout.address >= MEMORY_SIZE))
+	continue;
+
+      // The same as the loop in swarm's main, bar the endian swaps
+      uint32_t addr = pinout.address;
+      if (pinout.rw == 1)
+	switch (pinout.bw)
+	  {
+	  case 0:
+	    *((uint32_t*)(memory + (addr & ~0x3))) = pinout.data;
+	    break;
+	  case 1:
+	    memory[addr] = (uint8_t)pinout.data;
+	    break;
+	  case 2:
+	    *((uint16_t*)(memory + (addr & ~0x1))) = (uint16_t)pinout.data;
+	    break;
+	  }
+      else
+	pinout.data = *((uint32_t*)(memory + (addr & ~0x3)));
+    }
+
+  // The last instruction's writes are in by now
+  pCoSim->Process();
+  bool_t bFailed = pCoSim->HasFailed();
+
+  delete pArm;
+  delete pCoSim;
+
+  return bFailed;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// minimise - Turns as much of the body into no-ops as we can, a chunk at a
+//            time and the chunks getting smaller, while it still fails.
+//
+static void minimise(const uint8_t* pImage, uint32_t* pBody, uint32_t nLength)
+{
+  static uint8_t image[MEMORY_SIZE];
+
+  memcpy(image, pImage, MEMORY_SIZE);
+
+  for (uint32_t nChunk = nLength; nChunk > 0; nChunk /= 2)
+    for (uint32_t n = 0; n < nLength; n += nChunk)
+      {
+	uint32_t saved[MAX_LENGTH];
+	uint32_t nLen = ((n + nChunk) > nLength) ? nLength - n : nChunk;
+	bool_t bChanged = FALSE;
+
+	memcpy(saved, &pBody[n], nLen * 4);
+	for (uint32_t i = 0; i < nLen; i++)
+	  if (pBody[n + i] != NOP)
+	    {
+	      pBody[n + i] = NOP;
+	      bChanged = TRUE;
+	    }
+	if (!bChanged)
+	  continue;
+
+	memcpy(s_memory, image, MEMORY_SIZE);
+	place(pBody, nLength);
+	if (!run(s_memory))
+	  memcpy(&pBody[n], saved, nLen * 4);
+      }
+
+  memcpy(s_memory, image, MEMORY_SIZE);
+  place(pBody, nLength);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// report - Runs the minimised program once more for the checker's report,
+//          and prints it all in one go so the jobs don't interleave.
+//
+static void report(uint32_t nSeed, const uint32_t* pBody, uint32_t nLength,
+		   const char* strDir, int fdOut)
+{
+  char strLine[256], str[120];
+  char* strOut;
+  size_t nOut;
+  FILE* fp = open_memstream(&strOut, &nOut);
+  uint32_t nLeft = 0;
+
+  for (uint32_t i = 0; i < nLength; i++)
+    if (pBody[i] != NOP)
+      nLeft++;
+  fprintf(fp, "seed %u: the core and the reference differ, down to %u "
+	  "instruction%s:\n", nSeed, nLeft, (nLeft == 1) ? "" : "s");
+
+  for (uint32_t i = 0; i < nLength; i++)
+    if (pBody[i] != NOP)
+      {
+	memset(str, 0, sizeof(str));
+	CDisarm::Decode(pBody[i], str);
+	fprintf(fp, "  0x%08X: 0x%08X %s\n", BODY_BASE + (i * 4), pBody[i], str);
+      }
+
+  // The checker writes to stderr
+  FILE* fpErr = tmpfile();
+  int fdErr = dup(2);
+  if (fpErr != NULL)
+    dup2(fileno(fpErr), 2);
+  run(s_memory);
+  dup2(fdErr, 2);
+  close(fdErr);
+  if (fpErr != NULL)
+    {
+      rewind(fpErr);
+      while (fgets(strLine, sizeof(strLine), fpErr) != NULL)
+	fputs(strLine, fp);
+      fclose(fpErr);
+    }
+
+  if (strDir != NULL)
+    {
+      sprintf(strLine, "%s/%u.bin", strDir, nSeed);
+      int fd = open(strLine, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+      if ((fd >= 0) && (write(fd, s_memory, MEMORY_SIZE) == MEMORY_SIZE))
+	fprintf(fp, "  saved as %s\n", strLine);
+      else
+	fprintf(fp, "  couldn't save %s\n", strLine);
+      if (fd >= 0)
+	close(fd);
+    }
+
+  fclose(fp);
+  write(fdOut, strOut, nOut);
+  free(strOut);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// worker - Does runs nFirst, nFirst + nStep, ... up to nRuns.
+//
+static void worker(WORKER* pResult, uint32_t nSeed, uint32_t nRuns,
+		   uint32_t nFirst, uint32_t nStep, uint32_t nClasses,
+		   uint32_t nLength, const char* strDir, bool_t bKeepGoing)
+{
+  static uint8_t image[MEMORY_SIZE];
+  uint32_t body[MAX_LENGTH];
+
+  // Only the report should see the checker, and nobody wants each
+  // processor's cache counts
+  int fdNull = open("/dev/null", O_WRONLY);
+  int fdOut = dup(1);
+  int fdErr = dup(2);
+  dup2(fdNull, 1);
+  dup2(fdNull, 2);
+
+  for (uint32_t n = nFirst; n < nRuns; n += nStep)
+    {
+      generate(nSeed + n, nClasses, nLength, body);
+      place(body, nLength);
+      memcpy(image, s_memory, MEMORY_SIZE);
+
+      pResult->nRuns++;
+      if (!run(image))
+	continue;
+
+      pResult->nFailed++;
+      minimise(image, body, nLength);
+      dup2(fdErr, 2);
+      report(nSeed + n, body, nLength, strDir, fdOut);
+      dup2(fdNull, 2);
+
+      if (!bKeepGoing)
+	break;
+    }
+
+  close(fdNull);
+  close(fdOut);
+  close(fdErr);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// parse_classes - Returns 0 if any of them aren't classes.
+//
+static uint32_t parse_classes(char* strClasses)
+{
+  uint32_t nClasses = 0;
+  char* str;
+
+  while ((str = strsep(&strClasses, ",")) != NULL)
+    {
+      uint32_t i;
+
+      for (i = 0; i < sizeof(s_strClasses) / sizeof(char*); i++)
+	if (strcmp(str, s_strClasses[i]) == 0)
+	  break;
+      if (i == sizeof(s_strClasses) / sizeof(char*))
+	return 0;
+      nClasses |= 1 << i;
+    }
+
+  return nClasses;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// main -
+//
+int main(int argc, char* argv[])
+{
+  uint32_t nRuns = 1000, nSeed = 1, nLength = 32, nClasses = IC_ALL;
+  uint32_t nJobs = sysconf(_SC_NPROCESSORS_ONLN);
+  const char* strDir = NULL;
+  bool_t bKeepGoing = FALSE;
+  int c;
+
+  while ((c = getopt(argc, argv, "n:s:l:j:c:o:ka")) != -1)
+    switch (c)
+      {
+      case 'n': nRuns = strtoul(optarg, NULL, 0); break;
+      case 's': nSeed = strtoul(optarg, NULL, 0); break;
+      case 'l': nLength = strtoul(optarg, NULL, 0); break;
+      case 'j': nJobs = strtoul(optarg, NULL, 0); break;
+      case 'c': nClasses = parse_classes(optarg); break;
+      case 'o': strDir = optarg; break;
+      case 'k': bKeepGoing = TRUE; break;
+      case 'a': s_bKnown = TRUE; break;
+      default:
+	fprintf(stderr, USAGE);
+	return 2;
+      }
+  if ((nLength == 0) || (nLength > MAX_LENGTH) || (nClasses == 0) ||
+      (optind != argc))
+    {
+      fprintf(stderr, USAGE);
+      return 2;
+    }
+  if ((nJobs == 0) || (nJobs > nRuns))
+    nJobs = (nRuns == 0) ? 1 : nRuns;
+
+  // Somewhere the jobs can leave their counts
+  WORKER* pResults = (WORKER*)mmap(NULL, sizeof(WORKER) * nJobs,
+				   PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (pResults == MAP_FAILED)
+    {
+      perror("swarmfuzz");
+      return 2;
+    }
+  memset(pResults, 0, sizeof(WORKER) * nJobs);
+
+  fflush(stdout);
+  for (uint32_t i = 0; i < nJobs; i++)
+    {
+      pid_t pid = fork();
+
+      if (pid == 0)
+	{
+	  worker(&pResults[i], nSeed, nRuns, i, nJobs, nClasses, nLength,
+		 strDir, bKeepGoing);
+	  _exit(0);
+	}
+      if (pid < 0)
+	{
+	  // Do them here instead
+	  perror("swarmfuzz");
+	  worker(&pResults[i], nSeed, nRuns, i, nJobs, nClasses, nLength,
+		 strDir, bKeepGoing);
+	}
+    }
+  while (wait(NULL) > 0)
+    ;
+
+  uint64_t nDone = 0, nFailed = 0;
+  for (uint32_t i = 0; i < nJobs; i++)
+    {
+      nDone += pResults[i].nRuns;
+      nFailed += pResults[i].nFailed;
+    }
+  printf("%llu runs of %u instructions from seed %u, %llu failed\n",
+	 (unsigned long long)nDone, nLength, nSeed,
+	 (unsigned long long)nFailed);
+
+  return (nFailed == 0) ? 0 : 1;
+}
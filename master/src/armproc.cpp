@@ -23,15 +23,15 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <stdlib.h>
 #include "swarm.h"
 #include "armproc.h"
 #include <string.h>
 #include "cache.h"
-#include "direct.h"
-#include "associative.h"
-#include "setassoc.h"
+#include "cachestats.h"
 #include "copro.h"
 #include "syscopro.h"
+#include "perfmon.h"
 
 #define ICACHE_SIZE 1024
 #define DCACHE_SIZE 1024
@@ -43,9 +43,6 @@
 #endif
 
 
-#define CACHE_TYPE CSetAssociativeCache
-#define NEW_CACHE(_size)  new CACHE_TYPE(_size, 4)
-
 // The number of times slower than the CPU the bus is
 #define BUS_SPEED 10
 
@@ -54,85 +51,502 @@
 //
 CArmProc::CArmProc()
 {
-  m_pCore = new CArmCore();
-  m_pCoreBus = new COREBUS;
-  memset(m_pCoreBus, 0, sizeof(COREBUS));
-  m_pCoProBus = new COPROBUS;
-  memset(m_pCoProBus, 0, sizeof(COPROBUS));
-  m_addrPrev = 0;
+  CACHECONFIG config;
 
   // I use the same cache for both the instruction and data currently
 #ifdef SHARED_CACHE
-  m_pICache = NEW_CACHE(ICACHE_SIZE + DCACHE_SIZE);
-  m_pDCache = m_pICache;
+  InitCacheConfig(&config, ICACHE_SIZE + DCACHE_SIZE);
+  CCache* pCache = CreateCache(&config);
+  Init(pCache, pCache);
 #else
-  m_pICache = NEW_CACHE(ICACHE_SIZE);
-  m_pDCache = NEW_CACHE(DCACHE_SIZE);
+  InitCacheConfig(&config, ICACHE_SIZE);
+  CCache* pICache = CreateCache(&config);
+  InitCacheConfig(&config, DCACHE_SIZE);
+  Init(pICache, CreateCache(&config));
 #endif // SHARED_CACHE
+}
 
-  memset(m_pCoProList, 0, sizeof(CCoProcessor*) * 16);
-
-#ifndef NO_SYS_COPRO
-  m_pCoProList[15] = new CSysCoPro();
-#endif // NO_SYS_COPRO
+CArmProc::CArmProc(uint32_t nCacheSize)
+{
+  CACHECONFIG config;
 
-  ((CSysCoPro*)m_pCoProList[15])->RegisterCaches(m_pDCache, m_pICache);
+  InitCacheConfig(&config, nCacheSize);
+  CCache* pCache = CreateCache(&config);
+  Init(pCache, pCache);
+}
 
-  m_pOSTimer = new COSTimer();
-  m_pIntCtrl = new CIntCtrl();
-  m_pLCDCtrl = new CLCDCtrl();
-  //m_pUARTCtrl = new CUARTCtrl();
+///////////////////////////////////////////////////////////////////////////////
+// CArmProc - Constructor. Builds the caches from the configs given. If 
+//            pDConfig is NULL then a single cache described by pIConfig is
+//            shared for instructions and data. Throws a 
+//            CCacheConfigException if a config is bad.
+//
+CArmProc::CArmProc(CACHECONFIG* pIConfig, CACHECONFIG* pDConfig)
+{
+  CCache* pICache = CreateCache(pIConfig);
+  CCache* pDCache = pICache;
 
-  m_nCycles = 0;
-  m_nCacheHits = 0;
-  m_nCacheMisses = 0;
-  m_mode = P_NORMAL;
-  m_pending = 0;
+  if (pDConfig != NULL)
+    {
+      try
+	{
+	  pDCache = CreateCache(pDConfig);
+	}
+      catch (CCacheConfigException &e)
+	{
+	  delete pICache;
+	  throw;
+	}
+    }
 
-  Reset();
+  Init(pICache, pDCache);
 }
 
-CArmProc::CArmProc(uint32_t nCacheSize)
+
+///////////////////////////////////////////////////////////////////////////////
+// Init - Does the work common to all the constructors.
+//
+void CArmProc::Init(CCache* pICache, CCache* pDCache)
 {
   m_pCore = new CArmCore();
   m_pCoreBus = new COREBUS;
   memset(m_pCoreBus, 0, sizeof(COREBUS));
+  m_pCoreBus->di = 1;     // Out of reset the core fetches
   m_pCoProBus = new COPROBUS;
   memset(m_pCoProBus, 0, sizeof(COPROBUS));
   m_addrPrev = 0;
 
-  m_pICache = NEW_CACHE(nCacheSize);
-  m_pDCache = m_pICache;
+  m_pICache = pICache;
+  m_pDCache = pDCache;
 
   memset(m_pCoProList, 0, sizeof(CCoProcessor*) * 16);
+  m_nCoProActive = 0;
+
+  // Until a coprocessor has been cycled the core mustn't think it's busy
+  m_pCoreBus->cpb = 1;
 
 #ifndef NO_SYS_COPRO
   m_pCoProList[15] = new CSysCoPro();
+  m_pSysCoPro = (CSysCoPro*)m_pCoProList[15];
+  m_pSysCoPro->RegisterCaches(m_pDCache, m_pICache);
+  m_nCoProActive |= 0x1 << 15;
+#else
+  m_pSysCoPro = NULL;
 #endif // NO_SYS_COPRO
 
-  ((CSysCoPro*)m_pCoProList[15])->RegisterCaches(m_pDCache, m_pICache);
-
   m_pOSTimer = new COSTimer();
+  m_pRTC = new CRTC();
   m_pIntCtrl = new CIntCtrl();
   m_pLCDCtrl = new CLCDCtrl();
-  //m_pUARTCtrl = new CUARTCtrl();
+  m_pUARTCtrl = NULL;
+  m_pDMACtrl = new CDMACtrl();
+  m_pBlockDev = NULL;
+  m_pNetDev = NULL;
+  m_pMemory = NULL;
+  m_nMemSize = 0;
+  m_pReadDev = NULL;
+  m_nDevClock = 0;
+  m_nThrottleKHz = 0;
+  m_nThrottleNext = ~(uint64_t)0;
+  m_pOSTimer->SetClock(&m_nDevClock);
+  m_pRTC->SetClock(&m_nDevClock);
+  m_pIntCtrl->SetClock(&m_nDevClock);
+  m_pLCDCtrl->SetClock(&m_nDevClock);
+  m_pDMACtrl->SetClock(&m_nDevClock);
+  m_pDMACtrl->SetCaches(m_pICache, m_pDCache, NULL);
+  InitDeviceConfig(m_devConfig);
+  MapDevices();
 
   m_nCycles = 0;
   m_nCacheHits = 0;
   m_nCacheMisses = 0;
+  m_bRefill = FALSE;
+  m_strStatsFile = NULL;
+  m_strSnapshotFile = NULL;
+  m_pIStats = new CCacheStats(m_pICache, FALSE);
+  m_pDStats = (m_pDCache == m_pICache) ? m_pIStats :
+    new CCacheStats(m_pDCache, FALSE);
+  m_nMissStart = 0;
   m_mode = P_NORMAL;
+  m_pending = 0;
+  m_pTrace = NULL;
+  m_pCoSim = NULL;
+  m_pGdb = NULL;
+
+  // No L2 and flat memory timing unless told otherwise
+  m_pL2Cache = NULL;
+  m_nL2Latency = 0;
+  m_nL2Hits = 0;
+  m_nL2Misses = 0;
+  m_pDram = new CDramTiming(BUS_SPEED);
+
+  CStats::Register(this, "cycles.real", &m_nCycles);
+  CStats::Register(this, "cache.hits", &m_nCacheHits);
+  CStats::Register(this, "cache.misses", &m_nCacheMisses);
+  CStats::Register(this, "cache.miss_cycles", &m_missCycles);
+  RegisterCacheStats();
 
   Reset();
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// SetL2Cache - Puts a unified L2 cache between the L1 cache(s) and memory.
+//              nLatency is the cost in cycles of looking in it. Throws a
+//              CCacheConfigException if the config is bad or the L2 lines
+//              are smaller than the L1 ones.
+//
+void CArmProc::SetL2Cache(CACHECONFIG* pConfig, uint32_t nLatency)
+{
+  if ((pConfig->nLineSize < m_pICache->GetLineSize()) ||
+      (pConfig->nLineSize < m_pDCache->GetLineSize()))
+    throw CCacheConfigException("L2 cache lines must be at least as big as "
+				"the L1 ones");
+
+  CCache* pCache = CreateCache(pConfig);
+
+  if (m_pL2Cache != NULL)
+    delete m_pL2Cache;
+  else
+    {
+      CStats::Register(this, "l2.hits", &m_nL2Hits);
+      CStats::Register(this, "l2.misses", &m_nL2Misses);
+    }
+  m_pL2Cache = pCache;
+  m_nL2Latency = nLatency;
+  m_pDMACtrl->SetCaches(m_pICache, m_pDCache, m_pL2Cache);
+  if (m_pBlockDev != NULL)
+    m_pBlockDev->SetCaches(m_pICache, m_pDCache, m_pL2Cache);
+  if (m_pNetDev != NULL)
+    m_pNetDev->SetCaches(m_pICache, m_pDCache, m_pL2Cache);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetDramTiming - Replaces the main memory timing model. We take ownership
+//                 of pDram.
+//
+void CArmProc::SetDramTiming(CDramTiming* pDram)
+{
+  delete m_pDram;
+  m_pDram = pDram;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetUART - Connects the UART to the host. Throws a CUARTException if the
+//           backend can't be opened.
+//
+void CArmProc::SetUART(const char* strBackend)
+{
+  CUARTCtrl* pUART = new CUARTCtrl(strBackend);
+  pUART->SetClock(&m_nDevClock);
+  pUART->SetMemory(m_pMemory, m_nMemSize);
+
+  if (m_pUARTCtrl != NULL)
+    delete m_pUARTCtrl;
+  m_pUARTCtrl = pUART;
+
+  MapDevices();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetBlockDevice - Attaches a block device using strImage. Throws a
+//                  CBlockDevException if it can't be opened.
+//
+void CArmProc::SetBlockDevice(const char* strImage)
+{
+  CBlockDev* pBlockDev = new CBlockDev(strImage);
+  pBlockDev->SetClock(&m_nDevClock);
+  pBlockDev->SetMemory(m_pMemory, m_nMemSize);
+  pBlockDev->SetCaches(m_pICache, m_pDCache, m_pL2Cache);
+
+  if (m_pBlockDev != NULL)
+    delete m_pBlockDev;
+  m_pBlockDev = pBlockDev;
+
+  MapDevices();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetNetDevice - Attaches a network device using strBackend. Throws a
+//                CNetDevException if it can't be opened.
+//
+void CArmProc::SetNetDevice(const char* strBackend)
+{
+  CNetDev* pNetDev = new CNetDev(strBackend);
+  pNetDev->SetClock(&m_nDevClock);
+  pNetDev->SetMemory(m_pMemory, m_nMemSize);
+  pNetDev->SetCaches(m_pICache, m_pDCache, m_pL2Cache);
+
+  if (m_pNetDev != NULL)
+    delete m_pNetDev;
+  m_pNetDev = pNetDev;
+
+  MapDevices();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetMemory - pMemory must stay around for as long as we do.
+//
+void CArmProc::SetMemory(uint8_t* pMemory, uint32_t nMemSize)
+{
+  m_pMemory = pMemory;
+  m_nMemSize = nMemSize;
+
+  m_pOSTimer->SetMemory(pMemory, nMemSize);
+  m_pRTC->SetMemory(pMemory, nMemSize);
+  m_pIntCtrl->SetMemory(pMemory, nMemSize);
+  m_pLCDCtrl->SetMemory(pMemory, nMemSize);
+  m_pDMACtrl->SetMemory(pMemory, nMemSize);
+  if (m_pUARTCtrl != NULL)
+    m_pUARTCtrl->SetMemory(pMemory, nMemSize);
+  if (m_pBlockDev != NULL)
+    m_pBlockDev->SetMemory(pMemory, nMemSize);
+  if (m_pNetDev != NULL)
+    m_pNetDev->SetMemory(pMemory, nMemSize);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetThrottle - We look to see if we're ahead of the host every
+//               millisecond of simulated time.
+//
+void CArmProc::SetThrottle(uint32_t nKHz)
+{
+  m_nThrottleKHz = nKHz;
+  if (nKHz == 0)
+    {
+      m_nThrottleNext = ~(uint64_t)0;
+      return;
+    }
+
+  clock_gettime(CLOCK_MONOTONIC, &m_throttleStart);
+  m_nThrottleBase = m_nDevClock;
+  m_nThrottleNext = m_nDevClock + nKHz;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Throttle - Sleeps off however far the simulation is ahead of the host. If
+//            it has fallen a long way behind (e.g. the host was busy) we
+//            start counting again from now rather than run flat out to
+//            catch up.
+//
+void CArmProc::Throttle()
+{
+  struct timespec now;
+  int64_t nAhead;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  nAhead = (int64_t)(((m_nDevClock - m_nThrottleBase) * 1000000) /
+		     m_nThrottleKHz) -
+    (((int64_t)(now.tv_sec - m_throttleStart.tv_sec) * 1000000000) +
+     (now.tv_nsec - m_throttleStart.tv_nsec));
+
+  if (nAhead > 0)
+    {
+      struct timespec ts;
+
+      ts.tv_sec = nAhead / 1000000000;
+      ts.tv_nsec = nAhead % 1000000000;
+      nanosleep(&ts, NULL);
+    }
+  else if (nAhead < -100000000)
+    {
+      m_throttleStart = now;
+      m_nThrottleBase = m_nDevClock;
+    }
+
+  m_nThrottleNext = m_nDevClock + m_nThrottleKHz;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetDeviceMap - Reads where the devices go from strFile. Throws a
+//                CDeviceMapException if the file is bad or the devices
+//                don't fit where it puts them.
+//
+void CArmProc::SetDeviceMap(const char* strFile)
+{
+  ReadDeviceConfig(strFile, m_devConfig);
+  MapDevices();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MapDevices - Rebuilds the device map and the list of devices to cycle
+//              from m_devConfig. The interrupt controller comes last, so
+//              it sees what the others raise that cycle.
+//
+void CArmProc::MapDevices()
+{
+  CDevice* pDevices[DEV_NUM];
+
+  pDevices[DEV_OSTIMER] = m_pOSTimer;
+  pDevices[DEV_LCD] = m_pLCDCtrl;
+  pDevices[DEV_UART] = m_pUARTCtrl;
+  pDevices[DEV_DMA] = m_pDMACtrl;
+  pDevices[DEV_BLOCK] = m_pBlockDev;
+  pDevices[DEV_NET] = m_pNetDev;
+  pDevices[DEV_RTC] = m_pRTC;
+  pDevices[DEV_INTCTRL] = m_pIntCtrl;
+
+  m_devMap.Clear();
+  m_nDevices = 0;
+  m_pReadDev = NULL;
+  m_pIntCtrl->SetLines(0xFFFFFFFF, 0);
+
+  for (int i = 0; i < DEV_NUM; i++)
+    {
+      if ((pDevices[i] == NULL) || !m_devConfig[i].bMapped)
+	continue;
+
+      m_devMap.Attach(pDevices[i], m_devConfig[i].base);
+
+      m_pDevices[m_nDevices] = pDevices[i];
+      m_devIrq[m_nDevices] = (i != DEV_INTCTRL) ? m_devConfig[i].irq : -1;
+      m_devLines[m_nDevices] = 0;
+      m_nDevices++;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetStatsFile - Turns on miss classification, and asks for all the cache
+//                stats to be written to strFile as JSON when we're done.
+//                Call before running anything, as the stats are restarted.
+//
+void CArmProc::SetStatsFile(const char* strFile)
+{
+  if (m_pDStats != m_pIStats)
+    delete m_pDStats;
+  delete m_pIStats;
+
+  m_pIStats = new CCacheStats(m_pICache, TRUE);
+  m_pDStats = (m_pDCache == m_pICache) ? m_pIStats :
+    new CCacheStats(m_pDCache, TRUE);
+  RegisterCacheStats();
+
+  if (m_strStatsFile != NULL)
+    free(m_strStatsFile);
+  m_strStatsFile = strdup(strFile);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// RegisterCacheStats - Names the L1 stats as WriteStats does.
+//
+void CArmProc::RegisterCacheStats()
+{
+  if (m_pIStats == m_pDStats)
+    m_pIStats->Register("l1");
+  else
+    {
+      m_pIStats->Register("l1i");
+      m_pDStats->Register("l1d");
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteStats - Writes out the stats file.
+//
+void CArmProc::WriteStats()
+{
+  FILE* fp = fopen(m_strStatsFile, "w");
+  if (fp == NULL)
+    {
+      cerr << "Failed to write stats to " << m_strStatsFile << "\n";
+      return;
+    }
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"cycles\": {\"real\": %llu, \"logical\": %llu},\n",
+	  (unsigned long long)GetRealCycles(), 
+	  (unsigned long long)GetLogicalCycles());
+  fprintf(fp, "  \"caches\": [\n");
+  if (m_pIStats == m_pDStats)
+    m_pIStats->WriteJSON(fp, "l1");
+  else
+    {
+      m_pIStats->WriteJSON(fp, "l1i");
+      fprintf(fp, ",\n");
+      m_pDStats->WriteJSON(fp, "l1d");
+    }
+  fprintf(fp, "\n  ]");
+
+  if (m_pL2Cache != NULL)
+    fprintf(fp, ",\n  \"l2\": {\"hits\": %llu, \"misses\": %llu}",
+	    (unsigned long long)m_nL2Hits, (unsigned long long)m_nL2Misses);
+  fprintf(fp, ",\n  \"memory\": {\"accesses\": %llu, \"row_hits\": %llu}",
+	  (unsigned long long)m_pDram->GetAccesses(),
+	  (unsigned long long)m_pDram->GetRowHits());
+  fprintf(fp, "\n}\n");
+
+  fclose(fp);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetSnapshotFile - Asks for the state of the caches to be written to
+//                   strFile when we're done. See cache.h for the format; the
+//                   L1 cache(s) go first (instruction then data if split),
+//                   followed by the L2 if there is one.
+//
+void CArmProc::SetSnapshotFile(const char* strFile)
+{
+  if (m_strSnapshotFile != NULL)
+    free(m_strSnapshotFile);
+  m_strSnapshotFile = strdup(strFile);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteSnapshot - Writes out the cache snapshot file.
+//
+void CArmProc::WriteSnapshot()
+{
+  FILE* fp = fopen(m_strSnapshotFile, "wb");
+  if (fp == NULL)
+    {
+      cerr << "Failed to write cache snapshot to " << m_strSnapshotFile << 
+	"\n";
+      return;
+    }
+
+  m_pICache->Snapshot(fp);
+  if (m_pDCache != m_pICache)
+    m_pDCache->Snapshot(fp);
+  if (m_pL2Cache != NULL)
+    m_pL2Cache->Snapshot(fp);
+
+  fclose(fp);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // ~CArmProc - Destructor
 //
 CArmProc::~CArmProc()
 {
+  CStats::Unregister(this);
+
   cout << "Cache info: hits = " << m_nCacheHits << " misses = " <<
     m_nCacheMisses << "\n";
+  if (m_strStatsFile != NULL)
+    WriteStats();
+  if (m_strSnapshotFile != NULL)
+    WriteSnapshot();
+  if (m_pL2Cache != NULL)
+    cout << "L2 info: hits = " << m_nL2Hits << " misses = " << 
+      m_nL2Misses << "\n";
+  if (!m_pDram->IsFlat())
+    cout << "Memory info: accesses = " << m_pDram->GetAccesses() << 
+      " row hits = " << m_pDram->GetRowHits() << "\n";
 
   // Clean up caches - check to see if they are the same.
   if (m_pICache == m_pDCache)
@@ -146,6 +560,17 @@ CArmProc::~CArmProc()
       delete m_pICache;
       delete m_pDCache;
     }
+  if (m_pL2Cache != NULL)
+    delete m_pL2Cache;
+  delete m_pDram;
+
+  if (m_pDStats != m_pIStats)
+    delete m_pDStats;
+  delete m_pIStats;
+  if (m_strStatsFile != NULL)
+    free(m_strStatsFile);
+  if (m_strSnapshotFile != NULL)
+    free(m_strSnapshotFile);
 
   for (int i = 0; i < 16; i++)
     if (m_pCoProList[i] != NULL)
@@ -153,8 +578,15 @@ CArmProc::~CArmProc()
 
   delete m_pIntCtrl;
   delete m_pOSTimer;
+  delete m_pRTC;
   delete m_pLCDCtrl;
-  //delete m_pUARTCtrl;
+  delete m_pDMACtrl;
+  if (m_pUARTCtrl != NULL)
+    delete m_pUARTCtrl;
+  if (m_pBlockDev != NULL)
+    delete m_pBlockDev;
+  if (m_pNetDev != NULL)
+    delete m_pNetDev;
 
   delete m_pCore;
   delete m_pCoreBus;
@@ -167,10 +599,7 @@ CArmProc::~CArmProc()
 //
 void CArmProc::Reset()
 {
-  memset(&m_ostbus, 0, sizeof(OSTBUS));
-  memset(&m_icbus, 0, sizeof(INTCTRLBUS));
-  memset(&m_lcdctrlbus, 0, sizeof(LCDCTRLBUS));
-  memset(&m_uartctrlbus, 0, sizeof(UARTCTRLBUS));
+  m_pReadDev = NULL;
 }
 
 
@@ -182,65 +611,71 @@ void CArmProc::AtomicCycle(PINOUT* pinout)
 {
   uint32_t temp = m_pCoreBus->Din;
 
-  // Cycle any on chip aids
-  m_icbus.intbits = 0;
-
-  m_pOSTimer->Cycle(&m_ostbus);
-  if (m_ostbus.interrupt)
-    m_icbus.intbits |= (m_ostbus.interrupt << 26);
-
-  m_pLCDCtrl->Cycle(&m_lcdctrlbus);
-  if (m_lcdctrlbus.interrupt)
-    m_icbus.intbits |= (0x1 << 25);
-
-  //m_pUARTCtrl->Cycle(&m_uartctrlbus);
-  //if (m_uartctrlbus.interrupt)
-  //  m_icbus.intbits |= (0x1 << 24);
-
-  m_pIntCtrl->Cycle(&m_icbus);
+  // Cycle any on chip aids that are due, and tell the interrupt
+  // controller if their lines have changed
+  PERF_SECTION(PS_DEVICES);
+  m_nDevClock++;
+  if (m_nDevClock >= m_nThrottleNext)
+    Throttle();
+  for (uint32_t i = 0; i < m_nDevices; i++)
+    {
+      if (m_pDevices[i]->GetDeadline() <= m_nDevClock)
+	{
+	  uint32_t lines = m_pDevices[i]->Cycle();
 
-  // Clear these for generation by the core next time round
-  m_ostbus.r = m_ostbus.w = 0;
-  m_icbus.r = m_icbus.w = 0;
-  m_lcdctrlbus.r = m_lcdctrlbus.w = 0;
-  m_uartctrlbus.r = m_uartctrlbus.w = 0;
+	  if ((lines != m_devLines[i]) && (m_devIrq[i] >= 0))
+	    m_pIntCtrl->SetLines((m_devLines[i] | lines) << m_devIrq[i],
+				 lines << m_devIrq[i]);
+	  m_devLines[i] = lines;
+	}
+    }
 
-  // Generate the interrupt bits
-  m_pCoreBus->fiq = pinout->fiq && m_icbus.fiq;
-  m_pCoreBus->irq = pinout->irq && m_icbus.irq;
-  m_pCoProBus->fiq = pinout->fiq && m_icbus.fiq;
-  m_pCoProBus->irq = pinout->irq && m_icbus.irq;
+  // Generate the interrupt bits, and let the core know if they've changed
+  uint32_t fiq = pinout->fiq && m_pIntCtrl->GetFIQ();
+  uint32_t irq = pinout->irq && m_pIntCtrl->GetIRQ();
+  if ((fiq != m_pCoreBus->fiq) || (irq != m_pCoreBus->irq))
+    {
+      m_pCoreBus->fiq = m_pCoProBus->fiq = fiq;
+      m_pCoreBus->irq = m_pCoProBus->irq = irq;
+      m_pCore->SetInterruptPins(irq, fiq);
+    }
 
   if ((m_pCoProBus->dw == 1) && (m_pCoreBus->enout != 0))
     m_pCoreBus->Din = m_pCoProBus->Dout;
 
-  if (m_pCoreBus->A & 0x80000000)
+  // Finish off any read of a device asked for last cycle
+  if (m_pReadDev != NULL)
     {
-      // Find out which internal device we're talking to
-      if ((m_pCoreBus->A & 0xFFFF0000) == 0x90050000)
-	{
-	  // The interrupt controller 
-	  m_pCoreBus->Din = m_icbus.data;
-	}
-      else if ((m_pCoreBus->A & 0xFFFF0000) == 0x90000000)
-	{
-	  // The OS Timer
-	  m_pCoreBus->Din = m_ostbus.data;
-	}
-      else if ((m_pCoreBus->A & 0xFFFFF000) == 0x90081000)
-	{
-	  // The UART Controller
-	  m_pCoreBus->Din = m_uartctrlbus.data;
-	}
-      else if ((m_pCoreBus->A & 0xFFF00000) == 0x90100000)
-	{
-	  // The LCD Controller
-	  m_pCoreBus->Din = m_uartctrlbus.data;
-	}
+      m_pCoreBus->Din = m_pReadDev->Read(m_readAddr);
+      m_pReadDev = NULL;
     }
 
+  PERF_SECTION(PS_CORE);
   m_pCore->Cycle(m_pCoreBus);
+  PERF_SECTION(PS_PROC);
+
+  // Idle coprocessors are woken when one of their instructions is fetched,
+  // else there's nothing for us to do here
+  if (m_pCoreBus->opc == 1)
+    {
+      uint32_t inst = (m_pCoreBus->rw == 1) ? temp : m_pCoreBus->Din;
+
+      if (IS_COPRO_INST(inst))
+	{
+	  uint32_t nID = COPRO_INST_CPN(inst);
+
+	  if ((m_pCoProList[nID] != NULL) &&
+	      ((m_nCoProActive & (0x1 << nID)) == 0))
+	    {
+	      m_pCoProList[nID]->Skip(m_nDevClock - m_nCoProIdle[nID] - 1);
+	      m_nCoProActive |= 0x1 << nID;
+	    }
+	}
+    }
+  if (m_nCoProActive == 0)
+    return;
 
+  PERF_SECTION(PS_COPRO);
   m_pCoProBus->opc = m_pCoreBus->opc;
   m_pCoProBus->cpi = m_pCoreBus->cpi;
   m_pCoProBus->cpa = m_pCoreBus->cpa;
@@ -255,16 +690,81 @@ void CArmProc::AtomicCycle(PINOUT* pinout)
     m_pCoProBus->Din = m_pCoreBus->Din;
 
   for (int ii = 0; ii < 16; ii++)
-    if (m_pCoProList[ii] != NULL)
-      m_pCoProList[ii]->Cycle(m_pCoProBus);
+    if (m_nCoProActive & (0x1 << ii))
+      {
+	m_pCoProList[ii]->Cycle(m_pCoProBus);
+
+	// It can't go idle with data still to give the core
+	if ((m_pCoProBus->dw == 0) && m_pCoProList[ii]->IsIdle())
+	  {
+	    m_nCoProActive &= ~(0x1 << ii);
+	    m_nCoProIdle[ii] = m_nDevClock;
+	  }
+      }
 
   m_pCoreBus->cpa = m_pCoProBus->cpa;
   m_pCoreBus->cpb = m_pCoProBus->cpb;
 
   if ((m_pCoProBus->dw == 1) && (m_pCoreBus->enout == 0))
     m_pCoreBus->Dout = m_pCoProBus->Dout;
+  PERF_SECTION(PS_PROC);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteThrough - Updates a cache with a write going out on the bus, if the
+//                cache holds the word being written. Returns FALSE if it
+//                didn't.
+//
+bool_t CArmProc::WriteThrough(CCache* pCache, PINOUT* pinout)
+{
+  uint32_t temp;
+
+  // Is the data in the cache?
+  if (!pCache->Lookup((pinout->address >> 2), &temp))
+    return FALSE;
+
+  // In the cache - is it a word or a byte we're writing?
+  switch (pinout->bw)
+    {
+    case 0:		// Writing a word
+      {
+	// Writing a word
+	pCache->WriteWord((pinout->address >> 2), pinout->data);
+      }
+      break;
+    case 1:		// Write a byte
+      {
+	uint32_t mask = ~(0xFF << ((pinout->address & 0x3) * 8));
+	temp &= mask;
+	temp |= ((pinout->data << ((pinout->address & 0x3) * 8)) &
+		 (~mask));
+	pCache->WriteWord((pinout->address >> 2), temp);
+      }
+      break;
+    case 2:		// Writing a half word
+      {
+	if ((pinout->address & 0x00000002) == 0)
+	  {
+	    // Modify low half
+	    temp &= 0xFFFF0000;
+	    temp |= (pinout->data & 0x0000FFFF);
+	  }
+	else
+	  {
+	    // Modify high half
+	    temp &= 0x0000FFFF;
+	    temp |= (pinout->data << 16);
+	  }
+
+	pCache->WriteWord((pinout->address >> 2), temp);
+      }
+      break;
+    }
+
+  return TRUE;
 }
 
+
 #define PENDING_FIQ   0x1
 #define PENDING_IRQ   0x2
 #define PENDING_RESET 0x4
@@ -275,11 +775,25 @@ void CArmProc::AtomicCycle(PINOUT* pinout)
 //
 void CArmProc::Cycle(PINOUT* pinout)
 {
+  PERF_SECTION(PS_PROC);
+  if (m_pCoSim != NULL)
+    m_pCoSim->Process();
   switch (m_mode)
     {
     case P_NORMAL:
       {
 	uint32_t addr;
+	uint32_t traceAddr = m_pCoreBus->A;
+	uint32_t traceSize = m_pCoreBus->bw;
+	bool_t bRead = FALSE;
+	CCacheStats* pStats = NULL;
+
+	// The debugger may want to stop before the core starts the next
+	// instruction. Nothing is in flight at the top of a normal cycle. The
+	// first boundary is only the no-op the core was reset with.
+	if ((m_pGdb != NULL) && m_pCore->AtBoundary() &&
+	    (m_pCore->GetInstructions() != 0))
+	  m_pGdb->Boundary(m_pCore->NextPC() - 8, m_pCore->GetInstructions());
 
 	if (m_pending & PENDING_FIQ)
 	  {
@@ -303,13 +817,15 @@ void CArmProc::Cycle(PINOUT* pinout)
 	    // Assume we are reading a value
 	    ASSERT(m_pCoreBus->rw == 0);
 	    CCache* pCache = m_pCoreBus->di ? m_pICache : m_pDCache;
-	    try
+	    uint32_t data;
+	    if (pCache->Lookup((addr >> 2), &data))
 	    {
-	      m_nCacheHits++;
-	      m_pCoreBus->Din = pCache->Read((addr >> 2));
+	      m_pCoreBus->Din = data;
+	      bRead = TRUE;
+	      pStats = (pCache == m_pICache) ? m_pIStats : m_pDStats;
 	      //printf("got data 0x%x\n", m_pCoreBus->Din);
 	    }
-	    catch(CCacheMiss & e)
+	    else
 	    {
 	      //printf("cache miss\n");
 
@@ -321,7 +837,11 @@ void CArmProc::Cycle(PINOUT* pinout)
 	      if (pinout->irq == 0)
 		m_pending |= PENDING_IRQ;
 
+	      // The access is counted when we come back here after the 
+	      // line fill and hit, as only then do we know if it was a fetch
 	      m_nCacheMisses++;
+	      m_nMissStart = m_nCycles;
+	      m_bRefill = TRUE;
 	      m_mode = P_READING1;
 	      break;
 	    }
@@ -395,12 +915,46 @@ void CArmProc::Cycle(PINOUT* pinout)
 	//                                         //
 	/////////////////////////////////////////////
 
-	if (m_pCoreBus->swi_hack == 1)
+	// Note the access in the stats and trace. We don't know if it was a
+	// fetch until the core has taken the word. Only hits get here, so
+	// a miss is seen once, on the hit after the line fill.
+	if (bRead)
 	  {
-	    m_pICache->Reset();
-	    if (m_pICache != m_pDCache)
-	      m_pDCache->Reset();
+	    bool_t bInst = m_pCoreBus->opc;
+	    enum MISS_CLASS mc = pStats->Read(bInst, traceAddr >> 2, 
+					      m_bRefill);
+
+	    if (!m_bRefill)
+	      m_nCacheHits++;
+	    else
+	      m_missCycles.Add((uint32_t)(m_nCycles - m_nMissStart));
 
+	    if (m_pSysCoPro != NULL)
+	      {
+		if (!m_bRefill)
+		  m_pSysCoPro->NoteEvent(SC_CACHEHIT);
+		else
+		  {
+		    m_pSysCoPro->NoteEvent(SC_CACHEMISS);
+		    m_pSysCoPro->NoteEvent(bInst ? SC_IMISS : SC_DREADMISS);
+		    if (mc == MC_COMPULSORY)
+		      m_pSysCoPro->NoteEvent(SC_COMPULSORY);
+		    else if (mc == MC_CONFLICT)
+		      m_pSysCoPro->NoteEvent(SC_CONFLICT);
+		  }
+	      }
+	    m_bRefill = FALSE;
+
+	    if (m_pTrace != NULL)
+	      m_pTrace->Record(bInst ? TR_FETCH : TR_LOAD, traceSize, 
+			       traceAddr);
+	    if ((m_pGdb != NULL) && !bInst)
+	      m_pGdb->Read(traceAddr, traceSize);
+	  }
+
+	if (m_pCoreBus->swi_hack == 1)
+	  {
+	    FlushCaches();
 	    m_pCoreBus->swi_hack = 0;
 	  }
 
@@ -419,31 +973,9 @@ void CArmProc::Cycle(PINOUT* pinout)
 
 	    if ((m_pCoreBus->rw == 0) && (m_pCoreBus->enout == 0))
 	      {
-		// Find out which internal device we're talking to
-		if ((m_pCoreBus->A & 0xFFFF0000) == 0x90050000)
-		  {
-		    // The interrupt controller 
-		    m_icbus.addr = m_pCoreBus->A & 0x0000FFFF;
-		    m_icbus.r = 1;
-		  }
-		else if ((m_pCoreBus->A & 0xFFFF0000) == 0x90000000)
-		  {
-		    // The OS Timer
-		    m_ostbus.addr = m_pCoreBus->A & 0x0000FFFF;
-		    m_ostbus.r = 1;
-		  }
-		else if ((m_pCoreBus->A & 0xFFFFF000) == 0x90081000)
-		  {
-		    // The UART Controller
-		    m_uartctrlbus.addr = m_pCoreBus->A & 0x00000FFF;
-		    m_uartctrlbus.r = 1;
-		  }
-		else if ((m_pCoreBus->A & 0xFFF00000) == 0x90100000)
-		  {
-		    // The LCD Controller
-		    m_lcdctrlbus.addr = m_pCoreBus->A & 0x000FFFFF;
-		    m_lcdctrlbus.r = 1;
-		  }
+		// The device map says who we're talking to. The read
+		// happens next cycle.
+		m_pReadDev = m_devMap.Lookup(m_pCoreBus->A, &m_readAddr);
 	      }
 	  }
 	else
@@ -469,20 +1001,58 @@ void CArmProc::Cycle(PINOUT* pinout)
     case P_READING1:
       {
 	// Reading in a cache line here.
+	CCache* pCache = m_pCoreBus->di ? m_pICache : m_pDCache;
 	m_nRead = 0;
+	m_l1Mask = ~(pCache->GetLineSize() - 1);
 
 	if (pinout->fiq == 0)
 	  m_pending |= PENDING_FIQ;
 	if (pinout->irq == 0)
 	  m_pending |= PENDING_IRQ;
 
-	pinout->address = m_pCoreBus->A & 0xFFFFFFF0;
+	if (m_pL2Cache != NULL)
+	  {
+	    // Look in the L2 first. Its lines are at least as big as the L1
+	    // ones, so either the whole L1 line is there or none of it.
+	    uint32_t addr = (m_pCoreBus->A & m_l1Mask) >> 2;
+	    uint32_t nWords = pCache->GetLineWords();
+	    uint32_t i;
+
+	    m_nCycles += m_nL2Latency;
+
+	    for (i = 0; i < nWords; i++)
+	      if (!m_pL2Cache->Lookup(addr + i, &m_cacheLine[i]))
+		break;
+
+	    if (i == nWords)
+	      {
+		m_nL2Hits++;
+		pCache->WriteLine(addr, m_cacheLine);
+
+		pinout->benable = 0;
+		m_mode = P_NORMAL;
+		break;
+	      }
+
+	    // Not there, so fetch the L2 line from memory
+	    m_nL2Misses++;
+	    m_lineMask = ~(m_pL2Cache->GetLineSize() - 1);
+	    m_nFillWords = m_pL2Cache->GetLineWords();
+	  }
+	else
+	  {
+	    m_lineMask = m_l1Mask;
+	    m_nFillWords = pCache->GetLineWords();
+	  }
+
+	pinout->address = m_pCoreBus->A & m_lineMask;
 	pinout->rw = 0;
 	pinout->benable = 1;
 	m_mode = P_READING;
 
-	// Add extra cycle for initiating a read
-	m_nCycles += BUS_SPEED;
+	// Add extra cycle for initiating a read, and wait for the bus if
+	// a DMA copy has it
+	m_nCycles += m_pDram->Access(pinout->address) + m_pDMACtrl->BusWait();
       }
       break;
     case P_READING:
@@ -490,7 +1060,7 @@ void CArmProc::Cycle(PINOUT* pinout)
 	CCache* pCache = m_pCoreBus->di ? m_pICache : m_pDCache;
 	//printf("cache read 0x%x @ 0x%x\n", pinout->data, pinout->address);
 	m_cacheLine[m_nRead] = pinout->data;
-	//      pCache->Write((((m_pCoreBus->A & 0xFFFFFFF0) + (m_nRead * 4)) >> 2), 
+	//      pCache->Write((((m_pCoreBus->A & m_lineMask) + (m_nRead * 4)) >> 2), 
 	//                    pinout->data);
 
 	m_nRead++;
@@ -500,19 +1070,31 @@ void CArmProc::Cycle(PINOUT* pinout)
 	if (pinout->irq == 0)
 	  m_pending |= PENDING_IRQ;
 
-	if (m_nRead < CACHE_LINE)
+	if (m_nRead < m_nFillWords)
 	  {
 	    // Set up to read the next word in the cache line
-	    pinout->address = (m_pCoreBus->A & 0xFFFFFFF0) + (m_nRead * 4);
+	    pinout->address = (m_pCoreBus->A & m_lineMask) + (m_nRead * 4);
 	    pinout->rw = 0;
 	    pinout->benable = 1;
 	  }
 	else
 	  {
-	    // Write the full line into the cache
-	    CCache* pCache = m_pCoreBus->di ? m_pICache : m_pDCache;
-	    pCache->WriteLine(((m_pCoreBus->A & 0xFFFFFFF0) >> 2),
-			      m_cacheLine);
+	    // Write the full line into the cache(s). If we read an L2 line
+	    // then the L1 line is somewhere inside it.
+	    if (m_pL2Cache != NULL)
+	      {
+		m_pL2Cache->WriteLine(((m_pCoreBus->A & m_lineMask) >> 2),
+				      m_cacheLine);
+		pCache->WriteLine(((m_pCoreBus->A & m_l1Mask) >> 2),
+				  m_cacheLine + 
+				  (((m_pCoreBus->A & m_l1Mask) - 
+				    (m_pCoreBus->A & m_lineMask)) >> 2));
+	      }
+	    else
+	      {
+		pCache->WriteLine(((m_pCoreBus->A & m_lineMask) >> 2),
+				  m_cacheLine);
+	      }
 
 	    // Read in a line, so go back to work
 	    pinout->benable = 0;
@@ -535,9 +1117,14 @@ void CArmProc::Cycle(PINOUT* pinout)
 	pinout->rw = 1;
 
 	//printf("writing 0x%x @ 0x%x\n", pinout->data, pinout->address);
+	if (m_pCoSim != NULL)
+	  m_pCoSim->Write(pinout->address, pinout->bw, pinout->data);
+	if (m_pGdb != NULL)
+	  m_pGdb->Write(pinout->address, pinout->bw);
 
 	// Add extra cycle for cost of write.
-	m_nCycles += (BUS_SPEED * 2);
+	m_nCycles += BUS_SPEED + m_pDram->Access(pinout->address) +
+	  m_pDMACtrl->BusWait();
 
 	// What are we to do next?
 	if (m_pCoreBus->rw == 1)
@@ -552,84 +1139,20 @@ void CArmProc::Cycle(PINOUT* pinout)
 	    m_mode = P_NORMAL;
 	  }
 
-	// Write thru the cache
-	CCache* pCache = m_pCoreBus->di ? m_pICache : m_pDCache;
-	//printf("cache write 0x%x @ 0x%x\n", pinout->data, pinout->address);
-	try
-	{
-	  uint32_t temp;
-
-	  // Is the data in the cache?
-	  temp = pCache->Read(pinout->address >> 2);
-
-	  // No exception thrown, so must be in memory - is it a word
-	  // or a byte we're writing?
-	  switch (pinout->bw)
-	    {
-	    case 0:		// Writing a word
-	      {
-		// Writing a word
-		pCache->WriteWord((pinout->address >> 2), pinout->data);
-	      }
-	      break;
-	    case 1:		// Write a byte
-	      {
-		uint32_t ttemp = temp;
-
-		uint32_t mask = ~(0xFF << ((pinout->address & 0x3) * 8));
-		temp &= mask;
-		temp |= ((pinout->data << ((pinout->address & 0x3) * 8)) &
-			 (~mask));
-		//printf("Changing 0x%08x to 0x%08x (mask was 0x%08x)\n",
-		//     ttemp, temp, mask);
-		pCache->WriteWord((pinout->address >> 2), temp);
-	      }
-	      break;
-	    case 2:		// Writing a half word
-	      {
-		uint32_t ttemp = temp;
-
-		if ((pinout->address & 0x00000002) == 0)
-		  {
-		    // Modify low half
-		    temp &= 0xFFFF0000;
-		    temp |= (pinout->data & 0x0000FFFF);
-		  }
-		else
-		  {
-		    // Modify high half
-		    temp &= 0x0000FFFF;
-		    temp |= (pinout->data << 16);
-		  }
-
-		pCache->WriteWord((pinout->address >> 2), temp);
-	      }
-	      break;
-	    }
+	if (m_pTrace != NULL)
+	  m_pTrace->Record(TR_STORE, pinout->bw, pinout->address);
 
-#if 0
-	  if (pinout->bw == 1)
-	    {
-	      uint32_t ttemp = temp;
-
-	      uint32_t mask = ~(0xFF << ((pinout->address & 0x3) * 8));
-	      temp &= mask;
-	      temp |= ((pinout->data << ((pinout->address & 0x3) * 8)) &
-		       (~mask));
-	      //printf("Changing 0x%08x to 0x%08x (mask was 0x%08x)\n",
-	      //     ttemp, temp, mask);
-	      pCache->WriteWord((pinout->address >> 2), temp);
-	    }
-	  else
-	    {
-	      // Writing a word
-	      pCache->WriteWord((pinout->address >> 2), pinout->data);
-	    }
-#endif
-	}
-	catch(CCacheMiss & c)
-	{
-	}
+	// Write thru the caches. Stores are data, but a split I-cache is kept
+	// up to date too, so code the program writes is what gets run.
+	//printf("cache write 0x%x @ 0x%x\n", pinout->data, pinout->address);
+	bool_t bHit = WriteThrough(m_pDCache, pinout);
+	m_pDStats->Write(pinout->address >> 2, bHit);
+	if (!bHit && (m_pSysCoPro != NULL))
+	  m_pSysCoPro->NoteEvent(SC_WRITEMISS);
+	if (m_pICache != m_pDCache)
+	  WriteThrough(m_pICache, pinout);
+	if (m_pL2Cache != NULL)
+	  WriteThrough(m_pL2Cache, pinout);
       }
       break;
     case P_INTWRITE:
@@ -642,34 +1165,10 @@ void CArmProc::Cycle(PINOUT* pinout)
 	pinout->benable = 0;
 
 	// Find out which internal device we're talking to
-	if ((m_addrPrev & 0xFFFF0000) == 0x90050000)
-	  {
-	    // The interrupt controller 
-	    m_icbus.addr = m_addrPrev & 0x0000FFFF;
-	    m_icbus.w = 1;
-	    m_icbus.data = m_pCoreBus->Dout;
-	  }
-	else if ((m_addrPrev & 0xFFFF0000) == 0x90000000)
-	  {
-	    // The OS Timer
-	    m_ostbus.addr = m_addrPrev & 0x0000FFFF;
-	    m_ostbus.w = 1;
-	    m_ostbus.data = m_pCoreBus->Dout;
-	  }
-	else if ((m_addrPrev & 0xFFFFF000) == 0x90081000)
-	  {
-	    // The UART Controller
-	    m_uartctrlbus.addr = m_addrPrev & 0x00000FFF;
-	    m_uartctrlbus.w = 1;
-	    m_uartctrlbus.data = m_pCoreBus->Dout;
-	  }
-	else if ((m_addrPrev & 0xFFF00000) == 0x90100000)
-	  {
-	    // The LCD Controller
-	    m_lcdctrlbus.addr = m_addrPrev & 0x000FFFFF;
-	    m_lcdctrlbus.w = 1;
-	    m_lcdctrlbus.data = m_pCoreBus->Dout;
-	  }
+	uint32_t offset;
+	CDevice* pDevice = m_devMap.Lookup(m_addrPrev, &offset);
+	if (pDevice != NULL)
+	  pDevice->Write(offset, m_pCoreBus->Dout);
 
 	m_mode = P_NORMAL;
       }
@@ -691,6 +1190,7 @@ void CArmProc::RegisterCoProcessor(uint32_t nID, CCoProcessor* pCoPro)
     throw CCoProSetException();
 
   m_pCoProList[nID] = pCoPro;
+  m_nCoProActive |= 0x1 << nID;
 }
 
 
@@ -703,6 +1203,7 @@ void CArmProc::UnregisterCoProcessor(uint32_t nID)
     throw CCoProInvalidException();
 
   m_pCoProList[nID] = NULL;
+  m_nCoProActive &= ~(0x1 << nID);
 }
 
 
@@ -737,6 +1238,34 @@ void CArmProc::DebugDumpCoProc()
       m_pCoProList[i]->DebugDump();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// FlushCaches - 
+//
+void CArmProc::FlushCaches()
+{
+  m_pICache->Reset();
+  if (m_pICache != m_pDCache)
+    m_pDCache->Reset();
+  if (m_pL2Cache != NULL)
+    m_pL2Cache->Reset();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SyncCoPros - An idle coprocessor is only told of the cycles it missed when
+//              it's woken, which in most runs is never.
+//
+void CArmProc::SyncCoPros()
+{
+  for (int i = 0; i < 16; i++)
+    if ((m_pCoProList[i] != NULL) && ((m_nCoProActive & (0x1 << i)) == 0))
+      {
+	m_pCoProList[i]->Skip(m_nDevClock - m_nCoProIdle[i]);
+	m_nCoProIdle[i] = m_nDevClock;
+      }
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // NextPC - Gets the next PC value
 //
@@ -745,3 +1274,16 @@ long CArmProc::NextPC()
 	return m_pCore->NextPC();
 }
 
+
+///////////////////////////////////////////////////////////////////////////////
+// SetPC - Where the program starts, if not at the reset vector. Only
+//         before the first cycle.
+//
+void CArmProc::SetPC(uint32_t addr)
+{
+  m_pCore->SetPC(addr);
+
+  // The first fetch goes out on the bus before the core is cycled
+  m_pCoreBus->A = addr;
+}
+
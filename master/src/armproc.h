@@ -28,14 +28,27 @@
 #include "swarm.h"
 #include "core.h"
 #include "cache.h"
+#include "trace.h"
+#include "dram.h"
+#include "cachestats.h"
+#include "stats.h"
+#include "syscopro.h"
 #include "swi.h"
 #include <iostream.h>
+#include <time.h>
 #include "copro.h"
 
+#include "device.h"
 #include "ostimer.h"
+#include "rtc.h"
 #include "intctrl.h"
 #include "lcdctrl.h"
 #include "uartctrl.h"
+#include "dmactrl.h"
+#include "blockdev.h"
+#include "netdev.h"
+#include "cosim.h"
+#include "gdbstub.h"
 
 enum PPROC {P_NORMAL, P_READING1, P_READING, P_WRITING1, P_INTWRITE};
 
@@ -51,14 +64,13 @@ typedef struct POTAG
   uint32_t bw      : 2;   // 0 = word, 1 = byte, 2 = half word, 3 = UNDEF
 } PINOUT;
 
-#define CACHE_LINE 4
-
 class CArmProc
 {
   // constructors and destructor
  public:
   CArmProc();
   CArmProc(uint32_t nCacheSize);
+  CArmProc(CACHECONFIG* pIConfig, CACHECONFIG* pDConfig);
   ~CArmProc();
 
   // Public methods
@@ -66,7 +78,8 @@ class CArmProc
   void Cycle(PINOUT* pinout);  
   void Reset();
   inline uint64_t GetRealCycles() { return m_nCycles; }
-  inline uint64_t GetLogicalCycles() { return m_pCore->GetCycles();} 
+  inline uint64_t GetLogicalCycles() { return m_pCore->GetCycles();}
+  inline uint64_t GetInstructions() { return m_pCore->GetInstructions(); } 
 
   inline void RegisterSWI(uint32_t nSwi, SWI_CALL* pSwi)
     { m_pCore->RegisterSWI(nSwi, pSwi); }
@@ -76,46 +89,150 @@ class CArmProc
   void RegisterCoProcessor(uint32_t nID, CCoProcessor* pCoPro);
   void UnregisterCoProcessor(uint32_t nID);
 
+  // Memory hierarchy below the L1 cache(s)
+  void SetL2Cache(CACHECONFIG* pConfig, uint32_t nLatency);
+  void SetDramTiming(CDramTiming* pDram);
+
+  // Writes detailed cache stats as JSON to strFile at exit
+  void SetStatsFile(const char* strFile);
+
+  // Writes the tags and data of each cache to strFile at exit
+  void SetSnapshotFile(const char* strFile);
+
+  // Connects the UART to the host - see uartctrl.h for strBackend
+  void SetUART(const char* strBackend);
+
+  // Attaches a block device with strImage as its disk. Throws a
+  // CBlockDevException if the image can't be used.
+  void SetBlockDevice(const char* strImage);
+
+  // Attaches a network device - see netdev.h for strBackend. Throws a
+  // CNetDevException if the backend can't be opened.
+  void SetNetDevice(const char* strBackend);
+
+  // Holds the simulation back so the devices see nKHz thousand cycles a
+  // second of host time, as best we can. 0 runs flat out (the default).
+  void SetThrottle(uint32_t nKHz);
+
+  // Moves the devices to where strFile says - see device.h
+  void SetDeviceMap(const char* strFile);
+
+  // Gives the devices that work on memory (the LCD and DMA) the memory
+  // the program runs in
+  void SetMemory(uint8_t* pMemory, uint32_t nMemSize);
+
+  // Sends LCD frames to strOutput - see lcdctrl.h
+  inline void SetLCDOutput(const char* strOutput, uint32_t nFrameCycles)
+    { m_pLCDCtrl->SetOutput(strOutput, nFrameCycles); }
+
+  // Traces every access made to the cache to pTrace (NULL to stop)
+  inline void SetTrace(CTraceWriter* pTrace) { m_pTrace = pTrace; }
+
+  // Checks every instruction the core runs against pCoSim (NULL to stop)
+  inline void SetCoSim(CCoSim* pCoSim) 
+    { m_pCoSim = pCoSim; m_pCore->SetCoSim(pCoSim); }
+
+  // Lets pGdb stop us before each instruction (NULL to stop)
+  inline void SetGdbStub(CGdbStub* pGdb) { m_pGdb = pGdb; }
+
+  // The registers, only meaningful while pGdb has us stopped
+  inline void GetState(ARMSTATE* pState) { m_pCore->GetState(pState); }
+  inline void SetState(const ARMSTATE* pState) { m_pCore->SetState(pState); }
+
+  // Forgets everything cached, e.g. after memory was changed behind our back
+  void FlushCaches();
+
+  // Gives the idle coprocessors the cycles they've missed, so their
+  // counters are right before anyone outside reads them
+  void SyncCoPros();
+
   void DebugDump();
   void DebugDumpCore();
   void DebugDumpCoProc();
   long NextPC();
+  void SetPC(uint32_t addr);
 
  private:
+  void Init(CCache* pICache, CCache* pDCache);
   void AtomicCycle(PINOUT* pinout);
+  bool_t WriteThrough(CCache* pCache, PINOUT* pinout);
+  void WriteStats();
+  void RegisterCacheStats();
+  void WriteSnapshot();
+  void MapDevices();
+  void Throttle();
 
   // Member variables
  private:
   CArmCore* m_pCore;
   CCache*   m_pICache;
   CCache*   m_pDCache;
+  CCache*   m_pL2Cache;     // NULL if there isn't one
+  CDramTiming* m_pDram;
   COREBUS*  m_pCoreBus;
   COPROBUS* m_pCoProBus;
 
   COSTimer* m_pOSTimer;
+  CRTC*     m_pRTC;
   CIntCtrl* m_pIntCtrl;
   CLCDCtrl* m_pLCDCtrl;
-  CUARTCtrl* m_pUARTCtrl;
-
-  OSTBUS     m_ostbus;
-  INTCTRLBUS m_icbus;
-  LCDCTRLBUS m_lcdctrlbus;
-  UARTCTRLBUS m_uartctrlbus;
+  CUARTCtrl* m_pUARTCtrl;   // NULL unless SetUART has been called
+  CDMACtrl* m_pDMACtrl;
+  CBlockDev* m_pBlockDev;   // NULL unless SetBlockDevice has been called
+  CNetDev*  m_pNetDev;      // NULL unless SetNetDevice has been called
+  uint8_t*  m_pMemory;
+  uint32_t  m_nMemSize;
+
+  // Where the devices live, and the ones that are cycled
+  CDeviceMap m_devMap;
+  DEVCONFIG  m_devConfig[DEV_NUM];
+  CDevice*   m_pDevices[DEV_NUM];
+  int32_t    m_devIrq[DEV_NUM];
+  uint32_t   m_devLines[DEV_NUM]; // What each last raised
+  uint32_t   m_nDevices;
+  CDevice*   m_pReadDev;    // Device to read from next cycle, if any
+  uint32_t   m_readAddr;
+  uint64_t   m_nDevClock;   // Cycles the devices have seen
+
+  // Throttling, against the clock the devices see
+  uint32_t   m_nThrottleKHz;
+  uint64_t   m_nThrottleNext;  // When to next see if we're ahead (~0 if off)
+  uint64_t   m_nThrottleBase;  // The clock when m_throttleStart was read
+  struct timespec m_throttleStart;
 
   // Used for storing between cycles
   uint32_t   m_addrPrev;
   enum PPROC m_mode;
   uint32_t   m_nRead;
+  uint32_t   m_lineMask;  // Masks an address to the line being read
+  uint32_t   m_l1Mask;    // Masks an address to the L1 line
+  uint32_t   m_nFillWords;
 
   uint64_t   m_nCycles;
-  uint32_t   m_cacheLine[CACHE_LINE];
+  uint32_t   m_cacheLine[MAX_LINESIZE / 4];
   uint64_t   m_nCacheHits;
   uint64_t   m_nCacheMisses;
+  bool_t     m_bRefill;   // Next hit is the access that just missed
+  uint64_t   m_nMissStart; // m_nCycles when it missed
+  CHistogram m_missCycles; // How long each miss held up the core
+  CCacheStats* m_pIStats;
+  CCacheStats* m_pDStats; // Same as m_pIStats if the cache is shared
+  char*      m_strStatsFile;
+  char*      m_strSnapshotFile;
+  uint32_t   m_nL2Latency;
+  uint64_t   m_nL2Hits;
+  uint64_t   m_nL2Misses;
 
   uint32_t   m_pending;  // Did we have an interrupt whilst reading a cache 
                          // line?
 
   CCoProcessor* m_pCoProList[16];
+  CSysCoPro*    m_pSysCoPro;
+  uint32_t      m_nCoProActive;     // A bit for each one still being cycled
+  uint64_t      m_nCoProIdle[16];   // When each went idle
+  CTraceWriter* m_pTrace;
+  CCoSim*   m_pCoSim;
+  CGdbStub* m_pGdb;
 };
 
 #endif // __ARMPROC_H__
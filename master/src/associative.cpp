@@ -24,26 +24,43 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h> 
-#include <unistd.h>
-
 #include <stdlib.h>
 #include "swarm.h"
 #include "associative.h"
 
-#define LINE_SIZE_W 4  /* (words) */
-#define LINE_SIZE_B 16 /* (bytes) */
-#define INVALID_BIT 0x00000001
+#define INVALID_BIT 0xFFFFFFFF
 
 ///////////////////////////////////////////////////////////////////////////////
-// Constructor
+// Constructors
 //
 CAssociativeCache::CAssociativeCache(uint32_t nSize)
+{
+  Init(nSize, DEFAULT_LINESIZE, CP_RANDOM);
+}
+
+CAssociativeCache::CAssociativeCache(uint32_t nSize, uint32_t nLineSize,
+				     enum CACHE_POLICY policy)
+{
+  Init(nSize, nLineSize, policy);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Init - The tag is the word address with the word select bits masked off.
+//        Word addresses never have the top bits set, so all ones is safe to
+//        use as the invalid marker whatever the line size.
+//
+void CAssociativeCache::Init(uint32_t nSize, uint32_t nLineSize, 
+			     enum CACHE_POLICY policy)
 {
   m_nSize = nSize;
-  m_nLines = nSize / LINE_SIZE_B;
+  m_nLineSize = nLineSize;
+  m_nLines = nSize / nLineSize;
+  m_nWays = m_nLines;
+  m_lineWords = nLineSize >> 2;
+  m_tagMask = ~(m_lineWords - 1);
+  m_policy = policy;
+  m_nNext = 0;
 
   m_pDataRAM = new uint32_t[nSize / sizeof(uint32_t)];
   m_pTagCAM = new uint32_t[m_nLines];
@@ -57,12 +74,6 @@ CAssociativeCache::CAssociativeCache(uint32_t nSize)
 //
 CAssociativeCache::~CAssociativeCache()
 {
-#if 1
-  int fd = open("/tmp/cache", O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
-  write(fd, m_pDataRAM, m_nSize);
-  close(fd);
-#endif
-
   delete[] m_pDataRAM;
   delete[] m_pTagCAM;
 }
@@ -74,42 +85,44 @@ CAssociativeCache::~CAssociativeCache()
 void CAssociativeCache::Reset()
 {
   // Mark all the tags as invalid
-  for (uint32_t i = 0; i < (m_nSize / LINE_SIZE_B); i++)
+  for (uint32_t i = 0; i < m_nLines; i++)
     m_pTagCAM[i] = INVALID_BIT;
+  m_nNext = 0;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
 //
 //
-uint32_t CAssociativeCache::Read(uint32_t addr)
+bool_t CAssociativeCache::Lookup(uint32_t addr, uint32_t* pWord)
 {
-  uint32_t tag = addr & 0xFFFFFFFC;
-  uint32_t word = addr & 0x00000003;
+  uint32_t tag = addr & m_tagMask;
+  uint32_t word = addr & ~m_tagMask;
   
-  for (int i = 0; i < m_nLines; i++)
+  for (uint32_t i = 0; i < m_nLines; i++)
     {
       // If it's not this line then continue
       if (m_pTagCAM[i] != tag)
 	continue;
 
       // Got a hit, so return the correct word
-      return m_pDataRAM[(i * LINE_SIZE_W) + word];
+      *pWord = m_pDataRAM[(i * m_lineWords) + word];
+      return TRUE;
     }
 
-  // Failed to find data in the cache, so throw a miss
-  throw CCacheMiss(addr);
+  // Failed to find data in the cache
+  return FALSE;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // WriteLine - Replacement algorithm: first try to find a free space. If none,
-//             pick one at random.
+//             pick one at random or round robin depending on the policy.
 //
 void CAssociativeCache::WriteLine(uint32_t addr, uint32_t* pLine)
 {
-  uint32_t tag = addr & 0xFFFFFFFC;
-  int i;
+  uint32_t tag = addr & m_tagMask;
+  uint32_t i;
 
   // Look for a free line in the cache
   for (i = 0; i < m_nLines; i++)
@@ -120,21 +133,29 @@ void CAssociativeCache::WriteLine(uint32_t addr, uint32_t* pLine)
 
       // Got a place, so use it
       m_pTagCAM[i] = tag;
-      for (int j = 0; j < LINE_SIZE_W; j++)
-	m_pDataRAM[((i * LINE_SIZE_W) + j)] = pLine[j];
+      for (uint32_t j = 0; j < m_lineWords; j++)
+	m_pDataRAM[((i * m_lineWords) + j)] = pLine[j];
 
       return;
     }
   
-  // Failed to find a free cache line, so do a random selection
-  uint64_t temp = rand();
-  temp *= m_nLines;
-  temp /= RAND_MAX;
-  i = temp;
+  // Failed to find a free cache line, so pick a victim
+  if (m_policy == CP_RANDOM)
+    {
+      uint64_t temp = rand();
+      temp *= m_nLines;
+      temp /= ((uint64_t)RAND_MAX + 1);
+      i = temp;
+    }
+  else
+    {
+      i = m_nNext;
+      m_nNext = (m_nNext + 1) & (m_nLines - 1);
+    }
 
   m_pTagCAM[i] = tag;
-  for (int j = 0; j < LINE_SIZE_W; j++)
-    m_pDataRAM[((i * LINE_SIZE_W) + j)] = pLine[j];
+  for (uint32_t j = 0; j < m_lineWords; j++)
+    m_pDataRAM[((i * m_lineWords) + j)] = pLine[j];
 }
 
 
@@ -144,9 +165,9 @@ void CAssociativeCache::WriteLine(uint32_t addr, uint32_t* pLine)
 //
 void CAssociativeCache::InvalidateLineByAddr(uint32_t addr)
 {
-  uint32_t tag = addr & 0xFFFFFFFC;
+  uint32_t tag = addr & m_tagMask;
 
-  for (int i = 0; i < m_nLines; i++)
+  for (uint32_t i = 0; i < m_nLines; i++)
     {
       if (m_pTagCAM[i] == tag)
 	{
@@ -163,20 +184,36 @@ void CAssociativeCache::InvalidateLineByAddr(uint32_t addr)
 //
 void CAssociativeCache::WriteWord(uint32_t addr, uint32_t word)
 {
-  uint32_t tag = addr & 0xFFFFFFFC;
-  uint32_t word_sel = addr & 0x00000003;
+  uint32_t tag = addr & m_tagMask;
+  uint32_t word_sel = addr & ~m_tagMask;
   
   // Search for line in the tag CAM
-  for (int i = 0; i < m_nLines; i++)
+  for (uint32_t i = 0; i < m_nLines; i++)
     {
       if (m_pTagCAM[i] != tag)
 	continue;
 
       // Found the line, so update the word
-      m_pDataRAM[(i * LINE_SIZE_W) + word_sel] = word;
+      m_pDataRAM[(i * m_lineWords) + word_sel] = word;
       return;
     }
 
   // No find, so throw an exception
   throw CCacheMiss(addr);
 }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GetLine - All the lines are in the one set.
+//
+bool_t CAssociativeCache::GetLine(uint32_t n, uint32_t* pAddr, 
+				  uint32_t** ppData)
+{
+  if (m_pTagCAM[n] == INVALID_BIT)
+    return FALSE;
+
+  *pAddr = m_pTagCAM[n];
+  *ppData = m_pDataRAM + (n * m_lineWords);
+
+  return TRUE;
+}
@@ -32,23 +32,33 @@ class CAssociativeCache: public CCache
   // Constructors and destructor
  public:
   CAssociativeCache(uint32_t nSize);
+  CAssociativeCache(uint32_t nSize, uint32_t nLineSize, 
+		    enum CACHE_POLICY policy = CP_RANDOM);
   ~CAssociativeCache();
 
   // Public methods
  public: 
-  uint32_t Read(uint32_t addr);
+  bool_t   Lookup(uint32_t addr, uint32_t* pWord);
   void     WriteLine(uint32_t addr, uint32_t* pLine);
   void     WriteWord(uint32_t addr, uint32_t word);
   void     InvalidateLineByAddr(uint32_t addr);
   void     Reset();
+  bool_t   GetLine(uint32_t n, uint32_t* pAddr, uint32_t** ppData);
+
+ private:
+  void Init(uint32_t nSize, uint32_t nLineSize, enum CACHE_POLICY policy);
   
   // Private data types
  private:
   uint32_t*   m_pTagCAM;
   uint32_t*   m_pDataRAM;
-  uint32_t    m_nSize;
 
   uint32_t    m_nLines;
+  uint32_t    m_lineWords;
+  uint32_t    m_tagMask;
+  uint32_t    m_nNext;    // Next victim for round robin
+
+  enum CACHE_POLICY m_policy;
 };
 
 #endif // __DIRECT_H__
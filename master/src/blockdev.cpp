@@ -0,0 +1,349 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   blockdev.cpp
+// header blockdev.h
+// info   Implements the block device.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "swarm.h"
+#include "blockdev.h"
+#include "stats.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CBlockDevException -
+//
+CBlockDevException::CBlockDevException(const char* strError)
+{
+  free(m_strError);
+  m_strError = strdup(strError);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CBlockDev - Opens the image and starts the I/O thread.
+//
+CBlockDev::CBlockDev(const char* strImage)
+{
+  struct stat st;
+
+  m_fd = open(strImage, O_RDWR);
+  if (m_fd == -1)
+    throw CBlockDevException("Can't open block device image");
+  if (fstat(m_fd, &st) == -1)
+    {
+      close(m_fd);
+      throw CBlockDevException("Can't get the size of block device image");
+    }
+
+  m_pBuffer = new uint8_t[BLOCKDEV_MAXSECTORS * BLOCKDEV_SECTORSIZE];
+  m_bRequest = FALSE;
+  m_bDone = FALSE;
+  m_bFailed = FALSE;
+  m_bStop = FALSE;
+  m_nReads = 0;
+  m_nWrites = 0;
+  m_nSectors = 0;
+  m_nWaits = 0;
+
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_cond, NULL);
+  if (pthread_create(&m_thread, NULL, IOThreadEntry, this) != 0)
+    {
+      pthread_mutex_destroy(&m_lock);
+      pthread_cond_destroy(&m_cond);
+      delete [] m_pBuffer;
+      close(m_fd);
+      throw CBlockDevException("Can't start the block device I/O thread");
+    }
+
+  // Any odd bytes on the end can't be got at
+  m_regs[R_BLKSECTORS] = st.st_size / BLOCKDEV_SECTORSIZE;
+  Reset();
+
+  CStats::Register(this, "block.reads", &m_nReads);
+  CStats::Register(this, "block.writes", &m_nWrites);
+  CStats::Register(this, "block.sectors", &m_nSectors);
+  CStats::Register(this, "block.waits", &m_nWaits);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CBlockDev - Lets the I/O thread finish what it is doing.
+//
+CBlockDev::~CBlockDev()
+{
+  CStats::Unregister(this);
+
+  pthread_mutex_lock(&m_lock);
+  m_bStop = TRUE;
+  pthread_cond_broadcast(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+  pthread_join(m_thread, NULL);
+
+  pthread_mutex_destroy(&m_lock);
+  pthread_cond_destroy(&m_cond);
+  delete [] m_pBuffer;
+  close(m_fd);
+
+  if ((m_nReads + m_nWrites) != 0)
+    cout << "Block info: reads = " << m_nReads << " writes = " << m_nWrites
+	 << " sectors = " << m_nSectors << " waits = " << m_nWaits << "\n";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Reset - A command in progress still happens on the image, but we don't
+//         wait around to hear about it.
+//
+void CBlockDev::Reset()
+{
+  // Don't let the buffer be reused while the I/O thread has it
+  pthread_mutex_lock(&m_lock);
+  while (m_bRequest)
+    pthread_cond_wait(&m_cond, &m_lock);
+  m_bDone = FALSE;
+  pthread_mutex_unlock(&m_lock);
+
+  uint32_t nSectors = m_regs[R_BLKSECTORS];
+  memset(m_regs, 0, sizeof(m_regs));
+  m_regs[R_BLKSECTORS] = nSectors;
+  m_nEnd = 0;
+  m_nDeadline = ~(uint64_t)0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Command - Checks a command and hands it to the I/O thread. Sets the error
+//           bit if it isn't one we can do.
+//
+void CBlockDev::Command(uint32_t nCommand)
+{
+  uint32_t nSector = m_regs[R_BLKSECTOR];
+  uint32_t nCount = m_regs[R_BLKCOUNT];
+  uint32_t addr = m_regs[R_BLKADDR];
+  uint32_t nBytes = nCount * BLOCKDEV_SECTORSIZE;
+
+  if (nCommand == BLKCOMMAND_FLUSH)
+    nCount = 0;
+  else if ((nCommand != BLKCOMMAND_READ) && (nCommand != BLKCOMMAND_WRITE))
+    {
+      m_regs[R_BLKSTATUS] = BLKSTATUS_ERROR;
+      return;
+    }
+  else if ((nCount == 0) || (nCount > BLOCKDEV_MAXSECTORS) ||
+	   (nCount > m_regs[R_BLKSECTORS]) ||
+	   (nSector > m_regs[R_BLKSECTORS] - nCount) ||
+	   (nBytes > m_nMemSize) || (addr > m_nMemSize - nBytes))
+    {
+      m_regs[R_BLKSTATUS] = BLKSTATUS_ERROR;
+      return;
+    }
+
+  // What gets written is what is in memory now
+  if (nCommand == BLKCOMMAND_WRITE)
+    memcpy(m_pBuffer, m_pMemory + addr, nBytes);
+
+  pthread_mutex_lock(&m_lock);
+  m_nOp = nCommand;
+  m_nSector = nSector;
+  m_nCount = nCount;
+  m_bRequest = TRUE;
+  m_bDone = FALSE;
+  pthread_cond_broadcast(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+
+  m_nEnd = *m_pClock + BLOCKDEV_SEEKCYCLES +
+    ((uint64_t)nCount * BLOCKDEV_SECTORCYCLES);
+  m_regs[R_BLKSTATUS] = BLKSTATUS_BUSY;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Finish - The command's time is up. If the host hasn't caught up then the
+//          simulation waits for it.
+//
+void CBlockDev::Finish()
+{
+  pthread_mutex_lock(&m_lock);
+  if (!m_bDone)
+    {
+      m_nWaits++;
+      while (!m_bDone)
+	pthread_cond_wait(&m_cond, &m_lock);
+    }
+  bool_t bFailed = m_bFailed;
+  m_bDone = FALSE;
+  pthread_mutex_unlock(&m_lock);
+
+  if (bFailed)
+    {
+      m_regs[R_BLKSTATUS] = BLKSTATUS_ERROR;
+      return;
+    }
+
+  if (m_nOp == BLKCOMMAND_READ)
+    {
+      uint32_t addr = m_regs[R_BLKADDR];
+      uint32_t nBytes = m_nCount * BLOCKDEV_SECTORSIZE;
+
+      memcpy(m_pMemory + addr, m_pBuffer, nBytes);
+      InvalidateCaches(addr, nBytes);
+      m_nReads++;
+    }
+  else if (m_nOp == BLKCOMMAND_WRITE)
+    m_nWrites++;
+  m_nSectors += m_nCount;
+
+  m_regs[R_BLKSTATUS] = BLKSTATUS_DONE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cycle - Only called when a command is due to finish or a register has
+//         been written.
+//
+uint32_t CBlockDev::Cycle()
+{
+  m_nDeadline = ~(uint64_t)0;
+
+  if (m_regs[R_BLKSTATUS] & BLKSTATUS_BUSY)
+    {
+      if (m_nEnd <= *m_pClock)
+	Finish();
+      else
+	m_nDeadline = m_nEnd;
+    }
+
+  return ((m_regs[R_BLKCONTROL] & BLKCONTROL_INT) &&
+	  (m_regs[R_BLKSTATUS] & (BLKSTATUS_DONE | BLKSTATUS_ERROR))) ? 1 : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - Nothing but control and status can be changed while busy.
+//
+void CBlockDev::Write(uint32_t addr, uint32_t data)
+{
+  uint32_t nReg = addr >> 2;
+  bool_t bBusy = (m_regs[R_BLKSTATUS] & BLKSTATUS_BUSY) != 0;
+
+  switch (nReg)
+    {
+    case R_BLKSECTOR: case R_BLKCOUNT: case R_BLKADDR:
+      if (!bBusy)
+	m_regs[nReg] = data;
+      break;
+
+    case R_BLKCOMMAND:
+      if (!bBusy)
+	Command(data);
+      break;
+
+    case R_BLKSTATUS:
+      m_regs[R_BLKSTATUS] &= ~(data & (BLKSTATUS_DONE | BLKSTATUS_ERROR));
+      break;
+
+    case R_BLKCONTROL:
+      m_regs[R_BLKCONTROL] = data & BLKCONTROL_INT;
+      break;
+
+    default:
+      return;
+    }
+
+  // Our interrupt line may have changed
+  m_nDeadline = *m_pClock + 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read -
+//
+uint32_t CBlockDev::Read(uint32_t addr)
+{
+  uint32_t nReg = addr >> 2;
+
+  if (nReg >= BLOCKDEV_NUMREGS)
+    return 0;
+
+  return m_regs[nReg];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// IOThread - Does the requests it is given on the image until told to stop.
+//
+void CBlockDev::IOThread()
+{
+  pthread_mutex_lock(&m_lock);
+  while (1)
+    {
+      while (!m_bRequest && !m_bStop)
+	pthread_cond_wait(&m_cond, &m_lock);
+      if (!m_bRequest)
+	break;
+
+      uint32_t nOp = m_nOp;
+      off_t nOffset = (off_t)m_nSector * BLOCKDEV_SECTORSIZE;
+      size_t nBytes = m_nCount * BLOCKDEV_SECTORSIZE;
+      pthread_mutex_unlock(&m_lock);
+
+      bool_t bFailed = FALSE;
+      size_t nDone = 0;
+
+      if (nOp == BLKCOMMAND_FLUSH)
+	bFailed = (fsync(m_fd) == -1);
+
+      while ((nDone < nBytes) && !bFailed)
+	{
+	  ssize_t n;
+
+	  if (nOp == BLKCOMMAND_READ)
+	    n = pread(m_fd, m_pBuffer + nDone, nBytes - nDone,
+		      nOffset + nDone);
+	  else
+	    n = pwrite(m_fd, m_pBuffer + nDone, nBytes - nDone,
+		       nOffset + nDone);
+
+	  if (n > 0)
+	    nDone += n;
+	  else
+	    bFailed = TRUE;
+	}
+
+      pthread_mutex_lock(&m_lock);
+      m_bFailed = bFailed;
+      m_bRequest = FALSE;
+      m_bDone = TRUE;
+      pthread_cond_broadcast(&m_cond);
+    }
+  pthread_mutex_unlock(&m_lock);
+}
+
+void* CBlockDev::IOThreadEntry(void* arg)
+{
+  ((CBlockDev*)arg)->IOThread();
+  return NULL;
+}
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   blockdev.h
+// header n/a
+// info   A disk backed by an image file on the host, which moves whole
+//        sectors between the image and memory. The registers are:
+//
+//          0x00 first sector
+//          0x04 number of sectors (at most BLOCKDEV_MAXSECTORS)
+//          0x08 memory address
+//          0x0C command - 1 reads sectors into memory, 2 writes memory to
+//               sectors and 3 flushes the image to the host's disk
+//          0x10 status - bit 0 busy, bit 1 done, bit 2 error. Writing a 1
+//               to done or error clears it.
+//          0x14 control - bit 0 enables the interrupt
+//          0x18 sectors in the image (read only)
+//
+//        The host I/O is done by a thread of our own, so the simulation
+//        carries on while it happens. A command finishes after
+//        BLOCKDEV_SEEKCYCLES plus BLOCKDEV_SECTORCYCLES per sector whatever
+//        the host took; if the host hasn't finished by then we wait for it.
+//        Data read only lands in memory when the command finishes, and
+//        data written is taken from memory when the command is given.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __BLOCKDEV_H__
+#define __BLOCKDEV_H__
+
+#include <pthread.h>
+#include "swarm.h"
+#include "device.h"
+
+#define BLOCKDEV_SIZE         0x1000
+#define BLOCKDEV_SECTORSIZE   512
+#define BLOCKDEV_MAXSECTORS   256
+#define BLOCKDEV_SEEKCYCLES   20000  // Per command
+#define BLOCKDEV_SECTORCYCLES 1000   // Per sector moved
+
+#define R_BLKSECTOR   0x0
+#define R_BLKCOUNT    0x1
+#define R_BLKADDR     0x2
+#define R_BLKCOMMAND  0x3
+#define R_BLKSTATUS   0x4
+#define R_BLKCONTROL  0x5
+#define R_BLKSECTORS  0x6
+#define BLOCKDEV_NUMREGS 7
+
+#define BLKCOMMAND_READ  0x1
+#define BLKCOMMAND_WRITE 0x2
+#define BLKCOMMAND_FLUSH 0x3
+
+#define BLKSTATUS_BUSY   0x1
+#define BLKSTATUS_DONE   0x2
+#define BLKSTATUS_ERROR  0x4
+
+#define BLKCONTROL_INT   0x1
+
+class CBlockDevException : public CException
+{
+ public:
+  CBlockDevException(const char* strError);
+};
+
+class CBlockDev : public CDevice
+{
+  // Constructors and destructor
+ public:
+  CBlockDev(const char* strImage);  // Throws a CBlockDevException
+  ~CBlockDev();
+
+  // Public methods
+ public:
+  uint32_t Cycle();
+  uint32_t Read(uint32_t addr);
+  void     Write(uint32_t addr, uint32_t data);
+  void     Reset();
+  uint32_t GetSize() { return BLOCKDEV_SIZE; }
+
+  // Private methods
+ private:
+  void Command(uint32_t nCommand);
+  void Finish();
+  void IOThread();
+  static void* IOThreadEntry(void* arg);
+
+  // Private data
+ private:
+  uint32_t m_regs[BLOCKDEV_NUMREGS];
+  uint64_t m_nEnd;           // When the command in hand finishes
+  uint8_t* m_pBuffer;        // Sectors on their way to or from the image
+
+  // The request for the I/O thread, all under m_lock
+  int  m_fd;
+  bool_t m_bRequest;
+  bool_t m_bDone;
+  bool_t m_bFailed;
+  bool_t m_bStop;
+  uint32_t m_nOp;
+  uint32_t m_nSector;
+  uint32_t m_nCount;
+  pthread_t m_thread;
+  pthread_mutex_t m_lock;
+  pthread_cond_t m_cond;
+
+  // For the stats at the end
+  uint64_t m_nReads;
+  uint64_t m_nWrites;
+  uint64_t m_nSectors;
+  uint64_t m_nWaits;          // Times the host was slower than the model
+};
+
+#endif // __BLOCKDEV_H__
@@ -18,12 +18,18 @@
 // name   cache.cpp
 // author Michael Dales (michael@dcs.gla.ac.uk)
 // header cache.h
-// info   Implements the cache miss exception
+// info   Implements the cache miss exception and the helpers for building
+//        a cache from a CACHECONFIG.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <stdlib.h>
+#include <string.h>
 #include "swarm.h"
 #include "cache.h"
+#include "direct.h"
+#include "associative.h"
+#include "setassoc.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // CCacheMiss - Constructor
@@ -34,3 +40,167 @@ CCacheMiss::CCacheMiss(uint32_t addr)
 }
 
 CCache::~CCache() {}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// put_u32 - Writes a word out little endian.
+//
+static void put_u32(FILE* fp, uint32_t val)
+{
+  fputc(val & 0xFF, fp);
+  fputc((val >> 8) & 0xFF, fp);
+  fputc((val >> 16) & 0xFF, fp);
+  fputc((val >> 24) & 0xFF, fp);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Snapshot - Writes out the tags and data in the format given in cache.h
+//
+void CCache::Snapshot(FILE* fp)
+{
+  uint32_t nLines = m_nSize / m_nLineSize;
+  uint32_t nWords = m_nLineSize >> 2;
+
+  fwrite(SNAPSHOT_MAGIC, 1, 8, fp);
+  put_u32(fp, m_nSize);
+  put_u32(fp, m_nLineSize);
+  put_u32(fp, m_nWays);
+  put_u32(fp, GetSets());
+
+  for (uint32_t i = 0; i < nLines; i++)
+    {
+      uint32_t addr;
+      uint32_t* pData;
+
+      if (GetLine(i, &addr, &pData))
+	{
+	  put_u32(fp, addr << 2);
+	  for (uint32_t j = 0; j < nWords; j++)
+	    put_u32(fp, pData[j]);
+	}
+      else
+	{
+	  put_u32(fp, SNAPSHOT_INVALID);
+	  for (uint32_t j = 0; j < nWords; j++)
+	    put_u32(fp, 0);
+	}
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CCacheConfigException - Constructor
+//
+CCacheConfigException::CCacheConfigException(const char* strError)
+{
+  free(m_strError);
+  m_strError = strdup(strError);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// log2_exact - Returns log2 of n, or 0xFFFFFFFF if n isn't a power of two.
+//
+uint32_t log2_exact(uint32_t n)
+{
+  uint32_t bits = 0;
+
+  if ((n == 0) || ((n & (n - 1)) != 0))
+    return 0xFFFFFFFF;
+
+  while (n > 1)
+    {
+      n >>= 1;
+      bits++;
+    }
+
+  return bits;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// InitCacheConfig - Fills in the default geometry, which is what SWARM has
+//                   always used: 16 byte lines, 4 way, round robin.
+//
+void InitCacheConfig(CACHECONFIG* pConfig, uint32_t nSize)
+{
+  pConfig->nSize = nSize;
+  pConfig->nLineSize = DEFAULT_LINESIZE;
+  pConfig->nWays = 4;
+  pConfig->policy = CP_ROUNDROBIN;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ParseCacheConfig - Parses a string of the form
+//
+//                      size[:line[:ways[:policy]]]
+//
+//                    where policy is "rr" or "random". Fields not given are
+//                    left as they were in pConfig. Returns FALSE if the 
+//                    string is malformed.
+//
+bool_t ParseCacheConfig(const char* str, CACHECONFIG* pConfig)
+{
+  char* end;
+  const char* p = str;
+  uint32_t* fields[3] = {&pConfig->nSize, &pConfig->nLineSize, 
+			 &pConfig->nWays};
+
+  for (int i = 0; i < 3; i++)
+    {
+      uint32_t val = strtoul(p, &end, 0);
+      if (end == p)
+	return FALSE;
+      *(fields[i]) = val;
+
+      if (*end == '\0')
+	return TRUE;
+      if (*end != ':')
+	return FALSE;
+      p = end + 1;
+    }
+
+  if (strcmp(p, "rr") == 0)
+    pConfig->policy = CP_ROUNDROBIN;
+  else if (strcmp(p, "random") == 0)
+    pConfig->policy = CP_RANDOM;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CreateCache - Checks the geometry and builds the right sort of cache for
+//               it. Throws a CCacheConfigException if it can't.
+//
+CCache* CreateCache(CACHECONFIG* pConfig)
+{
+  if (log2_exact(pConfig->nSize) == 0xFFFFFFFF)
+    throw CCacheConfigException("Cache size must be a power of two");
+  if ((log2_exact(pConfig->nLineSize) == 0xFFFFFFFF) || 
+      (pConfig->nLineSize < 4) || (pConfig->nLineSize > MAX_LINESIZE))
+    throw CCacheConfigException("Cache line size must be a power of two "
+				"between 4 and 256 bytes");
+  if ((pConfig->nWays != 0) && (log2_exact(pConfig->nWays) == 0xFFFFFFFF))
+    throw CCacheConfigException("Cache associativity must be a power of two");
+  if (pConfig->nSize < (pConfig->nLineSize * 
+			(pConfig->nWays == 0 ? 1 : pConfig->nWays)))
+    throw CCacheConfigException("Cache too small for its line size and "
+				"associativity");
+
+  switch (pConfig->nWays)
+    {
+    case 0:
+      return new CAssociativeCache(pConfig->nSize, pConfig->nLineSize,
+				   pConfig->policy);
+    case 1:
+      return CDirectCache::Create(pConfig->nSize, pConfig->nLineSize);
+    default:
+      return CSetAssociativeCache::Create(pConfig->nSize, pConfig->nWays,
+					  pConfig->nLineSize, pConfig->policy);
+    }
+}
@@ -27,8 +27,41 @@
 #ifndef __CACHE_H__
 #define __CACHE_H__
 
+#include <stdio.h>
 #include "swarm.h"
 
+///////////////////////////////////////////////////////////////////////////////
+// CACHECONFIG - Describes the geometry of a cache. All sizes are in bytes and
+//               must be powers of two. nWays of 1 gives a direct mapped 
+//               cache, 0 a fully associative one.
+//
+enum CACHE_POLICY {CP_ROUNDROBIN = 0, CP_RANDOM};
+
+typedef struct CCTAG
+{
+  uint32_t          nSize;
+  uint32_t          nLineSize;
+  uint32_t          nWays;
+  enum CACHE_POLICY policy;
+} CACHECONFIG;
+
+#define DEFAULT_LINESIZE 16
+#define MAX_LINESIZE     256
+
+///////////////////////////////////////////////////////////////////////////////
+// Cache snapshots - CCache::Snapshot writes out the state of a cache as:
+//
+//   8 bytes   magic "SWCACHE1"
+//   4 x u32   size (bytes), line size (bytes), ways, sets
+//   then for each set, for each way in the set:
+//     u32     byte address of the line, or 0xFFFFFFFF if it's not valid
+//     n x u32 the data words of the line (all 0 if not valid)
+//
+// All u32s are little endian.
+//
+#define SNAPSHOT_MAGIC   "SWCACHE1"
+#define SNAPSHOT_INVALID 0xFFFFFFFF
+
 ///////////////////////////////////////////////////////////////////////////////
 // CCache - Abstract cache definition.
 //
@@ -38,11 +71,32 @@ class CCache
   virtual ~CCache();
 
  public:
-  virtual uint32_t Read(uint32_t addr) = 0;
+  // Lookup is the fast path - it returns FALSE on a miss rather than 
+  // throwing. Read is kept for code that prefers the exception.
+  virtual bool_t Lookup(uint32_t addr, uint32_t* pWord) = 0;
+  uint32_t Read(uint32_t addr);
+
   virtual void WriteLine(uint32_t addr, uint32_t* pLine) = 0;
   virtual void WriteWord(uint32_t addr, uint32_t word) = 0;
   virtual void InvalidateLineByAddr(uint32_t addr) = 0;
   virtual void Reset() = 0;
+
+  // Gets the nth line (n = set * ways + way). Returns FALSE if the line 
+  // isn't valid, else fills in the word address of the line and a pointer
+  // to its data.
+  virtual bool_t GetLine(uint32_t n, uint32_t* pAddr, uint32_t** ppData) = 0;
+  void Snapshot(FILE* fp);
+
+  inline uint32_t GetSize() { return m_nSize; }
+  inline uint32_t GetLineSize() { return m_nLineSize; }
+  inline uint32_t GetLineWords() { return m_nLineSize >> 2; }
+  inline uint32_t GetWays() { return m_nWays; }
+  inline uint32_t GetSets() { return m_nSize / (m_nLineSize * m_nWays); }
+
+ protected:
+  uint32_t m_nSize;      // bytes
+  uint32_t m_nLineSize;  // bytes
+  uint32_t m_nWays;      // lines per set
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -60,5 +114,30 @@ class CCacheMiss
   uint32_t m_addr;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// CCacheConfigException - Thrown when asked to build a cache with a geometry
+//                         we can't do (e.g. not a power of two).
+//
+class CCacheConfigException : public CException
+{
+ public:
+  CCacheConfigException(const char* strError);
+};
+
+// Helpers for building caches from a config
+uint32_t log2_exact(uint32_t n);
+void     InitCacheConfig(CACHECONFIG* pConfig, uint32_t nSize);
+bool_t   ParseCacheConfig(const char* str, CACHECONFIG* pConfig);
+CCache*  CreateCache(CACHECONFIG* pConfig);
+
+inline uint32_t CCache::Read(uint32_t addr)
+{
+  uint32_t word;
+
+  if (!Lookup(addr, &word))
+    throw CCacheMiss(addr);
+
+  return word;
+}
 
 #endif // __CACHE_H__
@@ -0,0 +1,346 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   cachestats.cpp
+// header cachestats.h
+// info   Implements the cache statistics and miss classification.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include "swarm.h"
+#include "cachestats.h"
+#include "stats.h"
+
+#define EMPTY_TAG 0xFFFFFFFF
+#define HASH(_t)  ((_t) * 0x9E3779B1)
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CCacheStats - Constructor
+//
+CCacheStats::CCacheStats(CCache* pCache, bool_t bClassify)
+{
+  m_pCache = pCache;
+  m_bClassify = bClassify;
+  m_lineShift = log2_exact(pCache->GetLineWords());
+
+  memset(m_nHits, 0, sizeof(m_nHits));
+  memset(m_nMisses, 0, sizeof(m_nMisses));
+  memset(m_nClasses, 0, sizeof(m_nClasses));
+
+  m_nSets = pCache->GetSets();
+  m_setMask = m_nSets - 1;
+  m_pSetMisses = new uint64_t[m_nSets];
+  m_pSetConflicts = new uint64_t[m_nSets];
+  memset(m_pSetMisses, 0, sizeof(uint64_t) * m_nSets);
+  memset(m_pSetConflicts, 0, sizeof(uint64_t) * m_nSets);
+
+  m_pTags = NULL;
+  m_pPrev = m_pNext = m_pChain = m_pBuckets = NULL;
+  m_pSeen = NULL;
+
+  if (!m_bClassify)
+    return;
+
+  // Shadow cache has as many lines as the real one
+  m_nLines = pCache->GetSize() / pCache->GetLineSize();
+  m_nUsed = 0;
+  m_pTags = new uint32_t[m_nLines];
+  m_pPrev = new int32_t[m_nLines];
+  m_pNext = new int32_t[m_nLines];
+  m_pChain = new int32_t[m_nLines];
+  m_pBuckets = new int32_t[m_nLines * 2];
+  m_bucketMask = (m_nLines * 2) - 1;
+  for (uint32_t i = 0; i < m_nLines * 2; i++)
+    m_pBuckets[i] = -1;
+  m_head = m_tail = -1;
+
+  m_nSeenSize = 4096;
+  m_nSeen = 0;
+  m_pSeen = new uint32_t[m_nSeenSize];
+  memset(m_pSeen, 0xFF, sizeof(uint32_t) * m_nSeenSize);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CCacheStats - Destructor
+//
+CCacheStats::~CCacheStats()
+{
+  CStats::Unregister(this);
+
+  delete[] m_pSetMisses;
+  delete[] m_pSetConflicts;
+
+  if (m_bClassify)
+    {
+      delete[] m_pTags;
+      delete[] m_pPrev;
+      delete[] m_pNext;
+      delete[] m_pChain;
+      delete[] m_pBuckets;
+      delete[] m_pSeen;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read - Notes a read of the word at addr. Returns the class of the miss if
+//        it was a miss and we're classifying them.
+//
+enum MISS_CLASS CCacheStats::Read(bool_t bInst, uint32_t addr, bool_t bMiss)
+{
+  uint32_t tag = addr >> m_lineShift;
+  enum MISS_CLASS mc = MC_NONE;
+
+  if (!bMiss)
+    m_nHits[bInst ? 1 : 0][0]++;
+  else
+    {
+      m_nMisses[bInst ? 1 : 0][0]++;
+      m_pSetMisses[tag & m_setMask]++;
+    }
+
+  if (!m_bClassify)
+    return MC_NONE;
+
+  // The shadow cache and seen list need updating on every read, not just
+  // the misses
+  bool_t bShadowHit = ShadowAccess(tag);
+  bool_t bSeen = Seen(tag);
+
+  if (bMiss)
+    {
+      if (!bSeen)
+	mc = MC_COMPULSORY;
+      else if (bShadowHit)
+	{
+	  mc = MC_CONFLICT;
+	  m_pSetConflicts[tag & m_setMask]++;
+	}
+      else
+	mc = MC_CAPACITY;
+
+      m_nClasses[mc]++;
+    }
+
+  return mc;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - Notes a write. As the caches are write through with no allocate
+//         these don't change what is cached, so they're just counted.
+//
+void CCacheStats::Write(uint32_t /*addr*/, bool_t bHit)
+{
+  if (bHit)
+    m_nHits[0][1]++;
+  else
+    m_nMisses[0][1]++;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ShadowAccess - Looks up a line in the shadow cache, moving it to the front
+//                of the LRU list (adding it if needed). Returns TRUE if it
+//                was already there.
+//
+bool_t CCacheStats::ShadowAccess(uint32_t tag)
+{
+  uint32_t bucket = HASH(tag) & m_bucketMask;
+  int32_t i;
+
+  for (i = m_pBuckets[bucket]; i != -1; i = m_pChain[i])
+    if (m_pTags[i] == tag)
+      break;
+
+  if (i != -1)
+    {
+      // Hit - move to the front
+      if (i != m_head)
+	{
+	  m_pNext[m_pPrev[i]] = m_pNext[i];
+	  if (m_pNext[i] != -1)
+	    m_pPrev[m_pNext[i]] = m_pPrev[i];
+	  else
+	    m_tail = m_pPrev[i];
+
+	  m_pPrev[i] = -1;
+	  m_pNext[i] = m_head;
+	  m_pPrev[m_head] = i;
+	  m_head = i;
+	}
+      return TRUE;
+    }
+
+  // Miss - take a free line, or throw out the least recently used
+  if (m_nUsed < m_nLines)
+    i = m_nUsed++;
+  else
+    {
+      i = m_tail;
+
+      // Off the end of the list...
+      m_tail = m_pPrev[i];
+      if (m_tail != -1)
+	m_pNext[m_tail] = -1;
+      else
+	m_head = -1;
+
+      // ...and out of its hash chain
+      int32_t* pLink = &m_pBuckets[HASH(m_pTags[i]) & m_bucketMask];
+      while (*pLink != i)
+	pLink = &m_pChain[*pLink];
+      *pLink = m_pChain[i];
+    }
+
+  m_pTags[i] = tag;
+  m_pChain[i] = m_pBuckets[bucket];
+  m_pBuckets[bucket] = i;
+
+  m_pPrev[i] = -1;
+  m_pNext[i] = m_head;
+  if (m_head != -1)
+    m_pPrev[m_head] = i;
+  else
+    m_tail = i;
+  m_head = i;
+
+  return FALSE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Seen - Returns TRUE if we've seen this line before, and remembers it if
+//        not.
+//
+bool_t CCacheStats::Seen(uint32_t tag)
+{
+  uint32_t mask = m_nSeenSize - 1;
+  uint32_t i;
+
+  for (i = HASH(tag) & mask; m_pSeen[i] != EMPTY_TAG; i = (i + 1) & mask)
+    if (m_pSeen[i] == tag)
+      return TRUE;
+
+  m_pSeen[i] = tag;
+  m_nSeen++;
+
+  // Keep the table at most half full
+  if (m_nSeen * 2 > m_nSeenSize)
+    {
+      uint32_t* pOld = m_pSeen;
+      uint32_t nOld = m_nSeenSize;
+
+      m_nSeenSize *= 2;
+      mask = m_nSeenSize - 1;
+      m_pSeen = new uint32_t[m_nSeenSize];
+      memset(m_pSeen, 0xFF, sizeof(uint32_t) * m_nSeenSize);
+
+      for (uint32_t j = 0; j < nOld; j++)
+	if (pOld[j] != EMPTY_TAG)
+	  {
+	    for (i = HASH(pOld[j]) & mask; m_pSeen[i] != EMPTY_TAG;
+		 i = (i + 1) & mask)
+	      ;
+	    m_pSeen[i] = pOld[j];
+	  }
+
+      delete[] pOld;
+    }
+
+  return FALSE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Register - The same counters as WriteJSON, bar the per set ones.
+//
+void CCacheStats::Register(const char* strName)
+{
+  // Nothing writes through the instruction side
+  static const char* strKinds[2][2] = {{"data.read", "data.write"},
+				       {"inst.read", NULL}};
+  char strFull[64];
+
+  for (int nInst = 0; nInst < 2; nInst++)
+    for (int nWrite = 0; nWrite < 2; nWrite++)
+      {
+	if (strKinds[nInst][nWrite] == NULL)
+	  continue;
+	snprintf(strFull, sizeof(strFull), "%s.%s_hits", strName,
+		 strKinds[nInst][nWrite]);
+	CStats::Register(this, strFull, &m_nHits[nInst][nWrite]);
+	snprintf(strFull, sizeof(strFull), "%s.%s_misses", strName,
+		 strKinds[nInst][nWrite]);
+	CStats::Register(this, strFull, &m_nMisses[nInst][nWrite]);
+      }
+
+  if (!m_bClassify)
+    return;
+
+  snprintf(strFull, sizeof(strFull), "%s.misses.compulsory", strName);
+  CStats::Register(this, strFull, &m_nClasses[MC_COMPULSORY]);
+  snprintf(strFull, sizeof(strFull), "%s.misses.capacity", strName);
+  CStats::Register(this, strFull, &m_nClasses[MC_CAPACITY]);
+  snprintf(strFull, sizeof(strFull), "%s.misses.conflict", strName);
+  CStats::Register(this, strFull, &m_nClasses[MC_CONFLICT]);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteJSON - Writes the stats out as a JSON object.
+//
+void CCacheStats::WriteJSON(FILE* fp, const char* strName)
+{
+  fprintf(fp, "    {\n");
+  fprintf(fp, "      \"name\": \"%s\",\n", strName);
+  fprintf(fp, "      \"size\": %u,\n", m_pCache->GetSize());
+  fprintf(fp, "      \"line\": %u,\n", m_pCache->GetLineSize());
+  fprintf(fp, "      \"ways\": %u,\n", m_pCache->GetWays());
+  fprintf(fp, "      \"inst\": {\"read_hits\": %llu, \"read_misses\": %llu},\n",
+	  (unsigned long long)m_nHits[1][0],
+	  (unsigned long long)m_nMisses[1][0]);
+  fprintf(fp, "      \"data\": {\"read_hits\": %llu, \"read_misses\": %llu, "
+	  "\"write_hits\": %llu, \"write_misses\": %llu},\n",
+	  (unsigned long long)m_nHits[0][0],
+	  (unsigned long long)m_nMisses[0][0],
+	  (unsigned long long)m_nHits[0][1],
+	  (unsigned long long)m_nMisses[0][1]);
+
+  if (m_bClassify)
+    fprintf(fp, "      \"misses\": {\"compulsory\": %llu, \"capacity\": %llu, "
+	    "\"conflict\": %llu},\n",
+	    (unsigned long long)m_nClasses[MC_COMPULSORY],
+	    (unsigned long long)m_nClasses[MC_CAPACITY],
+	    (unsigned long long)m_nClasses[MC_CONFLICT]);
+
+  fprintf(fp, "      \"set_misses\": [");
+  for (uint32_t i = 0; i < m_nSets; i++)
+    fprintf(fp, "%s%llu", i == 0 ? "" : ", ",
+	    (unsigned long long)m_pSetMisses[i]);
+  fprintf(fp, "],\n");
+
+  fprintf(fp, "      \"set_conflicts\": [");
+  for (uint32_t i = 0; i < m_nSets; i++)
+    fprintf(fp, "%s%llu", i == 0 ? "" : ", ",
+	    (unsigned long long)m_pSetConflicts[i]);
+  fprintf(fp, "]\n");
+
+  fprintf(fp, "    }");
+}
@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   cachestats.h
+// header n/a
+// info   Keeps statistics on how a cache is being used. Hits and misses are
+//        split by instruction/data and read/write. If asked to classify
+//        misses then each read miss is also put into one of the 3Cs:
+//
+//          compulsory - first time the line has been touched
+//          capacity   - would also miss in a fully associative LRU cache
+//                       of the same size
+//          conflict   - would have hit in that fully associative cache
+//
+//        which needs a shadow fully associative cache and a record of every
+//        line ever seen, so it's not free. Misses and conflict misses are
+//        also counted per set.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __CACHESTATS_H__
+#define __CACHESTATS_H__
+
+#include <stdio.h>
+#include "swarm.h"
+#include "cache.h"
+
+enum MISS_CLASS {MC_NONE = 0, MC_COMPULSORY, MC_CAPACITY, MC_CONFLICT};
+
+class CCacheStats
+{
+  // Constructors and destructor
+ public:
+  CCacheStats(CCache* pCache, bool_t bClassify);
+  ~CCacheStats();
+
+  // Public methods
+ public:
+  enum MISS_CLASS Read(bool_t bInst, uint32_t addr, bool_t bMiss);
+  void Write(uint32_t addr, bool_t bHit);
+  void WriteJSON(FILE* fp, const char* strName);
+  void Register(const char* strName);   // Adds our counters to CStats
+
+  inline uint64_t GetHits(bool_t bInst, bool_t bWrite)
+    { return m_nHits[bInst ? 1 : 0][bWrite ? 1 : 0]; }
+  inline uint64_t GetMisses(bool_t bInst, bool_t bWrite)
+    { return m_nMisses[bInst ? 1 : 0][bWrite ? 1 : 0]; }
+
+ private:
+  bool_t ShadowAccess(uint32_t tag);
+  bool_t Seen(uint32_t tag);
+
+  // Private data
+ private:
+  CCache*  m_pCache;
+  bool_t   m_bClassify;
+  uint32_t m_lineShift;   // Word address to line tag
+  uint32_t m_setMask;
+
+  uint64_t m_nHits[2][2];   // [instruction][write]
+  uint64_t m_nMisses[2][2];
+  uint64_t m_nClasses[4];   // Indexed by MISS_CLASS
+
+  uint32_t m_nSets;
+  uint64_t* m_pSetMisses;
+  uint64_t* m_pSetConflicts;
+
+  // The shadow fully associative LRU cache. Lines are kept on a doubly
+  // linked list (head is most recent) and found through a chained hash.
+  uint32_t  m_nLines;
+  uint32_t  m_nUsed;
+  uint32_t* m_pTags;
+  int32_t*  m_pPrev;
+  int32_t*  m_pNext;
+  int32_t*  m_pChain;
+  int32_t*  m_pBuckets;
+  uint32_t  m_bucketMask;
+  int32_t   m_head;
+  int32_t   m_tail;
+
+  // Every line tag we've seen, as an open addressed hash
+  uint32_t* m_pSeen;
+  uint32_t  m_nSeenSize;
+  uint32_t  m_nSeen;
+};
+
+#endif // __CACHESTATS_H__
@@ -59,8 +59,21 @@ class CCoProcessor
  public:
   virtual void Cycle(COPROBUS* bus) = 0;
   virtual void DebugDump() = 0;
+
+  // A coprocessor that says it is idle after a cycle isn't cycled again
+  // until the core fetches one of its instructions. It is then told how
+  // many cycles it missed before being cycled as usual. By default a
+  // coprocessor is never idle, and so sees every cycle.
+  virtual bool_t IsIdle() { return FALSE; }
+  virtual void Skip(uint64_t /*nCycles*/) {}
 };
 
+// True if an instruction is in the coprocessor space (LDC, STC, CDP, MCR
+// or MRC), and which coprocessor it is for
+#define IS_COPRO_INST(_i) ((((_i) & 0x0C000000) == 0x0C000000) && \
+			   (((_i) & 0x0F000000) != 0x0F000000))
+#define COPRO_INST_CPN(_i) (((_i) >> 8) & 0xF)
+
 class CCoProSetException : public CException
 {
  public:
@@ -28,6 +28,9 @@
 #include <string.h>
 #include <iostream.h>
 #include "disarm.h"
+#include "stats.h"
+#include "perfmon.h"
+#include "cosim.h"
 #ifndef ARM6
 #include "booth.h"
 #endif
@@ -324,12 +327,16 @@ void CArmCore::create_vector(enum MODE mode, uint32_t addr, CONTROL** ctrlList)
 CArmCore::CArmCore()
 {
   m_nCycles = 0;
+  m_nInstructions = 0;
   m_alu = alu_table;
   m_ctrlListNext = m_ctrlListCur = NULL;
   m_nCtrlCur = 0;
   m_busPrevious = m_busCurrent = 0;
+  m_irqLine = 0;
+  m_fiqPin = 1;
   m_regMult = 0;
   m_bMultCarry = 0;
+  m_pCoSim = NULL;
 
   m_swiCalls = (SWI_CALL**)TNEW(SWI_CALL*[MAX_SWI_CALL]);
   memset(m_swiCalls, 0, sizeof(SWI_CALL*) * MAX_SWI_CALL);
@@ -346,6 +353,9 @@ CArmCore::CArmCore()
   m_ctrlListNext = (CONTROL**)TNEW(CONTROL*[MAX_INST_LEN]);
   memset(m_ctrlListNext, 0, sizeof(CONTROL*) * MAX_INST_LEN);
 
+  CStats::Register(this, "cycles.logical", &m_nCycles);
+  CStats::Register(this, "instructions", &m_nInstructions);
+
   // Reset the chip.
   Reset();
 }
@@ -356,6 +366,8 @@ CArmCore::CArmCore()
 //
 CArmCore::~CArmCore()
 {
+  CStats::Unregister(this);
+
   if (m_ctrlListCur != NULL)
     {
       while (m_ctrlListCur[m_nCtrlCur] != NULL) 
@@ -523,23 +535,6 @@ void CArmCore::Cycle(COREBUS* bus)
 	{
 	  // Reset and branch to zero - XXX
 	}
-      else if (((m_busPrevious->fiq == 1) && (m_busCurrent->fiq == 0))
-	       && !(m_regsWorking[R_CPSR] & FIQ_BIT))
-	{
-	  m_pending |= FIQ_BIT;
-#ifndef QUIET
-	  cout << "FIQ pending\n";
-#endif
-	}
-      //else if (((m_busPrevious->irq == 1) && (m_busCurrent->irq == 0))
-      else if ((m_busCurrent->irq == 0)
-	       && !(m_regsWorking[R_CPSR] & IRQ_BIT))
-	{
-	  m_pending |= IRQ_BIT;
-#ifndef QUIET
-	  cout << "IRQ pending\n";
-#endif
-	}
     }
 
   /* Did we request a copro instruction, and did we get an reply?
@@ -590,14 +585,22 @@ void CArmCore::Cycle(COREBUS* bus)
       //if (m_ctrlListCur != NULL)
       //TDELETE(m_ctrlListCur);
 
-      // First see if there are any pending interrupts
-      if (m_pending == 0x0)
+      // First see if there are any pending interrupts. IRQ is level
+      // triggered, so it's pending for as long as the pin is low.
+      if ((m_pending | (m_irqLine & ~m_regsWorking[R_CPSR])) == 0x0)
 	{
 	  CONTROL** temp = m_ctrlListCur;
 	  m_ctrlListCur = m_ctrlListNext;
 	  m_ctrlListNext = temp;
 	  m_nCtrlCur = 0;
 	  m_multStage = 0;
+	  m_nInstructions++;
+	  if (m_pCoSim != NULL)
+	    {
+	      ARMSTATE state;
+	      GetState(&state);
+	      m_pCoSim->Boundary(&state, m_iPipe[2], CE_INSTRUCTION);
+	    }
 #ifndef QUIET
 	  char str[120];
 	  memset(str, 0, 120);
@@ -611,6 +614,14 @@ void CArmCore::Cycle(COREBUS* bus)
 #ifndef QUIET
 	  printf("---------------- Next Inst -------------------\n");
 #endif
+	  if (m_pCoSim != NULL)
+	    {
+	      ARMSTATE state;
+	      GetState(&state);
+	      m_pCoSim->Boundary(&state, m_iPipe[2], 
+				 (m_pending & FIQ_BIT) ? CE_FIQ : CE_IRQ);
+	    }
+
 	  if (m_pending & FIQ_BIT)
 	    {
 #ifndef QUIET 
@@ -621,14 +632,13 @@ void CArmCore::Cycle(COREBUS* bus)
 	      m_nCtrlCur = 0;
 	      m_pending &= ~FIQ_BIT;
 	    }
-	  else if (m_pending & IRQ_BIT)
+	  else
 	    {
 #ifndef QUIET 
 	      printf("Handling IRQ\n");
 #endif
 	      create_vector(M_IRQ, VEC_IRQ, m_ctrlListCur);
 	      m_nCtrlCur = 0;
-	      m_pending &= ~IRQ_BIT;
 	    }
 	}
     }
@@ -684,7 +694,9 @@ void CArmCore::Cycle(COREBUS* bus)
 	    }
 	  //TDELETE(m_ctrlListNext);
 	}
+      PERF_SECTION(PS_DECODE);
       Decode();
+      PERF_SECTION(PS_CORE);
     }
 
 #ifdef NATIVE_CHECK
@@ -706,7 +718,9 @@ void CArmCore::Cycle(COREBUS* bus)
 #endif
 
   // Exercise the datapath  
+  PERF_SECTION(PS_EXEC);
   Exec();
+  PERF_SECTION(PS_CORE);
 
 #ifdef NATIVE_CHECK
   //m_nativeResult = m_regsWorking[m_ctrlListCur[m_nCtrlCur]->rd];
@@ -835,10 +849,38 @@ void CArmCore::Cycle(COREBUS* bus)
       m_nCtrlCur++;      
     }
 
+  // opc says the word just read was an opcode. The processor needs to know
+  // before it reads the next one, to pick the instruction cache, so look at
+  // whether the step that will take it fills the pipe.
+  CONTROL* pNext = m_ctrlListCur[m_nCtrlCur];
+  if ((pNext == NULL) && (m_ctrlListNext != NULL))
+    pNext = m_ctrlListNext[0];
+  bus->di = ((pNext == NULL) || (pNext->updates & UPDATE_IP)) ? 1 : 0;
+
   m_nCycles++;  
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// SetInterruptPins - FIQ is taken on a falling edge if it isn't disabled at
+//                    the time. IRQ is looked at when the next instruction
+//                    is due.
+//
+void CArmCore::SetInterruptPins(uint32_t irq, uint32_t fiq)
+{
+  if ((m_fiqPin == 1) && (fiq == 0) && !(m_regsWorking[R_CPSR] & FIQ_BIT))
+    {
+      m_pending |= FIQ_BIT;
+#ifndef QUIET
+      cout << "FIQ pending\n";
+#endif
+    }
+
+  m_fiqPin = fiq;
+  m_irqLine = (irq == 0) ? IRQ_BIT : 0;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // reset - Resets the core as if the reset pin had been set high.
 //
@@ -890,6 +932,10 @@ void CArmCore::Reset()
   // Put in a no-op 
   m_ctrlListNext[0] = create_noop();
 
+  // and forget what was fetched, or it gets decoded before the first fetch
+  // from the reset vector arrives
+  memset(m_iPipe, 0, sizeof(m_iPipe));
+
   // Need to clear all the program status registers
   m_regsWorking[R_CPSR] = 0;
   m_regsUser[7] = 0;
@@ -4135,3 +4181,94 @@ long CArmCore::NextPC()
 {
   return m_regsWorking[15];
 }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetPC - Starts us somewhere other than the reset vector. The pipeline is
+//         just noops until the first cycle, so the first fetch is from here.
+//
+void CArmCore::SetPC(uint32_t addr)
+{
+  m_regAddr = addr;
+  m_regsWorking[R_PC] = addr;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GetState - Only meaningful between instructions, when the PC is 8 on from
+//            the instruction about to run. Whichever mode we're in has its
+//            registers in the working set, the rest are where SetMode left
+//            them.
+//
+void CArmCore::GetState(ARMSTATE* pState)
+{
+  uint32_t* banks[AB_NUM - 1] = {m_regsIrq, m_regsSvc, m_regsAbort, 
+				 m_regsUndef};
+  uint32_t* temp = NULL;
+
+  memcpy(pState->r, m_regsWorking, sizeof(uint32_t) * 16);
+  pState->r[R_PC] -= 8;
+  pState->cpsr = m_regsWorking[R_CPSR];
+
+  // The modes that only bank r13 and r14
+  for (int i = AB_IRQ; i < AB_USER; i++)
+    memcpy(pState->banked[i], banks[i - 1], sizeof(uint32_t) * 3);
+  memcpy(pState->banked[AB_FIQ], &(m_regsFiq[5]), sizeof(uint32_t) * 3);
+  memcpy(pState->banked[AB_USER], &(m_regsUser[5]), sizeof(uint32_t) * 2);
+  pState->banked[AB_USER][2] = 0;
+  memcpy(pState->fiq, m_regsFiq, sizeof(uint32_t) * 5);
+  memcpy(pState->user, m_regsUser, sizeof(uint32_t) * 5);
+
+  switch (m_mode)
+    {
+    case M_FIQ : temp = pState->banked[AB_FIQ]; break;
+    case M_IRQ : temp = pState->banked[AB_IRQ]; break;
+    case M_SVC : temp = pState->banked[AB_SVC]; break;
+    case M_ABORT : temp = pState->banked[AB_ABORT]; break;
+    case M_UNDEF : temp = pState->banked[AB_UNDEF]; break;
+    default: temp = pState->banked[AB_USER]; break;
+    }
+  temp[0] = m_regsWorking[R_SP];
+  temp[1] = m_regsWorking[R_LR];
+  pState->spsr = temp[2];
+
+  if (m_mode == M_FIQ)
+    memcpy(pState->fiq, &(m_regsWorking[R_R8]), sizeof(uint32_t) * 5);
+  else
+    memcpy(pState->user, &(m_regsWorking[R_R8]), sizeof(uint32_t) * 5);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetState - The reverse of GetState, for a debugger. The PC is left alone,
+//            as the next instruction has already been fetched and decoded,
+//            and so are the mode bits, as the working set is laid out for
+//            the mode we're in.
+//
+void CArmCore::SetState(const ARMSTATE* pState)
+{
+  uint32_t* banks[AB_NUM - 1] = {m_regsIrq, m_regsSvc, m_regsAbort, 
+				 m_regsUndef};
+
+  for (int i = AB_IRQ; i < AB_USER; i++)
+    memcpy(banks[i - 1], pState->banked[i], sizeof(uint32_t) * 3);
+  memcpy(&(m_regsFiq[5]), pState->banked[AB_FIQ], sizeof(uint32_t) * 3);
+  memcpy(&(m_regsUser[5]), pState->banked[AB_USER], sizeof(uint32_t) * 2);
+  memcpy(m_regsFiq, pState->fiq, sizeof(uint32_t) * 5);
+  memcpy(m_regsUser, pState->user, sizeof(uint32_t) * 5);
+
+  // The current mode's SPSR is only in its bank
+  switch (m_mode)
+    {
+    case M_FIQ : m_regsFiq[7] = pState->spsr; break;
+    case M_IRQ : m_regsIrq[2] = pState->spsr; break;
+    case M_SVC : m_regsSvc[2] = pState->spsr; break;
+    case M_ABORT : m_regsAbort[2] = pState->spsr; break;
+    case M_UNDEF : m_regsUndef[2] = pState->spsr; break;
+    default: break;
+    }
+
+  memcpy(m_regsWorking, pState->r, sizeof(uint32_t) * 15);
+  m_regsWorking[R_CPSR] = (pState->cpsr & ~MBITS_SYS) | 
+    (m_regsWorking[R_CPSR] & MBITS_SYS);
+}
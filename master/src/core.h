@@ -33,6 +33,7 @@
 
 // Forward decs
 typedef struct CTAG CONTROL;
+class CCoSim;
 
 
 enum MODE {M_PREV = 0x00, M_USER = 0x10, M_FIQ = 0x11, M_IRQ = 0x12, 
@@ -96,6 +97,23 @@ typedef struct CBIOTAG
                          //      cache, as a SWI upcall to swarm occurred 
 } COREBUS;
 
+///////////////////////////////////////////////////////////////////////////////
+// The programmer's view of the CPU between instructions - what a debugger or
+// another model of the ARM would see. The banks hold every mode's copy, the
+// current one's included.
+//
+enum ARMBANK {AB_FIQ = 0, AB_IRQ, AB_SVC, AB_ABORT, AB_UNDEF, AB_USER, AB_NUM};
+
+typedef struct ASTAG
+{
+  uint32_t r[16];              // r15 is the address of the next instruction
+  uint32_t cpsr;
+  uint32_t spsr;               // Of the current mode, 0 in user and system
+  uint32_t banked[AB_NUM][3];  // r13, r14 and spsr of each mode
+  uint32_t fiq[5];             // r8 - r12 of fiq mode
+  uint32_t user[5];            // r8 - r12 of the rest
+} ARMSTATE;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Contains the entire state for the CPU. 
 //
@@ -110,12 +128,26 @@ class CArmCore
  public:
   void Cycle(COREBUS* bus);
   inline uint64_t GetCycles() { return m_nCycles; }
+  inline uint64_t GetInstructions() { return m_nInstructions; }
+
+  // Called when the irq or fiq pins (active low) change, rather than us
+  // looking at them on the bus every cycle.
+  void SetInterruptPins(uint32_t irq, uint32_t fiq);
 
   void RegisterSWI(uint32_t swi_number, SWI_CALL* swi);
   void UnregisterSWI(uint32_t swi_number);
 
   void DebugDump();
   long NextPC();
+  void SetPC(uint32_t addr);   // Only before the first cycle
+  void GetState(ARMSTATE* pState);
+  void SetState(const ARMSTATE* pState);  // Not the PC or the mode
+
+  // TRUE if the next cycle starts an instruction (or takes an interrupt)
+  inline bool_t AtBoundary() { return m_ctrlListCur[m_nCtrlCur] == NULL; }
+
+  // Told of every instruction boundary, if set
+  inline void SetCoSim(CCoSim* pCoSim) { m_pCoSim = pCoSim; }
 
   // Private methods
  private:
@@ -173,6 +205,7 @@ class CArmCore
   // Private data
  private:
   uint64_t       m_nCycles;
+  uint64_t       m_nInstructions;  // Started, not counting exceptions
   enum MODE      m_mode;
   enum MODE      m_prevMode;
   uint32_t       m_regAddr;
@@ -203,12 +236,15 @@ class CArmCore
   COREBUS*       m_busCurrent;
   COREBUS*       m_busPrevious;
   uint32_t       m_pending; // Pending interrupts
+  uint32_t       m_irqLine; // IRQ_BIT while the irq pin is held low
+  uint32_t       m_fiqPin;
 
   SWI_CALL**     m_swiCalls;
 
   bool_t         m_write;
 
   CMemory<CONTROL>* m_pCtrlPool;
+  CCoSim*        m_pCoSim;
 
 #ifdef NATIVE_CHECK
   uint32_t       m_nativeCpsr;
@@ -0,0 +1,326 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   cosim.cpp
+// header cosim.h
+// info   Implements the co-simulation checker.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include "swarm.h"
+#include "cosim.h"
+#include "disarm.h"
+#include "elfimage.h"
+
+#define FNV_BASIS 0x811C9DC5
+#define FNV_PRIME 0x01000193
+
+static const char* s_strBanks[AB_NUM] =
+  {"fiq", "irq", "svc", "abort", "undef", "user"};
+static const char* s_strWidths[4] = {"word", "byte", "half", "?"};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CCoSim - Constructor
+//
+CCoSim::CCoSim(const uint8_t* pMemory, uint32_t nMemSize, uint32_t nInterval)
+{
+  m_pRef = new CRefArm(pMemory, nMemSize);
+  m_nInterval = (nInterval == 0) ? 1 : nInterval;
+  m_pElf = NULL;
+
+  m_bPending = FALSE;
+  m_inst = 0;
+  m_event = CE_INSTRUCTION;
+  m_bSynced = FALSE;
+  m_lastInst = 0;
+  m_lastPC = 0;
+  m_nWrites = 0;
+  m_refHash = m_coreHash = FNV_BASIS;
+  m_nSinceCompare = 0;
+
+  m_bFailed = FALSE;
+  m_nInstructions = 0;
+  m_nChecked = 0;
+  m_nSynced = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CCoSim - Destructor
+//
+CCoSim::~CCoSim()
+{
+  delete m_pRef;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Boundary - Only takes a copy; see cosim.h for why. Two boundaries in one
+//            cycle means the first instruction can't have written anything,
+//            so it's safe to check it now.
+//
+void CCoSim::Boundary(const ARMSTATE* pState, uint32_t inst,
+		      enum COSIM_EVENT e)
+{
+  if (m_bPending)
+    Check();
+
+  m_state = *pState;
+  m_inst = inst;
+  m_event = e;
+  m_bPending = TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - Normalised the way main() writes memory.
+//
+void CCoSim::Write(uint32_t addr, uint32_t bw, uint32_t data)
+{
+  if (m_nWrites == REF_MAXWRITES)
+    return;
+
+  REFWRITE* pWrite = &m_writes[m_nWrites++];
+  switch (bw)
+    {
+    case 0:
+      pWrite->addr = addr & ~0x3;
+      pWrite->data = data;
+      break;
+    case 1:
+      pWrite->addr = addr;
+      pWrite->data = data & 0xFF;
+      break;
+    default:
+      pWrite->addr = addr & ~0x1;
+      pWrite->data = data & 0xFFFF;
+      break;
+    }
+  pWrite->bw = bw;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check - The core has finished the last instruction. See whether the
+//         reference agrees, then have it run the next one.
+//
+void CCoSim::Check()
+{
+  m_bPending = FALSE;
+  if (m_bFailed)
+    return;
+
+  if (!m_bSynced)
+    {
+      m_pRef->SetState(&m_state);
+      m_bSynced = TRUE;
+      m_nSynced++;
+    }
+  else
+    {
+      // Whatever the core left in the UNPREDICTABLE flags is right
+      uint32_t unknown = m_pRef->GetUnknownFlags();
+      if (unknown != 0)
+	{
+	  ARMSTATE state;
+	  m_pRef->GetState(&state);
+	  state.cpsr = (state.cpsr & ~unknown) | (m_state.cpsr & unknown);
+	  m_pRef->SetState(&state);
+	}
+
+      Compare();
+      if (m_bFailed)
+	return;
+    }
+
+  m_nInstructions++;
+  m_nWrites = 0;
+  m_lastPC = m_state.r[15];
+  m_lastInst = m_inst;
+
+  if (m_event != CE_INSTRUCTION)
+    m_pRef->Interrupt(m_event == CE_FIQ);
+  else if (!m_pRef->Step())
+    m_bSynced = FALSE;
+  else if ((m_nInterval == 1) && (m_pRef->GetInst() != m_inst))
+    Report("fetched different instructions");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compare -
+//
+void CCoSim::Compare()
+{
+  ARMSTATE ref;
+  uint32_t nWrites = m_pRef->GetWrites();
+
+  m_pRef->GetState(&ref);
+
+  if (m_nInterval == 1)
+    {
+      m_nChecked++;
+      if (memcmp(&ref, &m_state, sizeof(ARMSTATE)) != 0)
+	Report("registers differ");
+      else if (nWrites != m_nWrites)
+	Report("different number of writes");
+      else
+	for (uint32_t i = 0; i < nWrites; i++)
+	  if (memcmp(m_pRef->GetWrite(i), &m_writes[i], sizeof(REFWRITE)) != 0)
+	    {
+	      Report("writes differ");
+	      break;
+	    }
+      return;
+    }
+
+  FoldState(&ref, &m_refHash);
+  for (uint32_t i = 0; i < nWrites; i++)
+    {
+      const REFWRITE* pWrite = m_pRef->GetWrite(i);
+      Fold(pWrite->addr, &m_refHash);
+      Fold(pWrite->data, &m_refHash);
+    }
+  FoldState(&m_state, &m_coreHash);
+  for (uint32_t i = 0; i < m_nWrites; i++)
+    {
+      Fold(m_writes[i].addr, &m_coreHash);
+      Fold(m_writes[i].data, &m_coreHash);
+    }
+
+  if (++m_nSinceCompare < m_nInterval)
+    return;
+
+  m_nChecked++;
+  if (m_refHash != m_coreHash)
+    Report("state differs somewhere in the last interval (use -C 1 to find "
+	   "where)");
+  m_refHash = m_coreHash = FNV_BASIS;
+  m_nSinceCompare = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fold / FoldState - FNV-1a, a word at a time.
+//
+void CCoSim::Fold(uint32_t value, uint32_t* pHash)
+{
+  *pHash = (*pHash ^ value) * FNV_PRIME;
+}
+
+void CCoSim::FoldState(const ARMSTATE* pState, uint32_t* pHash)
+{
+  const uint32_t* p = (const uint32_t*)pState;
+
+  for (uint32_t i = 0; i < sizeof(ARMSTATE) / sizeof(uint32_t); i++)
+    Fold(p[i], pHash);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Report - The two views side by side, differences marked.
+//
+void CCoSim::Report(const char* strWhy)
+{
+  ARMSTATE ref;
+  char str[120];
+  char strName[16];
+
+  m_bFailed = TRUE;
+  m_pRef->GetState(&ref);
+
+  memset(str, 0, sizeof(str));
+  CDisarm::Decode(m_lastInst, str);
+  fprintf(stderr, "SWARM co-simulation failed after %llu instructions: %s\n",
+	  (unsigned long long)m_nInstructions, strWhy);
+  fprintf(stderr, "  0x%08X: 0x%08X %s\n", m_lastPC, m_lastInst, str);
+  if (m_pElf != NULL)
+    {
+      const ELFSYM* pSym = m_pElf->Lookup(m_lastPC);
+      if (pSym != NULL)
+	fprintf(stderr, "              in %s + 0x%X\n", pSym->strName,
+		m_lastPC - pSym->addr);
+    }
+  fprintf(stderr, "             reference    core\n");
+
+  for (int i = 0; i < 16; i++)
+    fprintf(stderr, "  %c r%-7d 0x%08X   0x%08X\n",
+	    (ref.r[i] != m_state.r[i]) ? '*' : ' ', i, ref.r[i],
+	    m_state.r[i]);
+  fprintf(stderr, "  %c cpsr     0x%08X   0x%08X\n",
+	  (ref.cpsr != m_state.cpsr) ? '*' : ' ', ref.cpsr, m_state.cpsr);
+  fprintf(stderr, "  %c spsr     0x%08X   0x%08X\n",
+	  (ref.spsr != m_state.spsr) ? '*' : ' ', ref.spsr, m_state.spsr);
+
+  // Only the banked registers that differ
+  for (int i = 0; i < AB_NUM; i++)
+    for (int j = 0; j < 3; j++)
+      if (ref.banked[i][j] != m_state.banked[i][j])
+	{
+	  sprintf(strName, "%s_%s", (j == 2) ? "spsr" : ((j == 0) ? "r13" : "r14"),
+		  s_strBanks[i]);
+	  fprintf(stderr, "  * %-8s 0x%08X   0x%08X\n", strName,
+		  ref.banked[i][j], m_state.banked[i][j]);
+	}
+  for (int i = 0; i < 5; i++)
+    {
+      if (ref.fiq[i] != m_state.fiq[i])
+	{
+	  sprintf(strName, "r%d_fiq", i + 8);
+	  fprintf(stderr, "  * %-8s 0x%08X   0x%08X\n", strName, ref.fiq[i],
+		  m_state.fiq[i]);
+	}
+      if (ref.user[i] != m_state.user[i])
+	{
+	  sprintf(strName, "r%d_user", i + 8);
+	  fprintf(stderr, "  * %-8s 0x%08X   0x%08X\n", strName, ref.user[i],
+		  m_state.user[i]);
+	}
+    }
+
+  for (uint32_t i = 0; i < m_pRef->GetWrites(); i++)
+    fprintf(stderr, "    reference wrote 0x%08X to 0x%08X (%s)\n",
+	    m_pRef->GetWrite(i)->data, m_pRef->GetWrite(i)->addr,
+	    s_strWidths[m_pRef->GetWrite(i)->bw & 0x3]);
+  for (uint32_t i = 0; i < m_nWrites; i++)
+    fprintf(stderr, "    core wrote      0x%08X to 0x%08X (%s)\n",
+	    m_writes[i].data, m_writes[i].addr,
+	    s_strWidths[m_writes[i].bw & 0x3]);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Summary - Checks anything outstanding first.
+//
+void CCoSim::Summary()
+{
+  // Whatever is left over since the last comparison
+  if (m_bPending)
+    Check();
+  if (!m_bFailed && (m_nSinceCompare != 0))
+    {
+      m_nChecked++;
+      if (m_refHash != m_coreHash)
+	Report("state differs somewhere in the last interval (use -C 1 to find "
+	       "where)");
+    }
+
+  printf("Check info: instructions = %llu checked = %llu synced = %llu%s\n",
+	 (unsigned long long)m_nInstructions, (unsigned long long)m_nChecked,
+	 (unsigned long long)m_nSynced, m_bFailed ? " FAILED" : "");
+}
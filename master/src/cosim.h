@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   cosim.h
+// header n/a
+// info   Runs the reference interpreter (refarm.h) in lock step with the
+//        core, and complains the first time they disagree about the
+//        registers, the PSRs or what an instruction wrote to memory. Unlike
+//        NATIVE_CHECK it works on any host and covers every instruction.
+//
+//        The core tells us when each instruction starts. We can't check it
+//        there, as the last one's writes are still on their way to memory,
+//        so the processor calls Process at the start of its next cycle,
+//        by which time they have arrived.
+//
+//        With an interval of 1 every instruction is compared. With a
+//        larger one the state is folded into a hash, which is compared
+//        every that many instructions - much cheaper, but it only says
+//        roughly where things went wrong.
+//
+//        Things the interpreter doesn't model (SWARM's own SWIs, the
+//        coprocessors, the devices) are run by the core alone, and the
+//        interpreter is then given the core's state.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __COSIM_H__
+#define __COSIM_H__
+
+#include "swarm.h"
+#include "core.h"
+#include "refarm.h"
+
+enum COSIM_EVENT {CE_INSTRUCTION, CE_IRQ, CE_FIQ};
+
+class CElfImage;
+
+class CCoSim
+{
+  // Constructors and destructor
+ public:
+  CCoSim(const uint8_t* pMemory, uint32_t nMemSize, uint32_t nInterval);
+  ~CCoSim();
+
+  // Public methods
+ public:
+  // From the core, before it runs inst (or takes the interrupt instead)
+  void Boundary(const ARMSTATE* pState, uint32_t inst, enum COSIM_EVENT e);
+
+  // From the processor, for each write to memory
+  void Write(uint32_t addr, uint32_t bw, uint32_t data);
+
+  // From the processor, at the start of each cycle
+  inline void Process() { if (m_bPending) Check(); }
+
+  inline bool_t HasFailed() { return m_bFailed; }
+  void Summary();
+
+  // So a difference can be put down to a function. NULL if there are no
+  // symbols.
+  inline void SetSymbols(CElfImage* pElf) { m_pElf = pElf; }
+
+  // Private methods
+ private:
+  void Check();
+  void Compare();
+  void Fold(uint32_t value, uint32_t* pHash);
+  void FoldState(const ARMSTATE* pState, uint32_t* pHash);
+  void Report(const char* strWhy);
+
+  // Private data
+ private:
+  CRefArm* m_pRef;
+  uint32_t m_nInterval;
+  CElfImage* m_pElf;
+
+  // The boundary waiting to be checked
+  bool_t   m_bPending;
+  ARMSTATE m_state;
+  uint32_t m_inst;
+  enum COSIM_EVENT m_event;
+
+  bool_t   m_bSynced;       // FALSE until the reference has the core's state
+  uint32_t m_lastInst;      // The instruction the reference last ran
+  uint32_t m_lastPC;
+  uint32_t m_nWrites;       // The core's writes since the last boundary
+  REFWRITE m_writes[REF_MAXWRITES];
+  uint32_t m_refHash;
+  uint32_t m_coreHash;
+  uint32_t m_nSinceCompare;
+
+  bool_t   m_bFailed;
+  uint64_t m_nInstructions;
+  uint64_t m_nChecked;
+  uint64_t m_nSynced;
+};
+
+#endif // __COSIM_H__
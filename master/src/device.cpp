@@ -0,0 +1,271 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   device.cpp
+// header device.h
+// info   Implements the device map and reads device config files.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swarm.h"
+#include "device.h"
+
+static const char* s_strDevNames[DEV_NUM] = {"ostimer", "lcd", "uart",
+					     "dma", "block", "net", "rtc",
+					     "intctrl"};
+
+// Until the device is given a clock it's always cycle 0
+static const uint64_t s_nNoClock = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// CDevice
+//
+CDevice::CDevice()
+{
+  m_pClock = &s_nNoClock;
+  m_nDeadline = 0;
+  m_pMemory = NULL;
+  m_nMemSize = 0;
+  memset(m_pCaches, 0, sizeof(m_pCaches));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CDevice
+//
+CDevice::~CDevice() {}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetCaches -
+//
+void CDevice::SetCaches(CCache* pICache, CCache* pDCache, CCache* pL2Cache)
+{
+  m_pCaches[0] = pICache;
+  m_pCaches[1] = (pDCache != pICache) ? pDCache : NULL;
+  m_pCaches[2] = pL2Cache;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// InvalidateCaches - Drops anything the caches hold for nBytes of memory
+//                    from addr, after a device has written there.
+//
+void CDevice::InvalidateCaches(uint32_t addr, uint32_t nBytes)
+{
+  for (int i = 0; (i < 3) && (nBytes != 0); i++)
+    {
+      CCache* pCache = m_pCaches[i];
+
+      if (pCache == NULL)
+	continue;
+
+      if (nBytes >= pCache->GetSize())
+	pCache->Reset();
+      else
+	{
+	  uint32_t nLine = pCache->GetLineSize();
+	  for (uint32_t a = addr & ~(nLine - 1); a < addr + nBytes; a += nLine)
+	    pCache->InvalidateLineByAddr(a >> 2);
+	}
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CDeviceMapException - Constructor
+//
+CDeviceMapException::CDeviceMapException(const char* strError)
+{
+  free(m_strError);
+  m_strError = strdup(strError);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CDeviceMap - Constructor
+//
+CDeviceMap::CDeviceMap()
+{
+  memset(m_pTable, 0, sizeof(m_pTable));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CDeviceMap - Destructor. The devices aren't ours to delete.
+//
+CDeviceMap::~CDeviceMap()
+{
+  Clear();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Clear - Removes all the devices.
+//
+void CDeviceMap::Clear()
+{
+  for (uint32_t i = 0; i < DEVMAP_L1SIZE; i++)
+    if (m_pTable[i] != NULL)
+      {
+	delete[] m_pTable[i];
+	m_pTable[i] = NULL;
+      }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Attach - Maps pDevice at base. Devices have to be in the top half of the
+//          address space (the bottom half is memory), aligned to their
+//          size and not overlap. Throws a CDeviceMapException if not.
+//
+void CDeviceMap::Attach(CDevice* pDevice, uint32_t base)
+{
+  uint32_t nSize = pDevice->GetSize();
+  uint32_t addr;
+
+  if ((nSize < (1 << DEVMAP_PAGESHIFT)) || ((nSize & (nSize - 1)) != 0))
+    throw CDeviceMapException("Device size must be a power of two of at "
+			      "least a page");
+  if ((base & 0x80000000) == 0)
+    throw CDeviceMapException("Devices must be mapped at or above "
+			      "0x80000000");
+  if ((base & (nSize - 1)) != 0)
+    throw CDeviceMapException("Device base not aligned to its size");
+
+  // Check first so a failure leaves the map as it was
+  for (addr = base; addr - base < nSize; addr += (1 << DEVMAP_PAGESHIFT))
+    {
+      uint32_t offset;
+      if (Lookup(addr, &offset) != NULL)
+	throw CDeviceMapException("Devices overlap");
+    }
+
+  for (addr = base; addr - base < nSize; addr += (1 << DEVMAP_PAGESHIFT))
+    {
+      DEVMAPENTRY* pTable = m_pTable[addr >> DEVMAP_L2SHIFT];
+
+      if (pTable == NULL)
+	{
+	  pTable = new DEVMAPENTRY[DEVMAP_L2SIZE];
+	  memset(pTable, 0, sizeof(DEVMAPENTRY) * DEVMAP_L2SIZE);
+	  m_pTable[addr >> DEVMAP_L2SHIFT] = pTable;
+	}
+
+      pTable += (addr >> DEVMAP_PAGESHIFT) & (DEVMAP_L2SIZE - 1);
+      pTable->pDevice = pDevice;
+      pTable->base = base;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// InitDeviceConfig - Where the devices have always been.
+//
+void InitDeviceConfig(DEVCONFIG config[DEV_NUM])
+{
+  config[DEV_OSTIMER].base = 0x90000000;
+  config[DEV_OSTIMER].irq = 26;
+  config[DEV_INTCTRL].base = 0x90050000;
+  config[DEV_INTCTRL].irq = -1;
+  config[DEV_UART].base = 0x90081000;
+  config[DEV_UART].irq = 24;
+  config[DEV_LCD].base = 0x90100000;
+  config[DEV_LCD].irq = 25;
+  config[DEV_DMA].base = 0x90020000;
+  config[DEV_DMA].irq = 20;
+  config[DEV_BLOCK].base = 0x90030000;
+  config[DEV_BLOCK].irq = 19;
+  config[DEV_NET].base = 0x90040000;
+  config[DEV_NET].irq = 18;
+  config[DEV_RTC].base = 0x90010000;
+  config[DEV_RTC].irq = 30;
+
+  for (int i = 0; i < DEV_NUM; i++)
+    config[i].bMapped = TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadDeviceConfig - Reads a device config file (see device.h) over the
+//                    top of config. Devices not in the file are left as
+//                    they were. Throws a CDeviceMapException if the file
+//                    can't be read or has a bad line in.
+//
+void ReadDeviceConfig(const char* strFile, DEVCONFIG config[DEV_NUM])
+{
+  FILE* fp = fopen(strFile, "r");
+  char line[256];
+  char error[512];
+  int nLine = 0;
+
+  if (fp == NULL)
+    {
+      sprintf(error, "Can't open device config %.256s", strFile);
+      throw CDeviceMapException(error);
+    }
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+    {
+      char strName[32], strBase[32];
+      char* p;
+      int32_t irq;
+      int i, n;
+
+      nLine++;
+      if ((p = strchr(line, '#')) != NULL)
+	*p = '\0';
+
+      n = sscanf(line, "%31s %31s %d", strName, strBase, &irq);
+      if (n <= 0)
+	continue;
+
+      for (i = 0; i < DEV_NUM; i++)
+	if (strcmp(strName, s_strDevNames[i]) == 0)
+	  break;
+
+      if ((n < 2) || (i == DEV_NUM))
+	{
+	  fclose(fp);
+	  sprintf(error, "%.256s:%d: expected \"name base [irq]\", where name "
+		  "is one of ostimer, rtc, intctrl, lcd, uart, dma, block "
+		  "or net", strFile, nLine);
+	  throw CDeviceMapException(error);
+	}
+
+      if (strcmp(strBase, "none") == 0)
+	{
+	  config[i].bMapped = FALSE;
+	  continue;
+	}
+
+      config[i].base = strtoul(strBase, &p, 0);
+      if ((*p != '\0') || ((config[i].base & 0x80000000) == 0) ||
+	  ((n == 3) && ((irq < 0) || (irq > 31))))
+	{
+	  fclose(fp);
+	  sprintf(error, "%.256s:%d: bad base address or irq", strFile, nLine);
+	  throw CDeviceMapException(error);
+	}
+      if (n == 3)
+	config[i].irq = irq;
+      config[i].bMapped = TRUE;
+    }
+
+  fclose(fp);
+}
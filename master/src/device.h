@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   device.h
+// header n/a
+// info   Abstract interface for an on chip device, and the map of where
+//        the devices live in the address space. The map is a two level
+//        page table (4KB pages), with second level tables only made for
+//        the parts of the address space that have devices in, so finding
+//        the device for an address is two loads whatever is attached.
+//
+//        Where the devices go can be read from a file with lines of
+//
+//          name base [irq]
+//
+//        where name is one of ostimer, rtc, intctrl, lcd, uart, dma, block
+//        or net; base is the address, which must be in the top half of
+//        the address space and aligned to the device's size; and irq is
+//        the first interrupt controller line the device uses. A base of
+//        "none" leaves the device out. Anything after a # is a comment.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __DEVICE_H__
+#define __DEVICE_H__
+
+#include "swarm.h"
+#include "cache.h"
+
+#define DEVMAP_PAGESHIFT 12
+#define DEVMAP_L2SHIFT   22
+#define DEVMAP_L1SIZE    (1 << (32 - DEVMAP_L2SHIFT))
+#define DEVMAP_L2SIZE    (1 << (DEVMAP_L2SHIFT - DEVMAP_PAGESHIFT))
+
+class CDevice
+{
+  // Constructors and destructor
+ public:
+  CDevice();
+  virtual ~CDevice();
+
+  // Public methods. Addresses are offsets from where the device is mapped.
+ public:
+  virtual uint32_t Cycle() = 0;   // Returns the interrupt lines raised
+  virtual uint32_t Read(uint32_t addr) = 0;
+  virtual void     Write(uint32_t addr, uint32_t data) = 0;
+  virtual void     Reset() = 0;
+  virtual uint32_t GetSize() = 0; // Bytes of address space used
+
+  // Cycle() need only be called once the clock reaches the deadline. The
+  // interrupt lines stay as it last said until then. Devices with work to
+  // do every cycle leave the deadline at 0.
+  inline uint64_t GetDeadline() { return m_nDeadline; }
+  inline void SetClock(const uint64_t* pClock) { m_pClock = pClock; }
+
+  // The guest's memory, for devices that get at it directly
+  inline void SetMemory(uint8_t* pMemory, uint32_t nMemSize)
+    { m_pMemory = pMemory; m_nMemSize = nMemSize; }
+
+  // The caches to keep up to date when a device writes to memory. Any can
+  // be NULL.
+  void SetCaches(CCache* pICache, CCache* pDCache, CCache* pL2Cache);
+
+ protected:
+  void InvalidateCaches(uint32_t addr, uint32_t nBytes);
+
+  const uint64_t* m_pClock;       // Cycles the devices have been run for
+  uint64_t m_nDeadline;
+  uint8_t* m_pMemory;             // NULL until SetMemory is called
+  uint32_t m_nMemSize;
+  CCache*  m_pCaches[3];
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The devices SWARM knows about, in the order they are cycled.
+//
+enum DEVICE_ID {DEV_OSTIMER = 0, DEV_LCD, DEV_UART, DEV_DMA, DEV_BLOCK,
+		DEV_NET, DEV_RTC, DEV_INTCTRL, DEV_NUM};
+
+typedef struct DEVCTAG
+{
+  uint32_t base;
+  int32_t  irq;      // -1 if it doesn't interrupt
+  bool_t   bMapped;
+} DEVCONFIG;
+
+void InitDeviceConfig(DEVCONFIG config[DEV_NUM]);
+void ReadDeviceConfig(const char* strFile, DEVCONFIG config[DEV_NUM]);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CDeviceMap - Finds the device for an address.
+//
+typedef struct DMETAG
+{
+  CDevice* pDevice;
+  uint32_t base;
+} DEVMAPENTRY;
+
+class CDeviceMap
+{
+  // Constructors and destructor
+ public:
+  CDeviceMap();
+  ~CDeviceMap();
+
+  // Public methods
+ public:
+  void Attach(CDevice* pDevice, uint32_t base);
+  void Clear();
+  inline CDevice* Lookup(uint32_t addr, uint32_t* pOffset);
+
+  // Private data
+ private:
+  DEVMAPENTRY* m_pTable[DEVMAP_L1SIZE];
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CDeviceMapException - Thrown for a bad device map or config file.
+//
+class CDeviceMapException : public CException
+{
+ public:
+  CDeviceMapException(const char* strError);
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Lookup - Returns the device at addr (NULL if there isn't one), and the
+//          offset of addr into it.
+//
+inline CDevice* CDeviceMap::Lookup(uint32_t addr, uint32_t* pOffset)
+{
+  DEVMAPENTRY* pEntry = m_pTable[addr >> DEVMAP_L2SHIFT];
+
+  if (pEntry == NULL)
+    return NULL;
+
+  pEntry += (addr >> DEVMAP_PAGESHIFT) & (DEVMAP_L2SIZE - 1);
+  *pOffset = addr - pEntry->base;
+  return pEntry->pDevice;
+}
+
+#endif // __DEVICE_H__
@@ -24,26 +24,36 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h> 
-#include <unistd.h>
-
 #include "swarm.h"
 #include "direct.h"
 
-#define LINE_SIZE_W 4  /* (words) */
-#define LINE_SIZE_B 16 /* (bytes) */
-#define INVALID_BIT 0x80000000
+#define INVALID_BIT DIRECT_INVALID_BIT
 
 ///////////////////////////////////////////////////////////////////////////////
-// CDirectCache - Constructor
+// CDirectCache - Constructors
 //
 CDirectCache::CDirectCache(uint32_t nSize)
+{
+  Init(nSize, DEFAULT_LINESIZE);
+}
+
+CDirectCache::CDirectCache(uint32_t nSize, uint32_t nLineSize)
+{
+  Init(nSize, nLineSize);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Init - Works out the masks and shifts for the geometry. Both sizes are
+//        assumed to be powers of two (see CreateCache).
+//
+void CDirectCache::Init(uint32_t nSize, uint32_t nLineSize)
 {
   // XXX: Gross hack - must go...sometime
   m_nSize = nSize;
-  m_nLines = nSize / LINE_SIZE_B;
+  m_nLineSize = nLineSize;
+  m_nWays = 1;
+  m_nLines = nSize / nLineSize;
 
   m_pDataRAM = new uint32_t[nSize / sizeof(uint32_t)];
   m_pTagRAM = new uint32_t[m_nLines];
@@ -58,50 +68,68 @@ CDirectCache::CDirectCache(uint32_t nSize)
       m_tagBits++;
     }
 
+  m_wordMask = (nLineSize >> 2) - 1;
+  temp = m_wordMask;
+  m_lineShift = 0;
+  while (temp != 0)
+    {
+      temp = temp >> 1;
+      m_lineShift++;
+    }
+
   Reset();
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Create - Returns a cache specialised for the line size where we have one,
+//          otherwise the general version.
+//
+CDirectCache* CDirectCache::Create(uint32_t nSize, uint32_t nLineSize)
+{
+  switch (nLineSize)
+    {
+    case 4:   return new CDirectCacheT<0>(nSize);
+    case 8:   return new CDirectCacheT<1>(nSize);
+    case 16:  return new CDirectCacheT<2>(nSize);
+    case 32:  return new CDirectCacheT<3>(nSize);
+    case 64:  return new CDirectCacheT<4>(nSize);
+    default:  return new CDirectCache(nSize, nLineSize);
+    }
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // ~CDirectCache - Destructor
 //
 CDirectCache::~CDirectCache()
 {
-#if 1
-  int fd = open("/tmp/cache", O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
-  write(fd, m_pDataRAM, m_nSize);
-  close(fd);
-#endif
-
   delete[] m_pTagRAM;
   delete[] m_pDataRAM;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Read - Reads a word from the cache. Returns FALSE if there is a cache miss.
+// Lookup - Reads a word from the cache. Returns FALSE if there is a cache 
+//          miss.
 //
-uint32_t CDirectCache::Read(uint32_t addr)
+bool_t CDirectCache::Lookup(uint32_t addr, uint32_t* pWord)
 {
   uint32_t word_sel, tag_sel, tag;
   uint32_t temp;
  
   // Spilt the address up into the bits we want 
-  word_sel = addr & 0x00000003;
-  tag_sel = (addr >> 2) & m_tagMask;
-  tag = (addr >> (m_tagBits + 2));
+  word_sel = addr & m_wordMask;
+  tag_sel = (addr >> m_lineShift) & m_tagMask;
+  tag = (addr >> (m_tagBits + m_lineShift));
   
   // can we find the line of data we want in the cache? 
   temp = m_pTagRAM[tag_sel];
   if (((temp & INVALID_BIT) == INVALID_BIT) || (temp != tag))
-    {
-      //CCacheMiss c(addr);
-      //throw c;
-
-      throw CCacheMiss(addr);
-    }
+    return FALSE;
   
-  return m_pDataRAM[(tag_sel * 4) + word_sel];
+  *pWord = m_pDataRAM[(tag_sel << m_lineShift) + word_sel];
+  return TRUE;
 }
 
 
@@ -114,8 +142,8 @@ void CDirectCache::WriteLine(uint32_t addr, uint32_t* pLine)
   uint32_t word_sel, tag_sel, tag;
 
   // Spilt the address up into the bits we want 
-  tag_sel = (addr >> 2) & m_tagMask;
-  tag = (addr >> (m_tagBits + 2));    
+  tag_sel = (addr >> m_lineShift) & m_tagMask;
+  tag = (addr >> (m_tagBits + m_lineShift));    
 
 #if 0
   if ((m_pTagRAM[tag_sel] & INVALID_BIT) == 0)
@@ -125,8 +153,8 @@ void CDirectCache::WriteLine(uint32_t addr, uint32_t* pLine)
 #endif
 
   m_pTagRAM[tag_sel] = tag;
-  for (int i = 0; i < LINE_SIZE_W; i++)
-    m_pDataRAM[(tag_sel * 4) + i] = pLine[i];
+  for (uint32_t i = 0; i <= m_wordMask; i++)
+    m_pDataRAM[(tag_sel << m_lineShift) + i] = pLine[i];
 }
 
 
@@ -137,7 +165,7 @@ void CDirectCache::InvalidateLineByAddr(uint32_t addr)
 {
   uint32_t tag_sel;
 
-  tag_sel = (addr >> 2) & m_tagMask;
+  tag_sel = (addr >> m_lineShift) & m_tagMask;
 
   m_pTagRAM[tag_sel] |= INVALID_BIT;
 }
@@ -153,14 +181,14 @@ void CDirectCache::WriteWord(uint32_t addr, uint32_t word)
   uint32_t word_sel, tag_sel, tag;
 
   // Spilt the address up into the bits we want 
-  word_sel = addr & 0x00000003;
-  tag_sel = (addr >> 2) & m_tagMask;
-  tag = (addr >> (m_tagBits + 2));
+  word_sel = addr & m_wordMask;
+  tag_sel = (addr >> m_lineShift) & m_tagMask;
+  tag = (addr >> (m_tagBits + m_lineShift));
   
   if (m_pTagRAM[tag_sel] != tag)
     throw CCacheMiss(addr);
 
-  m_pDataRAM[(tag_sel * 4) + word_sel] = word;
+  m_pDataRAM[(tag_sel << m_lineShift) + word_sel] = word;
 }
 
 
@@ -169,8 +197,21 @@ void CDirectCache::WriteWord(uint32_t addr, uint32_t word)
 //
 void CDirectCache::Reset()
 {
-  for (uint32_t i = 0; i < (m_nSize / LINE_SIZE_B); i++)
+  for (uint32_t i = 0; i < m_nLines; i++)
     m_pTagRAM[i] = INVALID_BIT;
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// GetLine - There's one line per set, so n is the line number.
+//
+bool_t CDirectCache::GetLine(uint32_t n, uint32_t* pAddr, uint32_t** ppData)
+{
+  if ((m_pTagRAM[n] & INVALID_BIT) == INVALID_BIT)
+    return FALSE;
+
+  *pAddr = (m_pTagRAM[n] << (m_tagBits + m_lineShift)) | (n << m_lineShift);
+  *ppData = m_pDataRAM + (n << m_lineShift);
+
+  return TRUE;
+}
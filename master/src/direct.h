@@ -27,31 +27,97 @@
 
 #include "cache.h"
 
+#define DIRECT_INVALID_BIT 0x80000000
+
 class CDirectCache: public CCache
 {
   // Constructors and destructor
  public:
   CDirectCache(uint32_t nSize);
+  CDirectCache(uint32_t nSize, uint32_t nLineSize);
   ~CDirectCache();
 
+  // Builds the specialised version for the line size if there is one
+  static CDirectCache* Create(uint32_t nSize, uint32_t nLineSize);
+
   // Public methods
  public: 
-  uint32_t Read(uint32_t addr);
+  bool_t   Lookup(uint32_t addr, uint32_t* pWord);
   void     WriteLine(uint32_t addr, uint32_t* pLine);
   void     WriteWord(uint32_t addr, uint32_t word);
   void     InvalidateLineByAddr(uint32_t addr);
   void     Reset();
+  bool_t   GetLine(uint32_t n, uint32_t* pAddr, uint32_t** ppData);
 
-  
-  // Private data types
  private:
+  void Init(uint32_t nSize, uint32_t nLineSize);
+  
+  // Data - protected so that CDirectCacheT can get at it
+ protected:
   uint32_t*   m_pTagRAM;
   uint32_t*   m_pDataRAM;
-  uint32_t    m_nSize;
 
   uint32_t    m_nLines;
   uint32_t    m_tagBits;
   uint32_t    m_tagMask;
+  uint32_t    m_lineShift;  // log2 of the words in a line
+  uint32_t    m_wordMask;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CDirectCacheT - The same cache with the line size fixed at compile time, 
+//                 so the word select and tag shifts on the lookup path are 
+//                 constants. CDirectCache::Create hands these out for the 
+//                 common line sizes.
+//
+template<int LINE_SHIFT>
+class CDirectCacheT: public CDirectCache
+{
+ public:
+  CDirectCacheT(uint32_t nSize) : CDirectCache(nSize, 4 << LINE_SHIFT) {}
+
+ public:
+  bool_t   Lookup(uint32_t addr, uint32_t* pWord);
+  void     WriteLine(uint32_t addr, uint32_t* pLine);
+  void     WriteWord(uint32_t addr, uint32_t word);
 };
 
+template<int LINE_SHIFT>
+inline bool_t CDirectCacheT<LINE_SHIFT>::Lookup(uint32_t addr, uint32_t* pWord)
+{
+  uint32_t tag_sel = (addr >> LINE_SHIFT) & m_tagMask;
+  uint32_t temp = m_pTagRAM[tag_sel];
+
+  if (temp != (addr >> (m_tagBits + LINE_SHIFT)))
+    return FALSE;
+
+  *pWord = m_pDataRAM[(tag_sel << LINE_SHIFT) + 
+		      (addr & ((1 << LINE_SHIFT) - 1))];
+  return TRUE;
+}
+
+template<int LINE_SHIFT>
+inline void CDirectCacheT<LINE_SHIFT>::WriteLine(uint32_t addr, uint32_t* pLine)
+{
+  uint32_t tag_sel = (addr >> LINE_SHIFT) & m_tagMask;
+  uint32_t* pData = m_pDataRAM + (tag_sel << LINE_SHIFT);
+
+  m_pTagRAM[tag_sel] = addr >> (m_tagBits + LINE_SHIFT);
+  for (int i = 0; i < (1 << LINE_SHIFT); i++)
+    pData[i] = pLine[i];
+}
+
+template<int LINE_SHIFT>
+inline void CDirectCacheT<LINE_SHIFT>::WriteWord(uint32_t addr, uint32_t word)
+{
+  uint32_t tag_sel = (addr >> LINE_SHIFT) & m_tagMask;
+
+  if (m_pTagRAM[tag_sel] != (addr >> (m_tagBits + LINE_SHIFT)))
+    throw CCacheMiss(addr);
+
+  m_pDataRAM[(tag_sel << LINE_SHIFT) + (addr & ((1 << LINE_SHIFT) - 1))] = 
+    word;
+}
+
 #endif // __DIRECT_H__
@@ -0,0 +1,249 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   dmactrl.cpp
+// header dmactrl.h
+// info   Implements the DMA controller.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream.h>
+#include <string.h>
+#include "swarm.h"
+#include "dmactrl.h"
+#include "stats.h"
+
+#define R_DMAPENDING 0x80
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CDMACtrl - Constructor
+//
+CDMACtrl::CDMACtrl()
+{
+  m_nCopies = 0;
+  m_nBytes = 0;
+  m_nBusCycles = 0;
+  m_nStalls = 0;
+
+  CStats::Register(this, "dma.copies", &m_nCopies);
+  CStats::Register(this, "dma.bytes", &m_nBytes);
+  CStats::Register(this, "dma.bus_cycles", &m_nBusCycles);
+  CStats::Register(this, "dma.stalls", &m_nStalls);
+  CStats::Register(this, "dma.copy_bytes", &m_copyBytes);
+
+  Reset();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CDMACtrl - Destructor
+//
+CDMACtrl::~CDMACtrl()
+{
+  CStats::Unregister(this);
+  if (m_nCopies != 0)
+    cout << "DMA info: copies = " << m_nCopies << " bytes = " << m_nBytes
+	 << " bus cycles = " << m_nBusCycles << " stalls = " << m_nStalls
+	 << "\n";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Reset - Stops all the channels. Copies that haven't finished don't happen.
+//
+void CDMACtrl::Reset()
+{
+  memset(m_regs, 0, sizeof(m_regs));
+  memset(m_nEnd, 0, sizeof(m_nEnd));
+  m_nBusFree = 0;
+  m_nDeadline = ~(uint64_t)0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Load - Loads the next descriptor into a channel's registers. Returns
+//        FALSE if it isn't in memory.
+//
+bool_t CDMACtrl::Load(int nChannel)
+{
+  uint32_t* regs = m_regs[nChannel];
+  uint32_t desc = regs[R_DMADESC];
+
+  if (((desc & 0x3) != 0) || (m_nMemSize < 16) || (desc > m_nMemSize - 16))
+    return FALSE;
+
+  uint32_t* pDesc = (uint32_t*)(m_pMemory + desc);
+  regs[R_DMASRC] = pDesc[0];
+  regs[R_DMADST] = pDesc[1];
+  regs[R_DMACOUNT] = pDesc[2];
+  regs[R_DMADESC] = pDesc[3];
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start - Checks the copy in a channel's registers and books it a slot on
+//         the bus. Sets the error bit if the copy isn't within memory.
+//
+void CDMACtrl::Start(int nChannel)
+{
+  uint32_t* regs = m_regs[nChannel];
+  uint32_t nCount = regs[R_DMACOUNT];
+
+  if ((nCount > m_nMemSize) || (regs[R_DMASRC] > m_nMemSize - nCount) ||
+      (regs[R_DMADST] > m_nMemSize - nCount))
+    {
+      regs[R_DMASTATUS] = DMASTATUS_ERROR;
+      return;
+    }
+
+  uint64_t nCycles = (uint64_t)((nCount + 3) >> 2) * DMACTRL_WORDCYCLES;
+  uint64_t nStart = *m_pClock + 1;
+
+  if (nStart < m_nBusFree)
+    nStart = m_nBusFree;
+  m_nEnd[nChannel] = nStart + nCycles;
+  m_nBusFree = m_nEnd[nChannel];
+  m_nBusCycles += nCycles;
+
+  regs[R_DMASTATUS] = DMASTATUS_BUSY;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Finish - The channel's time is up, so does the copy and moves on to the
+//          next descriptor if there is one.
+//
+void CDMACtrl::Finish(int nChannel)
+{
+  uint32_t* regs = m_regs[nChannel];
+  uint32_t dst = regs[R_DMADST];
+  uint32_t nCount = regs[R_DMACOUNT];
+
+  memmove(m_pMemory + dst, m_pMemory + regs[R_DMASRC], nCount);
+  m_nCopies++;
+  m_nBytes += nCount;
+  m_copyBytes.Add(nCount);
+
+  // Nothing in the caches should be left with the old contents
+  InvalidateCaches(dst, nCount);
+
+  regs[R_DMACOUNT] = 0;
+  if (regs[R_DMADESC] == 0)
+    regs[R_DMASTATUS] = DMASTATUS_DONE;
+  else if (Load(nChannel))
+    Start(nChannel);
+  else
+    regs[R_DMASTATUS] = DMASTATUS_ERROR;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cycle - Only called when a copy is due to finish or a register has been
+//         written.
+//
+uint32_t CDMACtrl::Cycle()
+{
+  uint64_t nNow = *m_pClock;
+  uint32_t lines = 0;
+
+  m_nDeadline = ~(uint64_t)0;
+  for (int i = 0; i < DMACTRL_CHANNELS; i++)
+    {
+      uint32_t* regs = m_regs[i];
+
+      if ((regs[R_DMASTATUS] & DMASTATUS_BUSY) && (m_nEnd[i] <= nNow))
+	Finish(i);
+
+      if ((regs[R_DMASTATUS] & DMASTATUS_BUSY) && (m_nEnd[i] < m_nDeadline))
+	m_nDeadline = m_nEnd[i];
+
+      if ((regs[R_DMACONTROL] & DMACONTROL_INT) &&
+	  (regs[R_DMASTATUS] & (DMASTATUS_DONE | DMASTATUS_ERROR)))
+	lines |= 0x1 << i;
+    }
+
+  return lines;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - The address registers can't be changed while the channel is busy.
+//
+void CDMACtrl::Write(uint32_t addr, uint32_t data)
+{
+  uint32_t nChannel = addr >> 5;
+  uint32_t nReg = (addr >> 2) & 0x7;
+
+  if ((nChannel >= DMACTRL_CHANNELS) || (nReg >= DMACTRL_NUMREGS))
+    return;
+
+  uint32_t* regs = m_regs[nChannel];
+  bool_t bBusy = (regs[R_DMASTATUS] & DMASTATUS_BUSY) != 0;
+
+  switch (nReg)
+    {
+    case R_DMASRC: case R_DMADST: case R_DMACOUNT: case R_DMADESC:
+      if (!bBusy)
+	regs[nReg] = data;
+      break;
+
+    case R_DMACONTROL:
+      regs[R_DMACONTROL] = data & DMACONTROL_INT;
+      if ((data & DMACONTROL_START) && !bBusy)
+	{
+	  // A chain can start with an empty copy in the registers
+	  if ((regs[R_DMACOUNT] == 0) && (regs[R_DMADESC] != 0) &&
+	      !Load(nChannel))
+	    regs[R_DMASTATUS] = DMASTATUS_ERROR;
+	  else
+	    Start(nChannel);
+	}
+      break;
+
+    case R_DMASTATUS:
+      regs[R_DMASTATUS] &= ~(data & (DMASTATUS_DONE | DMASTATUS_ERROR));
+      break;
+    }
+
+  // Our interrupt lines may have changed
+  m_nDeadline = *m_pClock + 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read -
+//
+uint32_t CDMACtrl::Read(uint32_t addr)
+{
+  uint32_t nChannel = addr >> 5;
+  uint32_t nReg = (addr >> 2) & 0x7;
+
+  if (addr == R_DMAPENDING)
+    {
+      uint32_t pending = 0;
+      for (int i = 0; i < DMACTRL_CHANNELS; i++)
+	if (m_regs[i][R_DMASTATUS] & (DMASTATUS_DONE | DMASTATUS_ERROR))
+	  pending |= 0x1 << i;
+      return pending;
+    }
+
+  if ((nChannel >= DMACTRL_CHANNELS) || (nReg >= DMACTRL_NUMREGS))
+    return 0;
+
+  return m_regs[nChannel][nReg];
+}
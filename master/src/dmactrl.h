@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   dmactrl.h
+// header n/a
+// info   A DMA controller with DMACTRL_CHANNELS channels that copies
+//        between two parts of memory. Each channel has a block of
+//        registers at (channel * 0x20):
+//
+//          0x00 source address
+//          0x04 destination address
+//          0x08 byte count
+//          0x0C next descriptor (0 if none)
+//          0x10 control - bit 0 starts the channel, bit 1 enables the
+//               interrupt
+//          0x14 status - bit 0 busy, bit 1 done, bit 2 error. Writing a 1
+//               to done or error clears it.
+//
+//        and 0x80 has the done and error bits of all the channels (bit n
+//        set if channel n needs looking at). A descriptor is four words
+//        in memory - source, destination, count and next - which are
+//        loaded into the registers when the one before has finished, so
+//        a channel can work through a chain of copies.
+//
+//        A copy takes DMACTRL_WORDCYCLES cycles per word on the external
+//        bus, which the channels take turns on. The data is moved in one
+//        go when the time is up. The caches are told to drop anything
+//        they hold for the destination. The core has to wait for the bus
+//        if it wants it while a copy is going on.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __DMACTRL_H__
+#define __DMACTRL_H__
+
+#include "swarm.h"
+#include "device.h"
+#include "stats.h"
+
+#define DMACTRL_SIZE        0x1000
+#define DMACTRL_CHANNELS    4
+#define DMACTRL_WORDCYCLES  10   // Bus cycles to move a word
+#define DMACTRL_STALLCYCLES 10   // What the core waits if the bus is busy
+
+#define R_DMASRC     0x0
+#define R_DMADST     0x1
+#define R_DMACOUNT   0x2
+#define R_DMADESC    0x3
+#define R_DMACONTROL 0x4
+#define R_DMASTATUS  0x5
+#define DMACTRL_NUMREGS 6
+
+#define DMACONTROL_START 0x1
+#define DMACONTROL_INT   0x2
+
+#define DMASTATUS_BUSY   0x1
+#define DMASTATUS_DONE   0x2
+#define DMASTATUS_ERROR  0x4
+
+class CDMACtrl : public CDevice
+{
+  // Constructors and destructor
+ public:
+  CDMACtrl();
+  ~CDMACtrl();
+
+  // Public methods
+ public:
+  uint32_t Cycle();   // Interrupt line n is channel n
+  uint32_t Read(uint32_t addr);
+  void     Write(uint32_t addr, uint32_t data);
+  void     Reset();
+  uint32_t GetSize() { return DMACTRL_SIZE; }
+
+  // Called when the core starts a memory access. Returns the extra cycles
+  // it takes as a copy has the bus.
+  inline uint32_t BusWait();
+
+  // Private methods
+ private:
+  void Start(int nChannel);
+  void Finish(int nChannel);
+  bool_t Load(int nChannel);
+
+  // Private data
+ private:
+  uint32_t m_regs[DMACTRL_CHANNELS][DMACTRL_NUMREGS];
+  uint64_t m_nEnd[DMACTRL_CHANNELS];  // When the current copy is done
+  uint64_t m_nBusFree;                // When the last copy queued is done
+
+  // For the stats at the end
+  uint64_t m_nCopies;
+  uint64_t m_nBytes;
+  uint64_t m_nBusCycles;
+  uint64_t m_nStalls;
+  CHistogram m_copyBytes;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BusWait -
+//
+inline uint32_t CDMACtrl::BusWait()
+{
+  if (*m_pClock >= m_nBusFree)
+    return 0;
+
+  m_nStalls++;
+  return DMACTRL_STALLCYCLES;
+}
+
+#endif // __DMACTRL_H__
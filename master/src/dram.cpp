@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   dram.cpp
+// header dram.h
+// info   Implements the main memory timing model.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include "swarm.h"
+#include "dram.h"
+#include "cache.h"
+#include "stats.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CDramTiming - Constructor for the flat model.
+//
+CDramTiming::CDramTiming(uint32_t nLatency)
+{
+  m_nRowSize = 0;
+  m_rowMask = 0;
+  m_nHitLatency = nLatency;
+  m_nMissLatency = nLatency;
+  m_openRow = 0;
+  m_bRowOpen = FALSE;
+  m_nAccesses = 0;
+  m_nRowHits = 0;
+  CStats::Register(this, "dram.accesses", &m_nAccesses);
+  CStats::Register(this, "dram.row_hits", &m_nRowHits);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CDramTiming - Constructor for the open row model. The row size is in bytes
+//               and must be a power of two.
+//
+CDramTiming::CDramTiming(uint32_t nRowSize, uint32_t nHitLatency,
+			 uint32_t nMissLatency)
+{
+  m_nRowSize = nRowSize;
+  m_rowMask = ~(nRowSize - 1);
+  m_nHitLatency = nHitLatency;
+  m_nMissLatency = nMissLatency;
+  m_openRow = 0;
+  m_bRowOpen = FALSE;
+  m_nAccesses = 0;
+  m_nRowHits = 0;
+  CStats::Register(this, "dram.accesses", &m_nAccesses);
+  CStats::Register(this, "dram.row_hits", &m_nRowHits);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CDramTiming - Destructor
+//
+CDramTiming::~CDramTiming()
+{
+  CStats::Unregister(this);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ParseDramTiming - Builds an open row model from "row:hit:miss".
+//
+CDramTiming* ParseDramTiming(const char* str)
+{
+  uint32_t vals[3];
+  const char* p = str;
+  char* end;
+
+  for (int i = 0; i < 3; i++)
+    {
+      vals[i] = strtoul(p, &end, 0);
+      if ((end == p) || ((i < 2) && (*end != ':')) ||
+	  ((i == 2) && (*end != '\0')))
+	return NULL;
+      p = end + 1;
+    }
+
+  if ((vals[0] < 4) || (log2_exact(vals[0]) == 0xFFFFFFFF))
+    return NULL;
+
+  return new CDramTiming(vals[0], vals[1], vals[2]);
+}
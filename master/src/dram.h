@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   dram.h
+// header n/a
+// info   A timing model for main memory. Each bus transaction starts with
+//        an access latency; with a row size of 0 this is always the same
+//        (the flat model SWARM has always used), otherwise the memory keeps
+//        one open row and accesses to it are cheaper than those that have
+//        to open a new one.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __DRAM_H__
+#define __DRAM_H__
+
+#include "swarm.h"
+
+class CDramTiming
+{
+  // Constructors and destructor
+ public:
+  CDramTiming(uint32_t nLatency);  // Flat model
+  CDramTiming(uint32_t nRowSize, uint32_t nHitLatency,
+	      uint32_t nMissLatency);
+  ~CDramTiming();
+
+  // Public methods
+ public:
+  inline uint32_t Access(uint32_t addr);
+
+  inline uint64_t GetAccesses() { return m_nAccesses; }
+  inline uint64_t GetRowHits() { return m_nRowHits; }
+  inline bool_t   IsFlat() { return m_nRowSize == 0; }
+
+  // Private data
+ private:
+  uint32_t m_nRowSize;
+  uint32_t m_rowMask;
+  uint32_t m_nHitLatency;
+  uint32_t m_nMissLatency;
+
+  uint32_t m_openRow;
+  bool_t   m_bRowOpen;
+
+  uint64_t m_nAccesses;
+  uint64_t m_nRowHits;
+};
+
+// Parses "row:hit:miss" - returns NULL if the string is malformed.
+CDramTiming* ParseDramTiming(const char* str);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Access - Returns the latency in cycles of starting a transaction at addr.
+//
+inline uint32_t CDramTiming::Access(uint32_t addr)
+{
+  m_nAccesses++;
+
+  if (m_nRowSize == 0)
+    return m_nHitLatency;
+
+  if (m_bRowOpen && ((addr & m_rowMask) == m_openRow))
+    {
+      m_nRowHits++;
+      return m_nHitLatency;
+    }
+
+  m_openRow = addr & m_rowMask;
+  m_bRowOpen = TRUE;
+
+  return m_nMissLatency;
+}
+
+#endif // __DRAM_H__
@@ -0,0 +1,285 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   elfimage.cpp
+// header elfimage.h
+// info   Implements the ELF loader.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "swarm.h"
+#include "elfimage.h"
+
+// The file is little endian whatever we are
+#ifdef __BIG_ENDIAN__
+#define ELF16(_x) ((uint16_t)(((_x) << 8) | ((_x) >> 8)))
+#define ELF32(_x) (((_x) << 24) | (((_x) << 8) & 0xFF0000) | \
+                   (((_x) >> 8) & 0xFF00) | ((_x) >> 24))
+#else
+#define ELF16(_x) (_x)
+#define ELF32(_x) (_x)
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CElfException -
+//
+CElfException::CElfException(const char* strError, const char* strFile)
+{
+  free(m_strError);
+
+  if (strFile == NULL)
+    {
+      m_strError = strdup(strError);
+      return;
+    }
+
+  m_strError = (char*)malloc(strlen(strError) + strlen(strFile) + 3);
+  sprintf(m_strError, "%s: %s", strError, strFile);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// IsElf - Just looks at the magic number at the start of the file.
+//
+bool_t CElfImage::IsElf(const char* strFile)
+{
+  unsigned char ident[SELFMAG];
+  int fd;
+
+  fd = open(strFile, O_RDONLY);
+  if (fd == -1)
+    return FALSE;
+  ssize_t n = read(fd, ident, SELFMAG);
+  close(fd);
+
+  return ((n == SELFMAG) && (memcmp(ident, ELFMAG, SELFMAG) == 0));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CElfImage - Maps the file and checks it is something we can run.
+//
+CElfImage::CElfImage(const char* strFile)
+{
+  struct stat st;
+  int fd;
+
+  m_pSymbols = NULL;
+  m_nSymbols = 0;
+
+  fd = open(strFile, O_RDONLY);
+  if (fd == -1)
+    throw CElfException("Can't open ELF file", strFile);
+  if (fstat(fd, &st) == -1)
+    {
+      close(fd);
+      throw CElfException("Can't get the size of ELF file", strFile);
+    }
+  m_nSize = st.st_size;
+  if (m_nSize < sizeof(Elf32_Ehdr))
+    {
+      close(fd);
+      throw CElfException("ELF file is too short", strFile);
+    }
+
+  m_pImage = (uint8_t*)mmap(NULL, m_nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m_pImage == (uint8_t*)MAP_FAILED)
+    throw CElfException("Can't map ELF file", strFile);
+
+  Elf32_Ehdr* pHdr = (Elf32_Ehdr*)m_pImage;
+  const char* strError = NULL;
+
+  if (memcmp(pHdr->e_ident, ELFMAG, SELFMAG) != 0)
+    strError = "Not an ELF file";
+  else if ((pHdr->e_ident[EI_CLASS] != ELFCLASS32) ||
+	   (pHdr->e_ident[EI_DATA] != ELFDATA2LSB))
+    strError = "Not a little endian 32 bit ELF file";
+  else if ((ELF16(pHdr->e_type) != ET_EXEC) ||
+	   (ELF16(pHdr->e_machine) != EM_ARM))
+    strError = "Not an ARM executable";
+  else if ((ELF16(pHdr->e_phentsize) != sizeof(Elf32_Phdr)) ||
+	   ((uint64_t)ELF32(pHdr->e_phoff) +
+	    ((uint64_t)ELF16(pHdr->e_phnum) * sizeof(Elf32_Phdr)) > m_nSize))
+    strError = "Bad program headers in ELF file";
+
+  if (strError != NULL)
+    {
+      munmap(m_pImage, m_nSize);
+      throw CElfException(strError, strFile);
+    }
+
+  m_strFile = strdup(strFile);
+  m_entry = ELF32(pHdr->e_entry);
+
+  ReadSymbols();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CElfImage -
+//
+CElfImage::~CElfImage()
+{
+  if (m_pSymbols != NULL)
+    free(m_pSymbols);
+  munmap(m_pImage, m_nSize);
+  free(m_strFile);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Load - Every segment is checked before anything is copied, so memory is
+//        left alone if the image doesn't fit.
+//
+void CElfImage::Load(uint8_t* pMemory, uint32_t nMemSize)
+{
+  Elf32_Ehdr* pHdr = (Elf32_Ehdr*)m_pImage;
+  Elf32_Phdr* pPhdrs = (Elf32_Phdr*)(m_pImage + ELF32(pHdr->e_phoff));
+  uint32_t nPhdrs = ELF16(pHdr->e_phnum);
+
+  for (uint32_t i = 0; i < nPhdrs; i++)
+    {
+      Elf32_Phdr* p = &pPhdrs[i];
+
+      if (ELF32(p->p_type) != PT_LOAD)
+	continue;
+      if ((ELF32(p->p_filesz) > ELF32(p->p_memsz)) ||
+	  ((uint64_t)ELF32(p->p_offset) + ELF32(p->p_filesz) > m_nSize))
+	throw CElfException("Bad segment in ELF file", m_strFile);
+      if ((uint64_t)ELF32(p->p_paddr) + ELF32(p->p_memsz) > nMemSize)
+	throw CElfException("ELF segment is outside memory", m_strFile);
+    }
+
+  for (uint32_t i = 0; i < nPhdrs; i++)
+    {
+      Elf32_Phdr* p = &pPhdrs[i];
+      uint32_t addr = ELF32(p->p_paddr);
+      uint32_t nFile = ELF32(p->p_filesz);
+
+      if (ELF32(p->p_type) != PT_LOAD)
+	continue;
+
+      memcpy(pMemory + addr, m_pImage + ELF32(p->p_offset), nFile);
+      memset(pMemory + addr + nFile, 0, ELF32(p->p_memsz) - nFile);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadSymbols - Keeps the functions and objects from the symbol table. A
+//               stripped file just has no symbols.
+//
+void CElfImage::ReadSymbols()
+{
+  Elf32_Ehdr* pHdr = (Elf32_Ehdr*)m_pImage;
+  uint32_t nShdrs = ELF16(pHdr->e_shnum);
+
+  if ((nShdrs == 0) || (ELF16(pHdr->e_shentsize) != sizeof(Elf32_Shdr)) ||
+      ((uint64_t)ELF32(pHdr->e_shoff) +
+       ((uint64_t)nShdrs * sizeof(Elf32_Shdr)) > m_nSize))
+    return;
+
+  Elf32_Shdr* pShdrs = (Elf32_Shdr*)(m_pImage + ELF32(pHdr->e_shoff));
+  Elf32_Shdr* pSymTab = NULL;
+
+  for (uint32_t i = 0; (i < nShdrs) && (pSymTab == NULL); i++)
+    if (ELF32(pShdrs[i].sh_type) == SHT_SYMTAB)
+      pSymTab = &pShdrs[i];
+  if ((pSymTab == NULL) || (ELF32(pSymTab->sh_link) >= nShdrs))
+    return;
+
+  Elf32_Shdr* pStrTab = &pShdrs[ELF32(pSymTab->sh_link)];
+  uint32_t nSyms = ELF32(pSymTab->sh_size) / sizeof(Elf32_Sym);
+  uint32_t nStrSize = ELF32(pStrTab->sh_size);
+
+  if (((uint64_t)ELF32(pSymTab->sh_offset) + ELF32(pSymTab->sh_size) >
+       m_nSize) ||
+      ((uint64_t)ELF32(pStrTab->sh_offset) + nStrSize > m_nSize) ||
+      (nSyms == 0))
+    return;
+
+  Elf32_Sym* pSyms = (Elf32_Sym*)(m_pImage + ELF32(pSymTab->sh_offset));
+  const char* pStrs = (const char*)(m_pImage + ELF32(pStrTab->sh_offset));
+
+  m_pSymbols = (ELFSYM*)malloc(nSyms * sizeof(ELFSYM));
+  for (uint32_t i = 0; i < nSyms; i++)
+    {
+      Elf32_Sym* s = &pSyms[i];
+      uint32_t nType = ELF32_ST_TYPE(s->st_info);
+      uint32_t nName = ELF32(s->st_name);
+
+      if (((nType != STT_FUNC) && (nType != STT_OBJECT)) ||
+	  (ELF16(s->st_shndx) == SHN_UNDEF) || (nName == 0) ||
+	  (nName >= nStrSize) ||
+	  (memchr(pStrs + nName, 0, nStrSize - nName) == NULL))
+	continue;
+
+      ELFSYM* pSym = &m_pSymbols[m_nSymbols++];
+
+      // Thumb functions have the bottom bit set
+      pSym->addr = ELF32(s->st_value);
+      if (nType == STT_FUNC)
+	pSym->addr &= ~0x1;
+      pSym->nSize = ELF32(s->st_size);
+      pSym->strName = pStrs + nName;
+    }
+
+  qsort(m_pSymbols, m_nSymbols, sizeof(ELFSYM), CompareSymbols);
+}
+
+int CElfImage::CompareSymbols(const void* a, const void* b)
+{
+  uint32_t addrA = ((const ELFSYM*)a)->addr;
+  uint32_t addrB = ((const ELFSYM*)b)->addr;
+
+  return (addrA < addrB) ? -1 : ((addrA > addrB) ? 1 : 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Lookup - Finds the last symbol at or below addr.
+//
+const ELFSYM* CElfImage::Lookup(uint32_t addr)
+{
+  uint32_t nLow = 0, nHigh = m_nSymbols;
+
+  while (nLow < nHigh)
+    {
+      uint32_t nMid = (nLow + nHigh) / 2;
+
+      if (m_pSymbols[nMid].addr <= addr)
+	nLow = nMid + 1;
+      else
+	nHigh = nMid;
+    }
+  if (nLow == 0)
+    return NULL;
+
+  const ELFSYM* pSym = &m_pSymbols[nLow - 1];
+  if ((pSym->nSize != 0) && (addr - pSym->addr >= pSym->nSize))
+    return NULL;
+
+  return pSym;
+}
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   elfimage.h
+// header n/a
+// info   Loads a little endian 32 bit ARM ELF executable. The PT_LOAD
+//        segments are copied to their physical addresses, with the part
+//        not in the file (the bss) zeroed, and the entry point is noted.
+//        The function and object symbols are kept so addresses can be
+//        turned back into names, which the co-simulation checker uses to
+//        say which function a difference is in.
+//
+//        The file is mmapped for as long as the image is around, so the
+//        symbol names are never copied.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ELFIMAGE_H__
+#define __ELFIMAGE_H__
+
+#include <sys/types.h>
+#include "swarm.h"
+
+typedef struct ELFSYMTAG
+{
+  uint32_t    addr;
+  uint32_t    nSize;
+  const char* strName;
+} ELFSYM;
+
+class CElfException : public CException
+{
+ public:
+  CElfException(const char* strError, const char* strFile = NULL);
+};
+
+class CElfImage
+{
+  // Constructors and destructor
+ public:
+  CElfImage(const char* strFile);   // Throws a CElfException
+  ~CElfImage();
+
+  // Public methods
+ public:
+  static bool_t IsElf(const char* strFile);
+
+  // Copies the segments into memory. Throws a CElfException if one
+  // doesn't fit.
+  void Load(uint8_t* pMemory, uint32_t nMemSize);
+
+  inline uint32_t GetEntry() { return m_entry; }
+  inline uint32_t GetNumSymbols() { return m_nSymbols; }
+
+  // The symbol addr falls in (or after, if it has no size), or NULL
+  const ELFSYM* Lookup(uint32_t addr);
+
+  // Private methods
+ private:
+  void ReadSymbols();
+  static int CompareSymbols(const void* a, const void* b);
+
+  // Private data
+ private:
+  char*    m_strFile;
+  uint8_t* m_pImage;
+  size_t   m_nSize;
+  uint32_t m_entry;
+
+  ELFSYM*  m_pSymbols;   // Sorted by address
+  uint32_t m_nSymbols;
+};
+
+#endif // __ELFIMAGE_H__
@@ -0,0 +1,943 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   gdbstub.cpp
+// header gdbstub.h
+// info   Implements the GDB remote serial protocol server.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "swarm.h"
+#include "gdbstub.h"
+#include "armproc.h"
+
+#define EMPTY_PC   0xFFFFFFFF
+#define HASH(_pc)  ((_pc) * 0x9E3779B1)
+
+// gdb's registers for an ARM with no target description: r0 - r15, the
+// FPA's f0 - f7 (12 bytes each) and fps, which we don't have, then cpsr
+#define GDB_NUMREGS 26
+#define GDB_FPREGS  16
+#define GDB_FPS     24
+#define GDB_CPSR    25
+
+#define SIGINT_GDB  2
+#define SIGTRAP_GDB 5
+
+#define GDB_REGSLEN ((18 * 8) + (8 * 24))   // Of a 'g' reply
+
+static const char s_hex[] = "0123456789abcdef";
+
+
+///////////////////////////////////////////////////////////////////////////////
+// hex_value - -1 if c isn't a hex digit.
+//
+static int hex_value(char c)
+{
+  if ((c >= '0') && (c <= '9'))
+    return c - '0';
+  if ((c >= 'a') && (c <= 'f'))
+    return c - 'a' + 10;
+  if ((c >= 'A') && (c <= 'F'))
+    return c - 'A' + 10;
+  return -1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// reg_offset - Where register nReg is in a 'g' reply, and how many hex
+//              digits it has.
+//
+static uint32_t reg_offset(uint32_t nReg, uint32_t* pLen)
+{
+  if (nReg < GDB_FPREGS)
+    {
+      *pLen = 8;
+      return nReg * 8;
+    }
+  if (nReg < GDB_FPS)
+    {
+      *pLen = 24;
+      return (GDB_FPREGS * 8) + ((nReg - GDB_FPREGS) * 24);
+    }
+
+  *pLen = 8;
+  return (GDB_FPREGS * 8) + ((GDB_FPS - GDB_FPREGS) * 24) +
+    ((nReg - GDB_FPS) * 8);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// put_word / get_word - A register as gdb sends it, in target (little
+//                       endian) byte order. get_word returns FALSE if there
+//                       aren't eight hex digits.
+//
+static char* put_word(char* str, uint32_t value)
+{
+  for (int i = 0; i < 4; i++, value >>= 8)
+    {
+      *str++ = s_hex[(value >> 4) & 0xF];
+      *str++ = s_hex[value & 0xF];
+    }
+  *str = '\0';
+  return str;
+}
+
+static bool_t get_word(const char* str, uint32_t* pValue)
+{
+  uint32_t value = 0;
+
+  for (int i = 0; i < 4; i++)
+    {
+      int hi = hex_value(str[i * 2]);
+      int lo = (hi < 0) ? -1 : hex_value(str[(i * 2) + 1]);
+
+      if (lo < 0)
+	return FALSE;
+      value |= (uint32_t)((hi << 4) | lo) << (i * 8);
+    }
+
+  *pValue = value;
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CGdbException -
+//
+CGdbException::CGdbException(const char* strError)
+{
+  free(m_strError);
+  m_strError = strdup(strError);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CGdbStub - We start stopped, so the program waits for gdb to connect.
+//
+CGdbStub::CGdbStub(CArmProc* pArm, uint8_t* pMemory, uint32_t nMemSize,
+		   const char* strWhere)
+{
+  m_pArm = pArm;
+  m_pMemory = pMemory;
+  m_nMemSize = nMemSize;
+  m_strSocket = NULL;
+  m_fd = -1;
+
+  m_nSignal = SIGTRAP_GDB;
+  m_stopPC = EMPTY_PC;
+  m_nStopInst = 0;
+  m_bStep = TRUE;
+  m_bRunning = FALSE;
+
+  m_nBreaks = 0;
+  m_nBreaksSize = 16;
+  m_pBreaks = new uint32_t[m_nBreaksSize];
+  m_nHashSize = 32;
+  m_pHash = new uint32_t[m_nHashSize];
+  memset(m_pHash, 0xFF, sizeof(uint32_t) * m_nHashSize);
+
+  m_nWatches = 0;
+  m_bWatchHit = FALSE;
+  m_nPoll = GDB_POLL;
+  m_nIn = m_nInNext = 0;
+
+  if (strncmp(strWhere, "unix:", 5) == 0)
+    {
+      struct sockaddr_un sa;
+
+      if (strlen(strWhere + 5) >= sizeof(sa.sun_path))
+	throw CGdbException("GDB socket path is too long");
+
+      memset(&sa, 0, sizeof(sa));
+      sa.sun_family = AF_UNIX;
+      strcpy(sa.sun_path, strWhere + 5);
+      unlink(sa.sun_path);
+
+      m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if ((m_listenFd < 0) ||
+	  (bind(m_listenFd, (struct sockaddr*)&sa, sizeof(sa)) < 0) ||
+	  (listen(m_listenFd, 1) < 0))
+	throw CGdbException("Can't listen on the GDB socket");
+      m_strSocket = strdup(sa.sun_path);
+    }
+  else
+    {
+      struct sockaddr_in sa;
+      char* strEnd;
+      long nPort = strtol(strWhere, &strEnd, 10);
+      int nOne = 1;
+
+      if ((*strWhere == '\0') || (*strEnd != '\0') || (nPort <= 0) ||
+	  (nPort > 65535))
+	throw CGdbException("GDB needs a port or unix:path");
+
+      memset(&sa, 0, sizeof(sa));
+      sa.sin_family = AF_INET;
+      sa.sin_port = htons((uint16_t)nPort);
+      sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+      m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+      if ((m_listenFd < 0) ||
+	  (setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &nOne,
+		      sizeof(nOne)) < 0) ||
+	  (bind(m_listenFd, (struct sockaddr*)&sa, sizeof(sa)) < 0) ||
+	  (listen(m_listenFd, 1) < 0))
+	throw CGdbException("Can't listen on the GDB port");
+    }
+
+  printf("Note: Waiting for gdb on [%s]\n", strWhere);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CGdbStub - Destructor
+//
+CGdbStub::~CGdbStub()
+{
+  if (m_fd >= 0)
+    close(m_fd);
+  if (m_listenFd >= 0)
+    close(m_listenFd);
+  if (m_strSocket != NULL)
+    {
+      unlink(m_strSocket);
+      free(m_strSocket);
+    }
+
+  delete[] m_pBreaks;
+  delete[] m_pHash;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Stop - Works out whether we really are stopping here, and if so serves
+//        gdb until it says to carry on. If the fetch of the instruction
+//        misses in the cache we're asked again at the same boundary, which
+//        we mustn't stop at twice.
+//
+void CGdbStub::Stop(uint32_t pc, uint64_t nInst)
+{
+  bool_t bPolled = FALSE;
+
+  if (m_nPoll == 0)
+    {
+      m_nPoll = GDB_POLL;
+      bPolled = Poll();
+    }
+
+  if ((pc == m_stopPC) && (nInst == m_nStopInst) && !m_bWatchHit &&
+      !bPolled)
+    return;
+
+  if (m_bWatchHit)
+    m_nSignal = SIGTRAP_GDB;
+  else if (bPolled)
+    m_nSignal = m_bRunning ? SIGINT_GDB : SIGTRAP_GDB;
+  else if (m_bStep || IsBreak(pc))
+    m_nSignal = SIGTRAP_GDB;
+  else
+    return;
+
+  m_stopPC = pc;
+  m_nStopInst = nInst;
+  m_bStep = FALSE;
+
+  if (m_fd < 0)
+    Accept();
+
+  // gdb is waiting to hear why we stopped
+  if (m_bRunning)
+    {
+      StopReply();
+      PutPacket(m_reply);
+      m_bRunning = FALSE;
+    }
+  m_bWatchHit = FALSE;
+
+  while ((m_fd >= 0) && !m_bRunning)
+    {
+      if (!GetPacket())
+	Hangup();
+      else if (Command())
+	PutPacket(m_reply);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// IsBreak - Looks pc up in the hash.
+//
+bool_t CGdbStub::IsBreak(uint32_t pc)
+{
+  uint32_t mask = m_nHashSize - 1;
+
+  for (uint32_t i = HASH(pc) & mask; m_pHash[i] != EMPTY_PC;
+       i = (i + 1) & mask)
+    if (m_pHash[i] == pc)
+      return TRUE;
+
+  return FALSE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Watch - Notes the first watchpoint the access touches. We stop at the
+//         next boundary, when the instruction has finished.
+//
+void CGdbStub::Watch(uint32_t addr, uint32_t bw, bool_t bWrite)
+{
+  uint32_t len;
+
+  if (m_bWatchHit)
+    return;
+
+  switch (bw)
+    {
+    case 0: addr &= ~0x3; len = 4; break;
+    case 1: len = 1; break;
+    default: addr &= ~0x1; len = 2; break;
+    }
+
+  for (uint32_t i = 0; i < m_nWatches; i++)
+    {
+      GDBWATCH* pWatch = &m_watches[i];
+
+      if ((pWatch->type == GW_WRITE) && !bWrite)
+	continue;
+      if ((pWatch->type == GW_READ) && bWrite)
+	continue;
+      if ((addr < pWatch->addr + pWatch->len) &&
+	  (pWatch->addr < addr + len))
+	{
+	  m_bWatchHit = TRUE;
+	  m_watchHit = *pWatch;
+	  m_watchHit.addr = (addr > pWatch->addr) ? addr : pWatch->addr;
+	  return;
+	}
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Poll - Now and again we see whether gdb has sent a break (^C) or, if
+//        nobody is connected, whether someone wants to. Returns TRUE if we
+//        should stop.
+//
+bool_t CGdbStub::Poll()
+{
+  struct pollfd pfd;
+
+  pfd.fd = (m_fd >= 0) ? m_fd : m_listenFd;
+  pfd.events = POLLIN;
+  if (poll(&pfd, 1, 0) <= 0)
+    return FALSE;
+
+  if (m_fd < 0)
+    {
+      Accept();
+      return TRUE;
+    }
+
+  // Anything but a break while we're running is a stray ack
+  for (;;)
+    {
+      int c = GetChar();
+
+      if (c < 0)
+	{
+	  Hangup();
+	  return FALSE;
+	}
+      if (c == 0x03)
+	return TRUE;
+      if (m_nInNext == m_nIn)
+	return FALSE;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Accept - Blocks until gdb connects.
+//
+void CGdbStub::Accept()
+{
+  int nOne = 1;
+
+  m_fd = accept(m_listenFd, NULL, NULL);
+  if (m_fd < 0)
+    {
+      perror("GDB accept");
+      return;
+    }
+
+  if (m_strSocket == NULL)
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &nOne, sizeof(nOne));
+  m_nIn = m_nInNext = 0;
+  m_bRunning = FALSE;
+  printf("Note: gdb connected\n");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Hangup - gdb has gone, or detached. The program runs on without any
+//          breakpoints until somebody connects again.
+//
+void CGdbStub::Hangup()
+{
+  if (m_fd >= 0)
+    close(m_fd);
+  m_fd = -1;
+
+  m_nBreaks = 0;
+  BuildHash();
+  m_nWatches = 0;
+  m_bWatchHit = FALSE;
+  m_bStep = FALSE;
+  m_bRunning = TRUE;
+  printf("Note: gdb disconnected\n");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Kill - Ends the simulation there and then, without the stats.
+//
+void CGdbStub::Kill()
+{
+  Hangup();
+  if (m_strSocket != NULL)
+    unlink(m_strSocket);
+
+  printf("Note: Killed by gdb\n");
+  exit(EXIT_SUCCESS);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GetChar - The next byte from gdb, or -1 if it has gone.
+//
+int CGdbStub::GetChar()
+{
+  if (m_nInNext == m_nIn)
+    {
+      ssize_t n = read(m_fd, m_in, sizeof(m_in));
+
+      if (n <= 0)
+	return -1;
+      m_nIn = (uint32_t)n;
+      m_nInNext = 0;
+    }
+
+  return (uint8_t)m_in[m_nInNext++];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GetPacket - Reads $packet#xx into m_packet, asking for it again if the
+//             checksum is wrong. Returns FALSE if gdb has gone.
+//
+bool_t CGdbStub::GetPacket()
+{
+  for (;;)
+    {
+      uint32_t n = 0;
+      uint8_t sum = 0;
+      int c;
+
+      do
+	if ((c = GetChar()) < 0)
+	  return FALSE;
+      while (c != '$');
+
+      while ((c = GetChar()) != '#')
+	{
+	  if (c < 0)
+	    return FALSE;
+	  if (c == '$')
+	    {
+	      // gdb gave up on that one and started again
+	      n = 0;
+	      sum = 0;
+	      continue;
+	    }
+	  sum += (uint8_t)c;
+	  if (n < GDB_MAXPACKET)
+	    m_packet[n++] = (char)c;
+	}
+      m_packet[n] = '\0';
+
+      int hi = GetChar();
+      int lo = GetChar();
+      if ((hi < 0) || (lo < 0))
+	return FALSE;
+
+      if ((hex_value((char)hi) << 4 | hex_value((char)lo)) == sum)
+	{
+	  send(m_fd, "+", 1, MSG_NOSIGNAL);
+	  return TRUE;
+	}
+      send(m_fd, "-", 1, MSG_NOSIGNAL);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PutPacket - Sends str until gdb acknowledges it.
+//
+void CGdbStub::PutPacket(const char* str)
+{
+  static char strOut[GDB_MAXPACKET + 5];
+  uint32_t n = strlen(str);
+  uint8_t sum = 0;
+
+  strOut[0] = '$';
+  memcpy(strOut + 1, str, n);
+  for (uint32_t i = 0; i < n; i++)
+    sum += (uint8_t)str[i];
+  strOut[n + 1] = '#';
+  strOut[n + 2] = s_hex[sum >> 4];
+  strOut[n + 3] = s_hex[sum & 0xF];
+
+  while (m_fd >= 0)
+    {
+      int c;
+
+      if (send(m_fd, strOut, n + 4, MSG_NOSIGNAL) < 0)
+	{
+	  Hangup();
+	  return;
+	}
+
+      do
+	c = GetChar();
+      while ((c != '+') && (c != '-') && (c >= 0));
+
+      if (c == '+')
+	return;
+      if (c < 0)
+	Hangup();
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Command - Acts on m_packet and leaves the reply in m_reply. Returns FALSE
+//           if there's no reply to send (gdb said to carry on, or kill).
+//
+bool_t CGdbStub::Command()
+{
+  char* strArgs = m_packet + 1;
+  uint32_t addr, len;
+  int nType;
+
+  m_reply[0] = '\0';
+
+  switch (m_packet[0])
+    {
+    case '?':
+      StopReply();
+      break;
+
+    case 'g':
+      ReadRegisters(m_reply);
+      break;
+
+    case 'G':
+      strcpy(m_reply, WriteRegisters(strArgs) ? "OK" : "E01");
+      break;
+
+    case 'p':
+      {
+	uint32_t nReg = strtoul(strArgs, NULL, 16);
+	char strRegs[GDB_REGSLEN + 1];
+	uint32_t nOffset, nLen;
+
+	if (nReg >= GDB_NUMREGS)
+	  {
+	    strcpy(m_reply, "E01");
+	    break;
+	  }
+
+	// Cut it out of the 'g' reply
+	ReadRegisters(strRegs);
+	nOffset = reg_offset(nReg, &nLen);
+	memcpy(m_reply, strRegs + nOffset, nLen);
+	m_reply[nLen] = '\0';
+      }
+      break;
+
+    case 'P':
+      {
+	char* strValue;
+	uint32_t nReg = strtoul(strArgs, &strValue, 16);
+	uint32_t value;
+	ARMSTATE state;
+
+	if ((*strValue++ != '=') || (nReg >= GDB_NUMREGS))
+	  {
+	    strcpy(m_reply, "E01");
+	    break;
+	  }
+	if ((nReg >= GDB_FPREGS) && (nReg < GDB_CPSR))
+	  {
+	    // Nothing to write to, so nothing changes
+	    strcpy(m_reply, "OK");
+	    break;
+	  }
+
+	m_pArm->GetState(&state);
+	if (!get_word(strValue, &value) ||
+	    ((nReg == 15) && (value != state.r[15])))
+	  {
+	    strcpy(m_reply, "E01");
+	    break;
+	  }
+	if (nReg == GDB_CPSR)
+	  state.cpsr = value;
+	else
+	  state.r[nReg] = value;
+	m_pArm->SetState(&state);
+	strcpy(m_reply, "OK");
+      }
+      break;
+
+    case 'm':
+    case 'M':
+      {
+	char* strData;
+
+	addr = strtoul(strArgs, &strData, 16);
+	if (*strData++ != ',')
+	  {
+	    strcpy(m_reply, "E01");
+	    break;
+	  }
+	len = strtoul(strData, &strData, 16);
+
+	if (m_packet[0] == 'm')
+	  {
+	    if (!ReadMemory(addr, len, m_reply))
+	      strcpy(m_reply, "E01");
+	  }
+	else
+	  strcpy(m_reply, ((*strData == ':') &&
+			   WriteMemory(addr, len, strData + 1)) ? "OK" : "E01");
+      }
+      break;
+
+    case 'Z':
+    case 'z':
+      {
+	char* strRest;
+	bool_t bDone;
+
+	nType = strtol(strArgs, &strRest, 10);
+	if (*strRest++ != ',')
+	  {
+	    strcpy(m_reply, "E01");
+	    break;
+	  }
+	addr = strtoul(strRest, &strRest, 16);
+	if (*strRest++ != ',')
+	  {
+	    strcpy(m_reply, "E01");
+	    break;
+	  }
+	len = strtoul(strRest, NULL, 16);
+
+	if ((nType < 0) || (nType > GW_ACCESS))
+	  break;  // Empty, so gdb knows we don't do these
+
+	bDone = (m_packet[0] == 'Z') ? AddPoint(nType, addr, len) :
+	  RemovePoint(nType, addr, len);
+	strcpy(m_reply, bDone ? "OK" : "E01");
+      }
+      break;
+
+    case 'c':
+    case 's':
+      // We can't resume anywhere but where we are, so any address is
+      // ignored
+      m_bStep = (m_packet[0] == 's');
+      m_bRunning = TRUE;
+      return FALSE;
+
+    case 'D':
+      PutPacket("OK");
+      Hangup();
+      return FALSE;
+
+    case 'k':
+      Kill();
+      break;
+
+    case 'H':
+      strcpy(m_reply, "OK");
+      break;
+
+    case 'q':
+      if (strncmp(m_packet, "qSupported", 10) == 0)
+	sprintf(m_reply, "PacketSize=%x", GDB_MAXPACKET);
+      else if (strcmp(m_packet, "qAttached") == 0)
+	strcpy(m_reply, "1");
+      else if (strcmp(m_packet, "qC") == 0)
+	strcpy(m_reply, "QC1");
+      else if (strcmp(m_packet, "qfThreadInfo") == 0)
+	strcpy(m_reply, "m1");
+      else if (strcmp(m_packet, "qsThreadInfo") == 0)
+	strcpy(m_reply, "l");
+      break;
+
+    case 'v':
+      if (strncmp(m_packet, "vKill", 5) == 0)
+	{
+	  PutPacket("OK");
+	  Kill();
+	}
+      break;
+
+    default:
+      // An empty reply says we don't know the command
+      break;
+    }
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// StopReply - Why we stopped, in m_reply.
+//
+void CGdbStub::StopReply()
+{
+  static const char* strWatch[] = {"watch", "rwatch", "awatch"};
+
+  if (m_bWatchHit)
+    sprintf(m_reply, "T%02x%s:%08x;", m_nSignal,
+	    strWatch[m_watchHit.type - GW_WRITE], m_watchHit.addr);
+  else
+    sprintf(m_reply, "S%02x", m_nSignal);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadRegisters - All of them, as for 'g'.
+//
+void CGdbStub::ReadRegisters(char* strOut)
+{
+  ARMSTATE state;
+  uint32_t nLen;
+
+  m_pArm->GetState(&state);
+
+  for (int i = 0; i < 16; i++)
+    put_word(strOut + reg_offset(i, &nLen), state.r[i]);
+  memset(strOut + reg_offset(GDB_FPREGS, &nLen), '0', 
+	 reg_offset(GDB_CPSR, &nLen) - reg_offset(GDB_FPREGS, &nLen));
+  put_word(strOut + reg_offset(GDB_CPSR, &nLen), state.cpsr);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteRegisters - All of them, as for 'G'. The PC has to stay where it is.
+//
+bool_t CGdbStub::WriteRegisters(const char* strIn)
+{
+  ARMSTATE state;
+  uint32_t regs[16];
+  uint32_t cpsr;
+  uint32_t nLen;
+
+  if (strlen(strIn) < GDB_REGSLEN)
+    return FALSE;
+
+  m_pArm->GetState(&state);
+  for (int i = 0; i < 16; i++)
+    if (!get_word(strIn + reg_offset(i, &nLen), &regs[i]))
+      return FALSE;
+  if (!get_word(strIn + reg_offset(GDB_CPSR, &nLen), &cpsr) ||
+      (regs[15] != state.r[15]))
+    return FALSE;
+
+  memcpy(state.r, regs, sizeof(regs));
+  state.cpsr = cpsr;
+  m_pArm->SetState(&state);
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadMemory - Only the RAM; the devices would notice being read.
+//
+bool_t CGdbStub::ReadMemory(uint32_t addr, uint32_t len, char* strOut)
+{
+  if ((len > GDB_MAXPACKET / 2) ||
+      ((uint64_t)addr + len > (uint64_t)m_nMemSize))
+    return FALSE;
+
+  for (uint32_t i = 0; i < len; i++)
+    {
+      *strOut++ = s_hex[m_pMemory[addr + i] >> 4];
+      *strOut++ = s_hex[m_pMemory[addr + i] & 0xF];
+    }
+  *strOut = '\0';
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteMemory - The caches may have copies of what we change.
+//
+bool_t CGdbStub::WriteMemory(uint32_t addr, uint32_t len, const char* strIn)
+{
+  if (((uint64_t)addr + len > (uint64_t)m_nMemSize) ||
+      (strlen(strIn) < len * 2))
+    return FALSE;
+
+  for (uint32_t i = 0; i < len; i++)
+    {
+      int hi = hex_value(strIn[i * 2]);
+      int lo = hex_value(strIn[(i * 2) + 1]);
+
+      if ((hi < 0) || (lo < 0))
+	return FALSE;
+      m_pMemory[addr + i] = (uint8_t)((hi << 4) | lo);
+    }
+
+  m_pArm->FlushCaches();
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// AddPoint - Software and hardware breakpoints are the same thing here.
+//
+bool_t CGdbStub::AddPoint(int nType, uint32_t addr, uint32_t len)
+{
+  if (nType < GW_WRITE)
+    {
+      for (uint32_t i = 0; i < m_nBreaks; i++)
+	if (m_pBreaks[i] == addr)
+	  return TRUE;
+
+      if (m_nBreaks == m_nBreaksSize)
+	{
+	  uint32_t* pOld = m_pBreaks;
+
+	  m_nBreaksSize *= 2;
+	  m_pBreaks = new uint32_t[m_nBreaksSize];
+	  memcpy(m_pBreaks, pOld, sizeof(uint32_t) * m_nBreaks);
+	  delete[] pOld;
+	}
+      m_pBreaks[m_nBreaks++] = addr;
+      BuildHash();
+      return TRUE;
+    }
+
+  if ((m_nWatches == GDB_MAXWATCH) || (len == 0))
+    return FALSE;
+
+  m_watches[m_nWatches].addr = addr;
+  m_watches[m_nWatches].len = len;
+  m_watches[m_nWatches].type = (enum GDB_WATCH)nType;
+  m_nWatches++;
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// RemovePoint -
+//
+bool_t CGdbStub::RemovePoint(int nType, uint32_t addr, uint32_t len)
+{
+  if (nType < GW_WRITE)
+    {
+      for (uint32_t i = 0; i < m_nBreaks; i++)
+	if (m_pBreaks[i] == addr)
+	  {
+	    m_pBreaks[i] = m_pBreaks[--m_nBreaks];
+	    BuildHash();
+	    return TRUE;
+	  }
+      return FALSE;
+    }
+
+  for (uint32_t i = 0; i < m_nWatches; i++)
+    if ((m_watches[i].addr == addr) && (m_watches[i].len == len) &&
+	(m_watches[i].type == nType))
+      {
+	m_watches[i] = m_watches[--m_nWatches];
+	return TRUE;
+      }
+  return FALSE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BuildHash - Starts the hash again from m_pBreaks, at most a quarter full.
+//             Breakpoints don't change often enough to be worth removing
+//             from it one at a time.
+//
+void CGdbStub::BuildHash()
+{
+  uint32_t nSize = 32;
+
+  while (nSize < m_nBreaks * 4)
+    nSize *= 2;
+  if (nSize != m_nHashSize)
+    {
+      delete[] m_pHash;
+      m_nHashSize = nSize;
+      m_pHash = new uint32_t[m_nHashSize];
+    }
+  memset(m_pHash, 0xFF, sizeof(uint32_t) * m_nHashSize);
+
+  uint32_t mask = m_nHashSize - 1;
+  for (uint32_t j = 0; j < m_nBreaks; j++)
+    {
+      uint32_t i;
+
+      for (i = HASH(m_pBreaks[j]) & mask; m_pHash[i] != EMPTY_PC;
+	   i = (i + 1) & mask)
+	;
+      m_pHash[i] = m_pBreaks[j];
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Exited - gdb can't do anything more with us.
+//
+void CGdbStub::Exited(int nCode)
+{
+  if (m_fd < 0)
+    return;
+
+  sprintf(m_reply, "W%02x", nCode & 0xFF);
+  PutPacket(m_reply);
+  close(m_fd);
+  m_fd = -1;
+}
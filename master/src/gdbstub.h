@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   gdbstub.h
+// header n/a
+// info   A GDB remote serial protocol server, so the program SWARM runs
+//        can be debugged with gdb ("target remote"). It listens on
+//        either:
+//
+//          port         TCP on 127.0.0.1
+//          unix:path    a Unix socket at path
+//
+//        The processor asks us before the core starts each instruction,
+//        at the top of a cycle with nothing else in flight, and while
+//        we're stopped there the whole machine waits for gdb. Unless
+//        we're stepping, all that is asked is whether the PC is in the
+//        breakpoint hash, so running between breakpoints costs next to
+//        nothing. Watchpoints are told of each memory access the
+//        processor makes, but only looked at if any are set, and stop us
+//        at the end of the instruction that made it.
+//
+//        Breakpoints never touch memory, so the program can't see or
+//        overwrite them. The PC can't be written, as the core has
+//        already fetched and decoded what comes next.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __GDBSTUB_H__
+#define __GDBSTUB_H__
+
+#include "swarm.h"
+
+#define GDB_MAXPACKET  4096
+#define GDB_MAXWATCH   16
+#define GDB_POLL       0x10000   // Boundaries between looks at the socket
+
+enum GDB_WATCH {GW_WRITE = 2, GW_READ = 3, GW_ACCESS = 4};
+
+typedef struct GWTAG
+{
+  uint32_t addr;
+  uint32_t len;
+  enum GDB_WATCH type;
+} GDBWATCH;
+
+class CArmProc;
+
+class CGdbException : public CException
+{
+ public:
+  CGdbException(const char* strError);
+};
+
+class CGdbStub
+{
+  // Constructors and destructor
+ public:
+  // Throws a CGdbException if we can't listen on strWhere
+  CGdbStub(CArmProc* pArm, uint8_t* pMemory, uint32_t nMemSize,
+	   const char* strWhere);
+  ~CGdbStub();
+
+  // Public methods
+ public:
+  // From the processor, before the core starts the instruction at pc.
+  // Returns when the debugger lets it run.
+  inline void Boundary(uint32_t pc, uint64_t nInst)
+    {
+      if (m_bStep || m_bWatchHit || ((m_nBreaks != 0) && IsBreak(pc)) ||
+	  (--m_nPoll == 0))
+	Stop(pc, nInst);
+    }
+
+  // From the processor, for each memory access the program makes
+  inline void Read(uint32_t addr, uint32_t bw)
+    { if (m_nWatches != 0) Watch(addr, bw, FALSE); }
+  inline void Write(uint32_t addr, uint32_t bw)
+    { if (m_nWatches != 0) Watch(addr, bw, TRUE); }
+
+  // The program has finished with nCode; gdb is told
+  void Exited(int nCode);
+
+  // Private methods
+ private:
+  void Stop(uint32_t pc, uint64_t nInst);
+  bool_t IsBreak(uint32_t pc);
+  void Watch(uint32_t addr, uint32_t bw, bool_t bWrite);
+  bool_t Poll();
+
+  void Accept();
+  void Hangup();
+  void Kill();
+  bool_t GetPacket();
+  void PutPacket(const char* str);
+  int GetChar();
+
+  bool_t Command();
+  void StopReply();
+  void ReadRegisters(char* strOut);
+  bool_t WriteRegisters(const char* strIn);
+  bool_t ReadMemory(uint32_t addr, uint32_t len, char* strOut);
+  bool_t WriteMemory(uint32_t addr, uint32_t len, const char* strIn);
+  bool_t AddPoint(int nType, uint32_t addr, uint32_t len);
+  bool_t RemovePoint(int nType, uint32_t addr, uint32_t len);
+  void BuildHash();
+
+  // Private data
+ private:
+  CArmProc* m_pArm;
+  uint8_t*  m_pMemory;
+  uint32_t  m_nMemSize;
+  char*     m_strSocket;   // To unlink, if it's a Unix socket
+  int       m_listenFd;
+  int       m_fd;          // -1 while nobody is connected
+
+  char      m_in[256];     // What we've read from gdb
+  uint32_t  m_nIn;
+  uint32_t  m_nInNext;
+  char      m_packet[GDB_MAXPACKET + 1];
+  char      m_reply[GDB_MAXPACKET + 1];
+
+  // Why we last stopped, and where
+  int       m_nSignal;
+  uint32_t  m_stopPC;
+  uint64_t  m_nStopInst;
+  bool_t    m_bStep;
+  bool_t    m_bRunning;    // gdb is waiting to hear that we've stopped
+
+  // The breakpoints, and the same as an open addressed hash
+  uint32_t* m_pBreaks;
+  uint32_t  m_nBreaks;
+  uint32_t  m_nBreaksSize;
+  uint32_t* m_pHash;
+  uint32_t  m_nHashSize;
+
+  GDBWATCH  m_watches[GDB_MAXWATCH];
+  uint32_t  m_nWatches;
+  bool_t    m_bWatchHit;
+  GDBWATCH  m_watchHit;    // The watchpoint, with the address it saw
+
+  uint32_t  m_nPoll;
+};
+
+#endif // __GDBSTUB_H__
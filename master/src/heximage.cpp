@@ -0,0 +1,357 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   heximage.cpp
+// header heximage.h
+// info   Implements the S-record and Intel HEX loaders.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "swarm.h"
+#include "heximage.h"
+
+// The value of each hex digit, or 0xFF if it isn't one, so a bad digit
+// anywhere in a record shows up in the OR of all of them.
+static uint8_t s_hexDigits[256];
+static bool_t s_bHexDigits = FALSE;
+
+static void InitHexDigits()
+{
+  memset(s_hexDigits, 0xFF, sizeof(s_hexDigits));
+  for (int i = 0; i < 10; i++)
+    s_hexDigits['0' + i] = i;
+  for (int i = 0; i < 6; i++)
+    s_hexDigits['A' + i] = s_hexDigits['a' + i] = 10 + i;
+  s_bHexDigits = TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// DecodeHex - Decodes nBytes bytes of hex at p into pOut, adding them to
+//             *pSum. Returns FALSE if there was a bad digit.
+//
+static inline bool_t DecodeHex(const char* p, uint8_t* pOut, uint32_t nBytes,
+			       uint32_t* pSum)
+{
+  const uint8_t* q = (const uint8_t*)p;
+  uint32_t bad = 0;
+  uint32_t sum = 0;
+
+  for (uint32_t i = 0; i < nBytes; i++)
+    {
+      uint32_t hi = s_hexDigits[q[0]];
+      uint32_t lo = s_hexDigits[q[1]];
+      uint32_t b = (hi << 4) | lo;
+
+      bad |= hi | lo;
+      pOut[i] = b;
+      sum += b;
+      q += 2;
+    }
+
+  *pSum += sum;
+  return (bad & 0x80) == 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CHexException -
+//
+CHexException::CHexException(const char* strError, const char* strFile,
+			     uint32_t nLine)
+{
+  free(m_strError);
+
+  m_strError = (char*)malloc(strlen(strError) + strlen(strFile) + 32);
+  if (nLine == 0)
+    sprintf(m_strError, "%s: %s", strError, strFile);
+  else
+    sprintf(m_strError, "%s at line %u: %s", strError, nLine, strFile);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CHexImage - Just maps the file. Nothing is looked at until it is loaded.
+//
+CHexImage::CHexImage(const char* strFile)
+{
+  struct stat st;
+  int fd;
+
+  if (!s_bHexDigits)
+    InitHexDigits();
+
+  fd = open(strFile, O_RDONLY);
+  if (fd == -1)
+    throw CHexException("Can't open program", strFile, 0);
+  if (fstat(fd, &st) == -1)
+    {
+      close(fd);
+      throw CHexException("Can't get the size of program", strFile, 0);
+    }
+  m_nSize = st.st_size;
+  if (m_nSize == 0)
+    {
+      close(fd);
+      throw CHexException("Program is empty", strFile, 0);
+    }
+
+  m_pImage = (char*)mmap(NULL, m_nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m_pImage == (char*)MAP_FAILED)
+    throw CHexException("Can't map program", strFile, 0);
+
+  // We read the file front to back just the once
+  madvise(m_pImage, m_nSize, MADV_SEQUENTIAL);
+
+  m_strFile = strdup(strFile);
+  m_bEntry = FALSE;
+  m_entry = 0;
+  m_addrLow = 0xFFFFFFFF;
+  m_addrHigh = 0;
+  m_nBytes = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CHexImage -
+//
+CHexImage::~CHexImage()
+{
+  munmap(m_pImage, m_nSize);
+  free(m_strFile);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Error - Throws a CHexException for the line we're on.
+//
+void CHexImage::Error(const char* strError)
+{
+  throw CHexException(strError, m_strFile, m_nLine);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// EndLine - Moves on to the start of the next record, past any trailing
+//           space and blank lines.
+//
+void CHexImage::EndLine()
+{
+  while ((m_p < m_pEnd) && ((*m_p == ' ') || (*m_p == '\t')))
+    m_p++;
+  if ((m_p < m_pEnd) && (*m_p != '\r') && (*m_p != '\n'))
+    Error("Junk after record");
+
+  while ((m_p < m_pEnd) && ((*m_p == '\r') || (*m_p == '\n')))
+    {
+      if (*m_p == '\n')
+	m_nLine++;
+      m_p++;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Store - Decodes data in a record straight into memory.
+//
+void CHexImage::Store(uint8_t* pMemory, uint32_t nMemSize, uint32_t addr,
+		      const char* p, uint32_t nBytes, uint32_t* pSum)
+{
+  if (nBytes == 0)
+    return;
+  if ((nBytes > nMemSize) || (addr > nMemSize - nBytes))
+    Error("Record is outside memory");
+
+  if (!DecodeHex(p, pMemory + addr, nBytes, pSum))
+    Error("Bad hex digit");
+
+  if (addr < m_addrLow)
+    m_addrLow = addr;
+  if (addr + nBytes - 1 > m_addrHigh)
+    m_addrHigh = addr + nBytes - 1;
+  m_nBytes += nBytes;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Load - Works out which format we've got from the first character.
+//
+void CHexImage::Load(uint8_t* pMemory, uint32_t nMemSize)
+{
+  m_p = m_pImage;
+  m_pEnd = m_pImage + m_nSize;
+  m_nLine = 1;
+
+  if (*m_p == 'S')
+    LoadSRec(pMemory, nMemSize);
+  else if (*m_p == ':')
+    LoadIHex(pMemory, nMemSize);
+  else
+    throw CHexException("Not an S-record or Intel HEX file", m_strFile, 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// LoadSRec - Each record is Stnn, an address of 2, 3 or 4 bytes, the data
+//            and a checksum, with nn counting everything after itself. The
+//            checksum makes the sum of those bytes and nn 0xFF.
+//
+void CHexImage::LoadSRec(uint8_t* pMemory, uint32_t nMemSize)
+{
+  // Address bytes for each record type, 0 if it is one we skip
+  const static uint32_t addrBytes[10] = {0, 2, 3, 4, 0, 0, 0, 4, 3, 2};
+
+  while (m_p < m_pEnd)
+    {
+      uint8_t hdr[5];
+      uint32_t sum = 0;
+
+      if ((m_pEnd - m_p < 4) || (m_p[0] != 'S') ||
+	  (m_p[1] < '0') || (m_p[1] > '9'))
+	Error("Bad S-record");
+
+      uint32_t nType = m_p[1] - '0';
+      if (!DecodeHex(m_p + 2, hdr, 1, &sum))
+	Error("Bad hex digit");
+      uint32_t nCount = hdr[0];
+      if (m_pEnd - (m_p + 4) < (ptrdiff_t)(nCount * 2))
+	Error("S-record is cut short");
+      const char* pRec = m_p + 4;
+      m_p = pRec + (nCount * 2);
+
+      uint32_t nAddr = addrBytes[nType];
+      if (nAddr == 0)
+	{
+	  // Still worth knowing the file is sound
+	  uint8_t skip[255];
+	  if (!DecodeHex(pRec, skip, nCount, &sum))
+	    Error("Bad hex digit");
+	  if ((sum & 0xFF) != 0xFF)
+	    Error("Bad checksum");
+	  EndLine();
+	  continue;
+	}
+
+      if (nCount < nAddr + 1)
+	Error("S-record is too short");
+      if (!DecodeHex(pRec, hdr, nAddr, &sum))
+	Error("Bad hex digit");
+
+      uint32_t addr = 0;
+      for (uint32_t i = 0; i < nAddr; i++)
+	addr = (addr << 8) | hdr[i];
+
+      uint32_t nBytes = nCount - nAddr - 1;
+      const char* pData = pRec + (nAddr * 2);
+
+      if (nType <= 3)
+	Store(pMemory, nMemSize, addr, pData, nBytes, &sum);
+      else
+	{
+	  m_bEntry = TRUE;
+	  m_entry = addr;
+	}
+
+      if (!DecodeHex(pData + (nBytes * 2), hdr, 1, &sum))
+	Error("Bad hex digit");
+      if ((sum & 0xFF) != 0xFF)
+	Error("Bad checksum");
+
+      EndLine();
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// LoadIHex - Each record is :llaaaatt, l bytes of data and a checksum that
+//            makes the sum of all the bytes 0.
+//
+void CHexImage::LoadIHex(uint8_t* pMemory, uint32_t nMemSize)
+{
+  uint32_t base = 0;
+
+  while (m_p < m_pEnd)
+    {
+      uint8_t hdr[4];
+      uint32_t sum = 0;
+
+      if ((m_pEnd - m_p < 11) || (m_p[0] != ':'))
+	Error("Bad Intel HEX record");
+      if (!DecodeHex(m_p + 1, hdr, 4, &sum))
+	Error("Bad hex digit");
+
+      uint32_t nBytes = hdr[0];
+      uint32_t offset = (hdr[1] << 8) | hdr[2];
+      uint32_t nType = hdr[3];
+      const char* pData = m_p + 9;
+
+      if (m_pEnd - pData < (ptrdiff_t)((nBytes + 1) * 2))
+	Error("Intel HEX record is cut short");
+      m_p = pData + ((nBytes + 1) * 2);
+
+      uint8_t data[4];
+      switch (nType)
+	{
+	case 0x00:
+	  Store(pMemory, nMemSize, base + offset, pData, nBytes, &sum);
+	  break;
+
+	case 0x01:
+	  if (nBytes != 0)
+	    Error("Bad Intel HEX end of file record");
+	  break;
+
+	case 0x02: case 0x04:
+	  if ((nBytes != 2) || !DecodeHex(pData, data, 2, &sum))
+	    Error("Bad Intel HEX address record");
+	  base = (data[0] << 8) | data[1];
+	  base <<= (nType == 0x02) ? 4 : 16;
+	  break;
+
+	case 0x03: case 0x05:
+	  if ((nBytes != 4) || !DecodeHex(pData, data, 4, &sum))
+	    Error("Bad Intel HEX start address record");
+	  m_bEntry = TRUE;
+	  if (nType == 0x03)
+	    m_entry = (((data[0] << 8) | data[1]) << 4) +
+	      ((data[2] << 8) | data[3]);
+	  else
+	    m_entry = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) |
+	      data[3];
+	  break;
+
+	default:
+	  Error("Unknown Intel HEX record");
+	}
+
+      if (!DecodeHex(pData + (nBytes * 2), data, 1, &sum))
+	Error("Bad hex digit");
+      if ((sum & 0xFF) != 0)
+	Error("Bad checksum");
+
+      EndLine();
+      if (nType == 0x01)
+	break;
+    }
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   heximage.h
+// header n/a
+// info   Loads a program from Motorola S-records or Intel HEX, whichever
+//        the file starts with. The file is mmapped and the records are
+//        decoded straight into memory, with every checksum checked.
+//
+//        S-records: S1, S2 and S3 data records with 16, 24 and 32 bit
+//        addresses, and S7, S8 and S9 giving the start address. S0, S5
+//        and S6 are skipped.
+//
+//        Intel HEX: data (00), end of file (01), extended segment (02)
+//        and linear (04) addresses, and start segment (03) and linear
+//        (05) addresses.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEXIMAGE_H__
+#define __HEXIMAGE_H__
+
+#include <sys/types.h>
+#include "swarm.h"
+
+class CHexException : public CException
+{
+ public:
+  CHexException(const char* strError, const char* strFile, uint32_t nLine);
+};
+
+class CHexImage
+{
+  // Constructors and destructor
+ public:
+  CHexImage(const char* strFile);   // Throws a CHexException
+  ~CHexImage();
+
+  // Public methods
+ public:
+  // Throws a CHexException if a record is bad or outside memory. What
+  // came before it will have been loaded.
+  void Load(uint8_t* pMemory, uint32_t nMemSize);
+
+  inline bool_t   HasEntry() { return m_bEntry; }
+  inline uint32_t GetEntry() { return m_entry; }
+  inline uint32_t GetLowest() { return m_addrLow; }
+  inline uint32_t GetHighest() { return m_addrHigh; }
+  inline uint64_t GetBytes() { return m_nBytes; }
+
+  // Private methods
+ private:
+  void LoadSRec(uint8_t* pMemory, uint32_t nMemSize);
+  void LoadIHex(uint8_t* pMemory, uint32_t nMemSize);
+  void Store(uint8_t* pMemory, uint32_t nMemSize, uint32_t addr,
+	     const char* p, uint32_t nBytes, uint32_t* pSum);
+  void EndLine();
+  void Error(const char* strError);
+
+  // Private data
+ private:
+  char*       m_strFile;
+  char*       m_pImage;
+  size_t      m_nSize;
+
+  // Where we are in the file
+  const char* m_p;
+  const char* m_pEnd;
+  uint32_t    m_nLine;
+
+  bool_t      m_bEntry;
+  uint32_t    m_entry;
+  uint32_t    m_addrLow;
+  uint32_t    m_addrHigh;
+  uint64_t    m_nBytes;
+};
+
+#endif // __HEXIMAGE_H__
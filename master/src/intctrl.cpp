@@ -56,79 +56,100 @@ CIntCtrl::~CIntCtrl()
 void CIntCtrl::Reset()
 {
   memset(m_regs, 0, sizeof(uint32_t) * 6);
+  m_lines = 0;
+  m_irq = m_fiq = 1;
+  m_nDeadline = ~(uint64_t)0;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Cycle - 
+// Cycle - Only called after a register write, to pick up what it changed
+//         along with whatever the lines are doing by then.
 //
-void CIntCtrl::Cycle(INTCTRLBUS* bus)
+uint32_t CIntCtrl::Cycle()
 {
+  Update();
+  m_nDeadline = ~(uint64_t)0;
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - 
+//
+void CIntCtrl::Write(uint32_t addr, uint32_t data)
+{
+  m_nDeadline = *m_pClock + 1;
+
+  if (addr == 0x00000000)
+    m_regs[R_ICIP] = data;
+  else if (addr == 0x00000004)
+    m_regs[R_ICMR] = data;
+  else if (addr == 0x00000008)
+    m_regs[R_ICLR] = data;
+  else if (addr == 0x0000000C)
+    m_regs[R_ICCR] = data & 0x1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read - 
+//
+uint32_t CIntCtrl::Read(uint32_t addr)
+{
+  if (addr == 0x00000000)
+    return m_regs[R_ICIP];
+  else if (addr == 0x00000004)
+    return m_regs[R_ICMR];
+  else if (addr == 0x00000008)
+    return m_regs[R_ICLR];
+  else if (addr == 0x00000010)
+    return m_regs[R_ICFP];
+  else if (addr == 0x00000020)
+    return m_regs[R_ICPR];
+  else if (addr == 0x0000000C)
+    return m_regs[R_ICCR];
+  else
+    return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update - Works out the pending registers and outputs from the lines.
+//
+void CIntCtrl::Update()
+{
+  uint32_t intbits = m_lines;
   int PendingInterrupts;
 
   // Nothing interesting happing...yet
-  bus->fiq = bus->irq = bus->reset = 1;
-
-  // See what the pesky real world wants
-  if (bus->w != 0)
-    {
-      uint32_t addr = bus->addr;
-      if (addr == 0x00000000)
-	m_regs[R_ICIP] = bus->data;
-      else if (addr == 0x00000004)
-	m_regs[R_ICMR] = bus->data;
-      else if (addr == 0x00000008)
-	m_regs[R_ICLR] = bus->data;
-      else if (addr == 0x0000000C)
-	m_regs[R_ICCR] = bus->data & 0x1;
-    }
+  m_fiq = m_irq = 1;
 
   // Generate the new IRQ/FIQ pending registers
 #ifndef QUIET
-  if (bus->intbits)
+  if (intbits)
   {
 	  fprintf(stderr, "\nIntCtrl:\n Request: %x\n Mask: %x\n Level: %x\n", 
-	    bus->intbits, m_regs[R_ICMR], m_regs[R_ICLR]);
+	    intbits, m_regs[R_ICMR], m_regs[R_ICLR]);
   }
 #endif  
   PendingInterrupts = m_regs[R_ICIP];
-  m_regs[R_ICIP] = (bus->intbits & m_regs[R_ICMR]) & ~m_regs[R_ICLR];
-  m_regs[R_ICFP] = (bus->intbits & m_regs[R_ICMR]) & m_regs[R_ICLR];
+  m_regs[R_ICIP] = (intbits & m_regs[R_ICMR]) & ~m_regs[R_ICLR];
+  m_regs[R_ICFP] = (intbits & m_regs[R_ICMR]) & m_regs[R_ICLR];
 
   if (m_regs[R_ICIP] != 0)
     {
-      bus->irq = 0;
+      m_irq = 0;
 #ifndef QUIET
       fprintf(stderr,"\nIntCtrl: Got an IRQ\n");
 #endif
     }
   if (m_regs[R_ICFP] != 0)
     {
-      bus->fiq = 0;  
+      m_fiq = 0;  
 #ifndef QUIET
       fprintf(stderr,"\nIntCtrl: Got a FIQ\n");
 #endif
     }
   m_regs[R_ICIP] |= PendingInterrupts;
-
-  // Did the nosy busy body want any info?
-  if (bus->r != 0)
-    {
-      uint32_t addr = bus->addr;
-
-      if (addr == 0x00000000)
-	bus->data = m_regs[R_ICIP];
-      else if (addr == 0x00000004)
-	bus->data = m_regs[R_ICMR];
-      else if (addr == 0x00000008)
-	bus->data = m_regs[R_ICLR];
-      else if (addr == 0x00000010)
-	bus->data = m_regs[R_ICFP];
-      else if (addr == 0x00000020)
-	bus->data = m_regs[R_ICPR];
-      else if (addr == 0x0000000C)
-	bus->data = m_regs[R_ICCR];
-      else
-	bus->data = 0;
-    }
 }
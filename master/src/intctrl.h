@@ -24,19 +24,11 @@
 #ifndef __INTCTRL_H__
 #define __INTCTRL_H__
 
-typedef struct ICBTAG
-{
-  uint32_t intbits:32;
-  uint32_t addr:32;
-  uint32_t data:32;
-  uint32_t irq:1;
-  uint32_t fiq:1;
-  uint32_t reset:1;
-  uint32_t r:1;
-  uint32_t w:1;
-} INTCTRLBUS;
-
-class CIntCtrl
+#include "device.h"
+
+#define INTCTRL_SIZE 0x10000
+
+class CIntCtrl : public CDevice
 {
   // constructors and destructor
  public:
@@ -44,11 +36,40 @@ class CIntCtrl
   ~CIntCtrl();
 
  public:
-  void Cycle(INTCTRLBUS* bus);
-  void Reset();
+  uint32_t Cycle();
+  uint32_t Read(uint32_t addr);
+  void     Write(uint32_t addr, uint32_t data);
+  void     Reset();
+  uint32_t GetSize() { return INTCTRL_SIZE; }
+
+  // The other devices' interrupt lines. Only those in mask are changed.
+  // The IRQ and FIQ outputs are active low, like the pins on the core, and
+  // are only worked out again when the lines, ICMR or ICLR change.
+  inline void SetLines(uint32_t mask, uint32_t lines);
+  inline uint32_t GetIRQ() { return m_irq; }
+  inline uint32_t GetFIQ() { return m_fiq; }
 
  private:
   uint32_t m_regs[6];
+  uint32_t m_lines;
+  uint32_t m_irq;
+  uint32_t m_fiq;
+
+  void Update();
 };
 
+
+///////////////////////////////////////////////////////////////////////////////
+// SetLines - 
+//
+inline void CIntCtrl::SetLines(uint32_t mask, uint32_t lines)
+{
+  lines = (m_lines & ~mask) | (lines & mask);
+  if (lines != m_lines)
+    {
+      m_lines = lines;
+      Update();
+    }
+}
+
 #endif // __INTCTRL_H__
@@ -1,56 +1,97 @@
 //////////////////////////////////////////////////////////////////////////////
-// 
+//
 // Copyright (C) 2001 C Hanish Menon [www.hanishkvc.com]
-// 
+//
 // This program is free software; you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
 // the Free Software Foundation; either version 2 of the License, or
 // (at your option) any later version.
-// 
+//
 // This program is distributed in the hope that it will be useful,
 // but WITHOUT ANY WARRANTY; without even the implied warranty of
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
 // GNU General Public License for more details.
-// 
+//
 // You should have received a copy of the GNU General Public License
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
-// 
+//
 // Name   : lcdctrl.cpp
 // Author : C Hanish Menon [www.hanishkvc.com]
-// 
+//
 //////////////////////////////////////////////////////////////////////////////
 
 #include "swarm.h"
 #include "lcdctrl.h"
+#include "stats.h"
+#include <iostream.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 #define MODULE_NAME "LCDCTRL"
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// CLCDCtrl - 
+// CLCDException -
+//
+CLCDException::CLCDException(const char* strError)
+{
+  free(m_strError);
+  m_strError = strdup(strError);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CLCDCtrl -
 //
 CLCDCtrl::CLCDCtrl()
 {
   //printf(MODULE_NAME": In Constructor\n");
-  if((fScreen = fopen(LCDCTRL_SCREENFILE,"w")) == NULL)
-  {
-    fprintf(stderr,MODULE_NAME": Error opening %s\n",LCDCTRL_SCREENFILE);
-    exit(1);
-  }
+  m_nFrameCycles = LCDCTRL_FRAMECYCLES;
+  m_strPattern = NULL;
+  m_fpRaw = NULL;
+  m_bStop = FALSE;
+  m_pFree = m_pQueue = m_pQueueTail = NULL;
+  m_nFrames = 0;
+  m_nDropped = 0;
+  memset(m_frames, 0, sizeof(m_frames));
   Reset();
+
+  CStats::Register(this, "lcd.frames", &m_nFrames);
+  CStats::Register(this, "lcd.dropped", &m_nDropped);
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// ~CLCDCtrl - 
+// ~CLCDCtrl - Lets the writer finish what it has been given.
 //
 CLCDCtrl::~CLCDCtrl()
 {
   //printf(MODULE_NAME": In Destructor\n");
-  fclose(fScreen);
+  CStats::Unregister(this);
+  if ((m_strPattern == NULL) && (m_fpRaw == NULL))
+    return;
+
+  pthread_mutex_lock(&m_lock);
+  m_bStop = TRUE;
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_lock);
+  pthread_join(m_thread, NULL);
+
+  pthread_mutex_destroy(&m_lock);
+  pthread_cond_destroy(&m_cond);
+
+  cout << "LCD info: frames = " << m_nFrames << " dropped = " <<
+    m_nDropped << "\n";
+
+  if (m_fpRaw != NULL)
+    fclose(m_fpRaw);
+  if (m_strPattern != NULL)
+    free(m_strPattern);
+  for (int i = 0; i < LCDCTRL_NUMFRAMES; i++)
+    if (m_frames[i].pRGB != NULL)
+      delete[] m_frames[i].pRGB;
 }
 
 
@@ -61,7 +102,7 @@ void CLCDCtrl::Reset()
 {
   int r, g, b, colorinc;
   double dcolorinc;
-  
+
   memset(m_regs, 0, sizeof(uint32_t) * LCDCTRL_NUMREGS);
   m_regs[R_LCDVER] = 0x00001000; // v0.1
 
@@ -70,67 +111,378 @@ void CLCDCtrl::Reset()
   colorinc = (int) dcolorinc+1;
   for(int i = 0; i < LCDCTRL_NUMPALS; i++)
   {
-    r = g = b = i*colorinc;      
+    r = g = b = i*colorinc;
     m_pals[i] = ( (r << 16) | (g << 8) | b );
   }
+
+  m_bLUTDirty = TRUE;
+  m_nVSync = *m_pClock + m_nFrameCycles;
+  m_nDeadline = m_nVSync;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// UpdateScreen - 
+// SetOutput - Starts the writer thread. R_LCDSTARTADDR is an offset into
+//             the memory given to SetMemory.
 //
-void CLCDCtrl::UpdateScreen()
+void CLCDCtrl::SetOutput(const char* strOutput, uint32_t nFrameCycles)
 {
-  //printf(MODULE_NAME": Updating Screen\n");
-  fseek(fScreen,0,SEEK_SET);
-  for(int i = 0; i < LCDCTRL_NUMPALS; i++)
-    fprintf(fScreen, "Pal[%x] = %x\n", i, m_pals[i]);
-  fflush(fScreen);
+  if ((m_strPattern != NULL) || (m_fpRaw != NULL))
+    throw CLCDException("LCD output already set");
+  if (nFrameCycles == 0)
+    throw CLCDException("LCD frame interval must be at least one cycle");
+
+  if (strncmp(strOutput, "ppm:", 4) == 0)
+  {
+    // Only a single %d (optionally with a width) is allowed
+    const char* p = strchr(strOutput + 4, '%');
+    if (p == NULL)
+      throw CLCDException("LCD ppm output needs a %d in its name");
+    for (p++; isdigit(*p); p++)
+      ;
+    if ((*p != 'd') || (strchr(p, '%') != NULL))
+      throw CLCDException("LCD ppm output can only have a single %d");
+
+    m_strPattern = strdup(strOutput + 4);
+  }
+  else if (strncmp(strOutput, "raw:", 4) == 0)
+  {
+    if ((m_fpRaw = fopen(strOutput + 4, "wb")) == NULL)
+      throw CLCDException("Can't open LCD output");
+  }
+  else
+    throw CLCDException("LCD output must be ppm:pattern or raw:file");
+
+  m_nFrameCycles = nFrameCycles;
+  m_nVSync = *m_pClock + nFrameCycles;
+  m_nDeadline = m_nVSync;
+
+  for (int i = 0; i < LCDCTRL_NUMFRAMES; i++)
+  {
+    m_frames[i].pNext = m_pFree;
+    m_pFree = &m_frames[i];
+  }
+
+  pthread_mutex_init(&m_lock, NULL);
+  pthread_cond_init(&m_cond, NULL);
+  if (pthread_create(&m_thread, NULL, WriterEntry, this) != 0)
+  {
+    // Leave things as if we'd never been asked
+    if (m_fpRaw != NULL)
+      fclose(m_fpRaw);
+    if (m_strPattern != NULL)
+      free(m_strPattern);
+    m_fpRaw = NULL;
+    m_strPattern = NULL;
+    throw CLCDException("Can't start the LCD writer thread");
+  }
 }
 
+
 ///////////////////////////////////////////////////////////////////////////////
-// Cycle - 
+// BuildLUT - For each byte value, the colours of the pixels it holds.
 //
-void CLCDCtrl::Cycle(LCDCTRLBUS* bus)
+void CLCDCtrl::BuildLUT(uint32_t nDepth)
 {
-  static int CycleCount = 0;
-  
-
-  if( (CycleCount++ % LCDCTRL_UPDATEINTERVAL) == 0)
-          UpdateScreen();
-  // See what the pesky real world wants
-  if (bus->w != 0)
-  {
-    uint32_t addr = bus->addr;
-    
-    // R_LCDVER        0x0
-    if (addr == 0x00000004) // R_LCDRESOLUTION 0x1
-      m_regs[R_LCDRESOLUTION] = bus->data;
-    else if (addr == 0x00000008) // R_LCDCOLORDEPTH 0x2
-      m_regs[R_LCDCOLORDEPTH] = bus->data;
-    else if (addr == 0x0000000C) // R_LCDSTARTADDR  0x3
-      m_regs[R_LCDSTARTADDR] = bus->data;
-    // R_LCDRESERVED1  0x4
-    // R_LCDPALINDEX   0x5
-    // R_LCDPALDATA    0x6
-    // R_LCDSTATUS     0x7
-  }
-
-
-  // Did the nosy busy body want any info?
-  if (bus->r != 0)
-  {
-    uint32_t addr = bus->addr;
-
-    if (addr == 0x00000000)
-	    bus->data = m_regs[R_LCDVER];
-    else if (addr == 0x00000004)
-	    bus->data = m_regs[R_LCDRESOLUTION];
-    else if (addr == 0x00000008)
-	    bus->data = m_regs[R_LCDCOLORDEPTH];
-    else if (addr == 0x0000000C)
-	    bus->data = m_regs[R_LCDSTARTADDR];
+  uint32_t nPixels = 8 / nDepth;
+  uint32_t mask = (1 << nDepth) - 1;
+
+  for (uint32_t b = 0; b < 256; b++)
+    for (uint32_t k = 0; k < nPixels; k++)
+      m_byteLUT[b][k] = m_pals[(b >> (k * nDepth)) & mask];
+
+  m_bLUTDirty = FALSE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ScanOut - Converts the framebuffer to RGB in pFrame. Returns FALSE if the
+//           registers don't describe a frame we can read.
+//
+bool_t CLCDCtrl::ScanOut(LCDFRAME* pFrame)
+{
+  uint32_t nWidth = m_regs[R_LCDRESOLUTION] >> 16;
+  uint32_t nHeight = m_regs[R_LCDRESOLUTION] & 0xFFFF;
+  uint32_t nDepth = m_regs[R_LCDCOLORDEPTH];
+  uint32_t start = m_regs[R_LCDSTARTADDR];
+
+  if ((nWidth == 0) || (nHeight == 0) || (nWidth > LCDCTRL_MAXWIDTH) ||
+      (nHeight > LCDCTRL_MAXHEIGHT))
+    return FALSE;
+
+  switch (nDepth)
+  {
+  case 1: case 2: case 4: case 8: case 16: case 24: case 32:
+    break;
+  default:
+    return FALSE;
+  }
+
+  // Rows start on a byte boundary
+  uint32_t nStride = ((nWidth * nDepth) + 7) / 8;
+  if ((start >= m_nMemSize) || ((m_nMemSize - start) / nStride < nHeight))
+    return FALSE;
+
+  uint32_t nSize = nWidth * nHeight * 3;
+  if (pFrame->nSize < nSize)
+  {
+    if (pFrame->pRGB != NULL)
+      delete[] pFrame->pRGB;
+    pFrame->pRGB = new uint8_t[nSize];
+    pFrame->nSize = nSize;
+  }
+  pFrame->nWidth = nWidth;
+  pFrame->nHeight = nHeight;
+
+  if ((nDepth <= 8) && m_bLUTDirty)
+    BuildLUT(nDepth);
+
+  for (uint32_t y = 0; y < nHeight; y++)
+  {
+    const uint8_t* src = m_pMemory + start + (y * nStride);
+    uint8_t* dst = pFrame->pRGB + (y * nWidth * 3);
+
+    switch (nDepth)
+    {
+    case 16:
+      for (uint32_t x = 0; x < nWidth; x++, src += 2, dst += 3)
+      {
+	uint32_t v = src[0] | (src[1] << 8);
+	uint32_t r = v >> 11, g = (v >> 5) & 0x3F, b = v & 0x1F;
+	dst[0] = (r << 3) | (r >> 2);
+	dst[1] = (g << 2) | (g >> 4);
+	dst[2] = (b << 3) | (b >> 2);
+      }
+      break;
+    case 24:
+      for (uint32_t x = 0; x < nWidth; x++, src += 3, dst += 3)
+      {
+	dst[0] = src[2];
+	dst[1] = src[1];
+	dst[2] = src[0];
+      }
+      break;
+    case 32:
+      for (uint32_t x = 0; x < nWidth; x++, src += 4, dst += 3)
+      {
+	dst[0] = src[2];
+	dst[1] = src[1];
+	dst[2] = src[0];
+      }
+      break;
+    default:
+      {
+	// One lookup gets all the pixels in a byte
+	uint32_t nPixels = 8 / nDepth;
+	for (uint32_t x = 0; x < nWidth; src++)
+	{
+	  const uint32_t* pix = m_byteLUT[*src];
+	  for (uint32_t k = 0; (k < nPixels) && (x < nWidth); k++, x++)
+	  {
+	    dst[0] = pix[k] >> 16;
+	    dst[1] = pix[k] >> 8;
+	    dst[2] = pix[k];
+	    dst += 3;
+	  }
+	}
+      }
+      break;
+    }
+  }
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// VSync - Scans out the frame if there is a buffer free, else drops it.
+//
+void CLCDCtrl::VSync()
+{
+  LCDFRAME* pFrame;
+
+  m_nVSync = *m_pClock + m_nFrameCycles;
+  m_regs[R_LCDSTATUS] |= LCDSTATUS_VSYNC;
+
+  if ((m_strPattern == NULL) && (m_fpRaw == NULL))
+    return;
+
+  pthread_mutex_lock(&m_lock);
+  pFrame = m_pFree;
+  if (pFrame != NULL)
+    m_pFree = pFrame->pNext;
+  pthread_mutex_unlock(&m_lock);
+
+  if (pFrame == NULL)
+  {
+    m_nDropped++;
+    return;
+  }
+
+  bool_t bOK = ScanOut(pFrame);
+  if (bOK)
+    pFrame->nFrame = m_nFrames++;
+
+  pthread_mutex_lock(&m_lock);
+  if (bOK)
+  {
+    pFrame->pNext = NULL;
+    if (m_pQueue == NULL)
+      m_pQueue = pFrame;
     else
-	    bus->data = 0;
+      m_pQueueTail->pNext = pFrame;
+    m_pQueueTail = pFrame;
+    pthread_cond_signal(&m_cond);
+  }
+  else
+  {
+    pFrame->pNext = m_pFree;
+    m_pFree = pFrame;
+  }
+  pthread_mutex_unlock(&m_lock);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteFrame - Writer thread.
+//
+void CLCDCtrl::WriteFrame(LCDFRAME* pFrame)
+{
+  uint32_t nSize = pFrame->nWidth * pFrame->nHeight * 3;
+
+  if (m_fpRaw != NULL)
+  {
+    fwrite(pFrame->pRGB, 1, nSize, m_fpRaw);
+    return;
+  }
+
+  char* strName = (char*)malloc(strlen(m_strPattern) + 32);
+  sprintf(strName, m_strPattern, pFrame->nFrame);
+
+  FILE* fp = fopen(strName, "wb");
+  if (fp == NULL)
+    fprintf(stderr, MODULE_NAME": Error opening %s\n", strName);
+  else
+  {
+    fprintf(fp, "P6\n%u %u\n255\n", pFrame->nWidth, pFrame->nHeight);
+    fwrite(pFrame->pRGB, 1, nSize, fp);
+    fclose(fp);
+  }
+  free(strName);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Writer - Writes out frames as they are queued until told to stop.
+//
+void CLCDCtrl::Writer()
+{
+  pthread_mutex_lock(&m_lock);
+  while (1)
+  {
+    while ((m_pQueue == NULL) && !m_bStop)
+      pthread_cond_wait(&m_cond, &m_lock);
+    if (m_pQueue == NULL)
+      break;
+
+    LCDFRAME* pFrame = m_pQueue;
+    m_pQueue = pFrame->pNext;
+    pthread_mutex_unlock(&m_lock);
+
+    WriteFrame(pFrame);
+
+    pthread_mutex_lock(&m_lock);
+    pFrame->pNext = m_pFree;
+    m_pFree = pFrame;
   }
+  pthread_mutex_unlock(&m_lock);
+}
+
+void* CLCDCtrl::WriterEntry(void* arg)
+{
+  ((CLCDCtrl*)arg)->Writer();
+  return NULL;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cycle - Only called when a vsync is due, or the next cycle after something
+//         that can change the interrupt line.
+//
+uint32_t CLCDCtrl::Cycle()
+{
+  if (*m_pClock >= m_nVSync)
+    VSync();
+  m_nDeadline = m_nVSync;
+
+  return ((m_regs[R_LCDCONTROL] & LCDCONTROL_VSYNC_INT) &&
+	  (m_regs[R_LCDSTATUS] & LCDSTATUS_VSYNC)) ? 1 : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write -
+//
+void CLCDCtrl::Write(uint32_t addr, uint32_t data)
+{
+  // R_LCDVER        0x0
+  if (addr == 0x00000004) // R_LCDRESOLUTION 0x1
+    m_regs[R_LCDRESOLUTION] = data;
+  else if (addr == 0x00000008) // R_LCDCOLORDEPTH 0x2
+  {
+    m_regs[R_LCDCOLORDEPTH] = data;
+    m_bLUTDirty = TRUE;
+  }
+  else if (addr == 0x0000000C) // R_LCDSTARTADDR  0x3
+    m_regs[R_LCDSTARTADDR] = data;
+  else if (addr == 0x00000010) // R_LCDCONTROL    0x4
+  {
+    m_regs[R_LCDCONTROL] = data;
+    m_nDeadline = *m_pClock + 1;
+  }
+  else if (addr == 0x00000014) // R_LCDPALINDEX   0x5
+    m_regs[R_LCDPALINDEX] = data & (LCDCTRL_NUMPALS - 1);
+  else if (addr == 0x00000018) // R_LCDPALDATA    0x6
+  {
+    // The index moves on so the palette can be written in one go
+    m_pals[m_regs[R_LCDPALINDEX]] = data & 0x00FFFFFF;
+    m_regs[R_LCDPALINDEX] = (m_regs[R_LCDPALINDEX] + 1) &
+      (LCDCTRL_NUMPALS - 1);
+    m_bLUTDirty = TRUE;
+  }
+  // R_LCDSTATUS     0x7
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read -
+//
+uint32_t CLCDCtrl::Read(uint32_t addr)
+{
+  uint32_t data;
+
+  if (addr == 0x00000000)
+    data = m_regs[R_LCDVER];
+  else if (addr == 0x00000004)
+    data = m_regs[R_LCDRESOLUTION];
+  else if (addr == 0x00000008)
+    data = m_regs[R_LCDCOLORDEPTH];
+  else if (addr == 0x0000000C)
+    data = m_regs[R_LCDSTARTADDR];
+  else if (addr == 0x00000010)
+    data = m_regs[R_LCDCONTROL];
+  else if (addr == 0x00000014)
+    data = m_regs[R_LCDPALINDEX];
+  else if (addr == 0x00000018)
+    data = m_pals[m_regs[R_LCDPALINDEX]];
+  else if (addr == 0x0000001C)
+  {
+    data = m_regs[R_LCDSTATUS];
+    m_regs[R_LCDSTATUS] &= ~LCDSTATUS_VSYNC;
+    m_nDeadline = *m_pClock + 1;
+  }
+  else
+    data = 0;
+
+  return data;
 }
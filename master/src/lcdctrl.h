@@ -1,53 +1,86 @@
 /*****************************************************************************
- * 
+ *
  * Copyright (C) 2001 C Hanish Menon [www.hanishkvc.com]
- * 
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
  * (at your option) any later version.
- * 
+ *
  * This program is distributed in the hope that it will be useful,
  * but WITHOUT ANY WARRANTY; without even the implied warranty of
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * GNU General Public License for more details.
- * 
+ *
  * You should have received a copy of the GNU General Public License
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
- * 
+ *
  * Name   : lcdctrl.h
  * Author : C Hanish Menon [www.hanishkvc.com]
- * 
+ *
+ * Every LCDCTRL_FRAMECYCLES cycles (vsync) the framebuffer at
+ * R_LCDSTARTADDR is scanned out, if there is somewhere to send it. The
+ * resolution register is (width << 16) | height, and the colour depth is
+ * the bits per pixel:
+ *
+ *   1, 2, 4, 8  palette indices, first pixel in the lowest bits
+ *   16          RGB 5:6:5
+ *   24          packed B, G, R bytes
+ *   32          0x00RRGGBB words
+ *
+ * Scan out turns the frame into 24 bit RGB on the simulation thread (a
+ * table lookup per byte) and hands it to a writer thread, which writes
+ * it as a PPM per frame or onto a raw RGB stream. If the writer hasn't
+ * finished with the last frames the new one is dropped rather than wait.
+ *
  ****************************************************************************/
 
 #ifndef __LCDCTRL_H__
 #define __LCDCTRL_H__
 
+#include <stdio.h>
+#include <pthread.h>
+#include "swarm.h"
+#include "device.h"
+
+#define LCDCTRL_SIZE 0x100000
 #define LCDCTRL_NUMREGS 8
 #define LCDCTRL_NUMPALS 256
-#define LCDCTRL_SCREENFILE "/tmp/swarm_screen"
-#define LCDCTRL_UPDATEINTERVAL 25
+#define LCDCTRL_FRAMECYCLES 1000000
+#define LCDCTRL_NUMFRAMES 2   // Frames that can be waiting to be written
+#define LCDCTRL_MAXWIDTH 4096
+#define LCDCTRL_MAXHEIGHT 4096
 
 #define R_LCDVER        0x0
 #define R_LCDRESOLUTION 0x1
 #define R_LCDCOLORDEPTH 0x2
 #define R_LCDSTARTADDR  0x3
-#define R_LCDRESERVED1  0x4
+#define R_LCDCONTROL    0x4
 #define R_LCDPALINDEX   0x5
 #define R_LCDPALDATA    0x6
 #define R_LCDSTATUS     0x7
 
-typedef struct LCDCTRLBTAG
+#define LCDCONTROL_VSYNC_INT 0x1   // Interrupt on vsync
+#define LCDSTATUS_VSYNC      0x1   // Vsync since status was last read
+
+typedef struct LCDFRAMETAG
 {
-  uint32_t addr: 32;      // IN - address, 0 to 5
-  uint32_t data: 32;      // IN/OUT - 32 bits of data
-  uint32_t interrupt: 1;  // OUT - has an interrupt happened?
-  uint32_t r:1;           // IN - is a read happening?
-  uint32_t w:1;           // IN - is a write happening?
-} LCDCTRLBUS;
+  uint32_t nWidth;
+  uint32_t nHeight;
+  uint32_t nFrame;
+  uint32_t nSize;    // Bytes allocated for pRGB
+  uint8_t* pRGB;
+  struct LCDFRAMETAG* pNext;
+} LCDFRAME;
 
-class CLCDCtrl
+class CLCDException : public CException
+{
+ public:
+  CLCDException(const char* strError);
+};
+
+class CLCDCtrl : public CDevice
 {
   // Constuctors and destructor
  public:
@@ -55,15 +88,47 @@ class CLCDCtrl
   ~CLCDCtrl();
 
  public:
-  void Cycle(LCDCTRLBUS* bus);
-  void Reset();
+  uint32_t Cycle();
+  uint32_t Read(uint32_t addr);
+  void     Write(uint32_t addr, uint32_t data);
+  void     Reset();
+  uint32_t GetSize() { return LCDCTRL_SIZE; }
+
+  // strOutput is "ppm:pattern" (pattern has a %d for the frame number)
+  // or "raw:file". Throws a CLCDException if it can't be used.
+  void SetOutput(const char* strOutput, uint32_t nFrameCycles);
 
  private:
   uint32_t m_regs[LCDCTRL_NUMREGS];
   uint32_t m_pals[LCDCTRL_NUMPALS];
-  FILE *fScreen;
+  uint64_t m_nVSync;       // The cycle the next vsync is due on
+  uint32_t m_nFrameCycles;
+
+  // The pixels in each byte for depths of 8 or under, rebuilt when the
+  // palette or depth changes
+  uint32_t m_byteLUT[256][8];
+  bool_t m_bLUTDirty;
+
+  // Output, on the writer thread
+  char* m_strPattern;
+  FILE* m_fpRaw;
+  bool_t m_bStop;
+  pthread_t m_thread;
+  pthread_mutex_t m_lock;
+  pthread_cond_t m_cond;
+  LCDFRAME m_frames[LCDCTRL_NUMFRAMES];
+  LCDFRAME* m_pFree;
+  LCDFRAME* m_pQueue;
+  LCDFRAME* m_pQueueTail;
+  uint32_t m_nFrames;
+  uint32_t m_nDropped;
 
-  void UpdateScreen();
+  void VSync();
+  void BuildLUT(uint32_t nDepth);
+  bool_t ScanOut(LCDFRAME* pFrame);
+  void WriteFrame(LCDFRAME* pFrame);
+  void Writer();
+  static void* WriterEntry(void* arg);
 };
 
 #endif // __LCDCTRL_H__
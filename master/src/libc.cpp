@@ -34,8 +34,14 @@
 #include <iostream.h>
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 
 #include "swi.h"
+#include "libc.h"
+#include "vfs.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // The gnuarm struct stat is in a different format to ours, so we need to 
@@ -88,20 +94,111 @@ struct arm_stat
 
 
 
+#ifdef __BIG_ENDIAN__
+#define ENDIAN_CORRECT(_x) ((_x << 24) | ((_x << 8) & 0xFF0000) | ((_x >> 8) & 0xFF00) | (_x >> 24))
+#else
+#define ENDIAN_CORRECT(_x) _x
+#endif
+
 extern char* pMemory;
 
+static uint32_t s_nMemSize;
+static uint32_t s_arenaBase;      // Where mmap hands out memory from...
+static uint32_t s_arenaNext;      // ...top down, having got this far...
+static uint32_t s_arenaTop;       // ...from here
+static int      s_nErrno;         // Set by the last call that failed
+static CVFS*    s_pVFS = NULL;    // In memory files, if we have any
+
+#define ARENA_PAGE   4096
+#define LIBC_MAXIOV  64
+
+
+///////////////////////////////////////////////////////////////////////////////
+// guest_ptr - Turns a guest buffer into a pointer we can hand to the host,
+//             or NULL if it doesn't all lie within memory.
+//
+static inline void* guest_ptr(uint32_t addr, uint32_t nBytes)
+{
+  if ((nBytes > s_nMemSize) || (addr > s_nMemSize - nBytes))
+    return NULL;
+
+  return (void*)(pMemory + addr);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// guest_str - As guest_ptr, for a string that must end within memory.
+//
+static inline char* guest_str(uint32_t addr)
+{
+  if ((addr >= s_nMemSize) ||
+      (memchr(pMemory + addr, 0, s_nMemSize - addr) == NULL))
+    return NULL;
+
+  return pMemory + addr;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// result - Notes errno if a call failed, and passes the result back.
+//
+static inline uint32_t result(int rv)
+{
+  if (rv == -1)
+    s_nErrno = errno;
+
+  return rv;
+}
+
+#define FAULT() (s_nErrno = EFAULT, (uint32_t)-1)
+
+
+///////////////////////////////////////////////////////////////////////////////
+// libc_init - Tells us how big memory is, and the part of it we can give
+//             out to mmap.
+//
+void libc_init(uint32_t nMemSize, uint32_t arenaBase, uint32_t arenaTop)
+{
+  s_nMemSize = nMemSize;
+  s_arenaBase = (arenaBase + ARENA_PAGE - 1) & ~(ARENA_PAGE - 1);
+  s_arenaTop = arenaTop & ~(ARENA_PAGE - 1);
+  s_arenaNext = s_arenaTop;
+  s_nErrno = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// libc_vfs - Files are looked for in pVFS before going to the host.
+//
+void libc_vfs(CVFS* pVFS)
+{
+  s_pVFS = pVFS;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// vfs_fd - Whether fd is one of the VFS's rather than the host's.
+//
+static inline bool_t vfs_fd(int fd)
+{
+  return (s_pVFS != NULL) && s_pVFS->IsOurs(fd);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // ssize_t write(int fd, const void *buf, size_t count)
 //
 uint32_t swi_libc_write(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
   int fd = r0;
-  void* data = (void*)(pMemory + r1);
+  void* data = guest_ptr(r1, r2);
   int count = r2;
-  
-  int rv = write(fd, data, count);
 
-  return rv;
+  if (data == NULL)
+    return FAULT();
+  if (vfs_fd(fd))
+    return result(s_pVFS->Write(fd, data, count));
+
+  return result(write(fd, data, count));
 }
 
 
@@ -111,12 +208,15 @@ uint32_t swi_libc_write(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 uint32_t swi_libc_read(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
   int fd = r0;
-  void* data = (void*)(pMemory + r1);
+  void* data = guest_ptr(r1, r2);
   int count = r2;
 
-  int rv = read(fd, data, count);  
+  if (data == NULL)
+    return FAULT();
+  if (vfs_fd(fd))
+    return result(s_pVFS->Read(fd, data, count));
 
-  return rv;
+  return result(read(fd, data, count));
 }
 
 
@@ -125,16 +225,21 @@ uint32_t swi_libc_read(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 //
 uint32_t swi_libc_open(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
-  char* pathname = (char*)(pMemory + r0);
+  char* pathname = guest_str(r0);
   int flags = r1;
   int mode = r2;
 
-  int rv =  open(pathname, flags, 0);//mode);
+  if (pathname == NULL)
+    return FAULT();
+
+  int rv = (s_pVFS != NULL) ? s_pVFS->Open(pathname, flags, mode) : VFS_NOTOURS;
+  if (rv == VFS_NOTOURS)
+    rv = open(pathname, flags, mode);
 
   if (rv == -1)
     cerr << "Error: " << strerror(errno) << "\n";
 
-  return rv;
+  return result(rv);
 }
 
 
@@ -143,12 +248,19 @@ uint32_t swi_libc_open(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 //
 uint32_t swi_libc_creat(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
-  char* pathname = (char*)(pMemory + r0);
+  char* pathname = guest_str(r0);
   int mode = r1;
 
-  int rv = creat(pathname, mode);
+  if (pathname == NULL)
+    return FAULT();
 
-  return rv;
+  int rv = VFS_NOTOURS;
+  if (s_pVFS != NULL)
+    rv = s_pVFS->Open(pathname, O_WRONLY | O_CREAT | O_TRUNC, mode);
+  if (rv == VFS_NOTOURS)
+    rv = creat(pathname, mode);
+
+  return result(rv);
 }
 
 
@@ -159,7 +271,10 @@ uint32_t swi_libc_close(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
   int fd = r0;
 
-  return close(fd);
+  if (vfs_fd(fd))
+    return result(s_pVFS->Close(fd));
+
+  return result(close(fd));
 }
 
 
@@ -171,13 +286,24 @@ uint32_t swi_libc_fcntl(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
   int fd = r0;
   int cmd = r1;
   long arg = r2;
+
+  // All we know about our own files is how they were opened
+  if (vfs_fd(fd))
+    {
+      if (cmd != F_GETFL)
+	{
+	  s_nErrno = EINVAL;
+	  return (uint32_t)-1;
+	}
+      return result(s_pVFS->GetFlags(fd));
+    }
   
-  return fcntl(fd, cmd, arg);
+  return result(fcntl(fd, cmd, arg));
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// int fcntl(int fd, int cmd, long arg)
+// off_t lseek(int fd, off_t offset, int whence)
 //
 uint32_t swi_libc_lseek(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
@@ -185,7 +311,10 @@ uint32_t swi_libc_lseek(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
   int offset = r1;
   long whence = r2;
 
-  return lseek(fd, offset, whence);
+  if (vfs_fd(fd))
+    return result(s_pVFS->Seek(fd, offset, whence));
+
+  return result(lseek(fd, offset, whence));
 }
 
 
@@ -194,15 +323,21 @@ uint32_t swi_libc_lseek(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 //
 uint32_t swi_libc_stat(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
-  char* file_name = (char*)(pMemory + r0);
-  struct arm_stat* buf = (struct arm_stat*)(pMemory + r1);
+  char* file_name = guest_str(r0);
+  struct arm_stat* buf =
+    (struct arm_stat*)guest_ptr(r1, sizeof(struct arm_stat));
   struct stat my_stat;
-  
-  int rv = stat(file_name, &my_stat);
+
+  if ((file_name == NULL) || (buf == NULL))
+    return FAULT();
+
+  int rv = (s_pVFS != NULL) ? s_pVFS->Stat(file_name, &my_stat) : VFS_NOTOURS;
+  if (rv == VFS_NOTOURS)
+    rv = stat(file_name, &my_stat);
 
   COPY_STAT(&my_stat, buf);
 
-  return rv;
+  return result(rv);
 }
 
 
@@ -212,14 +347,22 @@ uint32_t swi_libc_stat(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 uint32_t swi_libc_fstat(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
   int filedes = r0;
-  struct arm_stat* buf = (struct arm_stat*)(pMemory + r1);
+  struct arm_stat* buf =
+    (struct arm_stat*)guest_ptr(r1, sizeof(struct arm_stat));
   struct stat my_stat;
-  
-  int rv = fstat(filedes, &my_stat);
+
+  if (buf == NULL)
+    return FAULT();
+
+  int rv;
+  if (vfs_fd(filedes))
+    rv = s_pVFS->FStat(filedes, &my_stat);
+  else
+    rv = fstat(filedes, &my_stat);
 
   COPY_STAT(&my_stat, buf);
 
-  return rv;
+  return result(rv);
 }
 
 
@@ -228,13 +371,298 @@ uint32_t swi_libc_fstat(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 //
 uint32_t swi_libc_lstat(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
-  char* file_name = (char*)(pMemory + r0);
-  struct arm_stat* buf = (struct arm_stat*)(pMemory + r1);
+  char* file_name = guest_str(r0);
+  struct arm_stat* buf =
+    (struct arm_stat*)guest_ptr(r1, sizeof(struct arm_stat));
   struct stat my_stat;
-  
-  int rv = lstat(file_name, &my_stat);
+
+  if ((file_name == NULL) || (buf == NULL))
+    return FAULT();
+
+  int rv = (s_pVFS != NULL) ? s_pVFS->Stat(file_name, &my_stat) : VFS_NOTOURS;
+  if (rv == VFS_NOTOURS)
+    rv = lstat(file_name, &my_stat);
 
   COPY_STAT(&my_stat, buf);
 
-  return rv;
+  return result(rv);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// int gettimeofday(struct timeval *tv, struct timezone *tz) - The host's
+// time of day. tz is ignored.
+//
+uint32_t swi_libc_gettimeofday(uint32_t r0, uint32_t r1, uint32_t r2,
+			       uint32_t r3)
+{
+  uint32_t* tv = (uint32_t*)guest_ptr(r0, 8);
+  struct timeval now;
+
+  if (tv == NULL)
+    return FAULT();
+
+  int rv = gettimeofday(&now, NULL);
+
+  tv[0] = ENDIAN_CORRECT((uint32_t)now.tv_sec);
+  tv[1] = ENDIAN_CORRECT((uint32_t)now.tv_usec);
+
+  return result(rv);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// clock_t clock(void) - The host processor time we've used, in
+// microseconds.
+//
+uint32_t swi_libc_clock(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  clock_t t = clock();
+
+  if (t == (clock_t)-1)
+    return result(-1);
+
+  return (uint32_t)(((uint64_t)t * 1000000) / CLOCKS_PER_SEC);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// void* mmap(void *start, size_t length, ...) - Only anonymous memory. It
+// comes zeroed, in whole pages, top down from the arena main gave us.
+//
+uint32_t swi_libc_mmap(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  uint32_t nBytes = (r1 + ARENA_PAGE - 1) & ~(ARENA_PAGE - 1);
+
+  if ((r1 == 0) || (nBytes < r1) ||
+      (nBytes > s_arenaNext - s_arenaBase))
+    {
+      s_nErrno = ENOMEM;
+      return (uint32_t)-1;
+    }
+
+  s_arenaNext -= nBytes;
+  memset(pMemory + s_arenaNext, 0, nBytes);
+
+  return s_arenaNext;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// int munmap(void *start, size_t length) - Memory only goes back to the
+// arena if it was the last given out.
+//
+uint32_t swi_libc_munmap(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  uint32_t nBytes = (r1 + ARENA_PAGE - 1) & ~(ARENA_PAGE - 1);
+
+  if (((r0 & (ARENA_PAGE - 1)) != 0) || (r0 < s_arenaNext) ||
+      (r0 >= s_arenaTop) || (nBytes < r1))
+    {
+      s_nErrno = EINVAL;
+      return (uint32_t)-1;
+    }
+
+  if (r0 == s_arenaNext)
+    s_arenaNext = (nBytes > s_arenaTop - r0) ? s_arenaTop : r0 + nBytes;
+
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// iovecs - Turns a guest iovec array into one for the host. Returns FALSE if
+//          any of it is outside memory.
+//
+static bool_t iovecs(uint32_t addr, uint32_t nCount, struct iovec* pIov)
+{
+  uint32_t* pGuest = (uint32_t*)guest_ptr(addr, nCount * 8);
+
+  if (pGuest == NULL)
+    return FALSE;
+
+  for (uint32_t i = 0; i < nCount; i++)
+    {
+      uint32_t base = ENDIAN_CORRECT(pGuest[i * 2]);
+      uint32_t len = ENDIAN_CORRECT(pGuest[(i * 2) + 1]);
+
+      pIov[i].iov_base = guest_ptr(base, len);
+      pIov[i].iov_len = len;
+      if (pIov[i].iov_base == NULL)
+	return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// vfs_iov - readv and writev for the VFS's files, a buffer at a time.
+//
+static uint32_t vfs_iov(int fd, struct iovec* pIov, uint32_t nCount,
+			bool_t bWrite)
+{
+  uint32_t nTotal = 0;
+
+  for (uint32_t i = 0; i < nCount; i++)
+    {
+      int n;
+
+      if (bWrite)
+	n = s_pVFS->Write(fd, pIov[i].iov_base, pIov[i].iov_len);
+      else
+	n = s_pVFS->Read(fd, pIov[i].iov_base, pIov[i].iov_len);
+
+      if (n == -1)
+	return (nTotal == 0) ? result(-1) : nTotal;
+      nTotal += n;
+      if ((uint32_t)n < pIov[i].iov_len)
+	break;
+    }
+
+  return nTotal;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ssize_t readv(int fd, const struct iovec *vector, int count)
+//
+uint32_t swi_libc_readv(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  struct iovec iov[LIBC_MAXIOV];
+
+  if (r2 > LIBC_MAXIOV)
+    {
+      s_nErrno = EINVAL;
+      return (uint32_t)-1;
+    }
+  if (!iovecs(r1, r2, iov))
+    return FAULT();
+  if (vfs_fd(r0))
+    return vfs_iov(r0, iov, r2, FALSE);
+
+  return result(readv(r0, iov, r2));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ssize_t writev(int fd, const struct iovec *vector, int count)
+//
+uint32_t swi_libc_writev(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  struct iovec iov[LIBC_MAXIOV];
+
+  if (r2 > LIBC_MAXIOV)
+    {
+      s_nErrno = EINVAL;
+      return (uint32_t)-1;
+    }
+  if (!iovecs(r1, r2, iov))
+    return FAULT();
+  if (vfs_fd(r0))
+    return vfs_iov(r0, iov, r2, TRUE);
+
+  return result(writev(r0, iov, r2));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// int unlink(const char *pathname)
+//
+uint32_t swi_libc_unlink(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  char* pathname = guest_str(r0);
+
+  if (pathname == NULL)
+    return FAULT();
+
+  int rv = (s_pVFS != NULL) ? s_pVFS->Unlink(pathname) : VFS_NOTOURS;
+  if (rv == VFS_NOTOURS)
+    rv = unlink(pathname);
+
+  return result(rv);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// int rename(const char *oldpath, const char *newpath)
+//
+uint32_t swi_libc_rename(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  char* oldpath = guest_str(r0);
+  char* newpath = guest_str(r1);
+
+  if ((oldpath == NULL) || (newpath == NULL))
+    return FAULT();
+
+  int rv = (s_pVFS != NULL) ? s_pVFS->Rename(oldpath, newpath) : VFS_NOTOURS;
+  if (rv == VFS_NOTOURS)
+    rv = rename(oldpath, newpath);
+
+  return result(rv);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// int getenv_r(const char *name, char *buf, size_t len) - Copies a host
+// environment variable into buf, as we can't give out pointers to ours.
+//
+uint32_t swi_libc_getenv(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  char* name = guest_str(r0);
+  char* buf = (char*)guest_ptr(r1, r2);
+
+  if ((name == NULL) || (buf == NULL))
+    return FAULT();
+
+  char* value = getenv(name);
+  if (value == NULL)
+    {
+      s_nErrno = ENOENT;
+      return (uint32_t)-1;
+    }
+  if (strlen(value) >= r2)
+    {
+      s_nErrno = ERANGE;
+      return (uint32_t)-1;
+    }
+
+  strcpy(buf, value);
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// void _exit(int status) - Ends the simulation as SWI_EXIT does, but with
+// the program's exit status.
+//
+uint32_t swi_libc_exit(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  swarm_exit(r0);
+
+  return r0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// int errno(void) - The host errno from the last call that failed.
+//
+uint32_t swi_libc_errno(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  return s_nErrno;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// int fsync(int fd) - Writes one of the VFS's files back to the host now,
+// rather than at exit.
+//
+uint32_t swi_libc_fsync(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  int fd = r0;
+
+  if (vfs_fd(fd))
+    return result(s_pVFS->Sync(fd));
+
+  return result(fsync(fd));
 }
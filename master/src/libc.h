@@ -49,5 +49,40 @@ extern SWI_CALL swi_libc_fstat;
 #define SWI_LIBC_FSTAT   SWI_CALL_MASK | SWI_LIBC_MASK | 9
 extern SWI_CALL swi_libc_lstat;
 #define SWI_LIBC_LSTAT   SWI_CALL_MASK | SWI_LIBC_MASK | 10
+extern SWI_CALL swi_libc_gettimeofday;
+#define SWI_LIBC_GETTIMEOFDAY SWI_CALL_MASK | SWI_LIBC_MASK | 16
+extern SWI_CALL swi_libc_clock;
+#define SWI_LIBC_CLOCK   SWI_CALL_MASK | SWI_LIBC_MASK | 17
+extern SWI_CALL swi_libc_mmap;
+#define SWI_LIBC_MMAP    SWI_CALL_MASK | SWI_LIBC_MASK | 18
+extern SWI_CALL swi_libc_munmap;
+#define SWI_LIBC_MUNMAP  SWI_CALL_MASK | SWI_LIBC_MASK | 19
+extern SWI_CALL swi_libc_readv;
+#define SWI_LIBC_READV   SWI_CALL_MASK | SWI_LIBC_MASK | 20
+extern SWI_CALL swi_libc_writev;
+#define SWI_LIBC_WRITEV  SWI_CALL_MASK | SWI_LIBC_MASK | 21
+extern SWI_CALL swi_libc_unlink;
+#define SWI_LIBC_UNLINK  SWI_CALL_MASK | SWI_LIBC_MASK | 22
+extern SWI_CALL swi_libc_rename;
+#define SWI_LIBC_RENAME  SWI_CALL_MASK | SWI_LIBC_MASK | 23
+extern SWI_CALL swi_libc_getenv;
+#define SWI_LIBC_GETENV  SWI_CALL_MASK | SWI_LIBC_MASK | 24
+extern SWI_CALL swi_libc_exit;
+#define SWI_LIBC_EXIT    SWI_CALL_MASK | SWI_LIBC_MASK | 25
+extern SWI_CALL swi_libc_errno;
+#define SWI_LIBC_ERRNO   SWI_CALL_MASK | SWI_LIBC_MASK | 26
+extern SWI_CALL swi_libc_fsync;
+#define SWI_LIBC_FSYNC   SWI_CALL_MASK | SWI_LIBC_MASK | 27
+
+// Guest pointers are checked against nMemSize before we use them, and mmap
+// gives out memory between arenaBase and arenaTop.
+void libc_init(uint32_t nMemSize, uint32_t arenaBase, uint32_t arenaTop);
+
+// Files are looked for in pVFS before the host, if it isn't NULL
+class CVFS;
+void libc_vfs(CVFS* pVFS);
+
+// Provided by main, to end the simulation with an exit status
+void swarm_exit(int nCode);
 
 #endif //__LIBC_H__
@@ -34,29 +34,76 @@
 #endif
 #include "cache.h"
 #include "direct.h"
+#include "trace.h"
+#include "elfimage.h"
+#include "heximage.h"
 #include <iostream.h>
 #include <sys/stat.h>
+#include <signal.h>
 #include "libc.h"
+#include "vfs.h"
 #include "syscopro.h"
+#include "stats.h"
+#include "perfmon.h"
+#include "cosim.h"
+#include "gdbstub.h"
 
 #define FAST_CYCLE 1
 #define SLOW_CYCLE 4
 
 #define MEMORY_SIZE (1024 * 1024 * 12)
+#define ARGS_SIZE   2048               // At the very top of memory
+#define ARENA_SIZE  (1024 * 1024 * 3)  // For mmap, just below the args and
+                                       // clear of crt0's heap
 #define DEFAULT_CACHESIZE  1024 * 8
+#define DEFAULT_L2SIZE     1024 * 64
+#define DEFAULT_L2LATENCY  4
 
 #define SWI_EXIT 0x00800000
 #define SWI_DUMP 0x0080000F
+#define SWI_STATS 0x0080000D
 #define SWI_ARGS 0x0080000E
 
 CArmProc* pArm;
 char* pMemory;
+CTraceWriter* pTrace = NULL;
+CElfImage* pElf = NULL;
+CVFS* pVFS = NULL;
+CPerfMonitor* pPerf = NULL;
+CCoSim* pCoSim = NULL;
+CGdbStub* pGdb = NULL;
+char* strStatsExport = NULL;
+volatile sig_atomic_t bStatsWanted = 0;
 
 typedef struct OTAG
 {
   char* strProgName;
   char* strSrecProgName;
-  uint32_t nCacheSize;
+  CACHECONFIG cache;   // Used unless bSplitCache is set
+  CACHECONFIG icache;
+  CACHECONFIG dcache;
+  bool_t bSplitCache;
+  CACHECONFIG l2cache;
+  bool_t bL2Cache;
+  uint32_t nL2Latency;
+  char* strDramTiming;
+  char* strTraceFile;
+  char* strStatsFile;
+  char* strSnapshotFile;
+  char* strUART;
+  char* strBlock;
+  char* strNet;
+  uint32_t nThrottleKHz;
+  char* strLCD;
+  uint32_t nFrameCycles;
+  char* strDeviceMap;
+  char* strPreload;
+  bool_t bMemWrites;
+  char* strStatsExport;
+  bool_t bPerf;
+  uint32_t nPerfInterval;
+  uint32_t nCheckInterval;   // 0 if we're not checking the core
+  char* strGdb;
 } OPTS;
 
 #ifdef __BIG_ENDIAN__
@@ -68,12 +115,55 @@ typedef struct OTAG
 #endif
 
 
+///////////////////////////////////////////////////////////////////////////////
+// write_stats - Writes every registered counter to the file given with -o,
+//               if there was one. Returns FALSE if it couldn't be written.
+//
+bool_t write_stats()
+{
+  if (strStatsExport == NULL)
+    return TRUE;
+
+  pArm->SyncCoPros();
+  if (!CStats::Write(strStatsExport))
+    {
+      cerr << "Failed to write stats to " << strStatsExport << "\n";
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// stats_signal - SIGUSR1 asks for the stats. They are written from the main
+//                loop, as it isn't safe to do it here.
+//
+void stats_signal(int nSignal)
+{
+  bStatsWanted = 1;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // SWI_EXIT_FN - This is used to halt the simulation and display the cycle
 //               counts. It also saves the contents on the memory to a file
 //               called "/tmp/mem".
 //
 uint32_t SWI_EXIT_FN(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  // Older programs don't set r0, so this always succeeds
+  swarm_exit(EXIT_SUCCESS);
+
+  return r0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// swarm_exit - Does the work for SWI_EXIT_FN, with the status to give the
+//              shell.
+//
+void swarm_exit(int nCode)
 {
   ASSERT(pArm != NULL);
 
@@ -82,6 +172,22 @@ uint32_t SWI_EXIT_FN(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
   t2 = pArm->GetLogicalCycles();
   
   cout << "Cycle info: real = " << t1 << " logical = " << t2 << "\n";
+  write_stats();
+  if (pPerf != NULL)
+    {
+      pPerf->Summary();
+      delete pPerf;
+    }
+  if (pCoSim != NULL)
+    {
+      pCoSim->Summary();
+      delete pCoSim;
+    }
+  if (pGdb != NULL)
+    {
+      pGdb->Exited(nCode);
+      delete pGdb;
+    }
 
 #ifndef arm32  
   int fd = open("/tmp/mem", O_CREAT | O_RDWR, 0644);
@@ -91,10 +197,14 @@ uint32_t SWI_EXIT_FN(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 
   delete pMemory;
   delete pArm;
+  if (pTrace != NULL)
+    delete pTrace;
+  if (pElf != NULL)
+    delete pElf;
+  if (pVFS != NULL)
+    delete pVFS;
 
-  exit(EXIT_SUCCESS);
-
-  return r0;
+  exit(nCode);
 }
 
 
@@ -114,11 +224,35 @@ uint32_t SWI_DUMP_FN(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 //
 uint32_t SWI_ARGS_FN(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
 {
-  return (MEMORY_SIZE - 2048);
+  return (MEMORY_SIZE - ARGS_SIZE);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// int stats() - Writes the stats file now. Returns 0, or -1 if it couldn't.
+//
+uint32_t SWI_STATS_FN(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3)
+{
+  return write_stats() ? 0 : (uint32_t)-1;
 }
 
 
-enum PARAMS  {P_NONE, P_CACHE, P_SRECFILE, P_BAD};
+enum PARAMS  {P_NONE, P_CACHE, P_ICACHE, P_DCACHE, P_L2CACHE, P_L2LATENCY,
+	      P_DRAM, P_SRECFILE, P_TRACE, P_STATS, P_SNAPSHOT,
+	      P_UART, P_BLOCK, P_NET, P_THROTTLE, P_LCD, P_FRAMECYCLES, P_DEVMAP,
+	      P_PRELOAD, P_STATSEXPORT, P_PERF, P_COSIM, P_GDB, P_BAD};
+
+#define USAGE "Usage: swarm program-bin|program-elf -s program-srec|hex [-c cache] " \
+              "[-i icache -d dcache] [-2 l2cache [-L cycles]]\n" \
+              "       [-m row:hit:miss] [-T tracefile] [-j statsfile] " \
+              "[-S snapshotfile]\n" \
+              "       [-u pty|stdio|file:out[,in]|unix:path] [-b image]\n" \
+              "       [-n unix:path,peer|fd:n] [-t mhz]\n" \
+              "       [-l ppm:pattern|raw:file [-F cycles]] [-M devicemap]\n" \
+              "       [-p file[,file...]] [-w] [-o statsfile.json|csv]\n" \
+              "       [-P seconds] [-C instructions] [-g port|unix:path]\n" \
+              "       [params]\n" \
+              "       cache specs are size[:line[:ways[:rr|random]]]\n"
 
 void parse_options(int argc, char* argv[], OPTS* opts)
 {
@@ -128,14 +262,39 @@ void parse_options(int argc, char* argv[], OPTS* opts)
   // First check the args
   if (argc < 2)
     {
-      cerr << "Usage: swarm program-bin -s program-srec [params]\n";
+      cerr << USAGE;
       exit (EXIT_FAILURE);
     }
 
   // Defaults
-  opts->nCacheSize = DEFAULT_CACHESIZE;
+  InitCacheConfig(&opts->cache, DEFAULT_CACHESIZE);
+  InitCacheConfig(&opts->icache, DEFAULT_CACHESIZE / 2);
+  InitCacheConfig(&opts->dcache, DEFAULT_CACHESIZE / 2);
+  opts->bSplitCache = FALSE;
+  InitCacheConfig(&opts->l2cache, DEFAULT_L2SIZE);
+  opts->l2cache.nLineSize = 32;
+  opts->bL2Cache = FALSE;
+  opts->nL2Latency = DEFAULT_L2LATENCY;
+  opts->strDramTiming = NULL;
   opts->strProgName = NULL;
   opts->strSrecProgName = NULL;
+  opts->strTraceFile = NULL;
+  opts->strStatsFile = NULL;
+  opts->strSnapshotFile = NULL;
+  opts->strUART = NULL;
+  opts->strBlock = NULL;
+  opts->strNet = NULL;
+  opts->nThrottleKHz = 0;
+  opts->strLCD = NULL;
+  opts->nFrameCycles = LCDCTRL_FRAMECYCLES;
+  opts->strDeviceMap = NULL;
+  opts->strPreload = NULL;
+  opts->bMemWrites = FALSE;
+  opts->strStatsExport = NULL;
+  opts->bPerf = FALSE;
+  opts->nPerfInterval = 0;
+  opts->nCheckInterval = 0;
+  opts->strGdb = NULL;
 
   for (int i = 1; i < argc; i++)
     {
@@ -148,11 +307,117 @@ void parse_options(int argc, char* argv[], OPTS* opts)
 		p = P_CACHE;
 	      }
 	      break;
+	    case 'i' : 
+	      {
+		p = P_ICACHE;
+	      }
+	      break;
+	    case 'd' : 
+	      {
+		p = P_DCACHE;
+	      }
+	      break;
 	    case 's' :
 	      {
 		p = P_SRECFILE;
 	      }
 	      break;
+	    case 'T' :
+	      {
+		p = P_TRACE;
+	      }
+	      break;
+	    case 'j' :
+	      {
+		p = P_STATS;
+	      }
+	      break;
+	    case 'S' :
+	      {
+		p = P_SNAPSHOT;
+	      }
+	      break;
+	    case 'u' :
+	      {
+		p = P_UART;
+	      }
+	      break;
+	    case 'b' :
+	      {
+		p = P_BLOCK;
+	      }
+	      break;
+	    case 'n' :
+	      {
+		p = P_NET;
+	      }
+	      break;
+	    case 't' :
+	      {
+		p = P_THROTTLE;
+	      }
+	      break;
+	    case 'l' :
+	      {
+		p = P_LCD;
+	      }
+	      break;
+	    case 'F' :
+	      {
+		p = P_FRAMECYCLES;
+	      }
+	      break;
+	    case 'M' :
+	      {
+		p = P_DEVMAP;
+	      }
+	      break;
+	    case 'p' :
+	      {
+		p = P_PRELOAD;
+	      }
+	      break;
+	    case 'w' :
+	      {
+		opts->bMemWrites = TRUE;
+		p = P_NONE;
+	      }
+	      break;
+	    case 'o' :
+	      {
+		p = P_STATSEXPORT;
+	      }
+	      break;
+	    case 'P' :
+	      {
+		p = P_PERF;
+	      }
+	      break;
+	    case 'C' :
+	      {
+		p = P_COSIM;
+	      }
+	      break;
+	    case 'g' :
+	      {
+		p = P_GDB;
+	      }
+	      break;
+	    case '2' :
+	      {
+		p = P_L2CACHE;
+	      }
+	      break;
+	    case 'L' :
+	      {
+		p = P_L2LATENCY;
+	      }
+	      break;
+	    case 'm' :
+	      {
+		p = P_DRAM;
+	      }
+	      break;
 	    }
 	}
       else
@@ -166,7 +431,30 @@ void parse_options(int argc, char* argv[], OPTS* opts)
 	      break;
 	    case P_CACHE:
 	      {
-		opts->nCacheSize = atoi(argv[i]);
+		opts->bSplitCache = FALSE;
+		if (!ParseCacheConfig(argv[i], &opts->cache))
+		  {
+		    cerr << "Error: Bad cache spec " << argv[i] << "\n";
+		    cerr << USAGE;
+		    exit(EXIT_FAILURE);
+		  }
+		p = P_NONE;
+	      }
+	      break;
+	    case P_ICACHE:
+	    case P_DCACHE:
+	      {
+		CACHECONFIG* pConfig = (p == P_ICACHE) ? &opts->icache :
+		  &opts->dcache;
+
+		opts->bSplitCache = TRUE;
+		if (!ParseCacheConfig(argv[i], pConfig))
+		  {
+		    cerr << "Error: Bad cache spec " << argv[i] << "\n";
+		    cerr << USAGE;
+		    exit(EXIT_FAILURE);
+		  }
+		p = P_NONE;
 	      }
 	      break;
 	    case P_SRECFILE:
@@ -174,13 +462,133 @@ void parse_options(int argc, char* argv[], OPTS* opts)
 		opts->strSrecProgName = strdup(argv[i]);      
 	      }
 	      break;
+	    case P_L2CACHE:
+	      {
+		opts->bL2Cache = TRUE;
+		if (!ParseCacheConfig(argv[i], &opts->l2cache))
+		  {
+		    cerr << "Error: Bad cache spec " << argv[i] << "\n";
+		    cerr << USAGE;
+		    exit(EXIT_FAILURE);
+		  }
+		p = P_NONE;
+	      }
+	      break;
+	    case P_L2LATENCY:
+	      {
+		opts->nL2Latency = atoi(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_DRAM:
+	      {
+		opts->strDramTiming = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_TRACE:
+	      {
+		opts->strTraceFile = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_STATS:
+	      {
+		opts->strStatsFile = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_SNAPSHOT:
+	      {
+		opts->strSnapshotFile = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_UART:
+	      {
+		opts->strUART = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_BLOCK:
+	      {
+		opts->strBlock = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_NET:
+	      {
+		opts->strNet = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_THROTTLE:
+	      {
+		opts->nThrottleKHz = (uint32_t)(atof(argv[i]) * 1000);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_LCD:
+	      {
+		opts->strLCD = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_FRAMECYCLES:
+	      {
+		opts->nFrameCycles = strtoul(argv[i], NULL, 0);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_DEVMAP:
+	      {
+		opts->strDeviceMap = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_PRELOAD:
+	      {
+		opts->strPreload = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_STATSEXPORT:
+	      {
+		opts->strStatsExport = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_PERF:
+	      {
+		opts->bPerf = TRUE;
+		opts->nPerfInterval = atoi(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
+	    case P_COSIM:
+	      {
+		opts->nCheckInterval = atoi(argv[i]);
+		if (opts->nCheckInterval == 0)
+		  {
+		    cerr << "Error: -C needs a number of instructions\n";
+		    exit(EXIT_FAILURE);
+		  }
+		p = P_NONE;
+	      }
+	      break;
+	    case P_GDB:
+	      {
+		opts->strGdb = strdup(argv[i]);
+		p = P_NONE;
+	      }
+	      break;
 	    }
 	}
     }
   if ( (opts->strProgName == NULL) && (opts->strSrecProgName == NULL) )
   {
     cerr << "Error: No program specified\n";
-    cerr << "Usage: swarm program-bin -s program-srec [params]\n";
+    cerr << USAGE;
     exit(EXIT_FAILURE);
   }
 }
@@ -230,6 +638,31 @@ bool_t marshal_args(int argc, char* argv[], char* pMemory,
   return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// load_elf_program - Puts the segments where they ask to go and starts us at
+//                    the entry point. The image is kept for its symbols.
+//
+int load_elf_program(OPTS opts)
+{
+  try
+    {
+      pElf = new CElfImage(opts.strProgName);
+      pElf->Load((uint8_t*)pMemory, MEMORY_SIZE);
+    }
+  catch (CElfException &e)
+    {
+      // There's no point trying to run half a program
+      cerr << "Error: " << e.StrError() << "\n";
+      exit(EXIT_FAILURE);
+    }
+
+  pArm->SetPC(pElf->GetEntry());
+  printf("Note: Uploaded Program-ELF %s with entry point %x and %d symbols\n",
+	 opts.strProgName, pElf->GetEntry(), pElf->GetNumSymbols());
+  return EXIT_SUCCESS;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //
@@ -244,6 +677,9 @@ int load_program(OPTS opts)
       return EXIT_FAILURE;
     }
 
+  if (CElfImage::IsElf(opts.strProgName))
+    return load_elf_program(opts);
+
   fd = open(opts.strProgName, O_RDONLY);
   if (fd == -1)
     {
@@ -260,102 +696,36 @@ int load_program(OPTS opts)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-//
-//
-long hexstringtonumber(char *str, int start, int len)
-{
-	long iValue;
-	char sValue[256];
-	int iCur;
-
-	for(iCur = 0; iCur < len; iCur++)
-	{
-		sValue[iCur] = str[start+iCur];			
-	}
-	sValue[len] = '\0';
-	iValue = strtol(sValue,NULL,16);
-	//printf("String: %s Value: %d\n", sValue, iValue);
-	return iValue;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-//
-//  s-record loader, supports only 32bit addresses and transfer:
-//  S3   Data record with 32 bit load address                            
-//  S7   Termination record with 32 bit transfer address
-//
-//  Stnnaaaaaaaa[dddd...dddd]cc
-//   t record type field (0,1,2,3,6,7,8,9).          
-//   nn record length field, number of bytes in record excluding record type 
-//     and record length. 
-//   a...a load address field, can be 16, 24 or 32 bit address for data to 
-//     be loaded. 
-//   d...d data field, actual data to load, each byte is encoded in 2 
-//     characters. 
-//   cc checksum field, 1's complement of the sum of all bytes in the record
-//     length, load address and data fields 
-//
+// load_srec_program - Loads S-records or Intel HEX (see heximage.h). If
+//                     there is a start address we begin there.
 //
 int load_srec_program(OPTS opts)
 {
-  FILE *fd;
-  char str[4096];
-  int CountBytes, iCur, iValue;
-  unsigned long Address, MinAddress, MaxAddress;
-  
+  CHexImage* pHex;
+
   if (opts.strSrecProgName == NULL)
     {
       cerr << "Note: No Program-SRec to Upload\n";
       return EXIT_SUCCESS;
     }
-  MinAddress = 0xffffffff;
-  MaxAddress = 0;
 
-  fd = fopen(opts.strSrecProgName, "r");
-  if (fd == NULL)
-  {
-    cerr << "Error: Uploading Program-SRec:" << opts.strSrecProgName << "\n";
-    return EXIT_FAILURE;
-  }
-  
-  while(fgets(str,4096,fd) != NULL)
+  try
     {
-      if(str[0] != 'S')
-	{
-	  fprintf(stderr,"Error: Not a SRec line\n");
-	  continue;
-	}
-      switch(str[1])
-	{
-	case '2':
-	  CountBytes =	hexstringtonumber(str,2,2);
-	  Address = hexstringtonumber(str,4,6);
-	  if(MinAddress > Address) MinAddress = Address;
-	  if(MaxAddress < Address) MaxAddress = Address;
-	  for(iCur = 10; iCur < (CountBytes-4)*2+10; iCur+=2)
-	    {
-	      iValue = hexstringtonumber(str,iCur,2);
-	      pMemory[Address++]	=	iValue;
-	      //printf("Just read: %x is %x\n", pMemory[Address-1], iValue);
-	    }
-	  break;
-	case '3':
-	  CountBytes =	hexstringtonumber(str,2,2);
-	  Address = hexstringtonumber(str,4,8);
-	  for(iCur = 12; iCur < (CountBytes-5)*2+12; iCur+=2)
-	    {
-	      iValue = hexstringtonumber(str,iCur,2);
-	      pMemory[Address++]	=	iValue;
-	      //printf("Just read: %x is %x\n", pMemory[Address-1], iValue);
-	    }
-	  break;
-	case '7':
-	  break;
-	}
+      pHex = new CHexImage(opts.strSrecProgName);
+      pHex->Load((uint8_t*)pMemory, MEMORY_SIZE);
     }
-  fclose(fd);
+  catch (CHexException &e)
+    {
+      cerr << "Error: " << e.StrError() << "\n";
+      exit(EXIT_FAILURE);
+    }
+
+  if (pHex->HasEntry())
+    pArm->SetPC(pHex->GetEntry());
   printf("Note: Uploaded Program-SRec %s between addresses[hex]: %x to %x \n", 
-	 opts.strSrecProgName, MinAddress, MaxAddress);
+	 opts.strSrecProgName, pHex->GetLowest(), pHex->GetHighest());
+  delete pHex;
+
   return EXIT_SUCCESS;
 }
 
@@ -368,20 +738,144 @@ int main(int argc, char* argv[])
   PINOUT pinout;
   int i = 0;
 
-#ifdef DEBUGGER
-  int DebuggerRepeatCount = 0;
-  unsigned int DebuggerPrevPC=999, DebuggerBreakPoint=0, DebuggerMoreRequest;
-  char DebuggerRequest[64], sDebuggerBreakPoint[64];
-#endif
-
   // Let me used mixed IO
   ios::sync_with_stdio();
 
   OPTS opts;
   parse_options(argc, argv, &opts);
 
-  pArm = new CArmProc(DEFAULT_CACHESIZE);
+  try
+    {
+      if (opts.bSplitCache)
+	pArm = new CArmProc(&opts.icache, &opts.dcache);
+      else
+	pArm = new CArmProc(&opts.cache, NULL);
+
+      if (opts.bL2Cache)
+	pArm->SetL2Cache(&opts.l2cache, opts.nL2Latency);
+    }
+  catch (CCacheConfigException &e)
+    {
+      cerr << "Cache config error: " << e.StrError() << "\n";
+      exit(EXIT_FAILURE);
+    }
+  if (opts.strDramTiming != NULL)
+    {
+      CDramTiming* pDram = ParseDramTiming(opts.strDramTiming);
+      if (pDram == NULL)
+	{
+	  cerr << "Error: Bad memory timing " << opts.strDramTiming << "\n";
+	  cerr << USAGE;
+	  exit(EXIT_FAILURE);
+	}
+      pArm->SetDramTiming(pDram);
+    }
+
+  if (opts.strStatsFile != NULL)
+    pArm->SetStatsFile(opts.strStatsFile);
+  if (opts.strStatsExport != NULL)
+    {
+      struct sigaction sa;
+
+      // Restart host calls the signal lands in, so the libc SWIs don't
+      // see EINTR
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_handler = stats_signal;
+      sa.sa_flags = SA_RESTART;
+      sigemptyset(&sa.sa_mask);
+      sigaction(SIGUSR1, &sa, NULL);
+      strStatsExport = opts.strStatsExport;
+    }
+  if (opts.strSnapshotFile != NULL)
+    pArm->SetSnapshotFile(opts.strSnapshotFile);
+
+  if (opts.strUART != NULL)
+    {
+      try
+	{
+	  pArm->SetUART(opts.strUART);
+	}
+      catch (CUARTException &e)
+	{
+	  cerr << e.StrError() << ": " << opts.strUART << "\n";
+	  cerr << USAGE;
+	  exit(EXIT_FAILURE);
+	}
+    }
+
+  if (opts.strBlock != NULL)
+    {
+      try
+	{
+	  pArm->SetBlockDevice(opts.strBlock);
+	}
+      catch (CBlockDevException &e)
+	{
+	  cerr << e.StrError() << ": " << opts.strBlock << "\n";
+	  cerr << USAGE;
+	  exit(EXIT_FAILURE);
+	}
+    }
+
+  if (opts.strNet != NULL)
+    {
+      try
+	{
+	  pArm->SetNetDevice(opts.strNet);
+	}
+      catch (CNetDevException &e)
+	{
+	  cerr << e.StrError() << ": " << opts.strNet << "\n";
+	  cerr << USAGE;
+	  exit(EXIT_FAILURE);
+	}
+    }
+
+  // After the UART, block and network devices, so they get mapped too
+  if (opts.strDeviceMap != NULL)
+    {
+      try
+	{
+	  pArm->SetDeviceMap(opts.strDeviceMap);
+	}
+      catch (CDeviceMapException &e)
+	{
+	  cerr << "Device map error: " << e.StrError() << "\n";
+	  exit(EXIT_FAILURE);
+	}
+    }
+
   pMemory = new char[MEMORY_SIZE];
+  pArm->SetMemory((uint8_t*)pMemory, MEMORY_SIZE);
+
+  if (opts.strLCD != NULL)
+    {
+      try
+	{
+	  pArm->SetLCDOutput(opts.strLCD, opts.nFrameCycles);
+	}
+      catch (CLCDException &e)
+	{
+	  cerr << e.StrError() << ": " << opts.strLCD << "\n";
+	  cerr << USAGE;
+	  exit(EXIT_FAILURE);
+	}
+    }
+
+  // Record the memory accesses if asked to
+  if (opts.strTraceFile != NULL)
+    {
+      try
+	{
+	  pTrace = new CTraceWriter(opts.strTraceFile);
+	  pArm->SetTrace(pTrace);
+	}
+      catch (CTraceException &e)
+	{
+	  cerr << e.StrError() << "\n";
+	  goto exit;
+	}
+    }
 
   // Blank the memory
   memset(pMemory, 0, MEMORY_SIZE);
@@ -392,17 +886,41 @@ int main(int argc, char* argv[])
     goto exit;
 
   // In the last 2k of memory I'll shove in the arguments
-  if (!marshal_args(argc, argv, pMemory, MEMORY_SIZE - 2048, 2048))
+  if (!marshal_args(argc, argv, pMemory, MEMORY_SIZE - ARGS_SIZE, ARGS_SIZE))
     {
       cerr << "Failed to marshall arguments for test app\n";
       goto exit;
     }
 
+#ifdef LIBC_SUPPORT
+  // Files the program's libc calls will find in memory
+  if ((opts.strPreload != NULL) || opts.bMemWrites)
+    {
+      pVFS = new CVFS(opts.bMemWrites);
+      try
+	{
+	  char* strFiles = opts.strPreload;
+	  char* strFile;
+
+	  while ((strFile = strsep(&strFiles, ",")) != NULL)
+	    if (*strFile != '\0')
+	      pVFS->Preload(strFile);
+	}
+      catch (CVFSException &e)
+	{
+	  cerr << "Error: " << e.StrError() << "\n";
+	  goto exit;
+	}
+      libc_vfs(pVFS);
+    }
+#endif
+
   try
     {
       pArm->RegisterSWI(SWI_EXIT, SWI_EXIT_FN);
       pArm->RegisterSWI(SWI_DUMP, SWI_DUMP_FN);
       pArm->RegisterSWI(SWI_ARGS, SWI_ARGS_FN);
+      pArm->RegisterSWI(SWI_STATS, SWI_STATS_FN);
 #ifdef LIBC_SUPPORT
       pArm->RegisterSWI(SWI_LIBC_WRITE, swi_libc_write);
       pArm->RegisterSWI(SWI_LIBC_READ, swi_libc_read);
@@ -414,6 +932,20 @@ int main(int argc, char* argv[])
       pArm->RegisterSWI(SWI_LIBC_STAT, swi_libc_stat);
       pArm->RegisterSWI(SWI_LIBC_FSTAT, swi_libc_fstat);
       pArm->RegisterSWI(SWI_LIBC_LSTAT, swi_libc_lstat);
+      pArm->RegisterSWI(SWI_LIBC_GETTIMEOFDAY, swi_libc_gettimeofday);
+      pArm->RegisterSWI(SWI_LIBC_CLOCK, swi_libc_clock);
+      pArm->RegisterSWI(SWI_LIBC_MMAP, swi_libc_mmap);
+      pArm->RegisterSWI(SWI_LIBC_MUNMAP, swi_libc_munmap);
+      pArm->RegisterSWI(SWI_LIBC_READV, swi_libc_readv);
+      pArm->RegisterSWI(SWI_LIBC_WRITEV, swi_libc_writev);
+      pArm->RegisterSWI(SWI_LIBC_UNLINK, swi_libc_unlink);
+      pArm->RegisterSWI(SWI_LIBC_RENAME, swi_libc_rename);
+      pArm->RegisterSWI(SWI_LIBC_GETENV, swi_libc_getenv);
+      pArm->RegisterSWI(SWI_LIBC_EXIT, swi_libc_exit);
+      pArm->RegisterSWI(SWI_LIBC_ERRNO, swi_libc_errno);
+      pArm->RegisterSWI(SWI_LIBC_FSYNC, swi_libc_fsync);
+      libc_init(MEMORY_SIZE, MEMORY_SIZE - ARGS_SIZE - ARENA_SIZE,
+		MEMORY_SIZE - ARGS_SIZE);
 #endif
     }
   catch (CException &e)
@@ -423,6 +955,32 @@ int main(int argc, char* argv[])
       goto exit;
     }
 
+  // Only now, so loading doesn't count against the time we're given
+  if (opts.nThrottleKHz != 0)
+    pArm->SetThrottle(opts.nThrottleKHz);
+  if (opts.bPerf)
+    pPerf = new CPerfMonitor(pArm, opts.nPerfInterval);
+  if (opts.nCheckInterval != 0)
+    {
+      pCoSim = new CCoSim((uint8_t*)pMemory, MEMORY_SIZE, opts.nCheckInterval);
+      pCoSim->SetSymbols(pElf);
+      pArm->SetCoSim(pCoSim);
+    }
+  if (opts.strGdb != NULL)
+    {
+      try
+	{
+	  pGdb = new CGdbStub(pArm, (uint8_t*)pMemory, MEMORY_SIZE,
+			      opts.strGdb);
+	}
+      catch (CGdbException &e)
+	{
+	  cerr << "Error: " << e.StrError() << "\n";
+	  goto exit;
+	}
+      pArm->SetGdbStub(pGdb);
+    }
+
   // Setup the bus safely
   pinout.fiq = 1;
   pinout.irq = 1;  
@@ -435,73 +993,18 @@ int main(int argc, char* argv[])
        printf("cycle---->>>>\n");
       // Cycle the ARM
       pArm->Cycle(&pinout);
-#ifdef DEBUGGER
-      // Added by HanishKVC to help debug
-	if(DebuggerPrevPC != pArm->NextPC())
+      PERF_SECTION(PS_BUS);
+      if ((pCoSim != NULL) && pCoSim->HasFailed())
+	swarm_exit(EXIT_FAILURE);
+      if (bStatsWanted)
 	{
-	  DebuggerPrevPC = pArm->NextPC();
-	  if( (DebuggerPrevPC >= (DebuggerBreakPoint)) 
-			  && (DebuggerPrevPC <= (DebuggerBreakPoint+0x8)) )
-		DebuggerRepeatCount = 0;
-	  if(DebuggerRepeatCount <= 0)
-	  {
-		DebuggerRepeatCount = 1;
-		do
-		{
-			printf("\nSWARM Debugger[0x%x]>",DebuggerPrevPC);
-			cin >> DebuggerRequest;
-			DebuggerMoreRequest = 0;
-			if(DebuggerRequest[0] == 'q')
-				_exit(0);
-			else if(DebuggerRequest[0] == 'd')
-			{
-				pArm->DebugDumpCore();
-			}
-			else if(DebuggerRequest[0] == 'D')
-			{
-				pArm->DebugDump();
-				DebuggerMoreRequest = 1;
-			}
-			else if(DebuggerRequest[0] == 'c')
-				DebuggerRepeatCount = 2000000000;
-			else if(DebuggerRequest[0] == '1')
-				DebuggerRepeatCount = 10;
-			else if(DebuggerRequest[0] == '2')
-				DebuggerRepeatCount = 100;
-			else if(DebuggerRequest[0] == '3')
-				DebuggerRepeatCount = 1000;
-			else if(DebuggerRequest[0] == '4')
-				DebuggerRepeatCount = 10000;
-			else if(DebuggerRequest[0] == 'b')
-			{
-				cout << "Enter the breakpoint:";
-				cin >> sDebuggerBreakPoint;
-				DebuggerBreakPoint = strtoul(sDebuggerBreakPoint,NULL,0);
-				printf("Setting breakpoint to:0x%x\n",
-						DebuggerBreakPoint);
-				DebuggerMoreRequest = 1;
-			}
-			else if( (DebuggerRequest[0] == 'h') 
-					|| (DebuggerRequest[0] == '?') )
-			{
-				cout << "Supported commands: \n";
-				cout << " c - Continue\n";
-				cout << " d - dump processor Core status and Step 1 instr\n";
-				cout << " D - dump status of full Processor\n";
-				cout << " b - Set breakpoint\n";
-				cout << " 1 - execute 10 instructions \n";
-				cout << " 2 - execute 100 instructions \n";
-				cout << " 3 - execute 1000 instructions \n";
-				cout << " 4 - execute 10000 instructions \n";
-				cout << " h/? - Help\n";
-				cout << " q - Quit\n";
-				DebuggerMoreRequest = 1;
-			}
-		}while(DebuggerMoreRequest);
-	  }
-	  DebuggerRepeatCount--;
+	  bStatsWanted = 0;
+	  write_stats();
+	}
+      if ((pPerf != NULL) && pPerf->IsReportDue())
+	{
+	  pPerf->Report();
 	}
-#endif DEBUGGER
       // Do we need to do anything with the bus?
       if (pinout.benable == 1)
 	{
@@ -581,8 +1084,20 @@ int main(int argc, char* argv[])
   SWI_EXIT_FN(0, 0, 0, 0);
 
  exit:
+  if (pPerf != NULL)
+    delete pPerf;
+  if (pCoSim != NULL)
+    delete pCoSim;
+  if (pGdb != NULL)
+    delete pGdb;
   delete pMemory;
   delete pArm;
+  if (pTrace != NULL)
+    delete pTrace;
+  if (pElf != NULL)
+    delete pElf;
+  if (pVFS != NULL)
+    delete pVFS;
 
   return 0;
 }
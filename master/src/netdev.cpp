@@ -0,0 +1,511 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   netdev.cpp
+// header netdev.h
+// info   Implements the network device.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include "swarm.h"
+#include "netdev.h"
+#include "stats.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CNetDevException -
+//
+CNetDevException::CNetDevException(const char* strError)
+{
+  free(m_strError);
+  m_strError = strdup(strError);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CNetDev - Opens the host end and starts the I/O thread.
+//
+CNetDev::CNetDev(const char* strBackend)
+{
+  m_fd = -1;
+  m_wake[0] = m_wake[1] = -1;
+  m_bStop = FALSE;
+  m_bPeer = FALSE;
+  m_strSocket = NULL;
+  m_bEvent = 0;
+  m_nSent = 0;
+  m_nReceived = 0;
+  m_nLost = 0;
+
+  pthread_mutex_init(&m_lock, NULL);
+  Reset();
+
+  try
+    {
+      OpenBackend(strBackend);
+
+      if ((pipe(m_wake) < 0) || (fcntl(m_wake[0], F_SETFL, O_NONBLOCK) < 0) ||
+	  (fcntl(m_wake[1], F_SETFL, O_NONBLOCK) < 0))
+	throw CNetDevException("Can't set up the network I/O thread");
+      if (pthread_create(&m_thread, NULL, IOThreadEntry, this) != 0)
+	throw CNetDevException("Can't start the network I/O thread");
+    }
+  catch (CNetDevException&)
+    {
+      Stop();
+      throw;
+    }
+
+  CStats::Register(this, "net.sent", &m_nSent);
+  CStats::Register(this, "net.received", &m_nReceived);
+  CStats::Register(this, "net.lost", &m_nLost);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CNetDev - Anything not sent yet is lost.
+//
+CNetDev::~CNetDev()
+{
+  CStats::Unregister(this);
+
+  pthread_mutex_lock(&m_lock);
+  m_bStop = TRUE;
+  pthread_mutex_unlock(&m_lock);
+  Wake();
+  pthread_join(m_thread, NULL);
+
+  Stop();
+
+  if ((m_nSent + m_nReceived + m_nLost) != 0)
+    cout << "Net info: sent = " << m_nSent << " received = " << m_nReceived
+	 << " lost = " << m_nLost << "\n";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// OpenBackend - Throws a CNetDevException if strBackend (see netdev.h) is
+//               bad or can't be opened.
+//
+void CNetDev::OpenBackend(const char* strBackend)
+{
+  if (strncmp(strBackend, "fd:", 3) == 0)
+    {
+      char* strEnd;
+      int type;
+      socklen_t len = sizeof(type);
+
+      m_fd = strtol(strBackend + 3, &strEnd, 10);
+      if ((*strEnd != '\0') || (m_fd < 0) ||
+	  (getsockopt(m_fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0) ||
+	  ((type != SOCK_DGRAM) && (type != SOCK_SEQPACKET)))
+	{
+	  m_fd = -1;
+	  throw CNetDevException("Network fd must be a datagram socket");
+	}
+    }
+  else if (strncmp(strBackend, "unix:", 5) == 0)
+    {
+      struct sockaddr_un sa;
+      const char* strPeer = strchr(strBackend, ',');
+
+      if ((strPeer == NULL) ||
+	  ((strPeer - (strBackend + 5)) >= (int)sizeof(sa.sun_path)) ||
+	  (strlen(strPeer + 1) >= sizeof(m_peer.sun_path)))
+	throw CNetDevException("Network backend must be unix:path,peer");
+
+      memset(&sa, 0, sizeof(sa));
+      sa.sun_family = AF_UNIX;
+      memcpy(sa.sun_path, strBackend + 5, strPeer - (strBackend + 5));
+      memset(&m_peer, 0, sizeof(m_peer));
+      m_peer.sun_family = AF_UNIX;
+      strcpy(m_peer.sun_path, strPeer + 1);
+      m_bPeer = TRUE;
+
+      unlink(sa.sun_path);
+      m_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+      if ((m_fd < 0) || (bind(m_fd, (struct sockaddr*)&sa, sizeof(sa)) < 0))
+	throw CNetDevException("Can't open network socket");
+      m_strSocket = strdup(sa.sun_path);
+    }
+  else
+    throw CNetDevException("Network backend must be unix:path,peer or fd:n");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Stop - Closes anything we opened.
+//
+void CNetDev::Stop()
+{
+  if (m_fd >= 0)
+    close(m_fd);
+  if (m_wake[0] >= 0)
+    close(m_wake[0]);
+  if (m_wake[1] >= 0)
+    close(m_wake[1]);
+  if (m_strSocket != NULL)
+    {
+      unlink(m_strSocket);
+      free(m_strSocket);
+    }
+  m_fd = m_wake[0] = m_wake[1] = -1;
+  m_strSocket = NULL;
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Wake - Gets the I/O thread out of poll.
+//
+void CNetDev::Wake()
+{
+  char c = 0;
+
+  write(m_wake[1], &c, 1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Reset - Takes back all the buffers from the I/O thread.
+//
+void CNetDev::Reset()
+{
+  pthread_mutex_lock(&m_lock);
+  m_nTxQueued = m_nTxSent = m_nTxDone = 0;
+  m_nRxPosted = m_nRxFilled = m_nRxDone = 0;
+  pthread_mutex_unlock(&m_lock);
+
+  memset(m_regs, 0, sizeof(m_regs));
+  m_nDeadline = ~(uint64_t)0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// QueueSends - Hands the frames the send ring has for us to the I/O thread.
+//              Must have m_lock.
+//
+void CNetDev::QueueSends()
+{
+  uint32_t nSize = m_regs[R_NETTXSIZE];
+
+  while ((m_nTxQueued - m_nTxDone) < nSize)
+    {
+      uint32_t desc = m_regs[R_NETTXBASE] + (m_nTxQueued % nSize) * 16;
+      uint32_t* pDesc = (uint32_t*)(m_pMemory + desc);
+
+      if ((pDesc[2] & NETDESC_OWN) == 0)
+	break;
+
+      NETBUF* pBuf = &m_txBufs[m_nTxQueued % NETDEV_MAXRING];
+      pBuf->desc = desc;
+      pBuf->addr = pDesc[0];
+      pBuf->nSize = pDesc[1];
+      pBuf->nDone = 0;
+      pBuf->bError = (pBuf->nSize > NETDEV_MTU) ||
+	(pBuf->addr > m_nMemSize - pBuf->nSize);
+      m_nTxQueued++;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update - Hands back to the program what the I/O thread has finished
+//          with, and gives it any receive buffers the program has made.
+//
+void CNetDev::Update()
+{
+  uint32_t nSize = m_regs[R_NETRXSIZE];
+  uint32_t nPosted;
+
+  pthread_mutex_lock(&m_lock);
+  m_bEvent = 0;
+
+  for (; m_nTxDone != m_nTxSent; m_nTxDone++)
+    {
+      NETBUF* pBuf = &m_txBufs[m_nTxDone % NETDEV_MAXRING];
+
+      *(uint32_t*)(m_pMemory + pBuf->desc + 8) =
+	pBuf->bError ? NETDESC_ERROR : 0;
+      InvalidateCaches(pBuf->desc + 8, 4);
+      m_regs[R_NETSTATUS] |= pBuf->bError ? NETSTATUS_ERROR : NETSTATUS_TX;
+    }
+
+  for (; m_nRxDone != m_nRxFilled; m_nRxDone++)
+    {
+      NETBUF* pBuf = &m_rxBufs[m_nRxDone % NETDEV_MAXRING];
+
+      *(uint32_t*)(m_pMemory + pBuf->desc + 8) =
+	(pBuf->bError ? NETDESC_ERROR : 0) | pBuf->nDone;
+      InvalidateCaches(pBuf->desc + 8, 4);
+      InvalidateCaches(pBuf->addr, pBuf->nDone);
+      m_regs[R_NETSTATUS] |= pBuf->bError ? NETSTATUS_ERROR : NETSTATUS_RX;
+    }
+
+  nPosted = m_nRxPosted;
+  while ((m_nRxPosted - m_nRxDone) < nSize)
+    {
+      uint32_t desc = m_regs[R_NETRXBASE] + (m_nRxPosted % nSize) * 16;
+      uint32_t* pDesc = (uint32_t*)(m_pMemory + desc);
+
+      if ((pDesc[2] & NETDESC_OWN) == 0)
+	break;
+
+      // A buffer outside memory can't be used, and the ones after it
+      // have to wait for it
+      if ((pDesc[1] > m_nMemSize) || (pDesc[0] > m_nMemSize - pDesc[1]))
+	{
+	  m_regs[R_NETSTATUS] |= NETSTATUS_ERROR;
+	  break;
+	}
+
+      NETBUF* pBuf = &m_rxBufs[m_nRxPosted % NETDEV_MAXRING];
+      pBuf->desc = desc;
+      pBuf->addr = pDesc[0];
+      pBuf->nSize = pDesc[1];
+      pBuf->nDone = 0;
+      pBuf->bError = FALSE;
+      m_nRxPosted++;
+    }
+
+  m_regs[R_NETTXINDEX] = m_nTxDone % m_regs[R_NETTXSIZE];
+  m_regs[R_NETRXINDEX] = m_nRxDone % nSize;
+  pthread_mutex_unlock(&m_lock);
+
+  if (m_nRxPosted != nPosted)
+    Wake();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cycle - Looks for anything to do every NETDEV_POLLCYCLES while enabled.
+//
+uint32_t CNetDev::Cycle()
+{
+  uint32_t control = m_regs[R_NETCONTROL];
+
+  if (control & NETCONTROL_ENABLE)
+    {
+      // Only we change m_nRxPosted and m_nRxDone, so we can see if the
+      // program has given us another receive buffer without the lock
+      uint32_t nSize = m_regs[R_NETRXSIZE];
+      uint32_t desc = m_regs[R_NETRXBASE] + (m_nRxPosted % nSize) * 16;
+
+      if (m_bEvent || (((m_nRxPosted - m_nRxDone) < nSize) &&
+		       (*(uint32_t*)(m_pMemory + desc + 8) & NETDESC_OWN)))
+	Update();
+      m_nDeadline = *m_pClock + NETDEV_POLLCYCLES;
+    }
+  else
+    m_nDeadline = ~(uint64_t)0;
+
+  return (((control & NETCONTROL_TXINT) &&
+	   (m_regs[R_NETSTATUS] & (NETSTATUS_TX | NETSTATUS_ERROR))) ||
+	  ((control & NETCONTROL_RXINT) &&
+	   (m_regs[R_NETSTATUS] & (NETSTATUS_RX | NETSTATUS_ERROR)))) ? 1 : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write -
+//
+void CNetDev::Write(uint32_t addr, uint32_t data)
+{
+  uint32_t nReg = addr >> 2;
+  bool_t bEnabled = (m_regs[R_NETCONTROL] & NETCONTROL_ENABLE) != 0;
+
+  switch (nReg)
+    {
+    case R_NETTXBASE: case R_NETRXBASE:
+      if (!bEnabled)
+	m_regs[nReg] = data;
+      break;
+
+    case R_NETTXSIZE: case R_NETRXSIZE:
+      if (!bEnabled && (data <= NETDEV_MAXRING))
+	m_regs[nReg] = data;
+      break;
+
+    case R_NETCONTROL:
+      {
+	uint32_t nTxEnd = m_regs[R_NETTXBASE] + (m_regs[R_NETTXSIZE] * 16);
+	uint32_t nRxEnd = m_regs[R_NETRXBASE] + (m_regs[R_NETRXSIZE] * 16);
+
+	// Can't be enabled without both rings in memory
+	if ((data & NETCONTROL_ENABLE) &&
+	    ((m_regs[R_NETTXSIZE] == 0) || (m_regs[R_NETRXSIZE] == 0) ||
+	     (nTxEnd > m_nMemSize) || (nTxEnd < m_regs[R_NETTXBASE]) ||
+	     (nRxEnd > m_nMemSize) || (nRxEnd < m_regs[R_NETRXBASE]) ||
+	     ((m_regs[R_NETTXBASE] | m_regs[R_NETRXBASE]) & 0x3)))
+	  {
+	    data &= ~NETCONTROL_ENABLE;
+	    m_regs[R_NETSTATUS] |= NETSTATUS_ERROR;
+	  }
+
+	// Starting or stopping takes all the buffers back
+	if ((data ^ m_regs[R_NETCONTROL]) & NETCONTROL_ENABLE)
+	  {
+	    pthread_mutex_lock(&m_lock);
+	    m_nTxQueued = m_nTxSent = m_nTxDone = 0;
+	    m_nRxPosted = m_nRxFilled = m_nRxDone = 0;
+	    pthread_mutex_unlock(&m_lock);
+	    m_regs[R_NETTXINDEX] = m_regs[R_NETRXINDEX] = 0;
+	  }
+
+	m_regs[R_NETCONTROL] = data & (NETCONTROL_ENABLE | NETCONTROL_TXINT |
+				       NETCONTROL_RXINT);
+      }
+      break;
+
+    case R_NETSTATUS:
+      m_regs[R_NETSTATUS] &= ~(data & (NETSTATUS_TX | NETSTATUS_RX |
+				       NETSTATUS_ERROR));
+      break;
+
+    case R_NETTXPOLL:
+      if (bEnabled)
+	{
+	  pthread_mutex_lock(&m_lock);
+	  QueueSends();
+	  pthread_mutex_unlock(&m_lock);
+	  Wake();
+	}
+      break;
+
+    default:
+      return;
+    }
+
+  // Our interrupt line may have changed
+  m_nDeadline = *m_pClock + 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read -
+//
+uint32_t CNetDev::Read(uint32_t addr)
+{
+  uint32_t nReg = addr >> 2;
+
+  if (nReg >= NETDEV_NUMREGS)
+    return 0;
+
+  return m_regs[nReg];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// IOThread - Sends and receives straight from and into the buffers it has
+//            been given. The socket is only polled for what we have
+//            buffers for, so frames wait in the host until there is room.
+//
+void CNetDev::IOThread()
+{
+  struct pollfd fds[2];
+  bool_t bBlocked = FALSE;
+
+  fds[0].fd = m_wake[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = m_fd;
+
+  pthread_mutex_lock(&m_lock);
+  while (!m_bStop)
+    {
+      bool_t bMoved = FALSE;
+
+      bBlocked = FALSE;
+      while (m_nTxSent != m_nTxQueued)
+	{
+	  NETBUF* pBuf = &m_txBufs[m_nTxSent % NETDEV_MAXRING];
+
+	  if (!pBuf->bError)
+	    {
+	      ssize_t n;
+
+	      if (m_bPeer)
+		n = sendto(m_fd, m_pMemory + pBuf->addr, pBuf->nSize,
+			   MSG_DONTWAIT, (struct sockaddr*)&m_peer,
+			   sizeof(m_peer));
+	      else
+		n = send(m_fd, m_pMemory + pBuf->addr, pBuf->nSize,
+			 MSG_DONTWAIT);
+
+	      if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+		{
+		  bBlocked = TRUE;
+		  break;
+		}
+
+	      // Like a cable with nobody on the other end, a frame the host
+	      // won't take is just gone
+	      if (n < 0)
+		m_nLost++;
+	      else
+		m_nSent++;
+	    }
+
+	  m_nTxSent++;
+	  bMoved = TRUE;
+	}
+
+      while (m_nRxFilled != m_nRxPosted)
+	{
+	  NETBUF* pBuf = &m_rxBufs[m_nRxFilled % NETDEV_MAXRING];
+	  ssize_t n = recv(m_fd, m_pMemory + pBuf->addr, pBuf->nSize,
+			   MSG_DONTWAIT | MSG_TRUNC);
+
+	  if (n < 0)
+	    break;
+
+	  pBuf->nDone = ((uint32_t)n > pBuf->nSize) ? pBuf->nSize : n;
+	  pBuf->bError = ((uint32_t)n > pBuf->nSize);
+	  m_nReceived++;
+	  m_nRxFilled++;
+	  bMoved = TRUE;
+	}
+
+      if (bMoved)
+	m_bEvent = 1;
+
+      fds[1].events = (bBlocked ? POLLOUT : 0) |
+	((m_nRxFilled != m_nRxPosted) ? POLLIN : 0);
+      pthread_mutex_unlock(&m_lock);
+
+      poll(fds, 2, -1);
+      if (fds[0].revents & POLLIN)
+	{
+	  char buf[64];
+	  while (read(m_wake[0], buf, sizeof(buf)) > 0)
+	    ;
+	}
+
+      pthread_mutex_lock(&m_lock);
+    }
+  pthread_mutex_unlock(&m_lock);
+}
+
+void* CNetDev::IOThreadEntry(void* arg)
+{
+  ((CNetDev*)arg)->IOThread();
+  return NULL;
+}
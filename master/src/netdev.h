@@ -0,0 +1,159 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   netdev.h
+// header n/a
+// info   An Ethernet like network device. Frames are sent and received
+//        through rings of descriptors in memory, each four words:
+//
+//          0 buffer address
+//          1 buffer size (receive) or frame length (send)
+//          2 bit 31 set while the device owns it, bit 30 set if the
+//            frame was bad or didn't fit, and the length received in
+//            the bottom 16 bits
+//          3 unused
+//
+//        and the registers are:
+//
+//          0x00 send ring address       0x04 send ring entries
+//          0x08 receive ring address    0x0C receive ring entries
+//          0x10 control - bit 0 enables the device, bit 1 interrupts when
+//               a frame is sent, bit 2 when one is received
+//          0x14 status - bit 0 sent, bit 1 received, bit 2 error. Writing
+//               a 1 clears it.
+//          0x18 writing anything makes the device look at the send ring
+//          0x1C next send descriptor    0x20 next receive descriptor
+//
+//        The rings can only be changed while the device isn't enabled.
+//        The frames go between the host and the buffers in memory without
+//        being copied, on an I/O thread of our own. The host end is one
+//        of:
+//
+//          unix:path,peer  a datagram socket at path, sending to peer
+//          fd:n            a datagram socket we already have open (e.g.
+//                          one end of a socketpair)
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __NETDEV_H__
+#define __NETDEV_H__
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "swarm.h"
+#include "device.h"
+
+#define NETDEV_SIZE      0x1000
+#define NETDEV_MAXRING   256    // Most entries in a ring
+#define NETDEV_MTU       1536   // Biggest frame that can be sent
+#define NETDEV_POLLCYCLES 100   // How often we see what the host has done
+
+#define R_NETTXBASE   0x0
+#define R_NETTXSIZE   0x1
+#define R_NETRXBASE   0x2
+#define R_NETRXSIZE   0x3
+#define R_NETCONTROL  0x4
+#define R_NETSTATUS   0x5
+#define R_NETTXPOLL   0x6
+#define R_NETTXINDEX  0x7
+#define R_NETRXINDEX  0x8
+#define NETDEV_NUMREGS 9
+
+#define NETCONTROL_ENABLE 0x1
+#define NETCONTROL_TXINT  0x2
+#define NETCONTROL_RXINT  0x4
+
+#define NETSTATUS_TX      0x1
+#define NETSTATUS_RX      0x2
+#define NETSTATUS_ERROR   0x4
+
+#define NETDESC_OWN       0x80000000
+#define NETDESC_ERROR     0x40000000
+
+// A descriptor handed to the I/O thread
+typedef struct NETBUFTAG
+{
+  uint32_t desc;     // Where the descriptor is
+  uint32_t addr;
+  uint32_t nSize;    // Frame length to send, or buffer size to receive into
+  uint32_t nDone;    // Length received
+  bool_t   bError;
+} NETBUF;
+
+class CNetDevException : public CException
+{
+ public:
+  CNetDevException(const char* strError);
+};
+
+class CNetDev : public CDevice
+{
+  // Constructors and destructor
+ public:
+  CNetDev(const char* strBackend);   // Throws a CNetDevException
+  ~CNetDev();
+
+  // Public methods
+ public:
+  uint32_t Cycle();
+  uint32_t Read(uint32_t addr);
+  void     Write(uint32_t addr, uint32_t data);
+  void     Reset();
+  uint32_t GetSize() { return NETDEV_SIZE; }
+
+  // Private methods
+ private:
+  void OpenBackend(const char* strBackend);
+  void Stop();
+  void QueueSends();
+  void Update();
+  void Wake();
+  void IOThread();
+  static void* IOThreadEntry(void* arg);
+
+  // Private data
+ private:
+  uint32_t m_regs[NETDEV_NUMREGS];
+
+  // Buffers handed to the I/O thread. Each counter only goes up, and each
+  // ring of buffers is indexed by counter % NETDEV_MAXRING. Ours to
+  // change are m_nTxQueued, m_nTxDone, m_nRxPosted and m_nRxDone; the I/O
+  // thread moves on m_nTxSent and m_nRxFilled. All under m_lock.
+  NETBUF   m_txBufs[NETDEV_MAXRING];
+  NETBUF   m_rxBufs[NETDEV_MAXRING];
+  uint32_t m_nTxQueued, m_nTxSent, m_nTxDone;
+  uint32_t m_nRxPosted, m_nRxFilled, m_nRxDone;
+
+  // Set by the I/O thread when it has moved a counter on, so most polls
+  // don't need the lock.
+  volatile int m_bEvent;
+
+  int m_fd;
+  int m_wake[2];
+  bool_t m_bStop;
+  bool_t m_bPeer;                // Send to m_peer, else m_fd is connected
+  struct sockaddr_un m_peer;
+  char* m_strSocket;             // Ours to remove at the end, or NULL
+  pthread_t m_thread;
+  pthread_mutex_t m_lock;
+
+  // For the stats at the end
+  uint64_t m_nSent;
+  uint64_t m_nReceived;
+  uint64_t m_nLost;             // Sends the host wouldn't take
+};
+
+#endif // __NETDEV_H__
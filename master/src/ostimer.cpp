@@ -52,95 +52,119 @@ COSTimer::~COSTimer()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Reset - 
+// Reset - The counter starts again from 0 now.
 //
 void COSTimer::Reset()
 {
   memset(m_regs, 0, sizeof(uint32_t) * 8);
+  m_nBase = *m_pClock;
+  for (int i = 0; i < 4; i++)
+    m_nMatch[i] = NextMatch(i, m_nBase);
+  m_nDeadline = m_nBase + 1;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Cycle - 
+// NextMatch - Returns the first cycle after nCycle on which OSCR will equal
+//             match register i.
 //
-void COSTimer::Cycle(OSTBUS* bus)
+uint64_t COSTimer::NextMatch(int i, uint64_t nCycle)
 {
-  bus->interrupt = 0;
-  bus->reset = 0;
-  
-  // Check to see if a write is happening
-  if (bus->w != 0)
+  uint32_t oscr = (uint32_t)(nCycle + 1 - m_nBase);
+
+  return nCycle + 1 + (uint32_t)(m_regs[R_OSMR0 + i] - oscr);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - Anything written can change our interrupt lines, so we ask to be
+//         cycled next time round to work them out again.
+//
+void COSTimer::Write(uint32_t addr, uint32_t data)
+{
+  switch (addr >> 2)
     {
-      switch ((bus->addr) >> 2)
-	{
-	  // Write to a match register
-	case 0: case 1: case 2: case 3:
-	  m_regs[bus->addr] = bus->data;
-	  break;
-	  
-	  // Write to the status register. 
-	case 5:
-	  for (int i = 0; i < 4; i++)
-	    {
-	      if ((bus->data >> i) & 0x1)
-		m_regs[R_OSSR] &= ~(0x1 << i);
-	    }
-	  break;
-
-	  // Write to the watchdog enable bit
-	case 6:
-	  m_regs[R_OWER] = bus->data & 0x00000001;
-	  break;
+      // Write to a match register
+    case 0: case 1: case 2: case 3:
+      m_regs[addr >> 2] = data;
+      m_nMatch[addr >> 2] = NextMatch(addr >> 2, *m_pClock);
+      break;
 	  
-	  // Write to the interrupt enable register
-	case 7:
-	  m_regs[R_OIER] = bus->data & 0x0000000F;
-	  break;
+      // Write to the status register. 
+    case 5:
+      for (int i = 0; i < 4; i++)
+	{
+	  if ((data >> i) & 0x1)
+	    m_regs[R_OSSR] &= ~(0x1 << i);
 	}
+      break;
+
+      // Write to the watchdog enable bit
+    case 6:
+      m_regs[R_OWER] = data & 0x00000001;
+      break;
+	  
+      // Write to the interrupt enable register
+    case 7:
+      m_regs[R_OIER] = data & 0x0000000F;
+      break;
     }
 
-  // Increment the counter register
-  m_regs[R_OSCR]++;
+  m_nDeadline = *m_pClock + 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read - 
+//
+uint32_t COSTimer::Read(uint32_t addr)
+{
+  if (((addr >> 2) & 0x00000007) == R_OSCR)
+    return (uint32_t)(*m_pClock - m_nBase);
+
+  return m_regs[(addr >> 2) & 0x00000007];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cycle - Only called when a match is due or a register has been written.
+//         Sets the status bits for matches due now, and works out when the
+//         next one we care about is.
+//
+uint32_t COSTimer::Cycle()
+{
+  uint64_t nNow = *m_pClock;
 
   // See if we should set of an interrupt
-  if ((m_regs[R_OSMR0] == m_regs[R_OSCR]) && (m_regs[R_OIER] & 0x1))
+  for (int i = 0; i < 4; i++)
     {
+      if (m_nMatch[i] > nNow)
+	continue;
+
+      if ((m_nMatch[i] == nNow) && (m_regs[R_OIER] & (0x1 << i)))
+	{
 #ifndef QUIET	    
-      fprintf(stderr, "\nTimerCtrl: Timer0  interrupt request for Match[%d]\n", m_regs[R_OSMR0]);
+	  fprintf(stderr, "\nTimerCtrl: Timer%d  interrupt request for Match[%d]\n", i, m_regs[R_OSMR0 + i]);
 #endif      
-      //bus->interrupt |= 0x1;
-      m_regs[R_OSSR] |= 0x1;
-    }
-  if ((m_regs[R_OSMR1] == m_regs[R_OSCR]) && (m_regs[R_OIER] & 0x2))
-    {
-      //bus->interrupt |= 0x2;
-      m_regs[R_OSSR] |= 0x2;
-    }
-  if ((m_regs[R_OSMR2] == m_regs[R_OSCR]) && (m_regs[R_OIER] & 0x4))
-    {
-      //bus->interrupt |= 0x4;
-      m_regs[R_OSSR] |= 0x4;
-    }
-  if ((m_regs[R_OSMR3] == m_regs[R_OSCR]) && (m_regs[R_OIER] & 0x8))
-    {
-      //bus->interrupt |= 0x8;
-      m_regs[R_OSSR] |= 0x8;
-    }
-
-  bus->interrupt = m_regs[R_OSSR] & m_regs[R_OIER];  
+	  m_regs[R_OSSR] |= 0x1 << i;
+	}
 
-  // Should re do a reset?
-  if ((m_regs[R_OSMR3] == m_regs[R_OSCR]) && m_regs[R_OWER])
-    {
-      bus->reset = 1;
-    }
+      // The watchdog would reset us here, but nothing has ever listened
+      // for it.
+#ifndef QUIET	    
+      if ((i == 3) && (m_nMatch[i] == nNow) && m_regs[R_OWER])
+	fprintf(stderr, "\nTimerCtrl: Watchdog reset\n");
+#endif      
 
-  // Return info to the nosy user if necessary
-  if (bus->r != 0)
-    {
-      bus->data = m_regs[(bus->addr >> 2) & 0x00000007];
+      m_nMatch[i] = NextMatch(i, nNow);
     }
-}
 
+  // Matches that can't do anything aren't worth waking up for
+  m_nDeadline = ~(uint64_t)0;
+  for (int i = 0; i < 4; i++)
+    if ((m_regs[R_OIER] & (0x1 << i)) || ((i == 3) && m_regs[R_OWER]))
+      if (m_nMatch[i] < m_nDeadline)
+	m_nDeadline = m_nMatch[i];
 
-///////////////////////////////////////////////////////////////////////////////
+  return m_regs[R_OSSR] & m_regs[R_OIER];  
+}
@@ -24,17 +24,15 @@
 #ifndef __OSTIMER_H__
 #define __OSTIMER_H__
 
-typedef struct OSTBTAG
-{
-  uint32_t addr: 32;      // IN - address, 0 to 7
-  uint32_t data: 32;      // IN/OUT - 32 bits of data
-  uint32_t interrupt: 4;  // OUT - has an interrupt happened?
-  uint32_t reset: 1;      // OUT - has the watchdog happened?
-  uint32_t r:1;           // IN - is a read happening?
-  uint32_t w:1;           // IN - is a write happening?
-} OSTBUS;
-
-class COSTimer
+#include "device.h"
+
+#define OSTIMER_SIZE 0x10000
+
+// OSCR isn't counted, it's worked out from the clock when read, and the
+// matches are kept as the cycles they'll next happen on. Cycle() is only
+// needed on those cycles, and the one after a register is written.
+
+class COSTimer : public CDevice
 {
   // Constuctors and destructor
  public:
@@ -42,11 +40,18 @@ class COSTimer
   ~COSTimer();
 
  public:
-  void Cycle(OSTBUS* bus);
-  void Reset();
+  uint32_t Cycle();   // Interrupt lines 0 - 3 are the match registers
+  uint32_t Read(uint32_t addr);
+  void     Write(uint32_t addr, uint32_t data);
+  void     Reset();
+  uint32_t GetSize() { return OSTIMER_SIZE; }
 
  private:
   uint32_t m_regs[8];
+  uint64_t m_nBase;       // The clock when OSCR was 0
+  uint64_t m_nMatch[4];   // When each match register next matches
+
+  uint64_t NextMatch(int i, uint64_t nCycle);
 };
 
 #endif // __OSTIMER_H__
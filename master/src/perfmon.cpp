@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   perfmon.cpp
+// header perfmon.h
+// info   Implements the simulator's performance monitor.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "swarm.h"
+#include "perfmon.h"
+#include "armproc.h"
+#include "stats.h"
+
+#define PERF_SAMPLE_US 1000
+
+static const char* s_strSections[PS_NUM] =
+  {"other", "proc", "devices", "core", "decode", "exec", "copro", "bus"};
+
+volatile int CPerfMonitor::s_nSection = PS_OTHER;
+volatile int CPerfMonitor::s_bReportDue = 0;
+uint64_t CPerfMonitor::s_nSamples[PS_NUM];
+uint32_t CPerfMonitor::s_nInterval = 0;
+struct timespec CPerfMonitor::s_next;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CPerfMonitor - Starts the sampling timer.
+//
+CPerfMonitor::CPerfMonitor(CArmProc* pArm, uint32_t nInterval)
+{
+  struct sigaction sa;
+  struct itimerval it;
+  char strName[32];
+
+  m_pArm = pArm;
+  m_nLastInsts = pArm->GetInstructions();
+  m_nLastLogical = pArm->GetLogicalCycles();
+  m_nLastReal = pArm->GetRealCycles();
+  clock_gettime(CLOCK_MONOTONIC, &m_start);
+  m_last = m_start;
+  m_cpuStart = clock();
+
+  memset(s_nSamples, 0, sizeof(s_nSamples));
+  s_nInterval = nInterval * 1000;
+  s_next = m_start;
+  s_next.tv_sec += nInterval;
+  s_bReportDue = 0;
+
+  for (int i = 0; i < PS_NUM; i++)
+    {
+      sprintf(strName, "perf.samples.%s", s_strSections[i]);
+      CStats::Register(this, strName, &s_nSamples[i]);
+    }
+
+  // Host calls the timer lands in are restarted, so the libc SWIs don't
+  // see EINTR
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = Sample;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, NULL);
+
+  it.it_interval.tv_sec = 0;
+  it.it_interval.tv_usec = PERF_SAMPLE_US;
+  it.it_value = it.it_interval;
+  setitimer(ITIMER_PROF, &it, NULL);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CPerfMonitor - Stops the timer.
+//
+CPerfMonitor::~CPerfMonitor()
+{
+  struct itimerval it;
+
+  memset(&it, 0, sizeof(it));
+  setitimer(ITIMER_PROF, &it, NULL);
+  signal(SIGPROF, SIG_DFL);
+
+  CStats::Unregister(this);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Sample - The SIGPROF handler. Only notes that a progress line is due, as
+//          it can't safely print one.
+//
+void CPerfMonitor::Sample(int /*nSignal*/)
+{
+  s_nSamples[s_nSection]++;
+
+  if (s_nInterval == 0)
+    return;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if ((now.tv_sec > s_next.tv_sec) ||
+      ((now.tv_sec == s_next.tv_sec) && (now.tv_nsec >= s_next.tv_nsec)))
+    {
+      s_bReportDue = 1;
+
+      // Past now, or after a stall every sample would be due a report
+      do
+	s_next.tv_sec += s_nInterval / 1000;
+      while ((s_next.tv_sec < now.tv_sec) ||
+	     ((s_next.tv_sec == now.tv_sec) && (s_next.tv_nsec <= now.tv_nsec)));
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Seconds - The time between two readings of the clock.
+//
+double CPerfMonitor::Seconds(struct timespec* pFrom, struct timespec* pTo)
+{
+  return (double)(pTo->tv_sec - pFrom->tv_sec) +
+    ((double)(pTo->tv_nsec - pFrom->tv_nsec) / 1e9);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Report - The rates since the last progress line.
+//
+void CPerfMonitor::Report()
+{
+  struct timespec now;
+  uint64_t nInsts = m_pArm->GetInstructions();
+  uint64_t nLogical = m_pArm->GetLogicalCycles();
+  uint64_t nReal = m_pArm->GetRealCycles();
+
+  s_bReportDue = 0;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  double t = Seconds(&m_last, &now);
+  if (t > 0)
+    fprintf(stderr, "Perf: %.1fs MIPS = %.3f core cycles/s = %.0f "
+	    "real cycles/s = %.0f\n", Seconds(&m_start, &now),
+	    (double)(nInsts - m_nLastInsts) / (t * 1e6),
+	    (double)(nLogical - m_nLastLogical) / t,
+	    (double)(nReal - m_nLastReal) / t);
+
+  m_last = now;
+  m_nLastInsts = nInsts;
+  m_nLastLogical = nLogical;
+  m_nLastReal = nReal;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Summary - The rates over the whole run, and the share of the samples each
+//           part of the simulator took.
+//
+void CPerfMonitor::Summary()
+{
+  struct timespec now;
+  uint64_t nInsts = m_pArm->GetInstructions();
+  uint64_t nSamples = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double t = Seconds(&m_start, &now);
+  double cpu = (double)(clock() - m_cpuStart) / CLOCKS_PER_SEC;
+  if (t <= 0)
+    t = 1e-9;
+
+  fprintf(stderr, "Perf info: host = %.3fs cpu = %.3fs instructions = %llu\n",
+	  t, cpu, (unsigned long long)nInsts);
+  fprintf(stderr, "Perf rates: MIPS = %.3f core cycles/s = %.0f "
+	  "real cycles/s = %.0f\n", (double)nInsts / (t * 1e6),
+	  (double)m_pArm->GetLogicalCycles() / t,
+	  (double)m_pArm->GetRealCycles() / t);
+
+  for (int i = 0; i < PS_NUM; i++)
+    nSamples += s_nSamples[i];
+  if (nSamples == 0)
+    return;
+
+  fprintf(stderr, "Perf time:");
+  for (int i = 0; i < PS_NUM; i++)
+    fprintf(stderr, " %s = %.1f%%", s_strSections[i],
+	    (100.0 * s_nSamples[i]) / nSamples);
+  fprintf(stderr, "\n");
+}
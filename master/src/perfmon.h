@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   perfmon.h
+// header n/a
+// info   Measures how fast SWARM itself is going: instructions, core
+//        cycles and real cycles per host second, and where the host's
+//        time goes.
+//
+//        The time is sampled rather than timed. The simulator notes which
+//        part of it is running with PERF_SECTION, which is one store, and
+//        a profiling timer counts a sample against whichever part that was
+//        every millisecond of CPU time. Reading the clock on every change
+//        would cost more than most of the parts being measured.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PERFMON_H__
+#define __PERFMON_H__
+
+#include <time.h>
+#include "swarm.h"
+
+enum PERF_SECTION {PS_OTHER = 0, PS_PROC, PS_DEVICES, PS_CORE, PS_DECODE,
+		   PS_EXEC, PS_COPRO, PS_BUS, PS_NUM};
+
+#define PERF_SECTION(_s) (CPerfMonitor::s_nSection = (_s))
+
+class CArmProc;
+
+class CPerfMonitor
+{
+  // Constructors and destructor
+ public:
+  // Prints progress every nInterval host seconds, or only the summary if
+  // nInterval is 0
+  CPerfMonitor(CArmProc* pArm, uint32_t nInterval);
+  ~CPerfMonitor();
+
+  // Public methods
+ public:
+  inline bool_t IsReportDue() { return s_bReportDue; }
+  void Report();     // A progress line
+  void Summary();    // How the whole run went
+
+  // Public data, so PERF_SECTION is just a store
+ public:
+  static volatile int s_nSection;
+
+  // Private methods
+ private:
+  static void Sample(int nSignal);
+  static double Seconds(struct timespec* pFrom, struct timespec* pTo);
+
+  // Private data
+ private:
+  CArmProc* m_pArm;
+  struct timespec m_start;
+  struct timespec m_last;      // When we last reported
+  clock_t   m_cpuStart;
+  uint64_t  m_nLastInsts;
+  uint64_t  m_nLastLogical;
+  uint64_t  m_nLastReal;
+
+  static volatile int s_bReportDue;
+  static uint64_t s_nSamples[PS_NUM];
+  static uint32_t s_nInterval;   // ms
+  static struct timespec s_next; // When the next progress line is due
+};
+
+#endif // __PERFMON_H__
@@ -0,0 +1,923 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   refarm.cpp
+// header refarm.h
+// info   Implements the reference interpreter. Where the architecture
+//        leaves something to the implementation we do what the ARM7 does.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "swarm.h"
+#include "refarm.h"
+#include "alu.h"
+
+#define MODE_MASK 0x0000001F
+#define I_BIT     0x00000080
+#define F_BIT     0x00000040
+
+#define BIT(_i,_n)  (((_i) >> (_n)) & 0x1)
+#define REG(_i,_n)  (((_i) >> (_n)) & 0xF)
+#define ROR(_x,_n)  (((_n) == 0) ? (_x) : (((_x) >> (_n)) | ((_x) << (32 - (_n)))))
+
+enum REGS {R_R8 = 0x08, R_SP = 0x0D, R_LR = 0x0E, R_PC = 0x0F};
+
+// Index into m_bank. User and system modes (and nonsense) share one.
+static int bank(uint32_t mode)
+{
+  switch (mode)
+    {
+    case M_FIQ:   return AB_FIQ;
+    case M_IRQ:   return AB_IRQ;
+    case M_SVC:   return AB_SVC;
+    case M_ABORT: return AB_ABORT;
+    case M_UNDEF: return AB_UNDEF;
+    }
+  return AB_USER;
+}
+
+static inline uint32_t add_carry(uint32_t a, uint32_t b, uint32_t c,
+				 uint32_t* pFlags)
+{
+  uint64_t sum = (uint64_t)a + b + c;
+  uint32_t res = (uint32_t)sum;
+
+  *pFlags = ((sum >> 32) ? C_FLAG : 0) |
+    ((((a ^ ~b) & (a ^ res)) >> 31) ? V_FLAG : 0);
+  return res;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CRefArm - Constructor
+//
+CRefArm::CRefArm(const uint8_t* pMemory, uint32_t nMemSize)
+{
+  m_pMemory = pMemory;
+  m_nMemSize = nMemSize;
+
+  memset(m_r, 0, sizeof(m_r));
+  memset(m_bank, 0, sizeof(m_bank));
+  memset(m_bankFiq, 0, sizeof(m_bankFiq));
+  memset(m_bankUser, 0, sizeof(m_bankUser));
+  m_cpsr = M_SVC | I_BIT | F_BIT;
+
+  m_inst = 0;
+  m_bBranched = FALSE;
+  m_bUnmodelled = FALSE;
+  m_unknownFlags = 0;
+  m_nWrites = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetState -
+//
+void CRefArm::SetState(const ARMSTATE* pState)
+{
+  memcpy(m_r, pState->r, sizeof(m_r));
+  m_cpsr = pState->cpsr;
+  memcpy(m_bank, pState->banked, sizeof(m_bank));
+
+  if ((m_cpsr & MODE_MASK) == M_FIQ)
+    memcpy(m_bankUser, pState->user, sizeof(m_bankUser));
+  else
+    memcpy(m_bankFiq, pState->fiq, sizeof(m_bankFiq));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GetState -
+//
+void CRefArm::GetState(ARMSTATE* pState)
+{
+  int n = bank(m_cpsr & MODE_MASK);
+
+  memcpy(pState->r, m_r, sizeof(m_r));
+  pState->cpsr = m_cpsr;
+  memcpy(pState->banked, m_bank, sizeof(m_bank));
+  pState->banked[n][0] = m_r[R_SP];
+  pState->banked[n][1] = m_r[R_LR];
+  pState->spsr = (n == AB_USER) ? 0 : m_bank[n][2];
+
+  if (n == AB_FIQ)
+    {
+      memcpy(pState->fiq, &m_r[R_R8], sizeof(pState->fiq));
+      memcpy(pState->user, m_bankUser, sizeof(pState->user));
+    }
+  else
+    {
+      memcpy(pState->fiq, m_bankFiq, sizeof(pState->fiq));
+      memcpy(pState->user, &m_r[R_R8], sizeof(pState->user));
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Step - Fetches and runs one instruction.
+//
+bool_t CRefArm::Step()
+{
+  uint32_t pc = m_r[R_PC];
+
+  m_nWrites = 0;
+  m_unknownFlags = 0;
+  m_bBranched = FALSE;
+  m_bUnmodelled = FALSE;
+
+  if ((pc & 0x3) || (pc > m_nMemSize - 4))
+    {
+      m_inst = 0;
+      return FALSE;
+    }
+  m_inst = Load(pc, 0);
+  m_r[R_PC] = pc + 8;
+
+  uint32_t inst = m_inst;
+  uint32_t cond = inst >> 28;
+
+  // SWARM treats NV as undefined, as later architectures do
+  if (cond == C_NV)
+    Exception(M_UNDEF, 0x04);
+  else if (CondPassed(cond))
+    {
+      switch ((inst >> 25) & 0x7)
+	{
+	case 0:
+	  if ((inst & 0x0FC000F0) == 0x00000090)
+	    Multiply(inst);
+	  else if ((inst & 0x0F8000F0) == 0x00800090)
+	    MultiplyLong(inst);
+	  else if ((inst & 0x0FB00FF0) == 0x01000090)
+	    Swap(inst);
+	  else if ((inst & 0x00000090) == 0x00000090)
+	    HalfTransfer(inst);
+	  else if ((inst & 0x0FBF0FFF) == 0x010F0000)
+	    MRS(inst);
+	  else if ((inst & 0x0DB0F000) == 0x0120F000)
+	    MSR(inst);
+	  else if ((inst & 0x01900000) == 0x01000000)
+	    Exception(M_UNDEF, 0x04);   // Test without S
+	  else
+	    DataProcessing(inst);
+	  break;
+	case 1:
+	  if ((inst & 0x0DB0F000) == 0x0120F000)
+	    MSR(inst);
+	  else if ((inst & 0x01900000) == 0x01000000)
+	    Exception(M_UNDEF, 0x04);
+	  else
+	    DataProcessing(inst);
+	  break;
+	case 2:
+	  SingleTransfer(inst);
+	  break;
+	case 3:
+	  if (inst & 0x00000010)
+	    Exception(M_UNDEF, 0x04);
+	  else
+	    SingleTransfer(inst);
+	  break;
+	case 4:
+	  BlockTransfer(inst);
+	  break;
+	case 5:
+	  Branch(inst);
+	  break;
+	case 6:
+	  m_bUnmodelled = TRUE;         // LDC/STC
+	  break;
+	case 7:
+	  if ((inst & 0x01000000) == 0)
+	    m_bUnmodelled = TRUE;       // CDP/MRC/MCR
+#ifdef SWARM_SWI_HANDLER
+	  else if (inst & 0x00800000)
+	    m_bUnmodelled = TRUE;       // One of SWARM's own
+#endif
+	  else
+	    Exception(M_SVC, 0x08);
+	  break;
+	}
+    }
+
+  if (!m_bBranched)
+    m_r[R_PC] = pc + 4;
+
+  return !m_bUnmodelled;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Interrupt - The link register gets the next instruction + 4, so that
+//             "subs pc, lr, #4" goes back to it.
+//
+void CRefArm::Interrupt(bool_t bFiq)
+{
+  m_nWrites = 0;
+  m_unknownFlags = 0;
+  m_bUnmodelled = FALSE;
+
+  m_r[R_PC] += 8;
+  Exception(bFiq ? M_FIQ : M_IRQ, bFiq ? 0x1C : 0x18);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CondPassed -
+//
+bool_t CRefArm::CondPassed(uint32_t cond)
+{
+  bool_t n = (m_cpsr & N_FLAG) != 0;
+  bool_t z = (m_cpsr & Z_FLAG) != 0;
+  bool_t c = (m_cpsr & C_FLAG) != 0;
+  bool_t v = (m_cpsr & V_FLAG) != 0;
+
+  switch (cond)
+    {
+    case C_EQ: return z;
+    case C_NE: return !z;
+    case C_CS: return c;
+    case C_CC: return !c;
+    case C_MI: return n;
+    case C_PL: return !n;
+    case C_VS: return v;
+    case C_VC: return !v;
+    case C_HI: return c && !z;
+    case C_LS: return !c || z;
+    case C_GE: return n == v;
+    case C_LT: return n != v;
+    case C_GT: return !z && (n == v);
+    case C_LE: return z || (n != v);
+    }
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetPC / SetReg - Anything written to r15 is a branch.
+//
+void CRefArm::SetPC(uint32_t addr)
+{
+  m_r[R_PC] = addr & ~0x3;
+  m_bBranched = TRUE;
+}
+
+void CRefArm::SetReg(uint32_t n, uint32_t value)
+{
+  if (n == R_PC)
+    SetPC(value);
+  else
+    m_r[n] = value;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetNZ -
+//
+void CRefArm::SetNZ(uint32_t value)
+{
+  m_cpsr &= ~(N_FLAG | Z_FLAG);
+  m_cpsr |= (value & N_FLAG) | ((value == 0) ? Z_FLAG : 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SetCPSR - Switches the register bank if the mode changes.
+//
+void CRefArm::SetCPSR(uint32_t value)
+{
+  SwitchMode(value & MODE_MASK);
+  m_cpsr = value;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SPSR - The current mode's, or NULL in user and system modes.
+//
+uint32_t* CRefArm::SPSR()
+{
+  int n = bank(m_cpsr & MODE_MASK);
+
+  return (n == AB_USER) ? NULL : &m_bank[n][2];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SwitchMode - Swaps the banked registers over. Leaves the CPSR alone.
+//
+void CRefArm::SwitchMode(uint32_t mode)
+{
+  uint32_t old = m_cpsr & MODE_MASK;
+  int nOld = bank(old);
+  int nNew = bank(mode);
+
+  if (nOld != nNew)
+    {
+      m_bank[nOld][0] = m_r[R_SP];
+      m_bank[nOld][1] = m_r[R_LR];
+      if (nOld == AB_FIQ)
+	{
+	  memcpy(m_bankFiq, &m_r[R_R8], sizeof(m_bankFiq));
+	  memcpy(&m_r[R_R8], m_bankUser, sizeof(m_bankUser));
+	}
+
+      if (nNew == AB_FIQ)
+	{
+	  memcpy(m_bankUser, &m_r[R_R8], sizeof(m_bankUser));
+	  memcpy(&m_r[R_R8], m_bankFiq, sizeof(m_bankFiq));
+	}
+      m_r[R_SP] = m_bank[nNew][0];
+      m_r[R_LR] = m_bank[nNew][1];
+    }
+
+  m_cpsr = (m_cpsr & ~MODE_MASK) | mode;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Exception - Enters mode at vector. The link register gets the address of
+//             the instruction after the one running.
+//
+void CRefArm::Exception(uint32_t mode, uint32_t vector)
+{
+  uint32_t old = m_cpsr;
+  uint32_t lr = m_r[R_PC] - 4;
+
+  SwitchMode(mode);
+  m_bank[bank(mode)][2] = old;
+  m_r[R_LR] = lr;
+  m_cpsr |= I_BIT;
+  if (mode == M_FIQ)
+    m_cpsr |= F_BIT;
+  SetPC(vector);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// UserReg / SetUserReg - The user mode registers, for LDM/STM with ^.
+//
+uint32_t CRefArm::UserReg(uint32_t n)
+{
+  uint32_t mode = m_cpsr & MODE_MASK;
+
+  if ((n >= R_SP) && (n <= R_LR) && (bank(mode) != AB_USER))
+    return m_bank[AB_USER][n - R_SP];
+  if ((n >= R_R8) && (n < R_SP) && (mode == M_FIQ))
+    return m_bankUser[n - R_R8];
+  return m_r[n];
+}
+
+void CRefArm::SetUserReg(uint32_t n, uint32_t value)
+{
+  uint32_t mode = m_cpsr & MODE_MASK;
+
+  if ((n >= R_SP) && (n <= R_LR) && (bank(mode) != AB_USER))
+    m_bank[AB_USER][n - R_SP] = value;
+  else if ((n >= R_R8) && (n < R_SP) && (mode == M_FIQ))
+    m_bankUser[n - R_R8] = value;
+  else
+    SetReg(n, value);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ShiftImm - The barrel shifter with the distance in the instruction, where
+//            0 means 32 for the right shifts and RRX for ROR.
+//
+uint32_t CRefArm::ShiftImm(uint32_t value, uint32_t type, uint32_t dist,
+			   uint32_t* pCarry)
+{
+  switch (type)
+    {
+    case S_LSL:
+      if (dist == 0)
+	return value;
+      *pCarry = (value >> (32 - dist)) & 0x1;
+      return value << dist;
+    case S_LSR:
+      if (dist == 0)
+	{
+	  *pCarry = value >> 31;
+	  return 0;
+	}
+      *pCarry = (value >> (dist - 1)) & 0x1;
+      return value >> dist;
+    case S_ASR:
+      if (dist == 0)
+	{
+	  *pCarry = value >> 31;
+	  return (uint32_t)((int32_t)value >> 31);
+	}
+      *pCarry = (value >> (dist - 1)) & 0x1;
+      return (uint32_t)((int32_t)value >> dist);
+    default:
+      if (dist == 0)
+	{
+	  uint32_t res = (*pCarry << 31) | (value >> 1);
+	  *pCarry = value & 0x1;
+	  return res;
+	}
+      *pCarry = (value >> (dist - 1)) & 0x1;
+      return ROR(value, dist);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ShiftReg - The barrel shifter with the distance from the bottom byte of a
+//            register.
+//
+uint32_t CRefArm::ShiftReg(uint32_t value, uint32_t type, uint32_t dist,
+			   uint32_t* pCarry)
+{
+  if (dist == 0)
+    return value;
+
+  switch (type)
+    {
+    case S_LSL:
+      if (dist > 32)
+	{
+	  *pCarry = 0;
+	  return 0;
+	}
+      *pCarry = (value >> (32 - dist)) & 0x1;
+      return (dist == 32) ? 0 : value << dist;
+    case S_LSR:
+      if (dist > 32)
+	{
+	  *pCarry = 0;
+	  return 0;
+	}
+      *pCarry = (value >> (dist - 1)) & 0x1;
+      return (dist == 32) ? 0 : value >> dist;
+    case S_ASR:
+      if (dist >= 32)
+	{
+	  *pCarry = value >> 31;
+	  return (uint32_t)((int32_t)value >> 31);
+	}
+      *pCarry = (value >> (dist - 1)) & 0x1;
+      return (uint32_t)((int32_t)value >> dist);
+    default:
+      dist &= 0x1F;
+      if (dist == 0)
+	{
+	  *pCarry = value >> 31;
+	  return value;
+	}
+      *pCarry = (value >> (dist - 1)) & 0x1;
+      return ROR(value, dist);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Load - Memory is little endian whatever the host. An unaligned word load
+//        rotates the word it's in, a half word load ignores bit 0.
+//
+uint32_t CRefArm::Load(uint32_t addr, uint32_t bw)
+{
+  uint32_t base = addr & ~0x3;
+
+  if (base > m_nMemSize - 4)
+    {
+      m_bUnmodelled = TRUE;
+      return 0;
+    }
+
+  const uint8_t* p = m_pMemory + base;
+  uint32_t word = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+
+  switch (bw)
+    {
+    case 0:
+      return ROR(word, (addr & 0x3) * 8);
+    case 1:
+      return (word >> ((addr & 0x3) * 8)) & 0xFF;
+    default:
+      return (word >> ((addr & 0x2) * 8)) & 0xFFFF;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Store - Only noted. The address is aligned to the size, as the memory
+//         system does.
+//
+void CRefArm::Store(uint32_t addr, uint32_t bw, uint32_t data)
+{
+  if ((addr & ~0x3) > m_nMemSize - 4)
+    {
+      m_bUnmodelled = TRUE;
+      return;
+    }
+  if (m_nWrites == REF_MAXWRITES)
+    return;
+
+  REFWRITE* pWrite = &m_writes[m_nWrites++];
+  switch (bw)
+    {
+    case 0:
+      pWrite->addr = addr & ~0x3;
+      pWrite->data = data;
+      break;
+    case 1:
+      pWrite->addr = addr;
+      pWrite->data = data & 0xFF;
+      break;
+    default:
+      pWrite->addr = addr & ~0x1;
+      pWrite->data = data & 0xFFFF;
+      break;
+    }
+  pWrite->bw = bw;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// DataProcessing -
+//
+void CRefArm::DataProcessing(uint32_t inst)
+{
+  uint32_t opcode = (inst >> 21) & 0xF;
+  uint32_t rd = REG(inst, 12);
+  uint32_t carry = (m_cpsr & C_FLAG) ? 1 : 0;
+  uint32_t shifter = carry;
+  uint32_t a = m_r[REG(inst, 16)];
+  uint32_t b, res, flags = 0;
+  bool_t bLogical = TRUE, bWrite = TRUE;
+
+  if (BIT(inst, 25))
+    {
+      uint32_t rot = ((inst >> 8) & 0xF) * 2;
+
+      b = ROR(inst & 0xFF, rot);
+      if (rot != 0)
+	shifter = b >> 31;
+    }
+  else if (BIT(inst, 4))
+    {
+      // The PC reads 4 further on when there's a register shift
+      uint32_t rm = REG(inst, 0);
+
+      b = m_r[rm] + ((rm == R_PC) ? 4 : 0);
+      if (REG(inst, 16) == R_PC)
+	a += 4;
+      b = ShiftReg(b, (inst >> 5) & 0x3, m_r[REG(inst, 8)] & 0xFF, &shifter);
+    }
+  else
+    b = ShiftImm(m_r[REG(inst, 0)], (inst >> 5) & 0x3, (inst >> 7) & 0x1F,
+		 &shifter);
+
+  switch (opcode)
+    {
+    case OP_AND: res = a & b; break;
+    case OP_EOR: res = a ^ b; break;
+    case OP_TST: res = a & b; bWrite = FALSE; break;
+    case OP_TEQ: res = a ^ b; bWrite = FALSE; break;
+    case OP_ORR: res = a | b; break;
+    case OP_MOV: res = b; break;
+    case OP_BIC: res = a & ~b; break;
+    case OP_MVN: res = ~b; break;
+    default:
+      bLogical = FALSE;
+      switch (opcode)
+	{
+	case OP_SUB: res = add_carry(a, ~b, 1, &flags); break;
+	case OP_RSB: res = add_carry(b, ~a, 1, &flags); break;
+	case OP_ADD: res = add_carry(a, b, 0, &flags); break;
+	case OP_ADC: res = add_carry(a, b, carry, &flags); break;
+	case OP_SBC: res = add_carry(a, ~b, carry, &flags); break;
+	case OP_RSC: res = add_carry(b, ~a, carry, &flags); break;
+	case OP_CMP: res = add_carry(a, ~b, 1, &flags); bWrite = FALSE; break;
+	default:     res = add_carry(a, b, 0, &flags); bWrite = FALSE; break;
+	}
+      break;
+    }
+
+  if (bWrite)
+    SetReg(rd, res);
+
+  if (!BIT(inst, 20))
+    return;
+
+  if ((rd == R_PC) && bWrite)
+    {
+      // Back from an exception
+      uint32_t* pSpsr = SPSR();
+      if (pSpsr == NULL)
+	m_bUnmodelled = TRUE;
+      else
+	SetCPSR(*pSpsr);
+      return;
+    }
+
+  SetNZ(res);
+  if (bLogical)
+    m_cpsr = (m_cpsr & ~C_FLAG) | (shifter ? C_FLAG : 0);
+  else
+    m_cpsr = (m_cpsr & ~(C_FLAG | V_FLAG)) | flags;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Multiply - MUL and MLA. C is meaningless afterwards.
+//
+void CRefArm::Multiply(uint32_t inst)
+{
+  uint32_t res = m_r[REG(inst, 0)] * m_r[REG(inst, 8)];
+
+  if (BIT(inst, 21))
+    res += m_r[REG(inst, 12)];
+  SetReg(REG(inst, 16), res);
+
+  if (BIT(inst, 20))
+    {
+      SetNZ(res);
+      m_unknownFlags = C_FLAG;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MultiplyLong - UMULL, UMLAL, SMULL and SMLAL. C and V are meaningless
+//                afterwards.
+//
+void CRefArm::MultiplyLong(uint32_t inst)
+{
+  uint32_t rdHi = REG(inst, 16), rdLo = REG(inst, 12);
+  uint64_t res;
+
+  if (BIT(inst, 22))
+    res = (uint64_t)((int64_t)(int32_t)m_r[REG(inst, 0)] *
+		     (int64_t)(int32_t)m_r[REG(inst, 8)]);
+  else
+    res = (uint64_t)m_r[REG(inst, 0)] * m_r[REG(inst, 8)];
+
+  if (BIT(inst, 21))
+    res += ((uint64_t)m_r[rdHi] << 32) | m_r[rdLo];
+
+  SetReg(rdLo, (uint32_t)res);
+  SetReg(rdHi, (uint32_t)(res >> 32));
+
+  if (BIT(inst, 20))
+    {
+      m_cpsr &= ~(N_FLAG | Z_FLAG);
+      m_cpsr |= ((res >> 63) ? N_FLAG : 0) | ((res == 0) ? Z_FLAG : 0);
+      m_unknownFlags = C_FLAG | V_FLAG;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Swap - SWP and SWPB.
+//
+void CRefArm::Swap(uint32_t inst)
+{
+  uint32_t addr = m_r[REG(inst, 16)];
+  uint32_t bw = BIT(inst, 22) ? 1 : 0;
+  uint32_t value = Load(addr, bw);
+
+  Store(addr, bw, m_r[REG(inst, 0)]);
+  SetReg(REG(inst, 12), value);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// HalfTransfer - LDRH, STRH, LDRSB and LDRSH.
+//
+void CRefArm::HalfTransfer(uint32_t inst)
+{
+  uint32_t sh = (inst >> 5) & 0x3;
+  uint32_t rn = REG(inst, 16), rd = REG(inst, 12);
+  uint32_t offset, addr, value = 0;
+
+  // Signed stores are LDRD/STRD in later architectures
+  if (!BIT(inst, 20) && (sh != 1))
+    {
+      Exception(M_UNDEF, 0x04);
+      return;
+    }
+
+  if (BIT(inst, 22))
+    offset = ((inst >> 4) & 0xF0) | (inst & 0xF);
+  else
+    offset = m_r[REG(inst, 0)];
+  if (!BIT(inst, 23))
+    offset = -offset;
+
+  addr = m_r[rn] + (BIT(inst, 24) ? offset : 0);
+
+  if (BIT(inst, 20))
+    {
+      switch (sh)
+	{
+	case 1: value = Load(addr, 2); break;
+	case 2: value = (uint32_t)(int32_t)(int8_t)Load(addr, 1); break;
+	case 3: value = (uint32_t)(int32_t)(int16_t)Load(addr, 2); break;
+	}
+    }
+  else
+    Store(addr, 2, m_r[rd] + ((rd == R_PC) ? 4 : 0));
+
+  if (!BIT(inst, 24) || BIT(inst, 21))
+    SetReg(rn, m_r[rn] + offset);
+  if (BIT(inst, 20))
+    SetReg(rd, value);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SingleTransfer - LDR, STR, LDRB and STRB.
+//
+void CRefArm::SingleTransfer(uint32_t inst)
+{
+  uint32_t rn = REG(inst, 16), rd = REG(inst, 12);
+  uint32_t bw = BIT(inst, 22) ? 1 : 0;
+  uint32_t offset, addr, value = 0;
+
+  if (BIT(inst, 25))
+    {
+      uint32_t carry = (m_cpsr & C_FLAG) ? 1 : 0;
+
+      offset = ShiftImm(m_r[REG(inst, 0)], (inst >> 5) & 0x3,
+			(inst >> 7) & 0x1F, &carry);
+    }
+  else
+    offset = inst & 0xFFF;
+  if (!BIT(inst, 23))
+    offset = -offset;
+
+  addr = m_r[rn] + (BIT(inst, 24) ? offset : 0);
+
+  if (BIT(inst, 20))
+    value = Load(addr, bw);
+  else
+    Store(addr, bw, m_r[rd] + ((rd == R_PC) ? 4 : 0));
+
+  if (!BIT(inst, 24) || BIT(inst, 21))
+    SetReg(rn, m_r[rn] + offset);
+  if (BIT(inst, 20))
+    SetReg(rd, value);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// BlockTransfer - LDM and STM. The lowest register goes to the lowest
+//                 address. A stored base is the old value if it's the
+//                 first register, else the written back one.
+//
+void CRefArm::BlockTransfer(uint32_t inst)
+{
+  uint32_t rn = REG(inst, 16);
+  uint32_t list = inst & 0xFFFF;
+  uint32_t n = 0, addr, base;
+  bool_t bUser = BIT(inst, 22) && (!BIT(inst, 20) || !(list & 0x8000));
+
+  for (uint32_t i = 0; i < 16; i++)
+    if (list & (0x1 << i))
+      n++;
+  if (n == 0)
+    {
+      m_bUnmodelled = TRUE;
+      return;
+    }
+
+  base = m_r[rn];
+  if (BIT(inst, 23))
+    {
+      addr = base + (BIT(inst, 24) ? 4 : 0);
+      base += n * 4;
+    }
+  else
+    {
+      addr = base - (n * 4) + (BIT(inst, 24) ? 0 : 4);
+      base -= n * 4;
+    }
+
+  if (BIT(inst, 20))
+    {
+      // Anything loaded into the base wins over the write back
+      if (BIT(inst, 21))
+	m_r[rn] = base;
+      for (uint32_t i = 0; i < 16; i++)
+	if (list & (0x1 << i))
+	  {
+	    uint32_t value = Load(addr & ~0x3, 0);
+
+	    if (bUser)
+	      SetUserReg(i, value);
+	    else
+	      SetReg(i, value);
+	    addr += 4;
+	  }
+
+      if ((list & 0x8000) && BIT(inst, 22))
+	{
+	  uint32_t* pSpsr = SPSR();
+	  if (pSpsr == NULL)
+	    m_bUnmodelled = TRUE;
+	  else
+	    SetCPSR(*pSpsr);
+	}
+    }
+  else
+    {
+      bool_t bFirst = TRUE;
+
+      for (uint32_t i = 0; i < 16; i++)
+	if (list & (0x1 << i))
+	  {
+	    uint32_t value = bUser ? UserReg(i) : m_r[i];
+
+	    if (i == R_PC)
+	      value += 4;
+	    else if ((i == rn) && !bFirst && BIT(inst, 21))
+	      value = base;
+	    Store(addr, 0, value);
+	    addr += 4;
+	    bFirst = FALSE;
+	  }
+      if (BIT(inst, 21))
+	SetReg(rn, base);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Branch - B and BL.
+//
+void CRefArm::Branch(uint32_t inst)
+{
+  uint32_t target = m_r[R_PC] + (uint32_t)(((int32_t)(inst << 8)) >> 6);
+
+  if (BIT(inst, 24))
+    m_r[R_LR] = m_r[R_PC] - 4;
+  SetPC(target);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MRS -
+//
+void CRefArm::MRS(uint32_t inst)
+{
+  if (BIT(inst, 22))
+    {
+      uint32_t* pSpsr = SPSR();
+      if (pSpsr == NULL)
+	m_bUnmodelled = TRUE;
+      else
+	SetReg(REG(inst, 12), *pSpsr);
+    }
+  else
+    SetReg(REG(inst, 12), m_cpsr);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MSR - Only the flags can be changed in user mode.
+//
+void CRefArm::MSR(uint32_t inst)
+{
+  uint32_t value, mask = 0;
+
+  if (BIT(inst, 25))
+    value = ROR(inst & 0xFF, ((inst >> 8) & 0xF) * 2);
+  else
+    value = m_r[REG(inst, 0)];
+
+  if (BIT(inst, 16)) mask |= 0x000000FF;
+  if (BIT(inst, 17)) mask |= 0x0000FF00;
+  if (BIT(inst, 18)) mask |= 0x00FF0000;
+  if (BIT(inst, 19)) mask |= 0xFF000000;
+
+  if (BIT(inst, 22))
+    {
+      uint32_t* pSpsr = SPSR();
+      if (pSpsr == NULL)
+	m_bUnmodelled = TRUE;
+      else
+	*pSpsr = (*pSpsr & ~mask) | (value & mask);
+    }
+  else
+    {
+      if ((m_cpsr & MODE_MASK) == M_USER)
+	mask &= 0xFF000000;
+      SetCPSR((m_cpsr & ~mask) | (value & mask));
+    }
+}
@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   refarm.h
+// header n/a
+// info   A plain instruction at a time ARM interpreter, written from the
+//        architecture manual rather than from the core, for checking the
+//        core against (see cosim.h). It knows nothing of cycles, caches
+//        or the pipeline.
+//
+//        It reads the program's memory but never writes it - the core
+//        does that - so stores are just noted for comparing. Anything it
+//        can't do on its own is reported rather than guessed at: the
+//        coprocessors, SWIs handled by SWARM itself, and memory outside
+//        the program's (the on chip devices).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __REFARM_H__
+#define __REFARM_H__
+
+#include "swarm.h"
+#include "core.h"
+
+#define REF_MAXWRITES 16
+
+typedef struct RWTAG
+{
+  uint32_t addr;
+  uint32_t bw;     // As on the bus: 0 = word, 1 = byte, 2 = half word
+  uint32_t data;
+} REFWRITE;
+
+class CRefArm
+{
+  // Constructors and destructor
+ public:
+  CRefArm(const uint8_t* pMemory, uint32_t nMemSize);
+
+  // Public methods
+ public:
+  void SetState(const ARMSTATE* pState);
+  void GetState(ARMSTATE* pState);
+
+  // Runs the instruction at the PC. Returns FALSE if it needed something
+  // we don't model, in which case the state is not to be trusted.
+  bool_t Step();
+
+  // Takes an interrupt instead of running the next instruction
+  void Interrupt(bool_t bFiq);
+
+  inline uint32_t GetInst() { return m_inst; }
+  inline uint32_t GetWrites() { return m_nWrites; }
+  inline const REFWRITE* GetWrite(uint32_t n) { return &m_writes[n]; }
+
+  // The CPSR bits the last instruction left UNPREDICTABLE (the C and V
+  // flags after a multiply, say)
+  inline uint32_t GetUnknownFlags() { return m_unknownFlags; }
+
+  // Private methods
+ private:
+  bool_t CondPassed(uint32_t cond);
+  void SetPC(uint32_t addr);
+  void SetReg(uint32_t n, uint32_t value);
+  void SetNZ(uint32_t value);
+  void SetCPSR(uint32_t value);
+  uint32_t* SPSR();
+  void SwitchMode(uint32_t mode);
+  void Exception(uint32_t mode, uint32_t vector);
+  uint32_t UserReg(uint32_t n);
+  void SetUserReg(uint32_t n, uint32_t value);
+
+  uint32_t ShiftImm(uint32_t value, uint32_t type, uint32_t dist,
+		    uint32_t* pCarry);
+  uint32_t ShiftReg(uint32_t value, uint32_t type, uint32_t dist,
+		    uint32_t* pCarry);
+
+  uint32_t Load(uint32_t addr, uint32_t bw);
+  void Store(uint32_t addr, uint32_t bw, uint32_t data);
+
+  void DataProcessing(uint32_t inst);
+  void Multiply(uint32_t inst);
+  void MultiplyLong(uint32_t inst);
+  void Swap(uint32_t inst);
+  void HalfTransfer(uint32_t inst);
+  void SingleTransfer(uint32_t inst);
+  void BlockTransfer(uint32_t inst);
+  void Branch(uint32_t inst);
+  void MRS(uint32_t inst);
+  void MSR(uint32_t inst);
+
+  // Private data
+ private:
+  const uint8_t* m_pMemory;
+  uint32_t m_nMemSize;
+
+  uint32_t m_r[16];          // r15 is the instruction's address + 8 while
+                             // it runs, and the next one's otherwise
+  uint32_t m_cpsr;
+  uint32_t m_bank[AB_NUM][3];   // As ARMSTATE, but the current mode's r13
+  uint32_t m_bankFiq[5];        // and r14 (and fiq's r8 - r12, or user's if 
+  uint32_t m_bankUser[5];       // in fiq) are only in m_r
+
+  uint32_t m_inst;
+  bool_t   m_bBranched;
+  bool_t   m_bUnmodelled;
+  uint32_t m_unknownFlags;
+  uint32_t m_nWrites;
+  REFWRITE m_writes[REF_MAXWRITES];
+};
+
+#endif // __REFARM_H__
@@ -0,0 +1,147 @@
+//////////////////////////////////////////////////////////////////////////////
+// 
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// 
+// Name   : rtc.cpp
+// 
+//////////////////////////////////////////////////////////////////////////////
+
+#include "swarm.h"
+#include "rtc.h"
+#include <string.h>
+#include <time.h>
+
+#define R_RTAR 0x0
+#define R_RCNR 0x1
+#define R_RTTR 0x2
+#define R_RTSR 0x4
+
+#define RTSR_AL  0x1
+#define RTSR_HZ  0x2
+#define RTSR_ALE 0x4
+#define RTSR_HZE 0x8
+
+///////////////////////////////////////////////////////////////////////////////
+// CRTC - 
+//
+CRTC::CRTC()
+{
+  Reset();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CRTC - 
+//
+CRTC::~CRTC()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Reset - The count carries on, as a real one would on its own power.
+//
+void CRTC::Reset()
+{
+  memset(m_regs, 0, sizeof(uint32_t) * 5);
+  m_nOffset = 0;
+  m_nLast = Count();
+  m_nDeadline = ~(uint64_t)0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Count - What RCNR is now.
+//
+uint32_t CRTC::Count()
+{
+  return (uint32_t)time(NULL) + m_nOffset;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cycle - Sets HZ if the count has moved on since we last looked, and AL if
+//         it has gone past the alarm.
+//
+uint32_t CRTC::Cycle()
+{
+  uint32_t nNow = Count();
+
+  if (nNow != m_nLast)
+    {
+      m_regs[R_RTSR] |= RTSR_HZ;
+      if ((uint32_t)(m_regs[R_RTAR] - m_nLast - 1) < (uint32_t)(nNow - m_nLast))
+	m_regs[R_RTSR] |= RTSR_AL;
+      m_nLast = nNow;
+    }
+
+  if (m_regs[R_RTSR] & (RTSR_ALE | RTSR_HZE))
+    m_nDeadline = *m_pClock + RTC_POLLCYCLES;
+  else
+    m_nDeadline = ~(uint64_t)0;
+
+  return (((m_regs[R_RTSR] & RTSR_HZE) && (m_regs[R_RTSR] & RTSR_HZ)) ? 1 : 0) |
+    (((m_regs[R_RTSR] & RTSR_ALE) && (m_regs[R_RTSR] & RTSR_AL)) ? 2 : 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - We look at the count again the cycle after, in case the
+//         interrupt lines have changed.
+//
+void CRTC::Write(uint32_t addr, uint32_t data)
+{
+  switch (addr >> 2)
+    {
+    case R_RTAR:
+      m_regs[R_RTAR] = data;
+      break;
+    case R_RCNR:
+      m_nOffset = data - (uint32_t)time(NULL);
+      m_nLast = data;
+      break;
+    case R_RTTR:
+      m_regs[R_RTTR] = data;
+      break;
+    case R_RTSR:
+      m_regs[R_RTSR] = (m_regs[R_RTSR] & ~(data & (RTSR_AL | RTSR_HZ))) & 
+	(RTSR_AL | RTSR_HZ);
+      m_regs[R_RTSR] |= data & (RTSR_ALE | RTSR_HZE);
+      break;
+    default:
+      return;
+    }
+
+  m_nDeadline = *m_pClock + 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read - 
+//
+uint32_t CRTC::Read(uint32_t addr)
+{
+  switch (addr >> 2)
+    {
+    case R_RCNR:
+      return Count();
+    case R_RTAR:
+    case R_RTTR:
+    case R_RTSR:
+      return m_regs[addr >> 2];
+    }
+
+  return 0;
+}
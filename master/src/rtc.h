@@ -0,0 +1,56 @@
+/*****************************************************************************
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * 
+ * Name   : rtc.h
+ * 
+ ****************************************************************************/
+
+#ifndef __RTC_H__
+#define __RTC_H__
+
+#include "device.h"
+
+#define RTC_SIZE 0x10000
+#define RTC_POLLCYCLES 100000   // How often we look at the host clock
+
+// The SA-1100 real time clock, counting seconds of host time (whatever
+// speed the simulation runs at). Writing RCNR sets where the count is now.
+// The host clock is only looked at while the alarm or 1Hz interrupt is
+// enabled, every RTC_POLLCYCLES, so ticks can be late by that much.
+
+class CRTC : public CDevice
+{
+  // Constuctors and destructor
+ public:
+  CRTC();
+  ~CRTC();
+
+ public:
+  uint32_t Cycle();   // Interrupt line 0 is the 1Hz tick, 1 the alarm
+  uint32_t Read(uint32_t addr);
+  void     Write(uint32_t addr, uint32_t data);
+  void     Reset();
+  uint32_t GetSize() { return RTC_SIZE; }
+
+ private:
+  uint32_t m_regs[5];
+  uint32_t m_nOffset;     // RCNR less the host's seconds
+  uint32_t m_nLast;       // RCNR when we last looked
+
+  uint32_t Count();
+};
+
+#endif // __RTC_H__
@@ -32,9 +32,6 @@
 #include <string.h>
 
 
-#define LINE_SIZE_W 4  /* (words) */
-#define LINE_SIZE_B 16 /* (bytes) */
-
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -42,7 +39,9 @@
 CSetAssociativeCache::CSetAssociativeCache(uint32_t nSize)
 {
   m_nSize = nSize;
-  m_nWay = 2;
+  m_nLineSize = DEFAULT_LINESIZE;
+  m_nWay = m_nWays = 2;
+  m_policy = CP_ROUNDROBIN;
 
   InitSets();
 }
@@ -50,11 +49,60 @@ CSetAssociativeCache::CSetAssociativeCache(uint32_t nSize)
 CSetAssociativeCache::CSetAssociativeCache(uint32_t nSize, int nWay)
 {
   m_nSize = nSize;
-  m_nWay = nWay;
+  m_nLineSize = DEFAULT_LINESIZE;
+  m_nWay = m_nWays = nWay;
+  m_policy = CP_ROUNDROBIN;
 
   InitSets();
 }
 
+CSetAssociativeCache::CSetAssociativeCache(uint32_t nSize, int nWay, 
+					   uint32_t nLineSize, 
+					   enum CACHE_POLICY policy)
+{
+  m_nSize = nSize;
+  m_nLineSize = nLineSize;
+  m_nWay = m_nWays = nWay;
+  m_policy = policy;
+
+  InitSets();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Create - Returns a cache specialised for the line size and ways where we
+//          have one. The line sizes are the ones CDirectCache::Create
+//          specialises, as the ways must be CDirectCacheTs.
+//
+template<int LINE_SHIFT>
+static CSetAssociativeCache* CreateWays(uint32_t nSize, int nWay,
+					enum CACHE_POLICY policy)
+{
+  switch (nWay)
+    {
+    case 2:   return new CSetAssociativeCacheT<LINE_SHIFT, 2>(nSize, policy);
+    case 4:   return new CSetAssociativeCacheT<LINE_SHIFT, 4>(nSize, policy);
+    case 8:   return new CSetAssociativeCacheT<LINE_SHIFT, 8>(nSize, policy);
+    default:  return new CSetAssociativeCache(nSize, nWay, 4 << LINE_SHIFT,
+					      policy);
+    }
+}
+
+CSetAssociativeCache* CSetAssociativeCache::Create(uint32_t nSize, int nWay,
+						   uint32_t nLineSize,
+						   enum CACHE_POLICY policy)
+{
+  switch (nLineSize)
+    {
+    case 4:   return CreateWays<0>(nSize, nWay, policy);
+    case 8:   return CreateWays<1>(nSize, nWay, policy);
+    case 16:  return CreateWays<2>(nSize, nWay, policy);
+    case 32:  return CreateWays<3>(nSize, nWay, policy);
+    case 64:  return CreateWays<4>(nSize, nWay, policy);
+    default:  return new CSetAssociativeCache(nSize, nWay, nLineSize, policy);
+    }
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -62,17 +110,19 @@ CSetAssociativeCache::CSetAssociativeCache(uint32_t nSize, int nWay)
 void CSetAssociativeCache::InitSets()
 {
 
+  uint32_t nSets = (m_nSize / m_nWay) / m_nLineSize;
+
   // Allocate the direct mapped caches
   m_pSets = new CDirectCache*[m_nWay];
   for (int i = 0; i < m_nWay; i++)
-    m_pSets[i] = new CDirectCache(m_nSize/m_nWay);
+    m_pSets[i] = CDirectCache::Create(m_nSize/m_nWay, m_nLineSize);
   
   // Now Allocate the state to enable us to do the RR on lines
-  m_pSetRR = new uint8_t[m_nSize/m_nWay];
-  memset(m_pSetRR, 0, sizeof(uint8_t) * (m_nSize/m_nWay));
+  m_pSetRR = new uint32_t[nSets];
+  memset(m_pSetRR, 0, sizeof(uint32_t) * nSets);
 
   // Calc some useful into here
-  m_tagMask = ((m_nSize/m_nWay) / LINE_SIZE_B) - 1;
+  m_tagMask = nSets - 1;
   
   uint32_t temp = m_tagMask;
   m_tagBits = 0;
@@ -82,7 +132,15 @@ void CSetAssociativeCache::InitSets()
       m_tagBits++;
     }
 
-  m_tagBits += 2;
+  temp = (m_nLineSize >> 2) - 1;
+  m_lineShift = 0;
+  while (temp != 0)
+    {
+      temp = temp >> 1;
+      m_lineShift++;
+    }
+
+  m_tagBits += m_lineShift;
 }
 
 
@@ -93,8 +151,8 @@ CSetAssociativeCache::~CSetAssociativeCache()
 {
   for (int i = 0; i < m_nWay; i++)
     delete m_pSets[i];
-  delete m_pSets;
-  delete m_pSetRR;
+  delete[] m_pSets;
+  delete[] m_pSetRR;
 }
 
 
@@ -111,28 +169,15 @@ void CSetAssociativeCache::Reset()
 ///////////////////////////////////////////////////////////////////////////////
 //
 //
-uint32_t CSetAssociativeCache::Read(uint32_t addr)
+bool_t CSetAssociativeCache::Lookup(uint32_t addr, uint32_t* pWord)
 {
-  uint32_t rv;
-  int i;
-
-  // Try all our sub caches, and if we don't find one then barf
-  for (i = 0; i < m_nWay; i++)
-    {
-      try
-	{
-	  rv = m_pSets[i]->Read(addr);
-	  break;
-	}
-      catch (CCacheMiss &e)
-	{
-	}
-    }
-  if (i == m_nWay)
-    throw CCacheMiss(addr);
+  // Try all our sub caches - no exceptions here as this is the path every
+  // access takes.
+  for (int i = 0; i < m_nWay; i++)
+    if (m_pSets[i]->Lookup(addr, pWord))
+      return TRUE;
 
-  // Then try the read. Don't catch any errors, leave that for higher up
-  return rv;
+  return FALSE;
 }
 
 
@@ -144,15 +189,20 @@ void CSetAssociativeCache::WriteLine(uint32_t addr, uint32_t* pLine)
   int tag_sel;
 
   // Work out which line in a set it would be written to
-  tag_sel = (addr >> 2) & m_tagMask;
+  tag_sel = (addr >> m_lineShift) & m_tagMask;
 
+  if (m_policy == CP_RANDOM)
+    {
+      m_pSets[rand() % m_nWay]->WriteLine(addr, pLine);
+      return;
+    }
 
   // Now write the line to that set
   m_pSets[m_pSetRR[tag_sel]]->WriteLine(addr, pLine);
 
   // Update the RR info
   m_pSetRR[tag_sel]++;
-  if (m_pSetRR[tag_sel] == m_nWay)
+  if (m_pSetRR[tag_sel] == (uint32_t)m_nWay)
     m_pSetRR[tag_sel] = 0;
 }
 
@@ -162,25 +212,15 @@ void CSetAssociativeCache::WriteLine(uint32_t addr, uint32_t* pLine)
 //
 void CSetAssociativeCache::InvalidateLineByAddr(uint32_t addr)
 {
-  int i;
-
-  // Try all our sub caches, and if we don't find one then barf
-  for (i = 0; i < m_nWay; i++)
-    {
-      try
-	{
-	  m_pSets[i]->Read(addr);
-	  
-	  // Got here, so we succeeded. Now hose the line in that set
-	  m_pSets[i]->InvalidateLineByAddr(addr);
-
-	  break;
-	}
-      catch (CCacheMiss &e)
-	{
-	}
-    }
+  uint32_t temp;
 
+  // Find the set holding the line, then hose the line in that set
+  for (int i = 0; i < m_nWay; i++)
+    if (m_pSets[i]->Lookup(addr, &temp))
+      {
+	m_pSets[i]->InvalidateLineByAddr(addr);
+	break;
+      }
 }
 
 
@@ -189,23 +229,23 @@ void CSetAssociativeCache::InvalidateLineByAddr(uint32_t addr)
 //
 void CSetAssociativeCache::WriteWord(uint32_t addr, uint32_t word)
 {
-  int i;
+  uint32_t temp;
+
+  // Find the set holding the line, then write the word into that set
+  for (int i = 0; i < m_nWay; i++)
+    if (m_pSets[i]->Lookup(addr, &temp))
+      {
+	m_pSets[i]->WriteWord(addr, word);
+	break;
+      }
+}
 
-  // Try all our sub caches, and if we don't find one then barf
-  for (i = 0; i < m_nWay; i++)
-    {
-      try
-	{
-	  m_pSets[i]->Read(addr);
-	  
-	  // Got here, so we succeeded. Now write the word into that set
-	  m_pSets[i]->WriteWord(addr, word);
-
-	  break;
-	}
-      catch (CCacheMiss &e)
-	{
-	}
-    }
 
+///////////////////////////////////////////////////////////////////////////////
+// GetLine - Way w of set s is line s of the direct mapped cache for way w.
+//
+bool_t CSetAssociativeCache::GetLine(uint32_t n, uint32_t* pAddr, 
+				     uint32_t** ppData)
+{
+  return m_pSets[n % m_nWay]->GetLine(n / m_nWay, pAddr, ppData);
 }
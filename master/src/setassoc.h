@@ -26,9 +26,7 @@
 #define __SETASSOC_H__
 
 #include "cache.h"
-
-// forwards
-class CDirectCache;
+#include "direct.h"
 
 class CSetAssociativeCache : public CCache
 {
@@ -36,31 +34,91 @@ class CSetAssociativeCache : public CCache
  public:
   CSetAssociativeCache(uint32_t nSize); // Defaults to two way
   CSetAssociativeCache(uint32_t nSize, int nWay);
+  CSetAssociativeCache(uint32_t nSize, int nWay, uint32_t nLineSize,
+		       enum CACHE_POLICY policy);
   ~CSetAssociativeCache();
 
+  // Builds the specialised version for the line size and ways if there is
+  // one
+  static CSetAssociativeCache* Create(uint32_t nSize, int nWay,
+				      uint32_t nLineSize,
+				      enum CACHE_POLICY policy);
+
   // Public methods
  public: 
-  uint32_t Read(uint32_t addr);
+  bool_t   Lookup(uint32_t addr, uint32_t* pWord);
   void     WriteLine(uint32_t addr, uint32_t* pLine);
   void     WriteWord(uint32_t addr, uint32_t word);
   void     InvalidateLineByAddr(uint32_t addr);
   void     Reset();
+  bool_t   GetLine(uint32_t n, uint32_t* pAddr, uint32_t** ppData);
 
  private:
   void InitSets();
   
-  // Private data types
- private:
+  // Data - protected so that CSetAssociativeCacheT can get at it
+ protected:
   int            m_nWay;
-  uint32_t       m_nSize;
   
   uint32_t       m_tagBits;
   uint32_t       m_tagMask;
+  uint32_t       m_lineShift;
 
-  uint8_t*       m_pSetRR; // Used to round robin the lines in sets
+  enum CACHE_POLICY m_policy;
+  uint32_t*      m_pSetRR; // Used to round robin the lines in sets
 
   CDirectCache** m_pSets;
 
 };
 
+
+///////////////////////////////////////////////////////////////////////////////
+// CSetAssociativeCacheT - The same cache with the line size and number of
+//                         ways fixed at compile time. Each way is then a
+//                         CDirectCacheT, so the lookup calls its Lookup
+//                         directly rather than through the vtable, and the
+//                         loop over the ways unrolls. Create hands these
+//                         out for the common shapes.
+//
+template<int LINE_SHIFT, int WAYS>
+class CSetAssociativeCacheT: public CSetAssociativeCache
+{
+ public:
+  CSetAssociativeCacheT(uint32_t nSize, enum CACHE_POLICY policy)
+    : CSetAssociativeCache(nSize, WAYS, 4 << LINE_SHIFT, policy) {}
+
+ public:
+  bool_t   Lookup(uint32_t addr, uint32_t* pWord);
+  void     WriteWord(uint32_t addr, uint32_t word);
+
+ private:
+  inline CDirectCacheT<LINE_SHIFT>* Way(int i)
+    { return (CDirectCacheT<LINE_SHIFT>*)m_pSets[i]; }
+};
+
+template<int LINE_SHIFT, int WAYS>
+inline bool_t CSetAssociativeCacheT<LINE_SHIFT, WAYS>::Lookup(uint32_t addr,
+							      uint32_t* pWord)
+{
+  for (int i = 0; i < WAYS; i++)
+    if (Way(i)->CDirectCacheT<LINE_SHIFT>::Lookup(addr, pWord))
+      return TRUE;
+
+  return FALSE;
+}
+
+template<int LINE_SHIFT, int WAYS>
+inline void CSetAssociativeCacheT<LINE_SHIFT, WAYS>::WriteWord(uint32_t addr,
+							       uint32_t word)
+{
+  uint32_t temp;
+
+  for (int i = 0; i < WAYS; i++)
+    if (Way(i)->CDirectCacheT<LINE_SHIFT>::Lookup(addr, &temp))
+      {
+	Way(i)->CDirectCacheT<LINE_SHIFT>::WriteWord(addr, word);
+	break;
+      }
+}
+
 #endif // __SETASSOC_H__
@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   stats.cpp
+// header stats.h
+// info   Implements the statistics registry.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "swarm.h"
+#include "stats.h"
+
+STAT* CStats::s_pHead = NULL;
+STAT* CStats::s_pTail = NULL;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Reset -
+//
+void CHistogram::Reset()
+{
+  memset(m_nBuckets, 0, sizeof(m_nBuckets));
+  m_nCount = 0;
+  m_nTotal = 0;
+  m_nMax = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Register - One for each thing we can count.
+//
+void CStats::Register(const void* pOwner, const char* strName,
+		      const uint32_t* pCounter)
+{
+  Add(pOwner, strName, ST_COUNTER32, pCounter);
+}
+
+void CStats::Register(const void* pOwner, const char* strName,
+		      const uint64_t* pCounter)
+{
+  Add(pOwner, strName, ST_COUNTER64, pCounter);
+}
+
+void CStats::Register(const void* pOwner, const char* strName,
+		      const CHistogram* pHistogram)
+{
+  Add(pOwner, strName, ST_HISTOGRAM, pHistogram);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add - Puts a new entry on the end of the list.
+//
+void CStats::Add(const void* pOwner, const char* strName, STAT_TYPE type,
+		 const void* pValue)
+{
+  STAT* pStat = (STAT*)malloc(sizeof(STAT));
+
+  pStat->strName = strdup(strName);
+  pStat->pOwner = pOwner;
+  pStat->type = type;
+  pStat->pValue = pValue;
+  pStat->pNext = NULL;
+
+  if (s_pTail == NULL)
+    s_pHead = pStat;
+  else
+    s_pTail->pNext = pStat;
+  s_pTail = pStat;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Unregister - Drops everything pOwner registered.
+//
+void CStats::Unregister(const void* pOwner)
+{
+  STAT** ppStat = &s_pHead;
+
+  s_pTail = NULL;
+  while (*ppStat != NULL)
+    {
+      STAT* pStat = *ppStat;
+
+      if (pStat->pOwner == pOwner)
+	{
+	  *ppStat = pStat->pNext;
+	  free(pStat->strName);
+	  free(pStat);
+	}
+      else
+	{
+	  s_pTail = pStat;
+	  ppStat = &pStat->pNext;
+	}
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - See stats.h.
+//
+bool_t CStats::Write(const char* strFile)
+{
+  size_t nLen = strlen(strFile);
+  char* strTemp = (char*)malloc(nLen + 5);
+  bool_t bCSV = (nLen >= 4) && (strcmp(strFile + nLen - 4, ".csv") == 0);
+
+  sprintf(strTemp, "%s.new", strFile);
+
+  FILE* fp = fopen(strTemp, "w");
+  if (fp == NULL)
+    {
+      free(strTemp);
+      return FALSE;
+    }
+
+  if (bCSV)
+    WriteCSV(fp);
+  else
+    WriteJSON(fp);
+
+  bool_t bOK = (fclose(fp) == 0) && (rename(strTemp, strFile) == 0);
+  if (!bOK)
+    unlink(strTemp);
+  free(strTemp);
+
+  return bOK;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteJSON - An object of counters and an object of histograms, each keyed
+//             by name. Histogram buckets are [base, count] pairs, leaving
+//             out the empty ones.
+//
+void CStats::WriteJSON(FILE* fp)
+{
+  const char* strSep = "";
+
+  fprintf(fp, "{\n  \"counters\": {");
+  for (STAT* pStat = s_pHead; pStat != NULL; pStat = pStat->pNext)
+    {
+      unsigned long long nValue;
+
+      if (pStat->type == ST_HISTOGRAM)
+	continue;
+      if (pStat->type == ST_COUNTER32)
+	nValue = *((const uint32_t*)pStat->pValue);
+      else
+	nValue = *((const uint64_t*)pStat->pValue);
+
+      fprintf(fp, "%s\n    \"%s\": %llu", strSep, pStat->strName, nValue);
+      strSep = ",";
+    }
+
+  fprintf(fp, "\n  },\n  \"histograms\": {");
+  strSep = "";
+  for (STAT* pStat = s_pHead; pStat != NULL; pStat = pStat->pNext)
+    {
+      if (pStat->type != ST_HISTOGRAM)
+	continue;
+
+      CHistogram* pHist = (CHistogram*)pStat->pValue;
+      const char* strBucketSep = "";
+
+      fprintf(fp, "%s\n    \"%s\": {\"count\": %llu, \"total\": %llu, "
+	      "\"max\": %u, \"buckets\": [", strSep, pStat->strName,
+	      (unsigned long long)pHist->GetCount(),
+	      (unsigned long long)pHist->GetTotal(), pHist->GetMax());
+      for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+	if (pHist->GetBucket(i) != 0)
+	  {
+	    fprintf(fp, "%s[%u, %llu]", strBucketSep,
+		    CHistogram::BucketBase(i),
+		    (unsigned long long)pHist->GetBucket(i));
+	    strBucketSep = ", ";
+	  }
+      fprintf(fp, "]}");
+      strSep = ",";
+    }
+  fprintf(fp, "\n  }\n}\n");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteCSV - A row per counter. Each histogram gives rows for its count,
+//            total and max, and one per non-empty bucket named by its base.
+//
+void CStats::WriteCSV(FILE* fp)
+{
+  fprintf(fp, "name,value\n");
+  for (STAT* pStat = s_pHead; pStat != NULL; pStat = pStat->pNext)
+    {
+      switch (pStat->type)
+	{
+	case ST_COUNTER32:
+	  fprintf(fp, "%s,%u\n", pStat->strName,
+		  *((const uint32_t*)pStat->pValue));
+	  break;
+
+	case ST_COUNTER64:
+	  fprintf(fp, "%s,%llu\n", pStat->strName,
+		  (unsigned long long)*((const uint64_t*)pStat->pValue));
+	  break;
+
+	case ST_HISTOGRAM:
+	  {
+	    CHistogram* pHist = (CHistogram*)pStat->pValue;
+
+	    fprintf(fp, "%s.count,%llu\n", pStat->strName,
+		    (unsigned long long)pHist->GetCount());
+	    fprintf(fp, "%s.total,%llu\n", pStat->strName,
+		    (unsigned long long)pHist->GetTotal());
+	    fprintf(fp, "%s.max,%u\n", pStat->strName, pHist->GetMax());
+	    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+	      if (pHist->GetBucket(i) != 0)
+		fprintf(fp, "%s[%u],%llu\n", pStat->strName,
+			CHistogram::BucketBase(i),
+			(unsigned long long)pHist->GetBucket(i));
+	  }
+	  break;
+	}
+    }
+}
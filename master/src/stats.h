@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   stats.h
+// header n/a
+// info   A list of every counter and histogram in the simulator, so they
+//        can all be written out in one go as JSON or CSV.
+//
+//        Components keep counting in their own members as they always
+//        have; registering just hands over a pointer to one, so counting
+//        costs nothing more. Each is registered with a name ("dma.copies")
+//        and an owner, and the owner unregisters everything it gave us
+//        before it goes away.
+//
+//        Histograms have a bucket for 0 and one for each power of two, so
+//        bucket n holds values from 2^(n-1) up to 2^n - 1.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+#include "swarm.h"
+
+#define HISTOGRAM_BUCKETS 33
+
+class CHistogram
+{
+  // Constructors and destructor
+ public:
+  CHistogram() { Reset(); }
+
+  // Public methods
+ public:
+  inline void Add(uint32_t nValue)
+    {
+      m_nBuckets[Bucket(nValue)]++;
+      m_nCount++;
+      m_nTotal += nValue;
+      if (nValue > m_nMax)
+	m_nMax = nValue;
+    }
+  void Reset();
+
+  inline uint64_t GetCount() { return m_nCount; }
+  inline uint64_t GetTotal() { return m_nTotal; }
+  inline uint32_t GetMax() { return m_nMax; }
+  inline uint64_t GetBucket(uint32_t n) { return m_nBuckets[n]; }
+
+  // The smallest value that goes in bucket n
+  static inline uint32_t BucketBase(uint32_t n)
+    { return (n == 0) ? 0 : (1 << (n - 1)); }
+
+  // Private methods
+ private:
+  static inline uint32_t Bucket(uint32_t nValue)
+    {
+#ifdef __GNUC__
+      return (nValue == 0) ? 0 : 32 - __builtin_clz(nValue);
+#else
+      uint32_t n = 0;
+      while (nValue != 0)
+	{
+	  nValue >>= 1;
+	  n++;
+	}
+      return n;
+#endif
+    }
+
+  // Private data
+ private:
+  uint64_t m_nBuckets[HISTOGRAM_BUCKETS];
+  uint64_t m_nCount;
+  uint64_t m_nTotal;
+  uint32_t m_nMax;
+};
+
+
+enum STAT_TYPE {ST_COUNTER32, ST_COUNTER64, ST_HISTOGRAM};
+
+typedef struct STATTAG
+{
+  char*       strName;
+  const void* pOwner;
+  STAT_TYPE   type;
+  const void* pValue;
+  struct STATTAG* pNext;
+} STAT;
+
+class CStats
+{
+  // Public methods. Everything is static, as there is only the one list.
+ public:
+  static void Register(const void* pOwner, const char* strName,
+		       const uint32_t* pCounter);
+  static void Register(const void* pOwner, const char* strName,
+		       const uint64_t* pCounter);
+  static void Register(const void* pOwner, const char* strName,
+		       const CHistogram* pHistogram);
+  static void Unregister(const void* pOwner);
+
+  // Writes CSV if the file name ends in .csv, otherwise JSON. The file is
+  // written beside strFile and renamed over it, so anyone watching it never
+  // sees half of one. Returns FALSE if it couldn't be written.
+  static bool_t Write(const char* strFile);
+
+  static void WriteJSON(FILE* fp);
+  static void WriteCSV(FILE* fp);
+
+  // Private methods
+ private:
+  static void Add(const void* pOwner, const char* strName, STAT_TYPE type,
+		  const void* pValue);
+
+  // Private data
+ private:
+  static STAT* s_pHead;      // In the order they were registered
+  static STAT* s_pTail;
+};
+
+#endif // __STATS_H__
@@ -30,7 +30,7 @@
 #define SWI_CALL_MASK 0x00800000
 
 typedef uint32_t SWI_CALL(uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3);
-#define MAX_SWI_CALL 16
+#define MAX_SWI_CALL 32
 
 class CSWISetException : public CException
 {
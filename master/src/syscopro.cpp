@@ -26,6 +26,7 @@
 #include "syscopro.h"
 #include <string.h>
 #include "isa.h"
+#include "stats.h"
 #include <iostream.h>
 
 #include "memory.cpp"
@@ -59,9 +60,23 @@ const static uint32_t regPermissions[16] = {REG_READ, REG_READ | REG_WRITE,
 #define UPDATE_IP  0x8
 #define UPDATE_CPA 0x10
 
+// Counters, read with op2 from CYCLE_REG. The 3C counters only count if
+// swarm has been asked for detailed cache stats; capacity misses are the
+// ones left over.
 #define CNTR_CYCLE 0x0  // Cycle counter
-#define CNTR_CHIT  0x1  // Cache hit
-#define CNTR_CMISS 0x2  // Cache miss
+#define CNTR_CHIT  0x1  // Cache hit (reads)
+#define CNTR_CMISS 0x2  // Cache miss (reads)
+#define CNTR_IMISS 0x3  // Instruction fetch miss
+#define CNTR_DMISS 0x4  // Data read miss
+#define CNTR_WMISS 0x5  // Write miss
+#define CNTR_COMP  0x6  // Compulsory miss
+#define CNTR_CONF  0x7  // Conflict miss
+
+// What the counters are called in the stats
+static const char* s_strCounters[SC_NUM_COUNTERS] =
+  {"cp15.cycles", "cp15.cache_hits", "cp15.cache_misses", "cp15.fetch_misses",
+   "cp15.read_misses", "cp15.write_misses", "cp15.compulsory_misses",
+   "cp15.conflict_misses"};
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -105,6 +120,16 @@ CSysCoPro::CONTROL* CSysCoPro::create_noop()
 }
 
 
+/******************************************************************************
+ * is_noop - Is what is left of a control list from n on just a noop?
+ */
+bool_t CSysCoPro::is_noop(CONTROL** list, uint32_t n)
+{
+  return ((list[n] != NULL) && (list[n]->updates == UPDATE_IP) &&
+	  (list[n]->bWorking == FALSE) && (list[n + 1] == NULL));
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // CSysCoPro - 
 //
@@ -131,6 +156,9 @@ CSysCoPro::CSysCoPro()
   m_busPrevious = (COPROBUS*)NEW(COPROBUS);
   memset(m_busPrevious, 0, sizeof(COPROBUS));
 
+  for (int i = 0; i < SC_NUM_COUNTERS; i++)
+    CStats::Register(this, s_strCounters[i], &m_regsCounters[i]);
+
   Reset();
 }
 
@@ -140,6 +168,8 @@ CSysCoPro::CSysCoPro()
 //
 CSysCoPro::~CSysCoPro()
 {
+  CStats::Unregister(this);
+
   if (m_ctrlListCur != NULL)
     {
       for (int i = 0; m_ctrlListCur[i] != NULL; i++)
@@ -197,7 +227,7 @@ void CSysCoPro::Reset()
   m_nCtrlCur = 0;
 
   //m_regsWorking[CYCLE_REG] = 0;
-  memset(m_regsCounters, 0, sizeof(uint32_t) * 3);
+  memset(m_regsCounters, 0, sizeof(uint32_t) * SC_NUM_COUNTERS);
 
   m_regsWorking[1] = 0x00000001; // Turn on the MMU
 }
@@ -304,6 +334,33 @@ void CSysCoPro::Cycle(COPROBUS* bus)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// IsIdle - We've nothing to do if we're running noops and the instruction
+//          waiting to be decoded isn't one of ours. Until the core fetches
+//          one of ours each cycle would leave us just as we are, bar the
+//          cycle counter.
+//
+bool_t CSysCoPro::IsIdle()
+{
+  INST i;
+
+  i.raw = m_iPipe[1];
+  if ((i.cdt.cpn == SYSCOPRO_ID) && ((i.raw & CRT_MASK) == CRT_SIG))
+    return FALSE;
+
+  return (is_noop(m_ctrlListCur, m_nCtrlCur) && is_noop(m_ctrlListNext, 0));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Skip - Catches the cycle counter up with the cycles we weren't given.
+//
+void CSysCoPro::Skip(uint64_t nCycles)
+{
+  m_regsCounters[CNTR_CYCLE] += (uint32_t)nCycles;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //
@@ -517,6 +574,22 @@ void CSysCoPro::NoteEvent(enum SC_EVENT e)
       break;
     case SC_CACHEMISS:
       m_regsCounters[CNTR_CMISS]++;
+      break;
+    case SC_IMISS:
+      m_regsCounters[CNTR_IMISS]++;
+      break;
+    case SC_DREADMISS:
+      m_regsCounters[CNTR_DMISS]++;
+      break;
+    case SC_WRITEMISS:
+      m_regsCounters[CNTR_WMISS]++;
+      break;
+    case SC_COMPULSORY:
+      m_regsCounters[CNTR_COMP]++;
+      break;
+    case SC_CONFLICT:
+      m_regsCounters[CNTR_CONF]++;
+      break;
     }
 }
 
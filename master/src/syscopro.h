@@ -31,7 +31,10 @@
 #include "cache.h"
 #include "memory.h"
 
-enum SC_EVENT {SC_CACHEHIT, SC_CACHEMISS};
+enum SC_EVENT {SC_CACHEHIT, SC_CACHEMISS, SC_IMISS, SC_DREADMISS, 
+	       SC_WRITEMISS, SC_COMPULSORY, SC_CONFLICT};
+
+#define SC_NUM_COUNTERS 8
 
 class CSysCoPro: public CCoProcessor
 {
@@ -44,6 +47,8 @@ class CSysCoPro: public CCoProcessor
   void Cycle(COPROBUS* bus);
   void DebugDump();
   void Reset();
+  bool_t IsIdle();
+  void Skip(uint64_t nCycles);
 
   void NoteEvent(enum SC_EVENT e); // Used to send an event
 
@@ -71,6 +76,7 @@ class CSysCoPro: public CCoProcessor
   } CONTROL;
 
   CONTROL* create_noop();
+  bool_t is_noop(CONTROL** list, uint32_t n);
 
   void CacheOperations(CONTROL* ctrl, uint32_t data);
 
@@ -88,7 +94,7 @@ class CSysCoPro: public CCoProcessor
   uint32_t m_regDataIn;
   uint32_t m_regDataOut;
 
-  uint32_t m_regsCounters[3]; // Stores rpcc, cache misses, etc.
+  uint32_t m_regsCounters[SC_NUM_COUNTERS]; // Stores rpcc, cache misses, etc.
 
   CCache*  m_pDataCache;
   CCache*  m_pInstCache;
@@ -0,0 +1,264 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   trace.cpp
+// header trace.h
+// info   Implements the memory access trace reader and writer. See trace.h
+//        for the file format.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include "swarm.h"
+#include "trace.h"
+
+// The most a single record can take up: a header and a 5 byte varint
+#define MAX_RECORD 6
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceException - Constructor
+//
+CTraceException::CTraceException(const char* strError, const char* strFile)
+{
+  free(m_strError);
+
+  if (strFile == NULL)
+    {
+      m_strError = strdup(strError);
+      return;
+    }
+
+  m_strError = (char*)malloc(strlen(strError) + strlen(strFile) + 3);
+  sprintf(m_strError, "%s: %s", strError, strFile);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceWriter - Constructor
+//
+CTraceWriter::CTraceWriter(const char* strFile)
+{
+  m_fp = fopen(strFile, "wb");
+  if (m_fp == NULL)
+    throw CTraceException("Failed to create trace file", strFile);
+
+  m_pBuf = new uint8_t[TRACE_BUF_SIZE];
+  m_nBuf = 0;
+  m_nRun = 0;
+  m_nCount = 0;
+  memset(m_last, 0, sizeof(m_last));
+
+  fwrite(TRACE_MAGIC, 1, 8, m_fp);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CTraceWriter - Destructor
+//
+CTraceWriter::~CTraceWriter()
+{
+  Flush();
+  fclose(m_fp);
+
+  delete[] m_pBuf;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Flush - Pushes everything recorded so far out to the file.
+//
+void CTraceWriter::Flush()
+{
+  if (m_nRun != 0)
+    FlushRun();
+
+  if (m_nBuf != 0)
+    fwrite(m_pBuf, 1, m_nBuf, m_fp);
+  m_nBuf = 0;
+
+  fflush(m_fp);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FlushRun - Writes out the pending run of sequential fetches.
+//
+void CTraceWriter::FlushRun()
+{
+  Encode(TR_FETCH | 0x10 | ((m_nRun - 1) << 5), 0);
+  m_nRun = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Encode - Adds a record to the output buffer. The delta is only written if
+//          the header doesn't have the sequential bit set.
+//
+void CTraceWriter::Encode(uint8_t header, uint32_t delta)
+{
+  if (m_nBuf + MAX_RECORD > TRACE_BUF_SIZE)
+    {
+      fwrite(m_pBuf, 1, m_nBuf, m_fp);
+      m_nBuf = 0;
+    }
+
+  m_pBuf[m_nBuf++] = header;
+  if (header & 0x10)
+    return;
+
+  // Zig-zag encode so small negative steps stay small
+  uint32_t val = (delta << 1) ^ (uint32_t)(((int32_t)delta) >> 31);
+
+  while (val >= 0x80)
+    {
+      m_pBuf[m_nBuf++] = (val & 0x7F) | 0x80;
+      val >>= 7;
+    }
+  m_pBuf[m_nBuf++] = val;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceReader - Constructor
+//
+CTraceReader::CTraceReader(const char* strFile)
+{
+  char magic[8];
+
+  m_fp = fopen(strFile, "rb");
+  if (m_fp == NULL)
+    throw CTraceException("Failed to open trace file", strFile);
+
+  if ((fread(magic, 1, 8, m_fp) != 8) ||
+      (memcmp(magic, TRACE_MAGIC, 8) != 0))
+    {
+      fclose(m_fp);
+      throw CTraceException("Not a SWARM trace file", strFile);
+    }
+
+  m_pBuf = new uint8_t[TRACE_BUF_SIZE];
+  m_nPos = 0;
+  m_nBuf = 0;
+  m_nRun = 0;
+  m_bEOF = FALSE;
+  memset(m_last, 0, sizeof(m_last));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CTraceReader - Destructor
+//
+CTraceReader::~CTraceReader()
+{
+  fclose(m_fp);
+  delete[] m_pBuf;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fill - Moves what's left in the buffer to the front and tops it up from
+//        the file. Returns FALSE once there is nothing left to read.
+//
+bool_t CTraceReader::Fill()
+{
+  uint32_t nLeft = m_nBuf - m_nPos;
+
+  memmove(m_pBuf, m_pBuf + m_nPos, nLeft);
+  m_nPos = 0;
+  m_nBuf = nLeft;
+
+  if (!m_bEOF)
+    {
+      size_t n = fread(m_pBuf + m_nBuf, 1, TRACE_BUF_SIZE - m_nBuf, m_fp);
+      if (n == 0)
+	m_bEOF = TRUE;
+      m_nBuf += n;
+    }
+
+  return m_nBuf != 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read - Decodes up to nMax records into pRecs.
+//
+uint32_t CTraceReader::Read(TRACEREC* pRecs, uint32_t nMax)
+{
+  uint32_t i = 0;
+
+  while (i < nMax)
+    {
+      // Hand out any sequential fetches first
+      if (m_nRun != 0)
+	{
+	  m_last[TR_FETCH] += 4;
+	  pRecs[i].addr = m_last[TR_FETCH];
+	  pRecs[i].type = TR_FETCH;
+	  pRecs[i].size = 0;
+	  i++;
+	  m_nRun--;
+	  continue;
+	}
+
+      // Make sure there's a whole record in the buffer
+      if ((m_nBuf - m_nPos < MAX_RECORD) && !m_bEOF)
+	Fill();
+      if (m_nPos == m_nBuf)
+	break;
+
+      uint8_t header = m_pBuf[m_nPos++];
+      uint32_t type = header & 0x3;
+
+      if (type > TR_STORE)
+	throw CTraceException("Corrupt trace record");
+
+      if (header & 0x10)
+	{
+	  if ((type == TR_FETCH) && ((header & 0xC) == 0))
+	    {
+	      m_nRun = (header >> 5) + 1;
+	      continue;
+	    }
+	  m_last[type] += 4;
+	}
+      else
+	{
+	  uint32_t val = 0;
+	  uint32_t shift = 0;
+	  uint8_t  b;
+
+	  do
+	    {
+	      if (m_nPos == m_nBuf)
+		throw CTraceException("Truncated trace record");
+	      b = m_pBuf[m_nPos++];
+	      val |= (b & 0x7F) << shift;
+	      shift += 7;
+	    }
+	  while (b & 0x80);
+
+	  m_last[type] += (val >> 1) ^ (0 - (val & 1));
+	}
+
+      pRecs[i].addr = m_last[type];
+      pRecs[i].type = type;
+      pRecs[i].size = (header >> 2) & 0x3;
+      i++;
+    }
+
+  return i;
+}
@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   trace.h
+// header n/a
+// info   Reads and writes memory access traces. A trace is the stream of
+//        fetches, loads and stores the processor makes to the cache, so
+//        it can be replayed through different cache setups without running
+//        the program again (see bin/src/cachesim).
+//
+//        The file starts with the 8 byte magic "SWTRACE1". Each record
+//        then starts with a header byte:
+//
+//          bits 0-1  type (0 fetch, 1 load, 2 store)
+//          bits 2-3  size (0 word, 1 byte, 2 half word - as PINOUT.bw)
+//          bit  4    sequential - address is the last one of this type + 4
+//          bits 5-7  for sequential word fetches, the number of extra
+//                    sequential fetches that follow (0 - 7)
+//
+//        If the sequential bit is clear then the difference from the last
+//        address of this type follows, zig-zag encoded as a varint (seven
+//        bits a byte, low bits first, top bit set if more follow).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdio.h>
+#include "swarm.h"
+
+enum TRACE_TYPE {TR_FETCH = 0, TR_LOAD, TR_STORE};
+
+#define TRACE_MAGIC    "SWTRACE1"
+#define TRACE_BUF_SIZE (64 * 1024)
+
+typedef struct TRTAG
+{
+  uint32_t addr;
+  uint8_t  type;  // enum TRACE_TYPE
+  uint8_t  size;  // 0 = word, 1 = byte, 2 = half word
+} TRACEREC;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceException - Thrown if we can't open or understand a trace file.
+//
+class CTraceException : public CException
+{
+ public:
+  CTraceException(const char* strError, const char* strFile = NULL);
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceWriter - Encodes accesses into a trace file.
+//
+class CTraceWriter
+{
+ public:
+  CTraceWriter(const char* strFile);
+  ~CTraceWriter();
+
+ public:
+  inline void Record(enum TRACE_TYPE type, uint32_t size, uint32_t addr);
+  void Flush();
+  inline uint64_t GetCount() { return m_nCount; }
+
+ private:
+  void FlushRun();
+  void Encode(uint8_t header, uint32_t delta);
+
+ private:
+  FILE*    m_fp;
+  uint8_t* m_pBuf;
+  uint32_t m_nBuf;
+  uint32_t m_last[3];   // Last address seen for each type
+  uint32_t m_nRun;      // Pending sequential word fetches
+  uint64_t m_nCount;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceReader - Streams records back out of a trace file. Read fills an
+//                array with as many records as it can, and returns the
+//                number read, which is 0 at the end of the file.
+//
+class CTraceReader
+{
+ public:
+  CTraceReader(const char* strFile);
+  ~CTraceReader();
+
+ public:
+  uint32_t Read(TRACEREC* pRecs, uint32_t nMax);
+
+ private:
+  bool_t Fill();
+
+ private:
+  FILE*    m_fp;
+  uint8_t* m_pBuf;
+  uint32_t m_nPos;
+  uint32_t m_nBuf;
+  bool_t   m_bEOF;
+  uint32_t m_last[3];
+  uint32_t m_nRun;      // Sequential fetches still to hand out
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Record - Adds an access to the trace. Sequential word fetches are batched
+//          up, as they are most of what the processor does.
+//
+inline void CTraceWriter::Record(enum TRACE_TYPE type, uint32_t size,
+				 uint32_t addr)
+{
+  m_nCount++;
+
+  if ((type == TR_FETCH) && (size == 0) &&
+      (addr == m_last[TR_FETCH] + 4) && (m_nRun < 8))
+    {
+      m_last[TR_FETCH] = addr;
+      m_nRun++;
+      return;
+    }
+
+  if (m_nRun != 0)
+    FlushRun();
+
+  if ((type == TR_FETCH) && (size == 0) && (addr == m_last[TR_FETCH] + 4))
+    {
+      m_last[TR_FETCH] = addr;
+      m_nRun = 1;
+      return;
+    }
+
+  uint8_t header = type | (size << 2);
+
+  if (addr == m_last[type] + 4)
+    Encode(header | 0x10, 0);
+  else
+    Encode(header, addr - m_last[type]);
+
+  m_last[type] = addr;
+}
+
+#endif // __TRACE_H__
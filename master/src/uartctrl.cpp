@@ -1,50 +1,114 @@
 //////////////////////////////////////////////////////////////////////////////
-// 
+//
 // Copyright (C) 2001 C Hanish Menon [www.hanishkvc.com]
-// 
+//
 // This program is free software; you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
 // the Free Software Foundation; either version 2 of the License, or
 // (at your option) any later version.
-// 
+//
 // This program is distributed in the hope that it will be useful,
 // but WITHOUT ANY WARRANTY; without even the implied warranty of
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
 // GNU General Public License for more details.
-// 
+//
 // You should have received a copy of the GNU General Public License
 // along with this program; if not, write to the Free Software
 // Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
-// 
+//
 // Name   : uartctrl.cpp
 // Author : C Hanish Menon [www.hanishkvc.com]
-// 
+//
 //////////////////////////////////////////////////////////////////////////////
 
 #include "swarm.h"
 #include "uartctrl.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
 #include <fcntl.h>
 #include <termios.h>
-#define __USE_GNU
-#define __USE_XOPEN
-#include <stdlib.h>
 
 #define MODULE_NAME "UARTCTRL"
 
+#define FIFO_MASK (UART_FIFO_SIZE - 1)
+
+///////////////////////////////////////////////////////////////////////////////
+// fifo_put - Called by the producer only. Returns FALSE if full.
+//
+static inline bool_t fifo_put(UARTFIFO* f, uint8_t c)
+{
+	uint32_t head = f->head;
+
+	if ((head - f->tail) == UART_FIFO_SIZE)
+		return FALSE;
+
+	f->data[head & FIFO_MASK] = c;
+	__sync_synchronize();
+	f->head = head + 1;
+	return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fifo_get - Called by the consumer only. Returns FALSE if empty.
+//
+static inline bool_t fifo_get(UARTFIFO* f, uint8_t* c)
+{
+	uint32_t tail = f->tail;
+
+	if (f->head == tail)
+		return FALSE;
+
+	__sync_synchronize();
+	*c = f->data[tail & FIFO_MASK];
+	__sync_synchronize();
+	f->tail = tail + 1;
+	return TRUE;
+}
+
+static inline uint32_t fifo_count(UARTFIFO* f)
+{
+	return f->head - f->tail;
+}
+
+static int set_nonblock(int fd)
+{
+	int curFlags;
+
+	if( (curFlags = fcntl(fd, F_GETFL, 0)) < 0 )
+		return -1;
+	return fcntl(fd, F_SETFL, curFlags | O_NONBLOCK);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CUARTException -
+//
+CUARTException::CUARTException(const char* strError)
+{
+	free(m_strError);
+	m_strError = strdup(strError);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
-// ~CUARTCtrl - 
+// GetPty - Opens a new pty. We keep the slave open too, else the master
+//          reports a hangup until someone connects to it.
 //
 int CUARTCtrl::GetPty()
 {
 	char *namepty;
 	struct termios tiopty;
-	int curFlags;
-	
-	if((masterpty = getpt()) == 0)
+	int masterpty, slavepty;
+
+	if((masterpty = posix_openpt(O_RDWR | O_NOCTTY)) < 0)
 	{
 		printf(MODULE_NAME": Error getting the pty\n");
 		return -1;
@@ -60,74 +124,196 @@ int CUARTCtrl::GetPty()
 		printf(MODULE_NAME": Error getting slave pty name\n");
 		return -1;
 	}
-	else
+	if( (slavepty = open(namepty, O_RDWR | O_NOCTTY)) < 0 )
 	{
-		if( tcgetattr(masterpty, &tiopty) < 0 )
-		{
-			printf(MODULE_NAME": Error getting masterpty terminfo\n");
-			return -1;
-		}
-		tiopty.c_lflag &= ~(ECHO|ICANON);
-		tiopty.c_cc[VMIN] = 0;
-		tiopty.c_cc[VTIME] = 0;
-		if( tcsetattr(masterpty, TCSANOW, &tiopty) < 0 )
-		{
-			printf(MODULE_NAME": Error setting masterpty terminfo\n");
-			return -1;
-		}
-		if( tcgetattr(masterpty, &tiopty) < 0 )
-		{
-			printf(MODULE_NAME": Error getting masterpty terminfo\n");
+		printf(MODULE_NAME": Error opening slave pty\n");
+		return -1;
+	}
+	if( tcgetattr(slavepty, &tiopty) < 0 )
+	{
+		printf(MODULE_NAME": Error getting slave pty terminfo\n");
+		return -1;
+	}
+	cfmakeraw(&tiopty);
+	if( tcsetattr(slavepty, TCSANOW, &tiopty) < 0 )
+	{
+		printf(MODULE_NAME": Error setting slave pty terminfo\n");
+		return -1;
+	}
+	if( set_nonblock(masterpty) < 0 )
+	{
+		printf(MODULE_NAME": Error setting masterpty Flags\n");
+		return -1;
+	}
+
+	printf(MODULE_NAME": Serial device Slave pts [%s]\n", namepty);
+
+	m_inFd = m_outFd = masterpty;
+	m_slaveFd = slavepty;
+	m_bInPollable = TRUE;
+	return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// OpenBackend - Sets up the host end from the backend string (see
+//               uartctrl.h).
+//
+int CUARTCtrl::OpenBackend(const char* strBackend)
+{
+	struct stat st;
+
+	if (strcmp(strBackend, "pty") == 0)
+		return GetPty();
+
+	if (strcmp(strBackend, "stdio") == 0)
+	{
+		m_inFd = 0;
+		m_outFd = 1;
+	}
+	else if (strncmp(strBackend, "file:", 5) == 0)
+	{
+		char* strOut = strdup(strBackend + 5);
+		char* strIn = strchr(strOut, ',');
+
+		if (strIn != NULL)
+			*strIn++ = '\0';
+
+		m_outFd = open(strOut, O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if ((m_outFd >= 0) && (strIn != NULL))
+			m_inFd = open(strIn, O_RDONLY);
+		free(strOut);
+
+		if ((m_outFd < 0) || ((strIn != NULL) && (m_inFd < 0)))
 			return -1;
-		}
-		//printf(MODULE_NAME": Canonical mode = [%c], tiopty.MIN = [%x], tiopty.TIME = [%x]\n", 
-		//								(tiopty.c_lflag & ICANON) ? 'Y' : 'N',
-		//								tiopty.c_cc[VMIN], tiopty.c_cc[VTIME]);
-		// Forced to set O_NONBLOCK mode has Non Canonical mode of terminal
-		// and 0 MIN and 0 TIME didn't help make read non blocking - HanishKVC
-		if( (curFlags = fcntl(masterpty, F_GETFL, 0)) < 0 )
-		{
-			printf(MODULE_NAME": Error getting masterpty Flags\n");
+	}
+	else if (strncmp(strBackend, "unix:", 5) == 0)
+	{
+		struct sockaddr_un sa;
+
+		if (strlen(strBackend + 5) >= sizeof(sa.sun_path))
 			return -1;
-		}
-		curFlags |= O_NONBLOCK;
-		if( (curFlags = fcntl(masterpty, F_SETFL, curFlags)) < 0 )
-		{
-			printf(MODULE_NAME": Error getting masterpty Flags\n");
+
+		memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		strcpy(sa.sun_path, strBackend + 5);
+		unlink(sa.sun_path);
+
+		m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if ((m_listenFd < 0) ||
+		    (bind(m_listenFd, (struct sockaddr*)&sa, sizeof(sa)) < 0) ||
+		    (listen(m_listenFd, 1) < 0) ||
+		    (set_nonblock(m_listenFd) < 0))
 			return -1;
-		}
-		
-		printf(MODULE_NAME": Serial device Slave pts [%s]\n", namepty);
-		printf(MODULE_NAME": Connect to Slave pts if required, and press ENTER key\n");
-		getchar();
+
+		m_strSocket = strdup(sa.sun_path);
+		printf(MODULE_NAME": Serial device on socket [%s]\n", m_strSocket);
+		return 0;
 	}
+	else
+		return -1;
+
+	// epoll won't take regular files - they're always ready anyway
+	m_bInPollable = (m_inFd >= 0) && (fstat(m_inFd, &st) == 0) &&
+		!S_ISREG(st.st_mode);
 	return 0;
 }
 
+
 ///////////////////////////////////////////////////////////////////////////////
-// CUARTCtrl - 
+// CUARTCtrl - Throws a CUARTException if the backend can't be set up.
 //
-CUARTCtrl::CUARTCtrl()
+CUARTCtrl::CUARTCtrl(const char* strBackend)
 {
-#ifndef QUIET	
+#ifndef QUIET
 	printf(MODULE_NAME": In Constructor\n");
-#endif			
-	if(GetPty() < 0)
-		_exit(-1);
+#endif
+	m_inFd = m_outFd = m_slaveFd = m_listenFd = -1;
+	m_wake[0] = m_wake[1] = -1;
+	m_epFd = -1;
+	m_strSocket = NULL;
+	m_bInPollable = FALSE;
+	m_bOutBlocked = FALSE;
+	m_nInterest = 0;
+	m_bRxReady = m_bRxStalled = m_bStop = 0;
+	memset(&m_rx, 0, sizeof(UARTFIFO));
+	memset(&m_tx, 0, sizeof(UARTFIFO));
+
 	bRxBufferFree = 1;
 	Reset();
+
+	if (OpenBackend(strBackend) < 0)
+	{
+		Close();
+		throw CUARTException("Can't open UART backend");
+	}
+
+	if ((pipe(m_wake) < 0) || (set_nonblock(m_wake[0]) < 0) ||
+	    (set_nonblock(m_wake[1]) < 0) ||
+	    ((m_epFd = epoll_create(4)) < 0))
+	{
+		Close();
+		throw CUARTException("Can't set up the UART I/O thread");
+	}
+
+	Watch(m_wake[0], EPOLLIN, EPOLL_CTL_ADD);
+	if (m_listenFd >= 0)
+		Watch(m_listenFd, EPOLLIN, EPOLL_CTL_ADD);
+	else if (m_bInPollable)
+	{
+		m_nInterest = EPOLLIN;
+		Watch(m_inFd, m_nInterest, EPOLL_CTL_ADD);
+	}
+
+	if (pthread_create(&m_thread, NULL, IOThreadEntry, this) != 0)
+	{
+		Close();
+		throw CUARTException("Can't start the UART I/O thread");
+	}
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// ~CUARTCtrl - 
+// ~CUARTCtrl - Stops the I/O thread, which sends whatever is left first.
 //
 CUARTCtrl::~CUARTCtrl()
 {
-#ifndef QUIET	
+#ifndef QUIET
 	printf(MODULE_NAME": In Destructor\n");
-#endif			
-	close(masterpty);
+#endif
+	m_bStop = 1;
+	Wake();
+	pthread_join(m_thread, NULL);
+
+	Close();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Close - Closes anything we opened.
+//
+void CUARTCtrl::Close()
+{
+	if (m_inFd > 2)
+		close(m_inFd);
+	if ((m_outFd > 2) && (m_outFd != m_inFd))
+		close(m_outFd);
+	if (m_slaveFd >= 0)
+		close(m_slaveFd);
+	if (m_listenFd >= 0)
+		close(m_listenFd);
+	if (m_strSocket != NULL)
+	{
+		unlink(m_strSocket);
+		free(m_strSocket);
+	}
+	if (m_wake[0] >= 0)
+	{
+		close(m_wake[0]);
+		close(m_wake[1]);
+	}
+	if (m_epFd >= 0)
+		close(m_epFd);
 }
 
 
@@ -136,76 +322,342 @@ CUARTCtrl::~CUARTCtrl()
 //
 void CUARTCtrl::Reset()
 {
-  
+
 	memset(m_regs, 0, sizeof(uint32_t) * UARTCTRL_NUMREGS);
 	m_regs[R_UARTSTATUS] = UARTSTATUS_OUT_FREE; // Ready to output char
+	bRxBufferFree = 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Wake - Gets the I/O thread out of epoll_wait.
+//
+void CUARTCtrl::Wake()
+{
+	char c = 0;
 
+	write(m_wake[1], &c, 1);
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Cycle - 
+// Watch -
 //
-void CUARTCtrl::Cycle(UARTCTRLBUS* bus)
+void CUARTCtrl::Watch(int fd, uint32_t events, int op)
 {
-	char cCur;		
+	struct epoll_event ev;
 
-	if(bRxBufferFree)
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
+	epoll_ctl(m_epFd, op, fd, &ev);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Cycle - All we look at is the ready flag.
+//
+uint32_t CUARTCtrl::Cycle()
+{
+	if(bRxBufferFree && m_bRxReady)
 	{
-#ifndef QUIET		
-		fprintf(stderr,MODULE_NAME": Checking to READ\n");
-#endif
-		if( read(masterpty,&cCur,1) > 0 )
+		uint8_t c;
+
+		if (fifo_get(&m_rx, &c))
 		{
 			m_regs[R_UARTSTATUS] |= UARTSTATUS_IN_DATA;
-			m_regs[R_UARTRXDATA] = cCur;
-#ifndef QUIET		
-			fprintf(stderr,MODULE_NAME": Just READ [%c]\n",cCur);
-#endif			
-			bRxBufferFree = 0;	
+			m_regs[R_UARTRXDATA] = c;
+			bRxBufferFree = 0;
+
+			// The I/O thread may be waiting for room
+			__sync_synchronize();
+			if (m_bRxStalled)
+			{
+				m_bRxStalled = 0;
+				Wake();
+			}
+		}
+
+		if (fifo_count(&m_rx) == 0)
+		{
+			m_bRxReady = 0;
+			__sync_synchronize();
+			if (fifo_count(&m_rx) != 0)
+				m_bRxReady = 1;
+		}
+	}
+
+	return ((m_regs[R_UARTCONTROL] & UARTCONTROL_RX_INT) &&
+		!bRxBufferFree) ? 1 : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - The guest writes a register.
+//
+void CUARTCtrl::Write(uint32_t addr, uint32_t data)
+{
+	char cCur;
+
+#ifndef QUIET
+	fprintf(stderr,MODULE_NAME": Writing to [%x]\n",addr);
+#endif
+	if (addr == 0x0) // R_UARTTXDATA
+	{
+		// Dropped if full - the guest should check OUT_FREE
+		cCur = data;
+		if (fifo_put(&m_tx, cCur))
+		{
+			// Only need to wake the I/O thread if it might
+			// have seen the FIFO empty
+			__sync_synchronize();
+			if (fifo_count(&m_tx) == 1)
+				Wake();
 		}
+#ifndef QUIET
+		fprintf(stderr,MODULE_NAME": Just WROTE [%c]\n",cCur);
+#endif
+	}
+	else if (addr == 0x8) // R_UARTCONTROL
+		m_regs[R_UARTCONTROL] = data;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read - The guest reads a register.
+//
+uint32_t CUARTCtrl::Read(uint32_t addr)
+{
+	uint32_t data;
+
+#ifndef QUIET
+	fprintf(stderr,MODULE_NAME": Reading from [%x]\n",addr);
+#endif
+	if (addr == 0x4) // R_UARTRXDATA
+	{
+		data = m_regs[R_UARTRXDATA];
+		m_regs[R_UARTSTATUS] &= ~UARTSTATUS_IN_DATA;
+		bRxBufferFree = 1;
+	}
+	else if (addr == 0x8) // R_UARTCONTROL
+		data = m_regs[R_UARTCONTROL];
+	else if (addr == 0xC) // R_UARTSTATUS
+	{
+		data = m_regs[R_UARTSTATUS] & ~UARTSTATUS_OUT_FREE;
+		if (fifo_count(&m_tx) != UART_FIFO_SIZE)
+			data |= UARTSTATUS_OUT_FREE;
+	}
+	else // All other registers
+		data = 0;
+
+	return data;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FillRx - I/O thread. Reads as much as the RX FIFO has room for.
+//
+void CUARTCtrl::FillRx()
+{
+	uint8_t buf[UART_FIFO_SIZE];
+
+	while (m_inFd >= 0)
+	{
+		uint32_t space = UART_FIFO_SIZE - fifo_count(&m_rx);
+
+		if (space == 0)
+		{
+			// Tell Cycle to wake us when it makes room, and check
+			// it didn't just do so
+			m_bRxStalled = 1;
+			__sync_synchronize();
+			if (fifo_count(&m_rx) == UART_FIFO_SIZE)
+				return;
+			m_bRxStalled = 0;
+			continue;
+		}
+
+		int n = read(m_inFd, buf, space);
+		if (n > 0)
+		{
+			for (int i = 0; i < n; i++)
+				fifo_put(&m_rx, buf[i]);
+			__sync_synchronize();
+			m_bRxReady = 1;
+
+			// Pollable fds get read again when epoll says so
+			if (m_bInPollable)
+				return;
+		}
+		else if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR) ||
+				     (errno == EIO)))
+			return;
 		else
-			m_regs[R_UARTSTATUS] &= ~UARTSTATUS_IN_DATA;
-	}	
+		{
+			// End of input
+			if (m_listenFd >= 0)
+				Hangup();
+			else if (m_inFd == m_outFd)
+				return;
+			else
+			{
+				if (m_bInPollable)
+					epoll_ctl(m_epFd, EPOLL_CTL_DEL, m_inFd,
+						  NULL);
+				if (m_inFd > 2)
+					close(m_inFd);
+				m_inFd = -1;
+				m_nInterest = 0;
+			}
+			return;
+		}
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// DrainTx - I/O thread. Writes out everything in the TX FIFO, or as much as
+//           the host will take.
+//
+void CUARTCtrl::DrainTx()
+{
+	uint8_t buf[UART_FIFO_SIZE];
 
-	// See what the pesky real world wants
-	if (bus->w != 0)
+	while (!m_bOutBlocked)
 	{
-		uint32_t addr = bus->addr;
-#ifndef QUIET		
-		fprintf(stderr,MODULE_NAME": Writing to [%x]\n",addr);
-#endif			
-		if (addr == 0x0) // R_UARTTXDATA
+		uint32_t tail = m_tx.tail;
+		uint32_t n = m_tx.head - tail;
+
+		if (n == 0)
+			return;
+
+		__sync_synchronize();
+		for (uint32_t i = 0; i < n; i++)
+			buf[i] = m_tx.data[(tail + i) & FIFO_MASK];
+
+		// With nobody listening on the socket it just goes
+		int w = n;
+		if (m_outFd >= 0)
 		{
-			cCur = bus->data;
-			write(masterpty,&cCur,1);
-#ifndef QUIET		
-			fprintf(stderr,MODULE_NAME": Just WROTE [%c]\n",cCur);
-#endif			
+			w = write(m_outFd, buf, n);
+			if (w < 0)
+			{
+				if (errno == EAGAIN)
+					m_bOutBlocked = TRUE;
+				else if (errno != EINTR)
+				{
+					if (m_listenFd >= 0)
+						Hangup();
+					w = n;
+				}
+				if (w < 0)
+					w = 0;
+			}
 		}
-		else if (addr == 0x8) // R_UARTCONTROL
-			m_regs[R_UARTCONTROL] = bus->data;
+
+		// Free the space, then check for more - Cycle only wakes us
+		// if it sees the FIFO empty after it adds to it
+		__sync_synchronize();
+		m_tx.tail = tail + w;
+		__sync_synchronize();
 	}
+}
+
 
-	// Did the nosy busy body want any info?
-	if (bus->r != 0)
+///////////////////////////////////////////////////////////////////////////////
+// Accept - I/O thread. A client has connected to the socket.
+//
+void CUARTCtrl::Accept()
+{
+	int fd = accept(m_listenFd, NULL, NULL);
+
+	if (fd < 0)
+		return;
+
+	// One at a time
+	if (m_inFd >= 0)
+		Hangup();
+
+	set_nonblock(fd);
+	m_inFd = m_outFd = fd;
+	m_bInPollable = TRUE;
+	m_bOutBlocked = FALSE;
+	m_nInterest = EPOLLIN;
+	Watch(fd, m_nInterest, EPOLL_CTL_ADD);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Hangup - I/O thread. Drops the socket client.
+//
+void CUARTCtrl::Hangup()
+{
+	if (m_inFd < 0)
+		return;
+
+	epoll_ctl(m_epFd, EPOLL_CTL_DEL, m_inFd, NULL);
+	close(m_inFd);
+	m_inFd = m_outFd = -1;
+	m_bOutBlocked = FALSE;
+	m_nInterest = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// IOThread - Moves data between the host and the FIFOs until told to stop.
+//
+void CUARTCtrl::IOThread()
+{
+	struct epoll_event ev[4];
+
+	while (1)
 	{
-		uint32_t addr = bus->addr;
-		
-#ifndef QUIET		
-		fprintf(stderr,MODULE_NAME": Reading from [%x]\n",addr);
-#endif			
-		if (addr == 0x4) // R_UARTRXDATA
+		DrainTx();
+		if (m_bStop)
+			break;
+
+		// Regular files never show up in epoll
+		if (!m_bInPollable)
+			FillRx();
+
+		// Only ask for what we can deal with, else epoll will keep
+		// telling us about input we've no room for
+		if (m_bInPollable && (m_inFd >= 0))
+		{
+			uint32_t nInterest =
+				(m_bRxStalled ? 0 : (uint32_t)EPOLLIN) |
+				(m_bOutBlocked ? (uint32_t)EPOLLOUT : 0);
+			if (nInterest != m_nInterest)
+			{
+				m_nInterest = nInterest;
+				Watch(m_inFd, m_nInterest, EPOLL_CTL_MOD);
+			}
+		}
+
+		int n = epoll_wait(m_epFd, ev, 4, -1);
+		for (int i = 0; i < n; i++)
 		{
-			bus->data = m_regs[R_UARTRXDATA];
-			bRxBufferFree = 1;
+			if (ev[i].data.fd == m_wake[0])
+			{
+				char buf[64];
+				while (read(m_wake[0], buf, sizeof(buf)) > 0)
+					;
+			}
+			else if (ev[i].data.fd == m_listenFd)
+				Accept();
+			else if (ev[i].data.fd == m_inFd)
+			{
+				if (ev[i].events & EPOLLOUT)
+					m_bOutBlocked = FALSE;
+				if (ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					FillRx();
+			}
 		}
-		else if (addr == 0x8) // R_UARTCONTROL
-			bus->data = 0;
-		else if (addr == 0xC) // R_UARTSTATUS
-			bus->data = m_regs[R_UARTSTATUS] | UARTSTATUS_OUT_FREE;
-		else // All other registers
-			bus->data = 0;
 	}
 }
 
+void* CUARTCtrl::IOThreadEntry(void* arg)
+{
+	((CUARTCtrl*)arg)->IOThread();
+	return NULL;
+}
@@ -1,29 +1,46 @@
 /*****************************************************************************
- * 
+ *
  * Copyright (C) 2001 C Hanish Menon [www.hanishkvc.com]
- * 
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
  * (at your option) any later version.
- * 
+ *
  * This program is distributed in the hope that it will be useful,
  * but WITHOUT ANY WARRANTY; without even the implied warranty of
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * GNU General Public License for more details.
- * 
+ *
  * You should have received a copy of the GNU General Public License
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
- * 
+ *
  * Name   : uartctrl.h
  * Author : C Hanish Menon [www.hanishkvc.com]
- * 
+ *
+ * The host side of the UART lives on its own thread. It moves characters
+ * between the host (a pty, stdio, a file or a Unix socket) and a pair of
+ * single producer/single consumer FIFOs, so the simulated side never
+ * makes a system call except to wake the thread when it has something to
+ * send. Backends are given as:
+ *
+ *   pty          a new pseudo terminal, the slave name is printed
+ *   stdio        stdin/stdout
+ *   file:out     output appended to out, no input
+ *   file:out,in  as above, with input read from in
+ *   unix:path    listen on a Unix socket at path, one client at a time
+ *
  ****************************************************************************/
 
 #ifndef __UARTCTRL_H__
 #define __UARTCTRL_H__
 
+#include <pthread.h>
+#include "swarm.h"
+#include "device.h"
+
+#define UARTCTRL_SIZE 0x1000
 #define UARTCTRL_NUMREGS 8
 
 #define R_UARTTXDATA     0x0
@@ -38,33 +55,75 @@
 #define UARTSTATUS_IN_DATA 0x1
 #define UARTSTATUS_OUT_FREE 0x2
 
-typedef struct UARTCTRLBTAG
+#define UARTCONTROL_RX_INT 0x1   // Interrupt while there is data to read
+
+// Must be a power of two
+#define UART_FIFO_SIZE 4096
+
+// Head is only written by the producer, tail only by the consumer
+typedef struct UARTFIFOTAG
 {
-  uint32_t addr: 32;      // IN - address, 0 to 7
-  uint32_t data: 32;      // IN/OUT - 32 bits of data
-  uint32_t interrupt: 1;  // OUT - has an interrupt happened?
-  uint32_t r:1;           // IN - is a read happening?
-  uint32_t w:1;           // IN - is a write happening?
-} UARTCTRLBUS;
-
-class CUARTCtrl
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  uint8_t data[UART_FIFO_SIZE];
+} UARTFIFO;
+
+class CUARTException : public CException
+{
+ public:
+  CUARTException(const char* strError);
+};
+
+class CUARTCtrl : public CDevice
 {
   // Constuctors and destructor
  public:
-  CUARTCtrl();
+  CUARTCtrl(const char* strBackend);
   ~CUARTCtrl();
 
  public:
-  void Cycle(UARTCTRLBUS* bus);
-  void Reset();
+  uint32_t Cycle();
+  uint32_t Read(uint32_t addr);
+  void     Write(uint32_t addr, uint32_t data);
+  void     Reset();
+  uint32_t GetSize() { return UARTCTRL_SIZE; }
 
  private:
   uint32_t m_regs[UARTCTRL_NUMREGS];
-  int masterpty, slavepty;
   int bRxBufferFree;
-	
+
+  // Set by the I/O thread when it puts something in the RX FIFO, cleared
+  // by us when we empty it - all Cycle looks at most of the time.
+  volatile int m_bRxReady;
+  volatile int m_bRxStalled;  // I/O thread is waiting for RX FIFO space
+  volatile int m_bStop;
+
+  UARTFIFO m_rx;
+  UARTFIFO m_tx;
+
+  // Only touched by the I/O thread once it is running
+  int m_inFd, m_outFd;
+  int m_slaveFd;
+  int m_listenFd;
+  char* m_strSocket;
+  bool_t m_bInPollable;
+  bool_t m_bOutBlocked;
+  uint32_t m_nInterest;
+  int m_wake[2];
+  int m_epFd;
+  pthread_t m_thread;
+
   int GetPty();
+  int OpenBackend(const char* strBackend);
+  void Close();
+  void Wake();
+  void Watch(int fd, uint32_t events, int op);
+  void FillRx();
+  void DrainTx();
+  void Accept();
+  void Hangup();
+  void IOThread();
+  static void* IOThreadEntry(void* arg);
 };
 
 #endif // __UARTCTRL_H__
-
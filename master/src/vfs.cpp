@@ -0,0 +1,667 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   vfs.cpp
+// header vfs.h
+// info   Implements the in memory files behind the libc calls.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "swarm.h"
+#include "vfs.h"
+
+#define VFS_MINALLOC 4096
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CVFSException -
+//
+CVFSException::CVFSException(const char* strError, const char* strFile)
+{
+  free(m_strError);
+
+  m_strError = (char*)malloc(strlen(strError) + strlen(strFile) + 3);
+  sprintf(m_strError, "%s: %s", strError, strFile);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CVFS -
+//
+CVFS::CVFS(bool_t bMemWrites)
+{
+  m_bMemWrites = bMemWrites;
+  m_pNodes = NULL;
+  memset(m_files, 0, sizeof(m_files));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CVFS - Anything not yet written goes out now.
+//
+CVFS::~CVFS()
+{
+  SyncAll();
+
+  for (int i = 0; i < VFS_MAXFILES; i++)
+    if (m_files[i].pNode != NULL)
+      Close(VFS_FDBASE + i);
+
+  while (m_pNodes != NULL)
+    {
+      VFSNODE* pNext = m_pNodes->pNext;
+      Free(m_pNodes);
+      m_pNodes = pNext;
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Preload - Maps a host file. The mapping is shared with anyone else who has
+//           it mapped until the program writes to it.
+//
+void CVFS::Preload(const char* strPath)
+{
+  struct stat st;
+  int fd;
+
+  if (Find(strPath) != NULL)
+    return;
+
+  fd = open(strPath, O_RDONLY);
+  if (fd == -1)
+    throw CVFSException("Can't open file to preload", strPath);
+  if ((fstat(fd, &st) == -1) || !S_ISREG(st.st_mode))
+    {
+      close(fd);
+      throw CVFSException("Can only preload regular files", strPath);
+    }
+  if ((uint64_t)st.st_size > 0xFFFFFFFF)
+    {
+      close(fd);
+      throw CVFSException("File is too big to preload", strPath);
+    }
+
+  uint8_t* pData = NULL;
+  if (st.st_size != 0)
+    {
+      pData = (uint8_t*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (pData == (uint8_t*)MAP_FAILED)
+	{
+	  close(fd);
+	  throw CVFSException("Can't map file to preload", strPath);
+	}
+    }
+  close(fd);
+
+  VFSNODE* pNode = Add(strPath);
+  pNode->pData = pData;
+  pNode->nSize = st.st_size;
+  pNode->bMapped = (pData != NULL);
+  pNode->mtime = st.st_mtime;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Find - Only nodes that haven't been unlinked have a path.
+//
+VFSNODE* CVFS::Find(const char* strPath)
+{
+  for (VFSNODE* pNode = m_pNodes; pNode != NULL; pNode = pNode->pNext)
+    if (strcmp(pNode->strPath, strPath) == 0)
+      return pNode;
+
+  return NULL;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add - A new empty file.
+//
+VFSNODE* CVFS::Add(const char* strPath)
+{
+  VFSNODE* pNode = (VFSNODE*)malloc(sizeof(VFSNODE));
+
+  memset(pNode, 0, sizeof(VFSNODE));
+  pNode->strPath = strdup(strPath);
+  pNode->mtime = time(NULL);
+  pNode->mode = 0666;
+  pNode->pNext = m_pNodes;
+  m_pNodes = pNode;
+
+  return pNode;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Unlink - Takes a node out of the list. It stays around until the last
+//          file open on it is closed.
+//
+void CVFS::Unlink(VFSNODE* pNode)
+{
+  VFSNODE** ppNode = &m_pNodes;
+
+  while (*ppNode != pNode)
+    ppNode = &(*ppNode)->pNext;
+  *ppNode = pNode->pNext;
+
+  if (pNode->nOpen == 0)
+    Free(pNode);
+  else
+    pNode->bUnlinked = TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Free -
+//
+void CVFS::Free(VFSNODE* pNode)
+{
+  if (pNode->bMapped)
+    munmap(pNode->pData, pNode->nSize);
+  else if (pNode->pData != NULL)
+    free(pNode->pData);
+  free(pNode->strPath);
+  free(pNode);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// File - The open file for one of our descriptors, or NULL.
+//
+VFSFILE* CVFS::File(int fd)
+{
+  if (!IsOurs(fd) || (m_files[fd - VFS_FDBASE].pNode == NULL))
+    return NULL;
+
+  return &m_files[fd - VFS_FDBASE];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Grow - Makes sure a node has nSize bytes of its own to write to, taking a
+//        copy of a mapped file first. The space is doubled each time so
+//        lots of small writes don't each copy the file.
+//
+bool_t CVFS::Grow(VFSNODE* pNode, uint32_t nSize)
+{
+  if (!pNode->bMapped && (nSize <= pNode->nAlloc))
+    return TRUE;
+
+  uint32_t nAlloc = pNode->nAlloc * 2;
+  if (nAlloc < nSize)
+    nAlloc = nSize;
+  if (nAlloc < VFS_MINALLOC)
+    nAlloc = VFS_MINALLOC;
+
+  uint8_t* pData = (uint8_t*)malloc(nAlloc);
+  if (pData == NULL)
+    return FALSE;
+
+  if (pNode->pData != NULL)
+    {
+      memcpy(pData, pNode->pData, pNode->nSize);
+      if (pNode->bMapped)
+	munmap(pNode->pData, pNode->nSize);
+      else
+	free(pNode->pData);
+    }
+
+  pNode->pData = pData;
+  pNode->nAlloc = nAlloc;
+  pNode->bMapped = FALSE;
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadHost - Fills a new node from the host file of the same name. Returns
+//            FALSE with errno set if it couldn't be read.
+//
+bool_t CVFS::ReadHost(VFSNODE* pNode)
+{
+  struct stat st;
+  int fd;
+
+  fd = open(pNode->strPath, O_RDONLY);
+  if (fd == -1)
+    return FALSE;
+  if (fstat(fd, &st) == -1)
+    {
+      close(fd);
+      return FALSE;
+    }
+  if ((uint64_t)st.st_size > 0xFFFFFFFF)
+    {
+      close(fd);
+      errno = EFBIG;
+      return FALSE;
+    }
+
+  if (!Grow(pNode, st.st_size))
+    {
+      close(fd);
+      errno = ENOMEM;
+      return FALSE;
+    }
+
+  uint32_t nDone = 0;
+  while (nDone < (uint64_t)st.st_size)
+    {
+      ssize_t n = read(fd, pNode->pData + nDone, st.st_size - nDone);
+      if (n <= 0)
+	break;
+      nDone += n;
+    }
+  close(fd);
+
+  pNode->nSize = nDone;
+  pNode->mtime = st.st_mtime;
+
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open - Preloaded files are always ours. Other files are ours only if
+//        they're opened for writing and writes are being kept in memory.
+//
+int CVFS::Open(const char* strPath, int flags, int mode)
+{
+  VFSNODE* pNode = Find(strPath);
+  int nAccess = flags & O_ACCMODE;
+  bool_t bNew = FALSE;
+  int fd;
+
+  if ((pNode == NULL) && (!m_bMemWrites || (nAccess == O_RDONLY)))
+    return VFS_NOTOURS;
+
+  for (fd = 0; fd < VFS_MAXFILES; fd++)
+    if (m_files[fd].pNode == NULL)
+      break;
+  if (fd == VFS_MAXFILES)
+    {
+      errno = EMFILE;
+      return -1;
+    }
+
+  if (pNode == NULL)
+    {
+      struct stat st;
+      bool_t bExists = (stat(strPath, &st) == 0);
+
+      if (bExists && ((flags & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL)))
+	{
+	  errno = EEXIST;
+	  return -1;
+	}
+      if (!bExists && ((flags & O_CREAT) == 0))
+	{
+	  errno = ENOENT;
+	  return -1;
+	}
+
+      pNode = Add(strPath);
+      bNew = TRUE;
+      if (!bExists)
+	pNode->mode = mode;
+      if (bExists && ((flags & O_TRUNC) == 0) && !ReadHost(pNode))
+	{
+	  int nErrno = errno;
+	  Unlink(pNode);
+	  errno = nErrno;
+	  return -1;
+	}
+
+      // A new or truncated file has to reach the host even if it is
+      // never written to
+      pNode->bDirty = !bExists || ((flags & O_TRUNC) != 0);
+    }
+  else if ((flags & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL))
+    {
+      errno = EEXIST;
+      return -1;
+    }
+
+  if (!bNew && (nAccess != O_RDONLY) && ((flags & O_TRUNC) != 0))
+    {
+      if (pNode->bMapped)
+	{
+	  munmap(pNode->pData, pNode->nSize);
+	  pNode->pData = NULL;
+	  pNode->bMapped = FALSE;
+	}
+      pNode->nSize = 0;
+      pNode->bDirty = TRUE;
+      pNode->mtime = time(NULL);
+    }
+
+  m_files[fd].pNode = pNode;
+  m_files[fd].nPos = 0;
+  m_files[fd].flags = flags;
+  pNode->nOpen++;
+
+  return VFS_FDBASE + fd;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Close - Nothing is written to the host until it is synced.
+//
+int CVFS::Close(int fd)
+{
+  VFSFILE* pFile = File(fd);
+
+  if (pFile == NULL)
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  VFSNODE* pNode = pFile->pNode;
+  pFile->pNode = NULL;
+  if ((--pNode->nOpen == 0) && pNode->bUnlinked)
+    Free(pNode);
+
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read -
+//
+int CVFS::Read(int fd, void* pBuf, uint32_t nBytes)
+{
+  VFSFILE* pFile = File(fd);
+
+  if ((pFile == NULL) || ((pFile->flags & O_ACCMODE) == O_WRONLY))
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  VFSNODE* pNode = pFile->pNode;
+  if (pFile->nPos >= pNode->nSize)
+    return 0;
+  if (nBytes > pNode->nSize - pFile->nPos)
+    nBytes = pNode->nSize - pFile->nPos;
+
+  memcpy(pBuf, pNode->pData + pFile->nPos, nBytes);
+  pFile->nPos += nBytes;
+
+  return nBytes;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write - Writing past the end leaves a hole of zeros, as it would on the
+//         host.
+//
+int CVFS::Write(int fd, const void* pBuf, uint32_t nBytes)
+{
+  VFSFILE* pFile = File(fd);
+
+  if ((pFile == NULL) || ((pFile->flags & O_ACCMODE) == O_RDONLY))
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  VFSNODE* pNode = pFile->pNode;
+  if ((pFile->flags & O_APPEND) != 0)
+    pFile->nPos = pNode->nSize;
+  if (nBytes == 0)
+    return 0;
+  if (nBytes > 0xFFFFFFFF - pFile->nPos)
+    {
+      errno = EFBIG;
+      return -1;
+    }
+
+  uint32_t nEnd = pFile->nPos + nBytes;
+  if (!Grow(pNode, (nEnd > pNode->nSize) ? nEnd : pNode->nSize))
+    {
+      errno = ENOSPC;
+      return -1;
+    }
+
+  if (pFile->nPos > pNode->nSize)
+    memset(pNode->pData + pNode->nSize, 0, pFile->nPos - pNode->nSize);
+  memcpy(pNode->pData + pFile->nPos, pBuf, nBytes);
+  pFile->nPos = nEnd;
+  if (nEnd > pNode->nSize)
+    pNode->nSize = nEnd;
+  pNode->bDirty = TRUE;
+  pNode->mtime = time(NULL);
+
+  return nBytes;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Seek -
+//
+off_t CVFS::Seek(int fd, off_t offset, int whence)
+{
+  VFSFILE* pFile = File(fd);
+  int64_t nPos;
+
+  if (pFile == NULL)
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  switch (whence)
+    {
+    case SEEK_SET:
+      nPos = offset;
+      break;
+    case SEEK_CUR:
+      nPos = (int64_t)pFile->nPos + offset;
+      break;
+    case SEEK_END:
+      nPos = (int64_t)pFile->pNode->nSize + offset;
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+    }
+
+  if ((nPos < 0) || (nPos > 0xFFFFFFFF))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  pFile->nPos = nPos;
+  return nPos;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fill - What stat says about one of our files.
+//
+void CVFS::Fill(VFSNODE* pNode, struct stat* pStat)
+{
+  memset(pStat, 0, sizeof(struct stat));
+  pStat->st_mode = S_IFREG | 0644;
+  pStat->st_nlink = pNode->bUnlinked ? 0 : 1;
+  pStat->st_uid = getuid();
+  pStat->st_gid = getgid();
+  pStat->st_size = pNode->nSize;
+  pStat->st_blksize = VFS_MINALLOC;
+  pStat->st_blocks = (pNode->nSize + 511) / 512;
+  pStat->st_atime = pStat->st_mtime = pStat->st_ctime = pNode->mtime;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Stat -
+//
+int CVFS::Stat(const char* strPath, struct stat* pStat)
+{
+  VFSNODE* pNode = Find(strPath);
+
+  if (pNode == NULL)
+    return VFS_NOTOURS;
+
+  Fill(pNode, pStat);
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FStat -
+//
+int CVFS::FStat(int fd, struct stat* pStat)
+{
+  VFSFILE* pFile = File(fd);
+
+  if (pFile == NULL)
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  Fill(pFile->pNode, pStat);
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Unlink - If writes are kept in memory the host file goes too, or it would
+//          come back the next time the file was opened.
+//
+int CVFS::Unlink(const char* strPath)
+{
+  VFSNODE* pNode = Find(strPath);
+
+  if (pNode == NULL)
+    return VFS_NOTOURS;
+
+  if (m_bMemWrites && (unlink(strPath) == -1) && (errno != ENOENT))
+    return -1;
+
+  Unlink(pNode);
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Rename - If only the new path is ours, the host does the rename and our
+//          file is forgotten.
+//
+int CVFS::Rename(const char* strOld, const char* strNew)
+{
+  VFSNODE* pOld = Find(strOld);
+  VFSNODE* pNew = Find(strNew);
+
+  if (pOld == NULL)
+    {
+      if (pNew != NULL)
+	Unlink(pNew);
+      return VFS_NOTOURS;
+    }
+  if (pOld == pNew)
+    return 0;
+
+  if (m_bMemWrites && (unlink(strOld) == -1) && (errno != ENOENT))
+    return -1;
+
+  if (pNew != NULL)
+    Unlink(pNew);
+
+  free(pOld->strPath);
+  pOld->strPath = strdup(strNew);
+  pOld->bDirty = TRUE;
+
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SyncNode - Writes a file back to the host, if it has changed and writes
+//            are being kept in memory.
+//
+int CVFS::SyncNode(VFSNODE* pNode)
+{
+  if (!pNode->bDirty || !m_bMemWrites || pNode->bUnlinked)
+    return 0;
+
+  int fd = open(pNode->strPath, O_WRONLY | O_CREAT | O_TRUNC, pNode->mode);
+  if (fd == -1)
+    return -1;
+
+  uint32_t nDone = 0;
+  while (nDone < pNode->nSize)
+    {
+      ssize_t n = write(fd, pNode->pData + nDone, pNode->nSize - nDone);
+      if (n == -1)
+	{
+	  int nErrno = errno;
+	  close(fd);
+	  errno = nErrno;
+	  return -1;
+	}
+      nDone += n;
+    }
+
+  if (close(fd) == -1)
+    return -1;
+
+  pNode->bDirty = FALSE;
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Sync - fsync for one of our files.
+//
+int CVFS::Sync(int fd)
+{
+  VFSFILE* pFile = File(fd);
+
+  if (pFile == NULL)
+    {
+      errno = EBADF;
+      return -1;
+    }
+
+  return SyncNode(pFile->pNode);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SyncAll - Writes out everything that has changed. There is nobody to tell
+//           if this fails, so we say so ourselves.
+//
+void CVFS::SyncAll()
+{
+  for (VFSNODE* pNode = m_pNodes; pNode != NULL; pNode = pNode->pNext)
+    if (SyncNode(pNode) == -1)
+      fprintf(stderr, "Error: Can't write %s: %s\n", pNode->strPath,
+	      strerror(errno));
+}
@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// name   vfs.h
+// header n/a
+// info   Files held in memory for the libc calls, so the program being
+//        run doesn't have to go to the host's filesystem for them.
+//
+//        Preloaded files are mapped read only from the host when we start,
+//        so swarms running side by side share the one copy in the host's
+//        page cache. If the program writes to one it gets a copy of its
+//        own.
+//
+//        If asked, files opened for writing are kept in memory too (read
+//        in first unless truncated), and only written to the host when
+//        they are synced or we exit. Otherwise they go to the host as
+//        before, and changes to preloaded files are never written back.
+//
+//        Our descriptors start at VFS_FDBASE so they can't be mistaken
+//        for the host's. The calls return -1 and set errno as the host
+//        calls do, or VFS_NOTOURS if the path isn't one of ours.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VFS_H__
+#define __VFS_H__
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "swarm.h"
+
+#define VFS_FDBASE   1024
+#define VFS_MAXFILES 64      // Open at once
+#define VFS_NOTOURS  (-2)
+
+typedef struct VFSNODETAG
+{
+  char*     strPath;
+  uint8_t*  pData;
+  uint32_t  nSize;
+  uint32_t  nAlloc;
+  bool_t    bMapped;    // pData is the host's file, and nAlloc is 0
+  bool_t    bDirty;     // Needs writing to the host
+  bool_t    bUnlinked;  // Gone, but still open
+  uint32_t  nOpen;
+  time_t    mtime;
+  mode_t    mode;       // To create it on the host with
+  struct VFSNODETAG* pNext;
+} VFSNODE;
+
+typedef struct VFSFILETAG
+{
+  VFSNODE*  pNode;
+  uint32_t  nPos;
+  int       flags;
+} VFSFILE;
+
+class CVFSException : public CException
+{
+ public:
+  CVFSException(const char* strError, const char* strFile);
+};
+
+class CVFS
+{
+  // Constructors and destructor
+ public:
+  CVFS(bool_t bMemWrites);
+  ~CVFS();                                // Syncs everything
+
+  // Public methods
+ public:
+  void Preload(const char* strPath);      // Throws a CVFSException
+
+  inline bool_t IsOurs(int fd)
+    { return (fd >= VFS_FDBASE) && (fd < VFS_FDBASE + VFS_MAXFILES); }
+
+  int   Open(const char* strPath, int flags, int mode);
+  int   Close(int fd);
+  int   Read(int fd, void* pBuf, uint32_t nBytes);
+  int   Write(int fd, const void* pBuf, uint32_t nBytes);
+  off_t Seek(int fd, off_t offset, int whence);
+  int   Stat(const char* strPath, struct stat* pStat);
+  int   FStat(int fd, struct stat* pStat);
+  int   Unlink(const char* strPath);
+  int   Rename(const char* strOld, const char* strNew);
+  int   Sync(int fd);
+  void  SyncAll();
+
+  inline int GetFlags(int fd)
+    { return (File(fd) == NULL) ? -1 : File(fd)->flags; }
+
+  // Private methods
+ private:
+  VFSNODE* Find(const char* strPath);
+  VFSNODE* Add(const char* strPath);
+  void     Unlink(VFSNODE* pNode);
+  void     Free(VFSNODE* pNode);
+  VFSFILE* File(int fd);
+  bool_t   Grow(VFSNODE* pNode, uint32_t nSize);
+  bool_t   ReadHost(VFSNODE* pNode);
+  int      SyncNode(VFSNODE* pNode);
+  void     Fill(VFSNODE* pNode, struct stat* pStat);
+
+  // Private data
+ private:
+  bool_t   m_bMemWrites;
+  VFSNODE* m_pNodes;
+  VFSFILE  m_files[VFS_MAXFILES];
+};
+
+#endif // __VFS_H__